@@ -0,0 +1,124 @@
+/* Public header */
+#include "buffer_ring.h"
+
+/* Standard libraries */
+#include <stdlib.h>
+#include <string.h>
+
+/* Definitions - slot alignment (bytes) */
+#define SLOT_ALIGN (64)
+
+/* Public functions */
+bool BUFFER_RING_Init(BUFFER_RING_t *ring, size_t capacity, size_t buffer_size)
+{
+	/* Reset ring */
+	memset(ring, 0x00, sizeof(*ring));
+	ring->capacity = capacity;
+	ring->buffer_size = buffer_size;
+	atomic_init(&ring->head, 0);
+	atomic_init(&ring->tail, 0);
+
+	/* Allocate slots and their storage, each slot starting on a cache line (keeping the timestamp aligned) */
+	size_t stride = (buffer_size + (SLOT_ALIGN - 1U)) & ~(size_t)(SLOT_ALIGN - 1U);
+	ring->slots = calloc(capacity, sizeof(BUFFER_RING_Slot_t));
+	if (0 != posix_memalign((void**)&ring->mem, SLOT_ALIGN, capacity * stride))
+	{
+		ring->mem = NULL;
+	}
+	if (!ring->slots || !ring->mem)
+	{
+		BUFFER_RING_Free(ring);
+		return false;
+	}
+
+	/* Point slots at their storage */
+	for (size_t i = 0; i < capacity; i++)
+	{
+		ring->slots[i].data = &ring->mem[i * stride];
+	}
+
+	return true;
+}
+
+void BUFFER_RING_Free(BUFFER_RING_t *ring)
+{
+	free(ring->slots);
+	free(ring->mem);
+	ring->slots = NULL;
+	ring->mem = NULL;
+}
+
+size_t BUFFER_RING_Count(BUFFER_RING_t *ring)
+{
+	uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+	uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+	return (size_t)(tail - head);
+}
+
+size_t BUFFER_RING_Space(BUFFER_RING_t *ring)
+{
+	/* One slot always remains the producer's */
+	return ring->capacity - 1U - BUFFER_RING_Count(ring);
+}
+
+BUFFER_RING_Slot_t *BUFFER_RING_WriteSlot(BUFFER_RING_t *ring, size_t offset)
+{
+	/* Only the producer advances the tail, so a relaxed load suffices */
+	uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+	return &ring->slots[(tail + offset) % ring->capacity];
+}
+
+bool BUFFER_RING_Commit(BUFFER_RING_t *ring)
+{
+	uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+	/* Keep one slot back for the producer */
+	if ((tail - head) >= (ring->capacity - 1))
+	{
+		return false;
+	}
+
+	/* Publish slot (release ensures slot contents are visible before the index) */
+	atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+
+	return true;
+}
+
+BUFFER_RING_Slot_t *BUFFER_RING_ReadSlot(BUFFER_RING_t *ring)
+{
+	uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+	if (head == tail)
+	{
+		/* Empty */
+		return NULL;
+	}
+
+	return &ring->slots[head % ring->capacity];
+}
+
+BUFFER_RING_Slot_t *BUFFER_RING_PeekSlot(BUFFER_RING_t *ring, size_t offset)
+{
+	uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+	if (offset >= (tail - head))
+	{
+		/* Not committed */
+		return NULL;
+	}
+
+	return &ring->slots[(head + offset) % ring->capacity];
+}
+
+void BUFFER_RING_Release(BUFFER_RING_t *ring)
+{
+	uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+	/* Hand slot back to producer (release ensures our reads complete first) */
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
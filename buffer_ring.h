@@ -0,0 +1,94 @@
+#ifndef __BUFFER_RING_H__
+#define __BUFFER_RING_H__
+
+/* Standard libraries */
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Type definitions - slot */
+typedef struct
+{
+	/* Slot data (buffer_size bytes) */
+	uint8_t *data;
+
+	/* Slot holds a buffer to be pushed (if clear the producer abandoned it, it should be skipped) */
+	bool valid;
+
+	/* Sequence number / timestamp of buffer held */
+	uint64_t seqno;
+
+	/* Size of buffer held, to be pushed (bytes, including any timestamp) and samples (excluding timestamp) */
+	size_t size;
+	size_t samples;
+
+	/* Time buffer was committed (uS, monotonic) */
+	uint64_t commit_time;
+
+	/* Time final datagram of burst was received (uS, monotonic, zero unless buffer ends a burst) */
+	uint64_t burst_time;
+
+	/* Time first datagram flagged as a loopback marker was received (uS, monotonic, zero unless buffer is marked) */
+	uint64_t marker_time;
+
+} BUFFER_RING_Slot_t;
+
+/*
+** Type definitions - ring
+** Single producer, single consumer lock free ring of fixed size buffers.
+** The producer fills slots returned by BUFFER_RING_WriteSlot() in place before committing them (in order),
+** therefore at most (capacity - 1) slots are ever queued, at least one slot remaining the producer's.
+*/
+typedef struct
+{
+	/* Slot array */
+	BUFFER_RING_Slot_t *slots;
+
+	/* Backing storage for slot data */
+	uint8_t *mem;
+
+	/* Number of slots */
+	size_t capacity;
+
+	/* Size of each slot (bytes) */
+	size_t buffer_size;
+
+	/*
+	** Free running indices, head advanced by consumer, tail by producer
+	** 64 bits even on 32-bit targets, such that they never wrap (capacity not being a power of two, a wrapped index
+	** would no longer map to the same slot).
+	*/
+	_Atomic uint64_t head;
+	_Atomic uint64_t tail;
+
+} BUFFER_RING_t;
+
+/* Allocate ring */
+bool BUFFER_RING_Init(BUFFER_RING_t *ring, size_t capacity, size_t buffer_size);
+
+/* Free ring */
+void BUFFER_RING_Free(BUFFER_RING_t *ring);
+
+/* Number of committed slots */
+size_t BUFFER_RING_Count(BUFFER_RING_t *ring);
+
+/* Producer - number of further slots which may be committed */
+size_t BUFFER_RING_Space(BUFFER_RING_t *ring);
+
+/* Producer - retrieve slot to fill, offset slots beyond the next to be committed (offset must be less than space) */
+BUFFER_RING_Slot_t *BUFFER_RING_WriteSlot(BUFFER_RING_t *ring, size_t offset);
+
+/* Producer - commit next write slot, returning false if the ring is full (slot left uncommitted) */
+bool BUFFER_RING_Commit(BUFFER_RING_t *ring);
+
+/* Consumer - retrieve oldest committed slot, NULL if ring empty */
+BUFFER_RING_Slot_t *BUFFER_RING_ReadSlot(BUFFER_RING_t *ring);
+
+/* Consumer - retrieve committed slot, offset slots beyond the oldest, NULL if fewer are committed */
+BUFFER_RING_Slot_t *BUFFER_RING_PeekSlot(BUFFER_RING_t *ring, size_t offset);
+
+/* Consumer - release slot returned by BUFFER_RING_ReadSlot() */
+void BUFFER_RING_Release(BUFFER_RING_t *ring);
+
+#endif
@@ -6,12 +6,19 @@
 #include <errno.h>
 #include <sys/epoll.h>
 
+/* Local modules */
+#include "trace.h"
+#include "utils.h"
+
 /* Macros */
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
 
 /* Epoll event handler */
 typedef int (*epoll_event_handler)(void *arg);
 
+/* Private functions */
+static int dispatch(struct epoll_event *epoll_events, int event_count, void *handler_arg);
+
 /* Public functions */
 int EPOLL_LOOP_Run(int epoll_fd, int timeout, void *handler_arg)
 {
@@ -32,6 +39,59 @@ int EPOLL_LOOP_Run(int epoll_fd, int timeout, void *handler_arg)
 		return 0;
 	}
 
+	return dispatch(epoll_events, event_count, handler_arg);
+}
+
+int EPOLL_LOOP_RunPolled(int epoll_fd, int timeout, int32_t spin_us, void *handler_arg)
+{
+	if (0 == spin_us)
+	{
+		return EPOLL_LOOP_Run(epoll_fd, timeout, handler_arg);
+	}
+
+	/* Poll until an event arrives, the budget is spent or the timeout expires */
+	struct epoll_event epoll_events[10];
+	uint64_t start = UTILS_GetMonotonicMicros();
+	for (;;)
+	{
+		int event_count = epoll_wait(epoll_fd, epoll_events, ARRAY_SIZE(epoll_events), 0);
+		if (event_count < 0)
+		{
+			if (EINTR != errno)
+			{
+				perror("Epoll failed");
+				return -1;
+			}
+			return 0;
+		}
+		if (event_count > 0)
+		{
+			return dispatch(epoll_events, event_count, handler_arg);
+		}
+
+		uint64_t elapsed = UTILS_GetMonotonicMicros() - start;
+		if ((timeout >= 0) && (elapsed >= ((uint64_t)timeout * 1000U)))
+		{
+			/* Timed out */
+			return 0;
+		}
+		if ((spin_us > 0) && (elapsed >= (uint64_t)spin_us))
+		{
+			/* Budget spent, block for the remainder of the timeout */
+			int remaining = (timeout >= 0) ? (timeout - (int)(elapsed / 1000U)) : -1;
+			return EPOLL_LOOP_Run(epoll_fd, remaining, handler_arg);
+		}
+	}
+}
+
+/* Private functions */
+static int dispatch(struct epoll_event *epoll_events, int event_count, void *handler_arg)
+{
+	if (event_count > 0)
+	{
+		TRACE_Record(TRACE_EVENT_WAKE, (uint32_t)event_count, TRACE_Now());
+	}
+
 	/* Iterate over events */
 	for (int i = 0; i < event_count; i++)
 	{
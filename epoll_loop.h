@@ -1,7 +1,21 @@
 #ifndef __EPOLL_LOOP_H__
 #define __EPOLL_LOOP_H__
 
+/* Standard libraries */
+#include <stdint.h>
+
+/* Definitions - busy poll budget never blocking */
+#define EPOLL_LOOP_SPIN_FOREVER (-1)
+
 /* Wait for and handle epoll events */
 int EPOLL_LOOP_Run(int epoll_fd, int timeout, void *handler_arg);
 
+/*
+** Wait for and handle epoll events, spinning (polling without sleeping) for up to spin_us uS before blocking
+** Spinning avoids the scheduler wakeup latency of a blocking wait, at the cost of occupying a CPU. A budget of
+** zero blocks immediately (as EPOLL_LOOP_Run()), while EPOLL_LOOP_SPIN_FOREVER never blocks. The timeout (mS)
+** is observed either way.
+*/
+int EPOLL_LOOP_RunPolled(int epoll_fd, int timeout, int32_t spin_us, void *handler_arg);
+
 #endif
@@ -0,0 +1,38 @@
+/* Public header */
+#include "fec.h"
+
+/*
+** Type definitions - 128-bit vector
+** GCC lowers operations on this type to NEON on ARM and SSE2 on x86, falling back to scalar code elsewhere.
+** The reduced alignment and may_alias attributes permit loads / stores from arbitrary packet offsets.
+*/
+typedef uint64_t fec_vec_t __attribute__((vector_size(16), aligned(1), may_alias));
+
+/* Public functions */
+void FEC_XorBlock(uint8_t *dst, const uint8_t *src, size_t len)
+{
+	size_t i = 0;
+
+	/* Four vectors per iteration, giving the core independent loads to overlap */
+	for (; (i + (4 * sizeof(fec_vec_t))) <= len; i += (4 * sizeof(fec_vec_t)))
+	{
+		fec_vec_t *d = (fec_vec_t*)&dst[i];
+		const fec_vec_t *s = (const fec_vec_t*)&src[i];
+		d[0] ^= s[0];
+		d[1] ^= s[1];
+		d[2] ^= s[2];
+		d[3] ^= s[3];
+	}
+
+	/* Remaining whole vectors */
+	for (; (i + sizeof(fec_vec_t)) <= len; i += sizeof(fec_vec_t))
+	{
+		*(fec_vec_t*)&dst[i] ^= *(const fec_vec_t*)&src[i];
+	}
+
+	/* Remaining bytes */
+	for (; i < len; i++)
+	{
+		dst[i] ^= src[i];
+	}
+}
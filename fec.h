@@ -0,0 +1,11 @@
+#ifndef __FEC_H__
+#define __FEC_H__
+
+/* Standard libraries */
+#include <stdint.h>
+#include <stddef.h>
+
+/* XOR src into dst (len bytes, no alignment requirements) */
+void FEC_XorBlock(uint8_t *dst, const uint8_t *src, size_t len);
+
+#endif
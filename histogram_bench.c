@@ -0,0 +1,160 @@
+/* Standard / system libraries */
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Local modules */
+#include "utils.h"
+
+/* Definitions - values recorded unless requested otherwise, and size of the table they're drawn from (power of two) */
+#define DEFAULT_RECORDS (10000000U)
+#define VALUE_TABLE_SIZE (65536U)
+
+/* Private functions */
+static void fill_values(uint32_t *values);
+static void report(const char *name, uint64_t start_us, uint64_t count);
+static void print_usage(const char *program_name, FILE *dest);
+
+/* Public functions */
+int main(int argc, char *argv[])
+{
+	/* Long options array, mapping options to their short equivalents */
+	struct option long_options[] = {
+		{"count", required_argument, NULL, 'n'},
+		{"version", no_argument, NULL, 'v'},
+		{"help", no_argument, NULL, 'h'},
+		{0, 0, 0, 0} // Terminate the options array
+	};
+
+	/* Basic argument parsing */
+	int opt_c;
+	bool err = false;
+	unsigned long records = DEFAULT_RECORDS;
+	int opt_index = 0;
+	while ((opt_c = getopt_long(argc, argv, "hn:v", long_options, &opt_index)) != -1)
+	{
+		switch (opt_c)
+		{
+			case 'n':
+			{
+				records = strtoul(optarg, NULL, 0);
+				if ((records < 1000) || (records > 1000000000))
+				{
+					fprintf(stderr, "Error: Count must be 1000 to 1000000000\n");
+					err = true;
+				}
+				break;
+			}
+			case 'v':
+			{
+				printf("Version %s\n", PROGRAM_VERSION);
+				return 0;
+			}
+			case 'h':
+			{
+				print_usage(argv[0], stdout);
+				return 0;
+			}
+			case '?':
+			default:
+			{
+				err = true;
+				break;
+			}
+		}
+	}
+	if (err)
+	{
+		print_usage(argv[0], stderr);
+		return 1;
+	}
+
+	/* Values spread over the range of times seen (1 uS to ~1 s), drawn from a table so generating them isn't timed */
+	uint32_t *values = malloc(VALUE_TABLE_SIZE * sizeof(uint32_t));
+	UTILS_Histogram_t *hist = malloc(sizeof(UTILS_Histogram_t));
+	UTILS_Histogram_t *merged = malloc(sizeof(UTILS_Histogram_t));
+	if (!values || !hist || !merged)
+	{
+		perror("Failed to allocate benchmark");
+		return 1;
+	}
+	fill_values(values);
+	UTILS_ResetHistogram(hist);
+	UTILS_ResetHistogram(merged);
+
+	/* Record externally measured times, as the hot path does */
+	uint64_t start = UTILS_GetMonotonicMicros();
+	for (unsigned long i = 0; i < records; i++)
+	{
+		UTILS_RecordHistogram(hist, values[i & (VALUE_TABLE_SIZE - 1U)]);
+	}
+	report("Record", start, records);
+
+	/* Format summary, as at each stats report */
+	char summary[UTILS_HISTOGRAM_SUMMARY_SIZE];
+	unsigned long reports = records / 1000U;
+	start = UTILS_GetMonotonicMicros();
+	for (unsigned long i = 0; i < reports; i++)
+	{
+		UTILS_FormatHistogram(hist, summary);
+	}
+	report("Format", start, reports);
+
+	/* Merge period into stream histogram, as at each stats report */
+	start = UTILS_GetMonotonicMicros();
+	for (unsigned long i = 0; i < reports; i++)
+	{
+		UTILS_MergeHistogram(merged, hist);
+	}
+	report("Merge", start, reports);
+	printf("Summary of values recorded: %s (uS)\n", summary);
+
+	/* Record time since previous update, adding a read of the clock */
+	UTILS_ResetHistogram(hist);
+	UTILS_StartHistogram(hist);
+	start = UTILS_GetMonotonicMicros();
+	for (unsigned long i = 0; i < records; i++)
+	{
+		UTILS_UpdateHistogram(hist);
+	}
+	report("Update (clock read and record)", start, records);
+
+	free(merged);
+	free(hist);
+	free(values);
+
+	return 0;
+}
+
+/* Private functions */
+static void fill_values(uint32_t *values)
+{
+	/* Log uniform, xorshift generated such that runs are repeatable */
+	uint32_t x = 2463534242U;
+	for (unsigned int i = 0; i < VALUE_TABLE_SIZE; i++)
+	{
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		values[i] = (x >> 12) >> (x % 20U);
+	}
+}
+
+static void report(const char *name, uint64_t start_us, uint64_t count)
+{
+	/* Mean per operation, to a tenth of a nS */
+	uint64_t tenths = ((UTILS_GetMonotonicMicros() - start_us) * 10000U) / count;
+	printf("%s: %"PRIu64".%u nS\n", name, tenths / 10U, (unsigned int)(tenths % 10U));
+}
+
+static void print_usage(const char *program_name, FILE *dest)
+{
+	fprintf(dest, "Usage: %s [OPTIONS]\n", program_name);
+	fprintf(dest, "Measure cost of recording, merging and formatting latency histograms (mean per operation)\n");
+	fprintf(dest, "OPTIONS:\n");
+	fprintf(dest, "  -h, --help\tDisplay this help message\n");
+	fprintf(dest, "  -n, --count N\tRecord N values (default %u)\n", DEFAULT_RECORDS);
+	fprintf(dest, "  -v, --version\tDisplay the version of the program\n");
+}
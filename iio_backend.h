@@ -0,0 +1,95 @@
+#ifndef __IIO_BACKEND_H__
+#define __IIO_BACKEND_H__
+
+/* Standard libraries */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* libIIO */
+#include <iio.h>
+
+/*
+** Type definitions - DMA buffer
+** Wraps either the legacy single buffer IIO API (refill / push) or the libiio v1 block API,
+** the implementation being selected at build time. The caller dequeues a block, reads or fills it
+** in place and enqueues it again. The remaining blocks stay queued with the DMA engine meanwhile.
+*/
+typedef struct IIO_BACKEND_Buffer IIO_BACKEND_Buffer_t;
+
+/* Create local IIO context */
+struct iio_context *IIO_BACKEND_CreateContext(void);
+
+/* Read integer channel attribute */
+int IIO_BACKEND_ReadChannelAttr(const struct iio_channel *channel, const char *attr, long long *val);
+
+/* Write integer channel attribute */
+int IIO_BACKEND_WriteChannelAttr(const struct iio_channel *channel, const char *attr, long long val);
+
+/* Write string channel attribute */
+int IIO_BACKEND_WriteChannelAttrString(const struct iio_channel *channel, const char *attr, const char *val);
+
+/* Write integer device debug attribute */
+int IIO_BACKEND_WriteDebugAttr(const struct iio_device *dev, const char *attr, long long val);
+
+/*
+** Create DMA buffer of samples_count samples, enabling the channels whose bits are set in channels
+** blocks sets the number of blocks queued with the kernel (zero for the library default)
+*/
+IIO_BACKEND_Buffer_t *IIO_BACKEND_CreateBuffer(struct iio_device *dev,
+											   uint32_t channels,
+											   size_t samples_count,
+											   unsigned int blocks,
+											   bool output,
+											   bool cyclic);
+
+/* Destroy DMA buffer */
+void IIO_BACKEND_DestroyBuffer(IIO_BACKEND_Buffer_t *buffer);
+
+/*
+** Prepare buffer left idle by a previous stream for reuse, discarding input blocks completed in the meantime such
+** that the next block dequeued is one filled afterwards. Returns false if the buffer can't be reused cleanly
+** (output queued which never reached the DMA), in which case it should be recreated.
+*/
+bool IIO_BACKEND_Discard(IIO_BACKEND_Buffer_t *buffer);
+
+/*
+** Change input buffer's block size while streaming, new blocks being queued with the DMA behind those already queued
+** Returns the number of blocks of the previous size still to be dequeued (each being released rather than queued
+** again when handed back), after which blocks are of the new size. Returns a negative error code if the backend
+** can't resize in place, in which case the buffer should be recreated.
+*/
+int IIO_BACKEND_Resize(IIO_BACKEND_Buffer_t *buffer, size_t samples_count);
+
+/* Retrieve size of one sample of all enabled channels (bytes) */
+size_t IIO_BACKEND_GetSampleSize(IIO_BACKEND_Buffer_t *buffer);
+
+/* Retrieve file descriptor to poll for block availability (negative if unsupported) */
+int IIO_BACKEND_GetPollFd(IIO_BACKEND_Buffer_t *buffer);
+
+/*
+** Dequeue block (blocking)
+** For input buffers this waits for a block of samples, for output buffers it waits for a block
+** to be available for filling. Returns NULL on failure.
+*/
+uint8_t *IIO_BACKEND_Dequeue(IIO_BACKEND_Buffer_t *buffer);
+
+/*
+** Enqueue block returned by IIO_BACKEND_Dequeue()
+** For input buffers this hands the block back to the DMA, for output buffers it submits it for transmission.
+*/
+int IIO_BACKEND_Enqueue(IIO_BACKEND_Buffer_t *buffer);
+
+/*
+** Enqueue output block returned by IIO_BACKEND_Dequeue(), transmitting only its first bytes (a whole number of samples)
+** Input buffers have their block handed back as by IIO_BACKEND_Enqueue().
+*/
+int IIO_BACKEND_EnqueuePartial(IIO_BACKEND_Buffer_t *buffer, size_t bytes);
+
+/*
+** Start transmitting output blocks enqueued so far, rather than waiting for the DMA's full backlog (ending a burst,
+** such that its tail doesn't wait on blocks which may never come). Does nothing once transmitting.
+*/
+int IIO_BACKEND_Flush(IIO_BACKEND_Buffer_t *buffer);
+
+#endif
@@ -0,0 +1,237 @@
+/* Public header */
+#include "iio_backend.h"
+
+/* Standard / system libraries */
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+
+/* Macros */
+#define DEBUG_PRINT(...) if (debug) printf("IIO: "__VA_ARGS__)
+
+/* Definitions - number of kernel buffers used when caller doesn't specify (library default) */
+#define DEFAULT_BLOCKS (4)
+
+/* Type definitions */
+struct IIO_BACKEND_Buffer
+{
+	/* IIO buffer */
+	struct iio_buffer *buffer;
+
+	/* Buffer direction */
+	bool output;
+
+	/* Number of kernel buffers */
+	unsigned int nb_blocks;
+
+	/* Buffer size (bytes) */
+	size_t size;
+};
+
+/* Global variables */
+extern bool debug;
+
+/* Public functions */
+struct iio_context *IIO_BACKEND_CreateContext(void)
+{
+	return iio_create_local_context();
+}
+
+int IIO_BACKEND_ReadChannelAttr(const struct iio_channel *channel, const char *attr, long long *val)
+{
+	return iio_channel_attr_read_longlong(channel, attr, val);
+}
+
+int IIO_BACKEND_WriteChannelAttr(const struct iio_channel *channel, const char *attr, long long val)
+{
+	return iio_channel_attr_write_longlong(channel, attr, val);
+}
+
+int IIO_BACKEND_WriteChannelAttrString(const struct iio_channel *channel, const char *attr, const char *val)
+{
+	ssize_t rc = iio_channel_attr_write(channel, attr, val);
+	return (rc < 0) ? (int)rc : 0;
+}
+
+int IIO_BACKEND_WriteDebugAttr(const struct iio_device *dev, const char *attr, long long val)
+{
+	return iio_device_debug_attr_write_longlong(dev, attr, val);
+}
+
+IIO_BACKEND_Buffer_t *IIO_BACKEND_CreateBuffer(struct iio_device *dev,
+											   uint32_t channels,
+											   size_t samples_count,
+											   unsigned int blocks,
+											   bool output,
+											   bool cyclic)
+{
+	/* Disable all channels */
+	unsigned int nb_channels = iio_device_get_channels_count(dev);
+	DEBUG_PRINT("Found %u channels\n", nb_channels);
+	for (unsigned int i = 0; i < nb_channels; i++)
+	{
+		iio_channel_disable(iio_device_get_channel(dev, i));
+	}
+
+	/* Enable required channels */
+	for (unsigned int i = 0; i < 32; i++)
+	{
+		/* Enable channel if required */
+		if (channels & (1U << i))
+		{
+			/* Retrieve channel */
+			struct iio_channel *channel = iio_device_get_channel(dev, i);
+			if (!channel)
+			{
+				fprintf(stderr, "Failed to find iio chan %u\n", i);
+				return NULL;
+			}
+
+			/* Enable channels */
+			DEBUG_PRINT("Enable channel: %s, is scan element: %s\n",
+						iio_channel_get_id(channel),
+						iio_channel_is_scan_element(channel) ? "true" : "false");
+			iio_channel_enable(channel);
+		}
+	}
+
+	/* Set number of kernel buffers, allowing the DMA to work through several while we handle another */
+	if (blocks > 0)
+	{
+		int rc = iio_device_set_kernel_buffers_count(dev, blocks);
+		if (rc < 0)
+		{
+			fprintf(stderr, "Failed to set kernel buffer count to %u (%d)\n", blocks, rc);
+		}
+		else
+		{
+			DEBUG_PRINT("Set kernel buffer count: %u\n", blocks);
+		}
+	}
+
+	IIO_BACKEND_Buffer_t *buffer = calloc(1, sizeof(IIO_BACKEND_Buffer_t));
+	if (!buffer)
+	{
+		return NULL;
+	}
+	buffer->output = output;
+	buffer->nb_blocks = (blocks > 0) ? blocks : DEFAULT_BLOCKS;
+
+	/* Create buffer */
+	buffer->buffer = iio_device_create_buffer(dev, samples_count, cyclic);
+	if (!buffer->buffer)
+	{
+		fprintf(stderr, "Failed to create buffer for %zu samples\n", samples_count);
+		free(buffer);
+		return NULL;
+	}
+	buffer->size = (size_t)iio_buffer_step(buffer->buffer) * samples_count;
+
+	return buffer;
+}
+
+void IIO_BACKEND_DestroyBuffer(IIO_BACKEND_Buffer_t *buffer)
+{
+	if (buffer)
+	{
+		iio_buffer_destroy(buffer->buffer);
+		free(buffer);
+	}
+}
+
+bool IIO_BACKEND_Discard(IIO_BACKEND_Buffer_t *buffer)
+{
+	if (buffer->output)
+	{
+		/* Pushed blocks are already with the DMA */
+		return true;
+	}
+
+	/* Refill while blocks are ready, at most once per kernel buffer (plus the one held) so a running DMA can't hold us */
+	struct pollfd pfd = { .fd = iio_buffer_get_poll_fd(buffer->buffer), .events = POLLIN };
+	unsigned int discarded = 0;
+	while ((discarded <= buffer->nb_blocks) && (pfd.fd >= 0) && (poll(&pfd, 1, 0) > 0))
+	{
+		if (iio_buffer_refill(buffer->buffer) < 0)
+		{
+			break;
+		}
+		discarded++;
+	}
+	DEBUG_PRINT("Discarded %u stale blocks\n", discarded);
+
+	return true;
+}
+
+int IIO_BACKEND_Resize(IIO_BACKEND_Buffer_t *buffer, size_t samples_count)
+{
+	/* Buffer size is fixed at creation */
+	(void)buffer;
+	(void)samples_count;
+	return -ENOTSUP;
+}
+
+size_t IIO_BACKEND_GetSampleSize(IIO_BACKEND_Buffer_t *buffer)
+{
+	/* Retrieve number of bytes between two samples of the same channel (aka size of one sample of all enabled channels) */
+	return (size_t)iio_buffer_step(buffer->buffer);
+}
+
+int IIO_BACKEND_GetPollFd(IIO_BACKEND_Buffer_t *buffer)
+{
+	return iio_buffer_get_poll_fd(buffer->buffer);
+}
+
+uint8_t *IIO_BACKEND_Dequeue(IIO_BACKEND_Buffer_t *buffer)
+{
+	if (!buffer->output)
+	{
+		/* Refill buffer */
+		ssize_t nbytes = iio_buffer_refill(buffer->buffer);
+		if (nbytes != (ssize_t)buffer->size)
+		{
+			fprintf(stderr, "RX buffer read failed, expected %zu, read %zd bytes\n", buffer->size, nbytes);
+			return NULL;
+		}
+	}
+
+	/* Only one block is ever visible, the library moving the buffer start along as blocks are exchanged */
+	return iio_buffer_start(buffer->buffer);
+}
+
+int IIO_BACKEND_Enqueue(IIO_BACKEND_Buffer_t *buffer)
+{
+	if (!buffer->output)
+	{
+		/* Block is handed back by the next refill */
+		return 0;
+	}
+
+	/* Perform blocking write */
+	ssize_t nbytes = iio_buffer_push(buffer->buffer);
+
+	return (nbytes == (ssize_t)buffer->size) ? 0 : -1;
+}
+
+int IIO_BACKEND_EnqueuePartial(IIO_BACKEND_Buffer_t *buffer, size_t bytes)
+{
+	if (!buffer->output || (bytes >= buffer->size))
+	{
+		return IIO_BACKEND_Enqueue(buffer);
+	}
+
+	/* Perform blocking write of leading samples */
+	size_t samples = bytes / (size_t)iio_buffer_step(buffer->buffer);
+	ssize_t nbytes = iio_buffer_push_partial(buffer->buffer, samples);
+
+	return (nbytes == (ssize_t)(samples * (size_t)iio_buffer_step(buffer->buffer))) ? 0 : -1;
+}
+
+int IIO_BACKEND_Flush(IIO_BACKEND_Buffer_t *buffer)
+{
+	/* Each push is written to the kernel buffer straight away */
+	(void)buffer;
+	return 0;
+}
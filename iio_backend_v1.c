@@ -0,0 +1,484 @@
+/* Public header */
+#include "iio_backend.h"
+
+/* Standard / system libraries */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+/* Macros */
+#define DEBUG_PRINT(...) if (debug) printf("IIO: "__VA_ARGS__)
+
+/* Definitions - number of blocks used when caller doesn't specify */
+#define DEFAULT_BLOCKS (4)
+
+/* Type definitions */
+struct IIO_BACKEND_Buffer
+{
+	/* Enabled channels */
+	struct iio_channels_mask *mask;
+
+	/* IIO buffer */
+	struct iio_buffer *buffer;
+
+	/* Blocks, each of which is either queued with the DMA or held by the caller */
+	struct iio_block **blocks;
+	unsigned int nb_blocks;
+
+	/* Index of block next dequeued / currently held by the caller */
+	unsigned int curr;
+
+	/* Blocks of the previous size being retired following a resize (input only), index of next and count remaining */
+	struct iio_block **retiring;
+	unsigned int nb_retiring;
+	unsigned int retire_curr;
+	unsigned int retire_left;
+
+	/* Number of blocks submitted (output only, blocks are free until submitted for the first time) */
+	unsigned int submitted;
+
+	/* Buffer enabled (DMA running) */
+	bool enabled;
+
+	/* Buffer direction / mode */
+	bool output;
+	bool cyclic;
+
+	/* Sample size (bytes) */
+	size_t sample_size;
+
+	/* Block size (bytes) */
+	size_t size;
+};
+
+/* Global variables */
+extern bool debug;
+
+/* Public functions */
+struct iio_context *IIO_BACKEND_CreateContext(void)
+{
+	/* Default URI selects local backend when running on target */
+	struct iio_context *ctx = iio_create_context(NULL, "local:");
+	if (iio_err(ctx))
+	{
+		return NULL;
+	}
+
+	return ctx;
+}
+
+int IIO_BACKEND_ReadChannelAttr(const struct iio_channel *channel, const char *attr, long long *val)
+{
+	const struct iio_attr *iio_attr = iio_channel_find_attr(channel, attr);
+	if (!iio_attr)
+	{
+		return -ENOENT;
+	}
+
+	return iio_attr_read_longlong(iio_attr, val);
+}
+
+int IIO_BACKEND_WriteChannelAttr(const struct iio_channel *channel, const char *attr, long long val)
+{
+	const struct iio_attr *iio_attr = iio_channel_find_attr(channel, attr);
+	if (!iio_attr)
+	{
+		return -ENOENT;
+	}
+
+	return iio_attr_write_longlong(iio_attr, val);
+}
+
+int IIO_BACKEND_WriteChannelAttrString(const struct iio_channel *channel, const char *attr, const char *val)
+{
+	const struct iio_attr *iio_attr = iio_channel_find_attr(channel, attr);
+	if (!iio_attr)
+	{
+		return -ENOENT;
+	}
+
+	ssize_t rc = iio_attr_write_string(iio_attr, val);
+	return (rc < 0) ? (int)rc : 0;
+}
+
+int IIO_BACKEND_WriteDebugAttr(const struct iio_device *dev, const char *attr, long long val)
+{
+	const struct iio_attr *iio_attr = iio_device_find_debug_attr(dev, attr);
+	if (!iio_attr)
+	{
+		return -ENOENT;
+	}
+
+	return iio_attr_write_longlong(iio_attr, val);
+}
+
+IIO_BACKEND_Buffer_t *IIO_BACKEND_CreateBuffer(struct iio_device *dev,
+											   uint32_t channels,
+											   size_t samples_count,
+											   unsigned int blocks,
+											   bool output,
+											   bool cyclic)
+{
+	IIO_BACKEND_Buffer_t *buffer = calloc(1, sizeof(IIO_BACKEND_Buffer_t));
+	if (!buffer)
+	{
+		return NULL;
+	}
+	buffer->output = output;
+	buffer->cyclic = cyclic;
+
+	/* A cyclic buffer repeats a single block */
+	buffer->nb_blocks = cyclic ? 1 : ((blocks > 0) ? blocks : DEFAULT_BLOCKS);
+
+	/* Build mask of required channels */
+	unsigned int nb_channels = iio_device_get_channels_count(dev);
+	DEBUG_PRINT("Found %u channels\n", nb_channels);
+	buffer->mask = iio_create_channels_mask(nb_channels);
+	if (!buffer->mask)
+	{
+		fprintf(stderr, "Failed to create channel mask\n");
+		goto fail;
+	}
+	for (unsigned int i = 0; i < 32; i++)
+	{
+		/* Enable channel if required */
+		if (channels & (1U << i))
+		{
+			/* Retrieve channel */
+			struct iio_channel *channel = iio_device_get_channel(dev, i);
+			if (!channel)
+			{
+				fprintf(stderr, "Failed to find iio chan %u\n", i);
+				goto fail;
+			}
+
+			/* Enable channels */
+			DEBUG_PRINT("Enable channel: %s, is scan element: %s\n",
+						iio_channel_get_id(channel),
+						iio_channel_is_scan_element(channel) ? "true" : "false");
+			iio_channel_enable(channel, buffer->mask);
+		}
+	}
+
+	/* Retrieve size of one sample of all enabled channels */
+	ssize_t sample_size = iio_device_get_sample_size(dev, buffer->mask);
+	if (sample_size <= 0)
+	{
+		fprintf(stderr, "Failed to determine sample size (%zd)\n", sample_size);
+		goto fail;
+	}
+	buffer->sample_size = (size_t)sample_size;
+	buffer->size = buffer->sample_size * samples_count;
+
+	/* Create buffer */
+	buffer->buffer = iio_device_create_buffer(dev, 0, buffer->mask);
+	if (iio_err(buffer->buffer))
+	{
+		buffer->buffer = NULL;
+		fprintf(stderr, "Failed to create buffer\n");
+		goto fail;
+	}
+
+	/* Create blocks */
+	buffer->blocks = calloc(buffer->nb_blocks, sizeof(struct iio_block*));
+	if (!buffer->blocks)
+	{
+		goto fail;
+	}
+	for (unsigned int i = 0; i < buffer->nb_blocks; i++)
+	{
+		buffer->blocks[i] = iio_buffer_create_block(buffer->buffer, buffer->size);
+		if (iio_err(buffer->blocks[i]))
+		{
+			buffer->blocks[i] = NULL;
+			fprintf(stderr, "Failed to create block %u of %zu bytes\n", i, buffer->size);
+			goto fail;
+		}
+	}
+	DEBUG_PRINT("Created %u blocks of %zu bytes\n", buffer->nb_blocks, buffer->size);
+
+	if (!output)
+	{
+		/* Queue all blocks with the DMA and start it, such that it can fill them while we're busy */
+		for (unsigned int i = 0; i < buffer->nb_blocks; i++)
+		{
+			int rc = iio_block_enqueue(buffer->blocks[i], 0, false);
+			if (rc < 0)
+			{
+				fprintf(stderr, "Failed to enqueue block %u (%d)\n", i, rc);
+				goto fail;
+			}
+		}
+		int rc = iio_buffer_enable(buffer->buffer);
+		if (rc < 0)
+		{
+			fprintf(stderr, "Failed to enable buffer (%d)\n", rc);
+			goto fail;
+		}
+		buffer->enabled = true;
+	}
+
+	return buffer;
+
+fail:
+	IIO_BACKEND_DestroyBuffer(buffer);
+	return NULL;
+}
+
+void IIO_BACKEND_DestroyBuffer(IIO_BACKEND_Buffer_t *buffer)
+{
+	if (!buffer)
+	{
+		return;
+	}
+
+	if (buffer->enabled)
+	{
+		iio_buffer_disable(buffer->buffer);
+	}
+	if (buffer->blocks)
+	{
+		for (unsigned int i = 0; i < buffer->nb_blocks; i++)
+		{
+			if (buffer->blocks[i])
+			{
+				/* Block created */
+				iio_block_destroy(buffer->blocks[i]);
+			}
+		}
+		free(buffer->blocks);
+	}
+	if (buffer->retiring)
+	{
+		for (unsigned int i = 0; i < buffer->nb_retiring; i++)
+		{
+			if (buffer->retiring[i])
+			{
+				/* Block not yet retired */
+				iio_block_destroy(buffer->retiring[i]);
+			}
+		}
+		free(buffer->retiring);
+	}
+	if (buffer->buffer)
+	{
+		iio_buffer_destroy(buffer->buffer);
+	}
+	if (buffer->mask)
+	{
+		iio_channels_mask_destroy(buffer->mask);
+	}
+	free(buffer);
+}
+
+bool IIO_BACKEND_Discard(IIO_BACKEND_Buffer_t *buffer)
+{
+	if (buffer->output)
+	{
+		/* Blocks queued before the DMA was started would go out ahead of the next stream's */
+		return buffer->enabled || (0 == buffer->submitted);
+	}
+	if (buffer->retire_left > 0)
+	{
+		/* Left mid resize */
+		return false;
+	}
+
+	/* Hand completed blocks straight back to the DMA, in order, until one isn't yet complete */
+	unsigned int discarded = 0;
+	while (discarded < buffer->nb_blocks)
+	{
+		struct iio_block *block = buffer->blocks[buffer->curr];
+		if (iio_block_dequeue(block, true) < 0)
+		{
+			break;
+		}
+		if (iio_block_enqueue(block, 0, false) < 0)
+		{
+			fprintf(stderr, "Failed to enqueue block %u\n", buffer->curr);
+			break;
+		}
+		buffer->curr = (buffer->curr + 1) % buffer->nb_blocks;
+		discarded++;
+	}
+	DEBUG_PRINT("Discarded %u stale blocks\n", discarded);
+
+	return true;
+}
+
+int IIO_BACKEND_Resize(IIO_BACKEND_Buffer_t *buffer, size_t samples_count)
+{
+	if (buffer->output || buffer->cyclic || (buffer->retire_left > 0))
+	{
+		return -ENOTSUP;
+	}
+
+	/* Create blocks of new size, leaving those queued untouched should we fail */
+	size_t size = buffer->sample_size * samples_count;
+	struct iio_block **blocks = calloc(buffer->nb_blocks, sizeof(struct iio_block*));
+	if (!blocks)
+	{
+		return -ENOMEM;
+	}
+	for (unsigned int i = 0; i < buffer->nb_blocks; i++)
+	{
+		blocks[i] = iio_buffer_create_block(buffer->buffer, size);
+		if (iio_err(blocks[i]))
+		{
+			int rc = iio_err(blocks[i]);
+			fprintf(stderr, "Failed to create block %u of %zu bytes (%d)\n", i, size, rc);
+			/* Release blocks created so far */
+			for (unsigned int j = 0; j < i; j++)
+			{
+				iio_block_destroy(blocks[j]);
+			}
+			free(blocks);
+			return rc;
+		}
+	}
+
+	/* Every block is queued between dequeues, so the DMA completes all of the old blocks before any of the new */
+	for (unsigned int i = 0; i < buffer->nb_blocks; i++)
+	{
+		int rc = iio_block_enqueue(blocks[i], 0, false);
+		if (rc < 0)
+		{
+			/* Some of the new blocks may be queued, the buffer is no longer usable */
+			fprintf(stderr, "Failed to enqueue block %u (%d)\n", i, rc);
+			/* Release new blocks */
+			for (unsigned int j = 0; j < buffer->nb_blocks; j++)
+			{
+				iio_block_destroy(blocks[j]);
+			}
+			free(blocks);
+			return rc;
+		}
+	}
+	buffer->retiring = buffer->blocks;
+	buffer->nb_retiring = buffer->nb_blocks;
+	buffer->retire_curr = buffer->curr;
+	buffer->retire_left = buffer->nb_blocks;
+	buffer->blocks = blocks;
+	buffer->curr = 0;
+	buffer->size = size;
+	DEBUG_PRINT("Resized to %u blocks of %zu bytes, %u to retire\n", buffer->nb_blocks, buffer->size, buffer->retire_left);
+
+	return (int)buffer->retire_left;
+}
+
+size_t IIO_BACKEND_GetSampleSize(IIO_BACKEND_Buffer_t *buffer)
+{
+	return buffer->sample_size;
+}
+
+int IIO_BACKEND_GetPollFd(IIO_BACKEND_Buffer_t *buffer)
+{
+	/* Block API offers no poll fd, callers must dequeue (blocking) instead */
+	(void)buffer;
+	return -1;
+}
+
+uint8_t *IIO_BACKEND_Dequeue(IIO_BACKEND_Buffer_t *buffer)
+{
+	if (buffer->retire_left > 0)
+	{
+		/* Drain blocks of the previous size first */
+		struct iio_block *block = buffer->retiring[buffer->retire_curr];
+		int rc = iio_block_dequeue(block, false);
+		if (rc < 0)
+		{
+			fprintf(stderr, "Failed to dequeue retiring block %u (%d)\n", buffer->retire_curr, rc);
+			return NULL;
+		}
+		return iio_block_start(block);
+	}
+
+	struct iio_block *block = buffer->blocks[buffer->curr];
+
+	if (!buffer->output || (buffer->submitted >= buffer->nb_blocks))
+	{
+		/* Wait for DMA to complete block (input having been filled, output having been transmitted) */
+		int rc = iio_block_dequeue(block, false);
+		if (rc < 0)
+		{
+			fprintf(stderr, "Failed to dequeue block %u (%d)\n", buffer->curr, rc);
+			return NULL;
+		}
+	}
+
+	return iio_block_start(block);
+}
+
+int IIO_BACKEND_Enqueue(IIO_BACKEND_Buffer_t *buffer)
+{
+	return IIO_BACKEND_EnqueuePartial(buffer, buffer->size);
+}
+
+int IIO_BACKEND_EnqueuePartial(IIO_BACKEND_Buffer_t *buffer, size_t bytes)
+{
+	if (buffer->retire_left > 0)
+	{
+		/* Release block of the previous size rather than queuing it again */
+		iio_block_destroy(buffer->retiring[buffer->retire_curr]);
+		buffer->retiring[buffer->retire_curr] = NULL;
+		buffer->retire_curr = (buffer->retire_curr + 1) % buffer->nb_retiring;
+		buffer->retire_left--;
+		if (0 == buffer->retire_left)
+		{
+			free(buffer->retiring);
+			buffer->retiring = NULL;
+			buffer->nb_retiring = 0;
+		}
+		return 0;
+	}
+
+	struct iio_block *block = buffer->blocks[buffer->curr];
+
+	/* Hand block back to DMA (bytes used only matters for output) */
+	if (bytes > buffer->size)
+	{
+		/* Limit to block */
+		bytes = buffer->size;
+	}
+	int rc = iio_block_enqueue(block, buffer->output ? bytes : 0, buffer->cyclic);
+	if (rc < 0)
+	{
+		return rc;
+	}
+
+	/* Move on to next block */
+	buffer->curr = (buffer->curr + 1) % buffer->nb_blocks;
+
+	if (buffer->output && (buffer->submitted < buffer->nb_blocks))
+	{
+		/* Start DMA once every block has been queued once, such that it starts with a full backlog */
+		buffer->submitted++;
+		if (buffer->submitted >= buffer->nb_blocks)
+		{
+			return IIO_BACKEND_Flush(buffer);
+		}
+	}
+
+	return 0;
+}
+
+int IIO_BACKEND_Flush(IIO_BACKEND_Buffer_t *buffer)
+{
+	if (!buffer->output || buffer->enabled || (0 == buffer->submitted))
+	{
+		return 0;
+	}
+
+	/* Start DMA with the blocks queued so far, those yet to be submitted for the first time remaining free */
+	int rc = iio_buffer_enable(buffer->buffer);
+	if (rc < 0)
+	{
+		fprintf(stderr, "Failed to enable buffer (%d)\n", rc);
+		return rc;
+	}
+	buffer->enabled = true;
+
+	return 0;
+}
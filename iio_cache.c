@@ -0,0 +1,86 @@
+/* Public header */
+#include "iio_cache.h"
+
+/* Standard libraries */
+#include <stdio.h>
+
+/* Macros */
+#define DEBUG_PRINT(...) if (debug) printf("Cache: "__VA_ARGS__)
+
+/* Global variables */
+extern bool debug;
+
+/* Public functions */
+IIO_BACKEND_Buffer_t *IIO_CACHE_Get(IIO_CACHE_t *cache,
+									struct iio_device *dev,
+									uint32_t channels,
+									size_t samples_count,
+									unsigned int blocks,
+									bool output,
+									bool *hit)
+{
+	if (hit)
+	{
+		/* Miss, unless reused below */
+		*hit = false;
+	}
+
+	if (cache->buffer)
+	{
+		if (	(channels == cache->channels)
+			 && (samples_count == cache->samples_count)
+			 && (blocks == cache->blocks)
+			 && (output == cache->output)
+			 && IIO_BACKEND_Discard(cache->buffer)
+		   )
+		{
+			DEBUG_PRINT("Reusing %s buffer\n", output ? "output" : "input");
+			if (hit)
+			{
+				/* Report reuse */
+				*hit = true;
+			}
+			return cache->buffer;
+		}
+
+		/* Parameters changed, release device for new buffer */
+		IIO_CACHE_Flush(cache);
+	}
+
+	DEBUG_PRINT("Creating %s buffer\n", output ? "output" : "input");
+	cache->buffer = IIO_BACKEND_CreateBuffer(dev, channels, samples_count, blocks, output, false);
+	if (cache->buffer)
+	{
+		cache->channels = channels;
+		cache->samples_count = samples_count;
+		cache->blocks = blocks;
+		cache->output = output;
+	}
+
+	return cache->buffer;
+}
+
+int IIO_CACHE_Resize(IIO_CACHE_t *cache, size_t samples_count)
+{
+	if (!cache->buffer)
+	{
+		return -1;
+	}
+
+	int rc = IIO_BACKEND_Resize(cache->buffer, samples_count);
+	if (rc >= 0)
+	{
+		cache->samples_count = samples_count;
+	}
+
+	return rc;
+}
+
+void IIO_CACHE_Flush(IIO_CACHE_t *cache)
+{
+	if (cache->buffer)
+	{
+		IIO_BACKEND_DestroyBuffer(cache->buffer);
+		cache->buffer = NULL;
+	}
+}
@@ -0,0 +1,52 @@
+#ifndef __IIO_CACHE_H__
+#define __IIO_CACHE_H__
+
+/* Standard libraries */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Local headers */
+#include "iio_backend.h"
+
+/*
+** Type definitions - buffer cache
+** Keeps a device's buffer between streams, such that a stream with the same parameters as the last needn't wait
+** for the kernel to allocate and map its DMA buffers again. The kernel permits only one buffer per device, therefore
+** the cache holds at most one.
+*/
+typedef struct
+{
+	/* Cached buffer (NULL if none) */
+	IIO_BACKEND_Buffer_t *buffer;
+
+	/* Parameters buffer was created with */
+	uint32_t channels;
+	size_t samples_count;
+	unsigned int blocks;
+	bool output;
+
+} IIO_CACHE_t;
+
+/*
+** Retrieve buffer for the given parameters, reusing the cached buffer if it matches or replacing it otherwise
+** Buffer remains owned by the cache. Sets hit (if not NULL) to indicate whether the cached buffer was reused.
+*/
+IIO_BACKEND_Buffer_t *IIO_CACHE_Get(IIO_CACHE_t *cache,
+									struct iio_device *dev,
+									uint32_t channels,
+									size_t samples_count,
+									unsigned int blocks,
+									bool output,
+									bool *hit);
+
+/*
+** Resize cached buffer in place (see IIO_BACKEND_Resize()), returning the number of blocks of the previous size
+** still to be dequeued, or a negative error code if it must be recreated instead (by IIO_CACHE_Get())
+*/
+int IIO_CACHE_Resize(IIO_CACHE_t *cache, size_t samples_count);
+
+/* Destroy cached buffer (if any), as following a failure using it or to free the device for another buffer */
+void IIO_CACHE_Flush(IIO_CACHE_t *cache);
+
+#endif
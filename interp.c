@@ -0,0 +1,258 @@
+/* Public header */
+#include "interp.h"
+
+/* Standard libraries */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Definitions - input samples processed per block */
+#define BLOCK_SAMPLES (64)
+
+/* Definitions - default filter taps per phase */
+#define DEFAULT_TAPS (8)
+
+/*
+** Type definitions - vector of four lanes
+** GCC lowers operations on this type to NEON on ARM and SSE on x86, falling back to scalar code elsewhere.
+*/
+typedef float interp_vecf_t __attribute__((vector_size(16)));
+
+/* Private functions */
+static void design_filter(INTERP_t *interp);
+static inline int16_t saturate(float v);
+
+/* Public functions */
+bool INTERP_Init(INTERP_t *interp, unsigned int factor, unsigned int taps, size_t components, double nco_freq)
+{
+	memset(interp, 0x00, sizeof(*interp));
+
+	if ((factor < 1) || (factor > INTERP_MAX_FACTOR))
+	{
+		fprintf(stderr, "Interpolation factor must be 1 to %u\n", INTERP_MAX_FACTOR);
+		return false;
+	}
+	if (taps > INTERP_MAX_TAPS)
+	{
+		fprintf(stderr, "Interpolation filter limited to %u taps per phase\n", INTERP_MAX_TAPS);
+		return false;
+	}
+	if ((0 == components) || (0 != (components % 2)))
+	{
+		fprintf(stderr, "Interpolation requires I / Q pairs\n");
+		return false;
+	}
+
+	if (1 == factor)
+	{
+		/* Without interpolation, a single tap passes samples through to the NCO */
+		taps = 1;
+	}
+	else if (0 == taps)
+	{
+		/* Default filter length */
+		taps = DEFAULT_TAPS;
+	}
+	interp->factor = factor;
+	interp->taps = taps;
+	interp->phases = (factor + 3U) & ~3U;
+	interp->components = components;
+	interp->nco.freq = nco_freq;
+
+	/* Allocate, aligned to whole vectors where accessed as such */
+	size_t outputs = BLOCK_SAMPLES * interp->phases;
+	interp->coeffs = aligned_alloc(sizeof(interp_vecf_t), taps * interp->phases * sizeof(float));
+	interp->history = calloc(components * (taps - 1U + BLOCK_SAMPLES), sizeof(float));
+	interp->output = aligned_alloc(sizeof(interp_vecf_t), components * outputs * sizeof(float));
+	interp->rot_i = aligned_alloc(sizeof(interp_vecf_t), outputs * sizeof(float));
+	interp->rot_q = aligned_alloc(sizeof(interp_vecf_t), outputs * sizeof(float));
+	if (!interp->coeffs || !interp->history || !interp->output || !interp->rot_i || !interp->rot_q)
+	{
+		fprintf(stderr, "Failed to allocate interpolator\n");
+		INTERP_Destroy(interp);
+		return false;
+	}
+
+	design_filter(interp);
+
+	return true;
+}
+
+void INTERP_Destroy(INTERP_t *interp)
+{
+	free(interp->coeffs);
+	free(interp->history);
+	free(interp->output);
+	free(interp->rot_i);
+	free(interp->rot_q);
+	memset(interp, 0x00, sizeof(*interp));
+}
+
+void INTERP_Reset(INTERP_t *interp)
+{
+	memset(interp->history, 0x00, interp->components * (interp->taps - 1U + BLOCK_SAMPLES) * sizeof(float));
+}
+
+void INTERP_Process(INTERP_t *interp, uint8_t *dst, const uint8_t *src, size_t samples)
+{
+	const size_t factor = interp->factor;
+	const size_t taps = interp->taps;
+	const size_t phases = interp->phases;
+	const size_t components = interp->components;
+	const size_t stride = taps - 1U + BLOCK_SAMPLES;
+	const size_t outputs = BLOCK_SAMPLES * phases;
+	const bool nco = (0.0 != interp->nco.freq);
+	const int16_t *in = (const int16_t*)src;
+	int16_t *out = (int16_t*)dst;
+
+	while (samples > 0)
+	{
+		size_t n = (samples < BLOCK_SAMPLES) ? samples : BLOCK_SAMPLES;
+
+		for (size_t c = 0; c < components; c++)
+		{
+			/* Append block to history */
+			float *hist = &interp->history[c * stride];
+			for (size_t i = 0; i < n; i++)
+			{
+				hist[taps - 1U + i] = in[(i * components) + c];
+			}
+
+			/*
+			** Each input sample yields one output per phase, four phases at a time, from the taps most recent inputs
+			** Four input samples are filtered together, sharing coefficient loads and keeping independent sums in flight.
+			*/
+			float *acc = &interp->output[c * outputs];
+			size_t i = 0;
+			for (; (i + 4) <= n; i += 4)
+			{
+				const float *window = &hist[i];
+				for (size_t p = 0; p < phases; p += 4)
+				{
+					interp_vecf_t sum0 = { 0.0f, 0.0f, 0.0f, 0.0f };
+					interp_vecf_t sum1 = sum0, sum2 = sum0, sum3 = sum0;
+					for (size_t k = 0; k < taps; k++)
+					{
+						interp_vecf_t coeffs = *(const interp_vecf_t*)&interp->coeffs[(k * phases) + p];
+						sum0 += window[k] * coeffs;
+						sum1 += window[k + 1] * coeffs;
+						sum2 += window[k + 2] * coeffs;
+						sum3 += window[k + 3] * coeffs;
+					}
+					*(interp_vecf_t*)&acc[(i * phases) + p] = sum0;
+					*(interp_vecf_t*)&acc[((i + 1) * phases) + p] = sum1;
+					*(interp_vecf_t*)&acc[((i + 2) * phases) + p] = sum2;
+					*(interp_vecf_t*)&acc[((i + 3) * phases) + p] = sum3;
+				}
+			}
+			for (; i < n; i++)
+			{
+				const float *window = &hist[i];
+				for (size_t p = 0; p < phases; p += 4)
+				{
+					interp_vecf_t sum = { 0.0f, 0.0f, 0.0f, 0.0f };
+					for (size_t k = 0; k < taps; k++)
+					{
+						sum += window[k] * *(const interp_vecf_t*)&interp->coeffs[(k * phases) + p];
+					}
+					*(interp_vecf_t*)&acc[(i * phases) + p] = sum;
+				}
+			}
+
+			/* Carry history into next block */
+			memmove(hist, &hist[n], (taps - 1U) * sizeof(float));
+		}
+
+		/* Prepare NCO phasor for block's outputs (of unit amplitude, accumulated over whole vectors) */
+		size_t m = n * factor;
+		if (nco)
+		{
+			memset(interp->rot_i, 0x00, ((m + 3U) & ~3U) * sizeof(float));
+			memset(interp->rot_q, 0x00, ((m + 3U) & ~3U) * sizeof(float));
+			WAVEGEN_NcoBlock(&interp->nco, 1.0f, interp->rot_i, interp->rot_q, m);
+		}
+
+		/* Interleave I / Q pairs, shifting them and saturating filter overshoot */
+		for (size_t i = 0; i < n; i++)
+		{
+			for (size_t p = 0; p < factor; p++)
+			{
+				size_t j = (i * factor) + p;
+				for (size_t c = 0; c < components; c += 2)
+				{
+					float vi = interp->output[(c * outputs) + (i * phases) + p];
+					float vq = interp->output[((c + 1) * outputs) + (i * phases) + p];
+					if (nco)
+					{
+						float t = (vi * interp->rot_i[j]) - (vq * interp->rot_q[j]);
+						vq = (vi * interp->rot_q[j]) + (vq * interp->rot_i[j]);
+						vi = t;
+					}
+					out[(j * components) + c] = saturate(vi);
+					out[(j * components) + c + 1] = saturate(vq);
+				}
+			}
+		}
+
+		in += n * components;
+		out += m * components;
+		samples -= n;
+	}
+}
+
+/* Private functions */
+static void design_filter(INTERP_t *interp)
+{
+	/*
+	** Blackman windowed sinc of factor * taps coefficients, cut off at half the input rate, scaled for unity gain
+	** Phase p of output sample (n * factor + p) takes coefficients h[k * factor + p], k applying to input (n - k).
+	*/
+	const size_t factor = interp->factor;
+	const size_t taps = interp->taps;
+	const size_t phases = interp->phases;
+	const size_t length = factor * taps;
+	memset(interp->coeffs, 0x00, taps * phases * sizeof(float));
+	if (1 == factor)
+	{
+		/* Pass sample through */
+		interp->coeffs[0] = 1.0f;
+		return;
+	}
+
+	double h[INTERP_MAX_FACTOR * INTERP_MAX_TAPS];
+	double centre = (length - 1U) / 2.0;
+	double sum = 0.0;
+	for (size_t i = 0; i < length; i++)
+	{
+		double x = ((double)i - centre) / factor;
+		double sinc = (0.0 == x) ? 1.0 : (sin(M_PI * x) / (M_PI * x));
+		double w = 0.42 - (0.5 * cos((2.0 * M_PI * i) / (length - 1U))) + (0.08 * cos((4.0 * M_PI * i) / (length - 1U)));
+		h[i] = sinc * w;
+		sum += h[i];
+	}
+
+	/* Store coefficients by tap (oldest input first, matching the order of the history), then phase (padded) */
+	for (size_t j = 0; j < taps; j++)
+	{
+		for (size_t p = 0; p < factor; p++)
+		{
+			interp->coeffs[(j * phases) + p] = (float)((h[((taps - 1U - j) * factor) + p] * factor) / sum);
+		}
+	}
+}
+
+static inline int16_t saturate(float v)
+{
+	if (v > 32767.0f)
+	{
+		/* Clip positive */
+		return 32767;
+	}
+	if (v < -32768.0f)
+	{
+		/* Clip negative */
+		return -32768;
+	}
+	return (int16_t)v;
+}
@@ -0,0 +1,62 @@
+#ifndef __INTERP_H__
+#define __INTERP_H__
+
+/* Standard libraries */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Local modules */
+#include "wavegen.h"
+
+/* Definitions - maximum interpolation factor */
+#define INTERP_MAX_FACTOR (16)
+
+/* Definitions - maximum filter taps per phase */
+#define INTERP_MAX_TAPS (64)
+
+/* Type definitions - interpolator state */
+typedef struct
+{
+	/* Interpolation factor, filter taps per phase and phases computed (factor rounded up to a whole vector) */
+	unsigned int factor;
+	unsigned int taps;
+	unsigned int phases;
+
+	/* Components (int16, I / Q pairs) per sample */
+	size_t components;
+
+	/* Filter coefficients, by tap (oldest input first) then phase */
+	float *coeffs;
+
+	/* Input history of each component, taps - 1 samples carried between blocks ahead of the block's own */
+	float *history;
+
+	/* Filter output of each component for current block, by input sample then phase */
+	float *output;
+
+	/* NCO phasor of current block */
+	float *rot_i;
+	float *rot_q;
+
+	/* NCO (frequency in cycles per output sample), zero frequency disabling it */
+	WAVEGEN_Nco_t nco;
+
+} INTERP_t;
+
+/*
+** Prepare interpolator for samples of the given number of int16 components, returning false if the configuration
+** is invalid. Taps per phase of zero selects the default. NCO frequency is in cycles per output sample.
+*/
+bool INTERP_Init(INTERP_t *interp, unsigned int factor, unsigned int taps, size_t components, double nco_freq);
+
+/* Release interpolator */
+void INTERP_Destroy(INTERP_t *interp);
+
+/* Clear filter history, as following a gap in the input */
+void INTERP_Reset(INTERP_t *interp);
+
+/* Interpolate samples of interleaved int16 components, writing samples * factor samples (16-bit aligned) */
+void INTERP_Process(INTERP_t *interp, uint8_t *dst, const uint8_t *src, size_t samples);
+
+#endif
@@ -0,0 +1,151 @@
+/* Public header */
+#include "loopback.h"
+
+/* Standard / system libraries */
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+/* Local modules */
+#include "sdr_ip_gadget_types.h"
+
+/* Macros */
+#define DEBUG_PRINT(...) if (debug) printf("Loopback: "__VA_ARGS__)
+
+/* Global variables */
+extern bool debug;
+
+/* Private functions */
+static uint32_t since(uint64_t from, uint64_t to);
+
+/* Public functions */
+void LOOPBACK_Reset(LOOPBACK_t *lb)
+{
+	memset(lb, 0x00, sizeof(*lb));
+	atomic_init(&lb->threshold, 0);
+	atomic_init(&lb->armed, false);
+}
+
+void LOOPBACK_SetThreshold(LOOPBACK_t *lb, int32_t threshold)
+{
+	/* Probes in flight are left to the read thread, which abandons them once disabled */
+	atomic_store_explicit(&lb->threshold, threshold, memory_order_relaxed);
+	DEBUG_PRINT("Probes %s, threshold %"PRId32"\n", (threshold > 0) ? "enabled" : "disabled", threshold);
+}
+
+void LOOPBACK_Arm(LOOPBACK_t *lb, uint64_t tx_seqno, uint64_t received, uint64_t assembled, uint64_t pushed)
+{
+	if (	(atomic_load_explicit(&lb->threshold, memory_order_relaxed) <= 0)
+		 || atomic_load_explicit(&lb->armed, memory_order_acquire)
+	   )
+	{
+		DEBUG_PRINT("Ignoring marker %"PRIu64", probes disabled or another in flight\n", tx_seqno);
+		return;
+	}
+
+	/* Fill in probe, publishing it to the read thread */
+	lb->tx_seqno = tx_seqno;
+	lb->received = received;
+	lb->assembled = assembled;
+	lb->pushed = pushed;
+	atomic_store_explicit(&lb->armed, true, memory_order_release);
+}
+
+bool LOOPBACK_Armed(LOOPBACK_t *lb)
+{
+	return atomic_load_explicit(&lb->armed, memory_order_acquire);
+}
+
+ptrdiff_t LOOPBACK_Find(LOOPBACK_t *lb, const uint8_t *samples, size_t first, size_t count, size_t sample_size)
+{
+	int32_t threshold = atomic_load_explicit(&lb->threshold, memory_order_relaxed);
+	if (threshold <= 0)
+	{
+		/* Disabled since probe was armed, abandon it */
+		atomic_store_explicit(&lb->armed, false, memory_order_release);
+		return -1;
+	}
+
+	/* Check I and Q of first channel (a phase rotated marker may fall in either) */
+	bool check_q = (sample_size >= (2 * sizeof(int16_t)));
+	for (size_t i = first; i < count; i++)
+	{
+		int16_t component[2];
+		memcpy(component, samples + (i * sample_size), check_q ? sizeof(component) : sizeof(component[0]));
+		if (	(abs(component[0]) >= threshold)
+			 || (check_q && (abs(component[1]) >= threshold))
+		   )
+		{
+			return (ptrdiff_t)i;
+		}
+	}
+
+	return -1;
+}
+
+void LOOPBACK_Complete(LOOPBACK_t *lb,
+					   uint64_t rx_seqno,
+					   uint64_t captured,
+					   uint64_t dequeued,
+					   uint64_t sent,
+					   int fd,
+					   const struct sockaddr_in *addr)
+{
+	/* Prepare report, times relative to the marker being received */
+	data_ip_loopback_t report;
+	memset(&report, 0x00, sizeof(report));
+	report.magic = SDR_IP_GADGET_MAGIC;
+	report.flags = SDR_IP_GADGET_DATA_FLAG_LOOPBACK;
+	report.seqno = rx_seqno;
+	report.tx_seqno = lb->tx_seqno;
+	report.assembled_us = since(lb->received, lb->assembled);
+	report.pushed_us = since(lb->received, lb->pushed);
+	report.captured_us = (captured > 0) ? since(lb->received, captured) : 0;
+	report.dequeued_us = since(lb->received, dequeued);
+	report.sent_us = since(lb->received, sent);
+
+	/* Probe complete, the push thread may arm another */
+	atomic_store_explicit(&lb->armed, false, memory_order_release);
+
+	/* Report each stage's share */
+	printf("Loopback: marker %"PRIu64" -> %"PRIu64", assembled: %"PRIu32", pushed: %"PRIu32", ",
+		   report.tx_seqno,
+		   report.seqno,
+		   report.assembled_us,
+		   since(report.assembled_us, report.pushed_us));
+	if (report.captured_us > 0)
+	{
+		printf("captured: %"PRIu32", dequeued: %"PRIu32", ",
+			   since(report.pushed_us, report.captured_us),
+			   since(report.captured_us, report.dequeued_us));
+	}
+	else
+	{
+		printf("dequeued: %"PRIu32", ", since(report.pushed_us, report.dequeued_us));
+	}
+	printf("sent: %"PRIu32", total: %"PRIu32" (uS)\n", since(report.dequeued_us, report.sent_us), report.sent_us);
+
+	/* Send to client, following the marker's data */
+	if (sendto(fd, &report, sizeof(report), 0, (const struct sockaddr*)addr, sizeof(*addr)) < 0)
+	{
+		perror("Failed to send loopback report");
+	}
+}
+
+void LOOPBACK_CheckTimeout(LOOPBACK_t *lb, uint64_t micros)
+{
+	if (LOOPBACK_Armed(lb) && (since(lb->pushed, micros) > LOOPBACK_TIMEOUT_US))
+	{
+		fprintf(stderr, "Loopback marker %"PRIu64" not found in RX stream, abandoning probe\n", lb->tx_seqno);
+		atomic_store_explicit(&lb->armed, false, memory_order_release);
+	}
+}
+
+/* Private functions */
+static uint32_t since(uint64_t from, uint64_t to)
+{
+	/* Elapsed time, clamped should stages have been timed out of order */
+	return (to > from) ? (uint32_t)(to - from) : 0;
+}
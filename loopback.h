@@ -0,0 +1,76 @@
+#ifndef __LOOPBACK_H__
+#define __LOOPBACK_H__
+
+/* Standard libraries */
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <netinet/in.h>
+
+/* Definitions - default marker threshold (RX component magnitude, half the ADC's 12-bit full scale) */
+#define LOOPBACK_DEFAULT_THRESHOLD (1024)
+
+/* Definitions - time allowed for marker to arrive in the RX stream once pushed (uS) */
+#define LOOPBACK_TIMEOUT_US (1000000U)
+
+/*
+** Type definitions - loopback latency probe
+** A TX buffer flagged as a marker by its client is timed through the daemon. Having been pushed to the DAC, the RX
+** stream is searched for its arrival (looped back by the transceiver, or externally), its first sample of either
+** component of the first channel at or above the threshold being taken as the marker. The push thread arms the
+** probe, the read thread completing it, one probe being in flight at a time.
+*/
+typedef struct
+{
+	/* Marker threshold (zero disabling probes) */
+	_Atomic int32_t threshold;
+
+	/* Probe in flight, set by push thread having filled in the following */
+	_Atomic bool armed;
+
+	/* Sequence number / timestamp of marked TX buffer */
+	uint64_t tx_seqno;
+
+	/* Times (uS, monotonic) first marked datagram was received, its buffer assembled and pushed to the DAC */
+	uint64_t received;
+	uint64_t assembled;
+	uint64_t pushed;
+
+} LOOPBACK_t;
+
+/* Reset probe, disabled */
+void LOOPBACK_Reset(LOOPBACK_t *lb);
+
+/* Set marker threshold, zero disabling probes (any in flight being abandoned) */
+void LOOPBACK_SetThreshold(LOOPBACK_t *lb, int32_t threshold);
+
+/* Arm probe with marked buffer having been pushed (ignored while disabled or another is in flight) */
+void LOOPBACK_Arm(LOOPBACK_t *lb, uint64_t tx_seqno, uint64_t received, uint64_t assembled, uint64_t pushed);
+
+/* Check whether probe is in flight, awaiting its marker in the RX stream */
+bool LOOPBACK_Armed(LOOPBACK_t *lb);
+
+/*
+** Find marker within count samples (of sample_size bytes), returning its index or negative if absent
+** Samples before first were captured before the marker was pushed, and are ignored.
+*/
+ptrdiff_t LOOPBACK_Find(LOOPBACK_t *lb, const uint8_t *samples, size_t first, size_t count, size_t sample_size);
+
+/*
+** Complete probe, its marker having been found at RX timestamp / sequence number rx_seqno
+** Times (uS, monotonic) are those at which the marker was captured (zero if unknown), its block dequeued and sent.
+** Results are reported and sent to the RX client as a data_ip_loopback_t.
+*/
+void LOOPBACK_Complete(LOOPBACK_t *lb,
+					   uint64_t rx_seqno,
+					   uint64_t captured,
+					   uint64_t dequeued,
+					   uint64_t sent,
+					   int fd,
+					   const struct sockaddr_in *addr);
+
+/* Abandon probe should its marker not have arrived within LOOPBACK_TIMEOUT_US of micros (uS, monotonic) */
+void LOOPBACK_CheckTimeout(LOOPBACK_t *lb, uint64_t micros);
+
+#endif
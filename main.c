@@ -4,7 +4,9 @@
 #include <fcntl.h>
 #include <getopt.h>
 #include <inttypes.h>
+#include <linux/sock_diag.h>
 #include <netinet/in.h>
+#include <netinet/udp.h>
 #include <pthread.h>
 #include <signal.h>
 #include <stdbool.h>
@@ -14,6 +16,7 @@
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
 #include <sys/socket.h>
+#include <sys/timerfd.h>
 #include <unistd.h>
 
 /* libIIO */
@@ -22,8 +25,16 @@
 /* Local modules */
 #include "sdr_ip_gadget_types.h"
 #include "epoll_loop.h"
+#include "iio_backend.h"
+#include "loopback.h"
+#include "rf_control.h"
+#include "rt_tune.h"
+#include "sample_clock.h"
+#include "stats.h"
 #include "thread_read.h"
+#include "trace.h"
 #include "thread_write.h"
+#include "utils.h"
 
 /* Macros */
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
@@ -32,22 +43,77 @@
 /* Definitions - UDP port numbers */
 #define DIRECT_IP_PORT_CONTROL (30432) // IIOD + 1
 #define DIRECT_IP_PORT_DATA (30433) // IIOD + 2
+#define DIRECT_IP_PORT_DATA_RX (30434) // IIOD + 3, + shard index
+
+/* Definitions - data socket buffer sizes (bytes) */
+#define DATA_SOCKET_BUFFER_SIZE (524288)
+
+/* Definitions - UDP GRO option (should libc headers predate it) */
+#ifndef UDP_GRO
+#define UDP_GRO (104)
+#endif
+
+/* Definitions - socket busy poll options (should libc headers predate them) */
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL (46)
+#endif
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL (69)
+#endif
+
+/* Definitions - socket memory info option (should libc headers predate it) */
+#ifndef SO_MEMINFO
+#define SO_MEMINFO (55)
+#endif
+
+/* Definitions - statistics response size (bytes, header and TLVs of every statistic) */
+#define STATS_RESPONSE_SIZE (512)
+
+/* Definitions - period socket levels are sampled into published statistics (nS) */
+#define STATS_SOCKET_PERIOD_NS (100000000)
+
+/* Definitions - socket busy poll duration while threads spin indefinitely (uS) */
+#define BUSY_POLL_SOCKET_US (50)
 
 /* Type definitions */
 typedef struct
 {
 	/* Socket file descriptors */
 	int sock_control;
-	int sock_data;
+	int sock_data_tx;
 
 	/* Eventfds to signal threads */
 	int read_thread_event_fd;
 	int write_thread_event_fd;
 
-	/* Thread status */
+	/* IIO context, shared by threads */
+	struct iio_context *iio_ctx;
+
+	/* Thread status (created, and running a stream) */
+	bool read_created;
+	bool write_created;
 	bool read_started;
 	bool write_started;
 
+	/* Hardware sample clock, anchored by RX thread for TX thread */
+	SAMPLE_CLOCK_t sample_clock;
+
+	/* RF control (tuning and hopping) */
+	RF_CONTROL_t rf;
+
+	/* Loopback mode (SDR_IP_GADGET_LOOPBACK_*) and latency probe, shared by TX and RX threads */
+	uint8_t loopback_mode;
+	LOOPBACK_t loopback;
+
+	/* Statistics, maintained by threads, published in shared memory and queried by control command */
+	STATS_t *stats;
+
+	/* Timer sampling socket levels into statistics */
+	int stats_timerfd;
+
+	/* Trace of thread events, dumped on request */
+	TRACE_t trace;
+
 	/* Thread arguments */
 	THREAD_READ_Args_t read_args;
 	THREAD_WRITE_Args_t write_args;
@@ -66,14 +132,25 @@ bool debug;
 
 /* Private function */
 static int handle_control(state_t *state);
+static int handle_rf_timer(state_t *state);
+static int handle_stats_timer(state_t *state);
+static void sample_socket_stats(state_t *state);
+static void send_stats(state_t *state, const struct sockaddr_in *addr);
+static void dump_trace(state_t *state, unsigned int seconds);
+static int open_data_socket(uint16_t port);
+static int open_eventfd(const char *name);
+static bool create_threads(state_t *state);
+static void destroy_threads(state_t *state);
 static bool start_thread(state_t *state, bool tx);
 static bool stop_thread(state_t *state, bool tx);
 static void signal_handler(int signum);
+static void dump_signal_handler(int signum);
 static void print_usage(const char *program_name, FILE *dest);
 static const char* cmd_name(uint32_t cmd);
 
 /* Private variables */
 static volatile sig_atomic_t keep_running = 1;
+static volatile sig_atomic_t dump_requested = 0;
 
 /* Public functions */
 int main(int argc, char *argv[])
@@ -94,6 +171,16 @@ int main(int argc, char *argv[])
 	/* Long options array, mapping options to their short equivalents */
 	struct option long_options[] = {
 		{"debug", no_argument, NULL, 'd'},
+		{"gro", no_argument, NULL, 'g'},
+		{"trace", no_argument, NULL, 't'},
+		{"rx-shards", required_argument, NULL, 's'},
+		{"busy-poll", required_argument, NULL, 'b'},
+		{"config", required_argument, NULL, 'c'},
+		{"cpus", required_argument, NULL, 'T'},
+		{"sched", required_argument, NULL, 'T'},
+		{"mlock", no_argument, NULL, 'T'},
+		{"prefault-stack", required_argument, NULL, 'T'},
+		{"irq-affinity", required_argument, NULL, 'T'},
 		{"version", no_argument, NULL, 'v'},
 		{"help", no_argument, NULL, 'h'},
 		{0, 0, 0, 0} // Terminate the options array
@@ -102,7 +189,13 @@ int main(int argc, char *argv[])
 	/* Basic argument parsing */
 	int opt_c;
 	bool err = false;
-	while ((opt_c = getopt_long(argc, argv, "dhv", long_options, NULL)) != -1)
+	bool gro = false;
+	bool tracing = false;
+	int opt_index = 0;
+	unsigned int rx_shards = 1;
+	int32_t busy_poll_us = 0;
+	RT_TUNE_Reset();
+	while ((opt_c = getopt_long(argc, argv, "b:c:dghs:tv", long_options, &opt_index)) != -1)
 	{
 			switch (opt_c)
 			{
@@ -111,6 +204,63 @@ int main(int argc, char *argv[])
 					debug = true;
 					break;
 				}
+				case 'g':
+				{
+					gro = true;
+					break;
+				}
+				case 't':
+				{
+					tracing = true;
+					break;
+				}
+				case 's':
+				{
+					rx_shards = (unsigned int)strtoul(optarg, NULL, 0);
+					if ((rx_shards < 1) || (rx_shards > THREAD_READ_MAX_SHARDS))
+					{
+						fprintf(stderr, "Error: RX shards must be 1 to %u\n", THREAD_READ_MAX_SHARDS);
+						err = true;
+					}
+					break;
+				}
+				case 'b':
+				{
+					/* Spin indefinitely, or for a budget before blocking */
+					long budget = 0;
+					if (0 == strcmp(optarg, "spin"))
+					{
+						busy_poll_us = EPOLL_LOOP_SPIN_FOREVER;
+					}
+					else if (((budget = strtol(optarg, NULL, 0)) > 0) && (budget <= 1000000))
+					{
+						busy_poll_us = (int32_t)budget;
+					}
+					else
+					{
+						fprintf(stderr, "Error: Busy poll mode must be spin or a budget of 1 to 1000000 uS\n");
+						err = true;
+					}
+					break;
+				}
+				case 'c':
+				{
+					/* Options which follow override those of the file */
+					if (!RT_TUNE_LoadConfig(optarg))
+					{
+						err = true;
+					}
+					break;
+				}
+				case 'T':
+				{
+					/* Tuning option, named by its long form */
+					if (!RT_TUNE_SetOption(long_options[opt_index].name, optarg))
+					{
+						err = true;
+					}
+					break;
+				}
 				case 'v':
 				{
 					printf("Version %s\n", PROGRAM_VERSION);
@@ -139,6 +289,13 @@ int main(int argc, char *argv[])
 	/* Register signal handler */
 	signal(SIGINT, signal_handler);
 	signal(SIGTERM, signal_handler);
+	signal(SIGUSR1, dump_signal_handler);
+
+	/* Lock memory and steer interrupts, before anything is allocated for streaming */
+	if (!RT_TUNE_ApplyProcess())
+	{
+		return 1;
+	}
 
 	/* Open sockets */
 	state.sock_control = socket(AF_INET, SOCK_DGRAM, 0);
@@ -151,139 +308,171 @@ int main(int argc, char *argv[])
 	{
 		DEBUG_PRINT("Opened control socket :-)\n");
 	}
-	state.sock_data = socket(AF_INET, SOCK_DGRAM, 0);
-	if (state.sock_data < 0)
-	{
-		perror("Failed to open data socket");
-		return false;
-	}
-	else
-	{
-		DEBUG_PRINT("Opened data socket :-)\n");
-	}
 
-	/* Place sockets in non-blocking mode */
+	/* Place control socket in non-blocking mode */
 	if (fcntl(state.sock_control, F_SETFL, fcntl(state.sock_control, F_GETFL, 0) | O_NONBLOCK))
 	{
 		perror("Failed to set control socket mode to non-blocking");
 		return 1;
 	}
-	if (fcntl(state.sock_data, F_SETFL, fcntl(state.sock_data, F_GETFL, 0) | O_NONBLOCK))
+
+	/* Bind control socket */
+	memset(&addr, 0x00, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = INADDR_ANY;
+	addr.sin_port = htons(DIRECT_IP_PORT_CONTROL);
+	if (bind(state.sock_control, (const struct sockaddr *)&addr, sizeof(addr)))
 	{
-		perror("Failed to set data socket mode to non-blocking");
+		perror("Failed to bind control socket");
 		return 1;
 	}
-
-    // Get the current send buffer size
-    int send_size;
-	socklen_t size_len = sizeof(send_size);
-    if (getsockopt(state.sock_data, SOL_SOCKET, SO_SNDBUF, &send_size, &size_len) == -1)
+	else
 	{
-        perror("getsockopt for send buffer size");
-        return 1;
-    }
+		DEBUG_PRINT("Bound control socket :-)\n");
+	}
 
-    // Get the current receive buffer size
-    int recv_size;
-    size_len = sizeof(recv_size);
-    if (getsockopt(state.sock_data, SOL_SOCKET, SO_RCVBUF, &recv_size, &size_len) == -1)
+	/* Open TX data socket, receiving samples (and sending NACKs / status) */
+	state.sock_data_tx = open_data_socket(DIRECT_IP_PORT_DATA);
+	if (state.sock_data_tx < 0)
 	{
-        perror("getsockopt for receive buffer size");
-        return 1;
-    }
-
-	// Report current sizes
-    DEBUG_PRINT("Current socket send = %d receive = %d\n", send_size, recv_size);
+		return 1;
+	}
 
-	// Set the send buffer size
-	send_size = 524288;
-    if (setsockopt(state.sock_data, SOL_SOCKET, SO_SNDBUF, &send_size, sizeof(send_size)) == -1)
+	/* Enable generic receive offload if requested, falling back to individual datagrams if unsupported */
+	if (gro)
 	{
-        perror("setsockopt for send buffer size");
-        return 1;
-    }
+		int enable = 1;
+		if (setsockopt(state.sock_data_tx, SOL_UDP, UDP_GRO, &enable, sizeof(enable)) < 0)
+		{
+			perror("Failed to enable UDP GRO on data socket, continuing without");
+		}
+		else
+		{
+			DEBUG_PRINT("Enabled UDP GRO on data socket :-)\n");
+			state.write_args.udp_gro = true;
+		}
+	}
 
-	// Set the receive buffer size
-	recv_size = 524288;
-    if (setsockopt(state.sock_data, SOL_SOCKET, SO_RCVBUF, &recv_size, sizeof(send_size)) == -1)
+	/* Busy poll data socket if requested, the device driver being polled for datagrams rather than waiting on its interrupt */
+	if (0 != busy_poll_us)
 	{
-        perror("setsockopt for receive buffer size");
-        return 1;
-    }
+		int busy_poll = (busy_poll_us > 0) ? busy_poll_us : BUSY_POLL_SOCKET_US;
+		int prefer = 1;
+		if (setsockopt(state.sock_data_tx, SOL_SOCKET, SO_BUSY_POLL, &busy_poll, sizeof(busy_poll)) < 0)
+		{
+			perror("Failed to enable busy polling of data socket, continuing without");
+		}
+		else if (setsockopt(state.sock_data_tx, SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer, sizeof(prefer)) < 0)
+		{
+			perror("Failed to prefer busy polling of data socket, continuing without");
+		}
+		else
+		{
+			DEBUG_PRINT("Enabled busy polling of data socket :-)\n");
+		}
 
-    // Get the updated send buffer size
-	size_len = sizeof(send_size);
-    if (getsockopt(state.sock_data, SOL_SOCKET, SO_SNDBUF, &send_size, &size_len) == -1)
-	{
-        perror("getsockopt for send buffer size");
-        return 1;
-    }
+		/* Threads spin regardless, the socket option only saving the wait for an interrupt */
+		state.write_args.busy_poll_us = busy_poll_us;
+		state.read_args.busy_poll_us = busy_poll_us;
+	}
 
-    // Get the updated receive buffer size
-    size_len = sizeof(recv_size);
-    if (getsockopt(state.sock_data, SOL_SOCKET, SO_RCVBUF, &recv_size, &size_len) == -1)
+	/* Open RX data sockets, one per sender shard, each with its own source port */
+	for (unsigned int i = 0; i < rx_shards; i++)
 	{
-        perror("getsockopt for receive buffer size");
-        return 1;
-    }
-
-	// Report updated sizes
-    DEBUG_PRINT("Updated socket send = %d receive = %d\n", send_size, recv_size);
+		state.read_args.output_fds[i] = open_data_socket(DIRECT_IP_PORT_DATA_RX + i);
+		if (state.read_args.output_fds[i] < 0)
+		{
+			return 1;
+		}
+		state.read_args.output_fd_count++;
+	}
 
-	/* Bind sockets */
-	memset(&addr, 0x00, sizeof(addr));
-	addr.sin_family = AF_INET;
-	addr.sin_addr.s_addr = INADDR_ANY;
-	addr.sin_port = htons(DIRECT_IP_PORT_CONTROL);
-	if (bind(state.sock_control, (const struct sockaddr *)&addr, sizeof(addr)))
+	/* Prepare eventfds to notify threads to cancel, start streams and to be notified of streams ending */
+	state.read_thread_event_fd = open_eventfd("read");
+	state.write_thread_event_fd = open_eventfd("write");
+	state.read_args.start_event_fd = open_eventfd("read start");
+	state.read_args.idle_event_fd = open_eventfd("read idle");
+	state.write_args.start_event_fd = open_eventfd("write start");
+	state.write_args.idle_event_fd = open_eventfd("write idle");
+	state.read_args.reconfig_event_fd = open_eventfd("read reconfig");
+	state.write_args.reconfig_event_fd = open_eventfd("write reconfig");
+	if (	(state.read_thread_event_fd < 0)
+		 || (state.write_thread_event_fd < 0)
+		 || (state.read_args.start_event_fd < 0)
+		 || (state.read_args.idle_event_fd < 0)
+		 || (state.write_args.start_event_fd < 0)
+		 || (state.write_args.idle_event_fd < 0)
+		 || (state.read_args.reconfig_event_fd < 0)
+		 || (state.write_args.reconfig_event_fd < 0))
 	{
-		perror("Failed to bind control socket");
 		return 1;
 	}
-	else
-	{
-		DEBUG_PRINT("Bound control socket :-)\n");
-	}
-	addr.sin_port = htons(DIRECT_IP_PORT_DATA);
-	if (bind(state.sock_data, (const struct sockaddr *)&addr, sizeof(addr)))
+
+	/* Reconfig eventfds are cleared after streams end, whether or not one was handled */
+	if (fcntl(state.read_args.reconfig_event_fd, F_SETFL, fcntl(state.read_args.reconfig_event_fd, F_GETFL, 0) | O_NONBLOCK))
 	{
-		perror("Failed to bind data socket");
+		perror("Failed to set read reconfig eventfd non-blocking");
 		return 1;
 	}
-	else
+	if (fcntl(state.write_args.reconfig_event_fd, F_SETFL, fcntl(state.write_args.reconfig_event_fd, F_GETFL, 0) | O_NONBLOCK))
 	{
-		DEBUG_PRINT("Bound data socket :-)\n");
+		perror("Failed to set write reconfig eventfd non-blocking");
+		return 1;
 	}
 
-	/* Prepare eventfds to notify threads to cancel */
-	state.read_thread_event_fd = eventfd(0, 0);
-	if (state.read_thread_event_fd < 0)
+	/* Create IIO context once, such that streams needn't wait for the devices to be scanned */
+	state.iio_ctx = IIO_BACKEND_CreateContext();
+	if (!state.iio_ctx)
 	{
-		perror("Failed to open read eventfd");
+		fprintf(stderr, "Failed to open iio\n");
 		return 1;
 	}
-	else
-	{
-		DEBUG_PRINT("Opened read eventfd :-)\n");
-	}
-	state.write_thread_event_fd = eventfd(0, 0);
-	if (state.write_thread_event_fd < 0)
+
+	/* Prepare shared sample clock */
+	SAMPLE_CLOCK_Reset(&state.sample_clock);
+
+	/* Prepare RF control, hops being timed against the sample clock */
+	if (!RF_CONTROL_Init(&state.rf, state.iio_ctx, &state.sample_clock))
 	{
-		perror("Failed to open write eventfd");
 		return 1;
 	}
-	else
+
+	/* Prepare loopback probe, disabled until requested */
+	LOOPBACK_Reset(&state.loopback);
+
+	/* Create statistics, counted from now */
+	state.stats = STATS_Open();
+	if (!state.stats)
 	{
-		DEBUG_PRINT("Opened write eventfd :-)\n");
+		return 1;
 	}
 
+	/* Prepare trace, threads registering as they start should tracing be enabled */
+	TRACE_Init(&state.trace);
+
 	/* Prepare read args */
 	state.read_args.quit_event_fd = state.read_thread_event_fd;
-	state.read_args.output_fd = state.sock_data;
+	state.read_args.iio_ctx = state.iio_ctx;
+	state.read_args.sample_clock = &state.sample_clock;
+	state.read_args.loopback = &state.loopback;
+	state.read_args.stats = state.stats;
+	state.read_args.trace = tracing ? &state.trace : NULL;
 
 	/* Prepare write args */
 	state.write_args.quit_event_fd = state.write_thread_event_fd;
-	state.write_args.input_fd = state.sock_data;
+	state.write_args.iio_ctx = state.iio_ctx;
+	state.write_args.input_fd = state.sock_data_tx;
+	state.write_args.sample_clock = &state.sample_clock;
+	state.write_args.loopback = &state.loopback;
+	state.write_args.stats = state.stats;
+	state.write_args.trace = tracing ? &state.trace : NULL;
+
+	/* Create threads, which wait to be started */
+	if (!create_threads(&state))
+	{
+		destroy_threads(&state);
+		return 1;
+	}
 
 	/* Create epoll instance */
 	int epoll_fd = epoll_create1(0);
@@ -313,6 +502,52 @@ int main(int argc, char *argv[])
 		DEBUG_PRINT("Registered control socket with epoll :-)\n");
 	}
 
+	/* Register hop timer with epoll */
+	epoll_event.events = EPOLLIN;
+	epoll_event.data.ptr = handle_rf_timer;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, RF_CONTROL_GetTimerFd(&state.rf), &epoll_event) < 0)
+	{
+		/* Failed to register hop timer with epoll */
+		perror("Failed to register hop timer with epoll");
+		return 1;
+	}
+	else
+	{
+		DEBUG_PRINT("Registered hop timer with epoll :-)\n");
+	}
+
+	/* Create timer sampling socket levels, such that published statistics keep up with them */
+	state.stats_timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+	if (state.stats_timerfd < 0)
+	{
+		perror("Failed to open stats timerfd");
+		return 1;
+	}
+	struct itimerspec stats_period =
+	{
+		.it_value = { .tv_sec = 0, .tv_nsec = STATS_SOCKET_PERIOD_NS },
+		.it_interval = { .tv_sec = 0, .tv_nsec = STATS_SOCKET_PERIOD_NS }
+	};
+	if (timerfd_settime(state.stats_timerfd, 0, &stats_period, NULL) < 0)
+	{
+		perror("Failed to set stats timerfd");
+		return 1;
+	}
+
+	/* Register stats timer with epoll */
+	epoll_event.events = EPOLLIN;
+	epoll_event.data.ptr = handle_stats_timer;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, state.stats_timerfd, &epoll_event) < 0)
+	{
+		/* Failed to register stats timer with epoll */
+		perror("Failed to register stats timer with epoll");
+		return 1;
+	}
+	else
+	{
+		DEBUG_PRINT("Registered stats timer with epoll :-)\n");
+	}
+
 	/* Here we go */
 	printf("Ready :-)\n");
 
@@ -326,19 +561,51 @@ int main(int argc, char *argv[])
 			/* Handler failed...bail */
 			break;
 		}
+
+		/* Dump trace as signalled (epoll being interrupted by the signal) */
+		if (dump_requested)
+		{
+			dump_requested = 0;
+			dump_trace(&state, TRACE_DUMP_DEFAULT_SECS);
+		}
 	}
 	DEBUG_PRINT("Exit main loop :-(\n");
 
-	/* Stop threads */
+	/* Stop and destroy threads */
 	stop_thread(&state, false);
 	stop_thread(&state, true);
+	destroy_threads(&state);
+	if (SDR_IP_GADGET_LOOPBACK_DIGITAL == state.loopback_mode)
+	{
+		/* Leave transceiver as found */
+		RF_CONTROL_SetLoopback(&state.rf, false);
+	}
+	RF_CONTROL_Destroy(&state.rf);
+	iio_context_destroy(state.iio_ctx);
+
+	/* Unpublish statistics */
+	STATS_Close(state.stats);
+
+	/* Free trace, its threads having exited */
+	TRACE_Destroy(&state.trace);
 
 	/* Close files */
 	close(epoll_fd);
+	close(state.stats_timerfd);
 	close(state.read_thread_event_fd);
 	close(state.write_thread_event_fd);
+	close(state.read_args.start_event_fd);
+	close(state.read_args.idle_event_fd);
+	close(state.write_args.start_event_fd);
+	close(state.write_args.idle_event_fd);
+	close(state.read_args.reconfig_event_fd);
+	close(state.write_args.reconfig_event_fd);
 	close(state.sock_control);
-	close(state.sock_data);
+	close(state.sock_data_tx);
+	for (unsigned int i = 0; i < state.read_args.output_fd_count; i++)
+	{
+		close(state.read_args.output_fds[i]);
+	}
 
 	/* Goodbye */
 	printf("Bye!\n");
@@ -354,7 +621,8 @@ static int handle_control(state_t *state)
 	cmd_ip_t cmd;
 	int ret;
 
-	/* Read datagram from socket */
+	/* Read datagram from socket (zeroing command first, such that omitted optional fields read as zero) */
+	memset(&cmd, 0x00, sizeof(cmd));
     len = sizeof(addr);
     ret = recvfrom(state->sock_control, &cmd, sizeof(cmd), 0, (struct sockaddr*)&addr, &len);
 	if (ret < sizeof(cmd_ip_header_t))
@@ -379,7 +647,7 @@ static int handle_control(state_t *state)
 		case SDR_IP_GADGET_COMMAND_START_TX:
 		{
 			/* Check request size */
-			if (ret != sizeof(cmd_ip_tx_start_req_t))
+			if ((ret < (int)SDR_IP_GADGET_TX_START_MIN_SIZE) || (ret > (int)sizeof(cmd_ip_tx_start_req_t)))
 			{
 				printf("Bad TX start request, incorrect data size\n");
 				break;
@@ -389,13 +657,44 @@ static int handle_control(state_t *state)
 			stop_thread(state, true);
 
 			/* Prepare args */
-			DEBUG_PRINT("Start TX with chans: %08X, timestamp: %S, buffsize: %zu\n",
+			DEBUG_PRINT("Start TX with chans: %08X, timestamp: %s, buffsize: %u, jitter: %u buffers / %u ms, kernel buffers: %u, pktsize: %u, fec group: %u, nack window: %u, status: %u ms, format: %u, cyclic: %s, release horizon: %u ms, late policy: %u, burst idle: %u us, interp: %u x %u taps, nco: %d Hz\n",
 						cmd.start_tx.enabled_channels,
 						cmd.start_tx.timestamping_enabled ? "enabled" : "disabled",
-						cmd.start_tx.buffer_size);
+						cmd.start_tx.buffer_size,
+						cmd.start_tx.jitter_buffers,
+						cmd.start_tx.jitter_ms,
+						cmd.start_tx.kernel_buffers,
+						cmd.start_tx.packet_size,
+						cmd.start_tx.fec_group_size,
+						cmd.start_tx.nack_window,
+						cmd.start_tx.status_interval_ms,
+						cmd.start_tx.sample_format,
+						cmd.start_tx.cyclic ? "enabled" : "disabled",
+						cmd.start_tx.release_horizon_ms,
+						cmd.start_tx.late_policy,
+						cmd.start_tx.burst_idle_us,
+						cmd.start_tx.interp_factor,
+						cmd.start_tx.interp_taps,
+						(int)cmd.start_tx.interp_nco_hz);
 			state->write_args.iio_channels = cmd.start_tx.enabled_channels;
 			state->write_args.timestamping_enabled = cmd.start_tx.timestamping_enabled;
 			state->write_args.iio_buffer_size = cmd.start_tx.buffer_size;
+			state->write_args.jitter_buffers = cmd.start_tx.jitter_buffers;
+			state->write_args.jitter_ms = cmd.start_tx.jitter_ms;
+			state->write_args.kernel_buffers = cmd.start_tx.kernel_buffers;
+			state->write_args.udp_packet_size = cmd.start_tx.packet_size;
+			state->write_args.fec_group_size = cmd.start_tx.fec_group_size;
+			state->write_args.nack_window = cmd.start_tx.nack_window;
+			state->write_args.status_interval_ms = cmd.start_tx.status_interval_ms;
+			state->write_args.sample_format = cmd.start_tx.sample_format;
+			state->write_args.cyclic = cmd.start_tx.cyclic;
+			state->write_args.release_horizon_ms = cmd.start_tx.release_horizon_ms;
+			state->write_args.late_policy = cmd.start_tx.late_policy;
+			state->write_args.burst_idle_us = cmd.start_tx.burst_idle_us;
+			state->write_args.interp_factor = cmd.start_tx.interp_factor;
+			state->write_args.interp_taps = cmd.start_tx.interp_taps;
+			state->write_args.interp_nco_hz = cmd.start_tx.interp_nco_hz;
+			state->write_args.generate = false;
 
 			/* Start thread */
 			start_thread(state, true);
@@ -404,7 +703,7 @@ static int handle_control(state_t *state)
 		case SDR_IP_GADGET_COMMAND_START_RX:
 		{
 			/* Check request size */
-			if (ret != sizeof(cmd_ip_rx_start_req_t))
+			if ((ret < (int)SDR_IP_GADGET_RX_START_MIN_SIZE) || (ret > (int)sizeof(cmd_ip_rx_start_req_t)))
 			{
 				printf("Bad RX start request, incorrect data size\n");
 				break;
@@ -419,11 +718,12 @@ static int handle_control(state_t *state)
 				perror("Error converting address to string");
 				addr_str[0] = '\0';
 			}
-			DEBUG_PRINT("Start RX with chans: %08X, timestamp: %s, buffsize: %zu, pktsize: %zu, dest: %s:%u\n",
+			DEBUG_PRINT("Start RX with chans: %08X, timestamp: %s, buffsize: %u, pktsize: %u, kernel buffers: %u, dest: %s:%u\n",
 						cmd.start_rx.enabled_channels,
 						cmd.start_rx.timestamping_enabled ? "enabled" : "disabled",
 						cmd.start_rx.buffer_size,
 						cmd.start_rx.packet_size,
+						cmd.start_rx.kernel_buffers,
 						addr_str, ntohs(cmd.start_rx.data_port));
 			state->read_args.addr.sin_family = AF_INET;
 			state->read_args.addr.sin_addr = addr.sin_addr;
@@ -432,9 +732,67 @@ static int handle_control(state_t *state)
 			state->read_args.timestamping_enabled = cmd.start_rx.timestamping_enabled;
 			state->read_args.iio_buffer_size = cmd.start_rx.buffer_size;
 			state->read_args.udp_packet_size = cmd.start_rx.packet_size;
+			state->read_args.kernel_buffers = cmd.start_rx.kernel_buffers;
+
+			/* Start thread, tagging hops in its stream (which may only be scheduled should it be timestamped) */
+			if (start_thread(state, false))
+			{
+				RF_CONTROL_SetTagDestination(&state->rf, state->read_args.output_fds[0], &state->read_args.addr);
+			}
+			break;
+		}
+		case SDR_IP_GADGET_COMMAND_START_TX_GEN:
+		{
+			/* Check request size */
+			if (ret != sizeof(cmd_ip_tx_gen_req_t))
+			{
+				printf("Bad TX generator start request, incorrect data size\n");
+				break;
+			}
+
+			/* Ensure thread stopped */
+			stop_thread(state, true);
+
+			/* Prepare args, generated samples replacing those from the data socket */
+			DEBUG_PRINT("Start TX generator with chans: %08X, buffsize: %u, kernel buffers: %u, waveform: %u, amplitude: %d, freq: %d / %d Hz, tones: %u, period: %u\n",
+						cmd.start_tx_gen.enabled_channels,
+						cmd.start_tx_gen.buffer_size,
+						cmd.start_tx_gen.kernel_buffers,
+						cmd.start_tx_gen.waveform,
+						cmd.start_tx_gen.amplitude,
+						cmd.start_tx_gen.frequency,
+						cmd.start_tx_gen.frequency2,
+						cmd.start_tx_gen.tones,
+						cmd.start_tx_gen.period);
+			state->write_args.iio_channels = cmd.start_tx_gen.enabled_channels;
+			state->write_args.timestamping_enabled = false;
+			state->write_args.iio_buffer_size = cmd.start_tx_gen.buffer_size;
+			state->write_args.jitter_buffers = 0;
+			state->write_args.jitter_ms = 0;
+			state->write_args.kernel_buffers = cmd.start_tx_gen.kernel_buffers;
+			state->write_args.udp_packet_size = 0;
+			state->write_args.fec_group_size = 0;
+			state->write_args.nack_window = 0;
+			state->write_args.status_interval_ms = 0;
+			state->write_args.sample_format = SDR_IP_GADGET_SAMPLE_FORMAT_S16;
+			state->write_args.cyclic = false;
+			state->write_args.release_horizon_ms = 0;
+			state->write_args.late_policy = SDR_IP_GADGET_LATE_POLICY_PUSH;
+			state->write_args.burst_idle_us = 0;
+			state->write_args.interp_factor = 0;
+			state->write_args.interp_taps = 0;
+			state->write_args.interp_nco_hz = 0;
+			state->write_args.generate = true;
+			state->write_args.wavegen.waveform = cmd.start_tx_gen.waveform;
+			state->write_args.wavegen.amplitude = cmd.start_tx_gen.amplitude;
+			state->write_args.wavegen.frequency = cmd.start_tx_gen.frequency;
+			state->write_args.wavegen.frequency2 = cmd.start_tx_gen.frequency2;
+			state->write_args.wavegen.tones = cmd.start_tx_gen.tones;
+			state->write_args.wavegen.period = cmd.start_tx_gen.period;
+			state->write_args.wavegen.seed = cmd.start_tx_gen.seed;
 
 			/* Start thread */
-			start_thread(state, false);
+			start_thread(state, true);
 			break;
 		}
 		case SDR_IP_GADGET_COMMAND_STOP_TX:
@@ -449,6 +807,174 @@ static int handle_control(state_t *state)
 			stop_thread(state, tx);
 			break;
 		}
+		case SDR_IP_GADGET_COMMAND_RECONFIGURE:
+		{
+			/* Check request size */
+			if (ret != sizeof(cmd_ip_reconfigure_req_t))
+			{
+				printf("Bad reconfigure request, incorrect data size\n");
+				break;
+			}
+
+			DEBUG_PRINT("Reconfigure %s with buffsize: %u, pktsize: %u\n",
+						cmd.reconfigure.tx ? "TX" : "RX",
+						cmd.reconfigure.buffer_size,
+						cmd.reconfigure.packet_size);
+			if (cmd.reconfigure.tx)
+			{
+				/* Ignore unless running, next start request providing its own sizes */
+				if (!state->write_started)
+				{
+					printf("Ignoring TX reconfigure request, not running\n");
+					break;
+				}
+
+				/* Have thread switch to new sizes at the next buffer boundary, buffers already queued keeping theirs */
+				atomic_store(&state->write_args.reconfig_buffer_size, cmd.reconfigure.buffer_size);
+				atomic_store(&state->write_args.reconfig_packet_size, cmd.reconfigure.packet_size);
+				uint64_t eventfd_val = 0x1;
+				if (write(state->write_args.reconfig_event_fd, &eventfd_val, sizeof(eventfd_val)) < 0)
+				{
+					perror("Failed to signal write thread reconfigure");
+				}
+			}
+			else
+			{
+				if (!state->read_started)
+				{
+					printf("Ignoring RX reconfigure request, not running\n");
+					break;
+				}
+
+				/* Have thread switch to new sizes at the next buffer boundary */
+				atomic_store(&state->read_args.reconfig_buffer_size, cmd.reconfigure.buffer_size);
+				atomic_store(&state->read_args.reconfig_packet_size, cmd.reconfigure.packet_size);
+				uint64_t eventfd_val = 0x1;
+				if (write(state->read_args.reconfig_event_fd, &eventfd_val, sizeof(eventfd_val)) < 0)
+				{
+					perror("Failed to signal read thread reconfigure");
+				}
+			}
+			break;
+		}
+		case SDR_IP_GADGET_COMMAND_RF_SET:
+		{
+			/* Check request size */
+			if (ret != sizeof(cmd_ip_rf_set_req_t))
+			{
+				printf("Bad RF set request, incorrect data size\n");
+				break;
+			}
+
+			DEBUG_PRINT("RF set parameter: %u, value: %"PRId64"\n", cmd.rf_set.param, cmd.rf_set.value);
+			RF_CONTROL_Set(&state->rf, cmd.rf_set.param, cmd.rf_set.value);
+			break;
+		}
+		case SDR_IP_GADGET_COMMAND_FASTLOCK_STORE:
+		{
+			/* Check request size */
+			if (ret != sizeof(cmd_ip_fastlock_store_req_t))
+			{
+				printf("Bad fast lock store request, incorrect data size\n");
+				break;
+			}
+
+			DEBUG_PRINT("Store %s fast lock profile: %u, freq: %"PRIu64" Hz\n",
+						cmd.fastlock_store.tx ? "TX" : "RX",
+						cmd.fastlock_store.profile,
+						cmd.fastlock_store.frequency);
+			RF_CONTROL_FastlockStore(&state->rf, cmd.fastlock_store.tx, cmd.fastlock_store.profile, cmd.fastlock_store.frequency);
+			break;
+		}
+		case SDR_IP_GADGET_COMMAND_HOP:
+		{
+			/* Check request size */
+			if (ret != sizeof(cmd_ip_hop_req_t))
+			{
+				printf("Bad hop request, incorrect data size\n");
+				break;
+			}
+
+			DEBUG_PRINT("Hop %s to fast lock profile: %u, at: %"PRIu64", tag: %u\n",
+						cmd.hop.tx ? "TX" : "RX",
+						cmd.hop.profile,
+						cmd.hop.timestamp,
+						cmd.hop.tag);
+			RF_CONTROL_Hop_t hop =
+			{
+				.timestamp = cmd.hop.timestamp,
+				.tag = cmd.hop.tag,
+				.profile = cmd.hop.profile,
+				.tx = cmd.hop.tx
+			};
+			RF_CONTROL_Hop(&state->rf, &hop);
+			break;
+		}
+		case SDR_IP_GADGET_COMMAND_HOP_CANCEL:
+		{
+			DEBUG_PRINT("Cancel hops\n");
+			RF_CONTROL_CancelHops(&state->rf);
+			break;
+		}
+		case SDR_IP_GADGET_COMMAND_LOOPBACK:
+		{
+			/* Check request size */
+			if (ret != sizeof(cmd_ip_loopback_req_t))
+			{
+				printf("Bad loopback request, incorrect data size\n");
+				break;
+			}
+			if (cmd.loopback.mode > SDR_IP_GADGET_LOOPBACK_EXTERNAL)
+			{
+				printf("Bad loopback request, unknown mode %u\n", cmd.loopback.mode);
+				break;
+			}
+
+			DEBUG_PRINT("Loopback mode: %u, threshold: %u\n", cmd.loopback.mode, cmd.loopback.threshold);
+
+			/* Switch transceiver's digital loopback should it change */
+			bool digital = (SDR_IP_GADGET_LOOPBACK_DIGITAL == cmd.loopback.mode);
+			if (	(digital != (SDR_IP_GADGET_LOOPBACK_DIGITAL == state->loopback_mode))
+				 && !RF_CONTROL_SetLoopback(&state->rf, digital)
+			   )
+			{
+				break;
+			}
+			state->loopback_mode = cmd.loopback.mode;
+
+			/* Enable probes (with default threshold if unset) unless turning loopback off */
+			int32_t threshold = 0;
+			if (SDR_IP_GADGET_LOOPBACK_OFF != cmd.loopback.mode)
+			{
+				threshold = (cmd.loopback.threshold > 0) ? cmd.loopback.threshold : LOOPBACK_DEFAULT_THRESHOLD;
+			}
+			LOOPBACK_SetThreshold(&state->loopback, threshold);
+			break;
+		}
+		case SDR_IP_GADGET_COMMAND_GET_STATS:
+		{
+			/* Check request size */
+			if (ret != sizeof(cmd_ip_get_stats_req_t))
+			{
+				printf("Bad get stats request, incorrect data size\n");
+				break;
+			}
+
+			send_stats(state, &addr);
+			break;
+		}
+		case SDR_IP_GADGET_COMMAND_TRACE_DUMP:
+		{
+			/* Check request size */
+			if (ret != sizeof(cmd_ip_trace_dump_req_t))
+			{
+				printf("Bad trace dump request, incorrect data size\n");
+				break;
+			}
+
+			dump_trace(state, (cmd.trace_dump.seconds > 0) ? cmd.trace_dump.seconds : TRACE_DUMP_DEFAULT_SECS);
+			break;
+		}
 		default:
 		{
 			/* Ignore unknown requests */
@@ -459,7 +985,171 @@ static int handle_control(state_t *state)
 	return 0;
 }
 
-static bool start_thread(state_t *state, bool tx)
+static int handle_rf_timer(state_t *state)
+{
+	/* Make hops now due */
+	return RF_CONTROL_HandleTimer(&state->rf);
+}
+
+static int handle_stats_timer(state_t *state)
+{
+	/* Read timer to acknowledge it */
+	uint64_t timerfd_val;
+	if (read(state->stats_timerfd, &timerfd_val, sizeof(timerfd_val)) < 0)
+	{
+		perror("Failed to read stats timerfd");
+		return 1;
+	}
+
+	sample_socket_stats(state);
+
+	return 0;
+}
+
+static void sample_socket_stats(state_t *state)
+{
+	/* Sample socket levels (allocated receive / send memory) and kernel drops */
+	uint32_t meminfo[SK_MEMINFO_VARS];
+	socklen_t len = sizeof(meminfo);
+	if (getsockopt(state->sock_data_tx, SOL_SOCKET, SO_MEMINFO, meminfo, &len) == 0)
+	{
+		STATS_Set(state->stats, SDR_IP_GADGET_STAT_TX_SOCKET_QUEUED, meminfo[SK_MEMINFO_RMEM_ALLOC]);
+		STATS_Set(state->stats, SDR_IP_GADGET_STAT_TX_SOCKET_DROPS, meminfo[SK_MEMINFO_DROPS]);
+	}
+	uint64_t rx_queued = 0;
+	for (unsigned int i = 0; i < state->read_args.output_fd_count; i++)
+	{
+		len = sizeof(meminfo);
+		if (getsockopt(state->read_args.output_fds[i], SOL_SOCKET, SO_MEMINFO, meminfo, &len) == 0)
+		{
+			rx_queued += meminfo[SK_MEMINFO_WMEM_ALLOC];
+		}
+	}
+	STATS_Set(state->stats, SDR_IP_GADGET_STAT_RX_SOCKET_QUEUED, rx_queued);
+}
+
+static void send_stats(state_t *state, const struct sockaddr_in *addr)
+{
+	/* Bring socket levels up to date */
+	sample_socket_stats(state);
+
+	/* Prepare response, header followed by statistics */
+	uint8_t response[STATS_RESPONSE_SIZE];
+	cmd_ip_header_t hdr = { .magic = SDR_IP_GADGET_MAGIC, .cmd = SDR_IP_GADGET_COMMAND_GET_STATS };
+	memcpy(response, &hdr, sizeof(hdr));
+	size_t used = sizeof(hdr) + STATS_Encode(state->stats, response + sizeof(hdr), sizeof(response) - sizeof(hdr));
+
+	/* Send to requester */
+	if (sendto(state->sock_control, response, used, 0, (const struct sockaddr*)addr, sizeof(*addr)) < 0)
+	{
+		perror("Failed to send stats");
+	}
+}
+
+static void dump_trace(state_t *state, unsigned int seconds)
+{
+	if (!state->read_args.trace)
+	{
+		printf("Trace: not enabled (-t), nothing to dump\n");
+		return;
+	}
+
+	/* Formatting trace in this thread, those traced being left undisturbed */
+	long events = TRACE_Dump(&state->trace, TRACE_DUMP_PATH, seconds);
+	if (events >= 0)
+	{
+		printf("Trace: dumped %ld events of last %u s to %s\n", events, seconds, TRACE_DUMP_PATH);
+	}
+}
+
+static int open_data_socket(uint16_t port)
+{
+	/* Open socket */
+	int sock = socket(AF_INET, SOCK_DGRAM, 0);
+	if (sock < 0)
+	{
+		perror("Failed to open data socket");
+		return -1;
+	}
+	else
+	{
+		DEBUG_PRINT("Opened data socket for port %u :-)\n", port);
+	}
+
+	/* Place socket in non-blocking mode */
+	if (fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK))
+	{
+		perror("Failed to set data socket mode to non-blocking");
+		close(sock);
+		return -1;
+	}
+
+	/* Enlarge send / receive buffers, reporting sizes before and after */
+	int send_size;
+	int recv_size;
+	socklen_t size_len = sizeof(send_size);
+	if (	(getsockopt(sock, SOL_SOCKET, SO_SNDBUF, &send_size, &size_len) == -1)
+		 || (getsockopt(sock, SOL_SOCKET, SO_RCVBUF, &recv_size, &size_len) == -1))
+	{
+		perror("getsockopt for buffer size");
+		close(sock);
+		return -1;
+	}
+	DEBUG_PRINT("Current socket send = %d receive = %d\n", send_size, recv_size);
+	send_size = DATA_SOCKET_BUFFER_SIZE;
+	recv_size = DATA_SOCKET_BUFFER_SIZE;
+	if (	(setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &send_size, sizeof(send_size)) == -1)
+		 || (setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &recv_size, sizeof(recv_size)) == -1))
+	{
+		perror("setsockopt for buffer size");
+		close(sock);
+		return -1;
+	}
+	if (	(getsockopt(sock, SOL_SOCKET, SO_SNDBUF, &send_size, &size_len) == -1)
+		 || (getsockopt(sock, SOL_SOCKET, SO_RCVBUF, &recv_size, &size_len) == -1))
+	{
+		perror("getsockopt for buffer size");
+		close(sock);
+		return -1;
+	}
+	DEBUG_PRINT("Updated socket send = %d receive = %d\n", send_size, recv_size);
+
+	/* Bind socket */
+	struct sockaddr_in addr;
+	memset(&addr, 0x00, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = INADDR_ANY;
+	addr.sin_port = htons(port);
+	if (bind(sock, (const struct sockaddr *)&addr, sizeof(addr)))
+	{
+		perror("Failed to bind data socket");
+		close(sock);
+		return -1;
+	}
+	else
+	{
+		DEBUG_PRINT("Bound data socket :-)\n");
+	}
+
+	return sock;
+}
+
+static int open_eventfd(const char *name)
+{
+	int fd = eventfd(0, 0);
+	if (fd < 0)
+	{
+		fprintf(stderr, "Failed to open %s eventfd: %s\n", name, strerror(errno));
+	}
+	else
+	{
+		DEBUG_PRINT("Opened %s eventfd :-)\n", name);
+	}
+
+	return fd;
+}
+
+static bool create_threads(state_t *state)
 {
 	/* Mask all signals (such that threads will by default not handle them) */
 	sigset_t new_mask, old_mask;
@@ -470,33 +1160,79 @@ static bool start_thread(state_t *state, bool tx)
 		return false;
 	}
 
-	/* Create appropriate thread */
+	/* Create threads, each waiting to be started */
+	atomic_init(&state->read_args.terminate, false);
+	atomic_init(&state->write_args.terminate, false);
+	state->read_created = (0 == pthread_create(&state->thread_read, NULL, &THREAD_READ_Entrypoint, &state->read_args));
+	if (!state->read_created)
+	{
+		perror("Failed to create read thread");
+	}
+	state->write_created = (0 == pthread_create(&state->thread_write, NULL, &THREAD_WRITE_Entrypoint, &state->write_args));
+	if (!state->write_created)
+	{
+		perror("Failed to create write thread");
+	}
+
+	/* Return signal mask to old value, such that all signals will be handled by main thread */
+	if (sigprocmask(SIG_SETMASK, &old_mask, NULL) < 0)
+	{
+		perror("Failed to unmask signals");
+		return false;
+	}
+
+	return state->read_created && state->write_created;
+}
+
+static void destroy_threads(state_t *state)
+{
+	/* Signal threads to start with terminate set, such that they exit, joining with them */
+	uint64_t eventfd_val = 0x1;
+	if (state->read_created)
+	{
+		atomic_store(&state->read_args.terminate, true);
+		if (write(state->read_args.start_event_fd, &eventfd_val, sizeof(eventfd_val)) < 0)
+		{
+			perror("Failed to write to read thread start eventfd");
+		}
+		pthread_join(state->thread_read, NULL);
+		state->read_created = false;
+	}
+	if (state->write_created)
+	{
+		atomic_store(&state->write_args.terminate, true);
+		if (write(state->write_args.start_event_fd, &eventfd_val, sizeof(eventfd_val)) < 0)
+		{
+			perror("Failed to write to write thread start eventfd");
+		}
+		pthread_join(state->thread_write, NULL);
+		state->write_created = false;
+	}
+}
+
+static bool start_thread(state_t *state, bool tx)
+{
+	/* Signal appropriate thread to start stream, args having been prepared */
+	uint64_t eventfd_val = 0x1;
 	if (tx && !state->write_started)
 	{
-		/* Start thread */
-		state->write_started = (0 == pthread_create(&state->thread_write, NULL, &THREAD_WRITE_Entrypoint, &state->write_args));
-		if (!state->write_started)
+		state->write_args.start_time = UTILS_GetMonotonicMicros();
+		if (write(state->write_args.start_event_fd, &eventfd_val, sizeof(eventfd_val)) < 0)
 		{
 			perror("Failed to start write thread");
 			return false;
 		}
+		state->write_started = true;
 	}
 	else if (!tx && !state->read_started)
 	{
-		/* Start thread */
-		state->read_started = (0 == pthread_create(&state->thread_read, NULL, &THREAD_READ_Entrypoint, &state->read_args));
-		if (!state->read_started)
+		state->read_args.start_time = UTILS_GetMonotonicMicros();
+		if (write(state->read_args.start_event_fd, &eventfd_val, sizeof(eventfd_val)) < 0)
 		{
 			perror("Failed to start read thread");
 			return false;
 		}
-	}
-
-	/* Return signal mask to old value, such that all signals will be handled by main thread */
-	if (sigprocmask(SIG_SETMASK, &old_mask, NULL) < 0)
-	{
-		perror("Failed to unmask signals");
-		return false;
+		state->read_started = true;
 	}
 
 	return true;
@@ -514,8 +1250,12 @@ static bool stop_thread(state_t *state, bool tx)
 			return false;
 		}
 
-		/* Join with thread */
-		pthread_join(state->thread_write, NULL);
+		/* Wait for thread to end stream (it may already have, having failed) */
+		if (read(state->write_args.idle_event_fd, &eventfd_val, sizeof(eventfd_val)) < 0)
+		{
+			perror("Failed to read from write thread idle eventfd");
+			return false;
+		}
 
 		/* Read eventfd now thread has stopped to reset it */
 		if (read(state->write_thread_event_fd, &eventfd_val, sizeof(eventfd_val)) < 0)
@@ -524,6 +1264,13 @@ static bool stop_thread(state_t *state, bool tx)
 			return false;
 		}
 
+		/* Discard any reconfiguration the stream ended before handling, so as not to apply it to the next */
+		if ((read(state->write_args.reconfig_event_fd, &eventfd_val, sizeof(eventfd_val)) < 0) && (EAGAIN != errno))
+		{
+			perror("Failed to read from write thread reconfig eventfd");
+			return false;
+		}
+
 		/* Clear running flag */
 		state->write_started = false;
 	}
@@ -537,8 +1284,12 @@ static bool stop_thread(state_t *state, bool tx)
 			return false;
 		}
 
-		/* Join with thread */
-		pthread_join(state->thread_read, NULL);
+		/* Wait for thread to end stream (it may already have, having failed) */
+		if (read(state->read_args.idle_event_fd, &eventfd_val, sizeof(eventfd_val)) < 0)
+		{
+			perror("Failed to read from read thread idle eventfd");
+			return false;
+		}
 
 		/* Read eventfd now thread has stopped to reset it */
 		if (read(state->read_thread_event_fd, &eventfd_val, sizeof(eventfd_val)) < 0)
@@ -547,8 +1298,16 @@ static bool stop_thread(state_t *state, bool tx)
 			return false;
 		}
 
-		/* Clear running flag */
+		/* Discard any reconfiguration the stream ended before handling, so as not to apply it to the next */
+		if ((read(state->read_args.reconfig_event_fd, &eventfd_val, sizeof(eventfd_val)) < 0) && (EAGAIN != errno))
+		{
+			perror("Failed to read from read thread reconfig eventfd");
+			return false;
+		}
+
+		/* Clear running flag, hops no longer being tagged */
 		state->read_started = false;
+		RF_CONTROL_SetTagDestination(&state->rf, -1, NULL);
 	}
 
 	return true;
@@ -562,19 +1321,38 @@ static void signal_handler(int signum)
 	keep_running = 0;
 }
 
+static void dump_signal_handler(int signum)
+{
+	(void)signum;
+
+	/* Request trace dump, from main loop */
+	dump_requested = 1;
+}
+
 static void print_usage(const char *program_name, FILE *dest)
 {
 	fprintf(dest, "Usage: %s [OPTIONS]\n", program_name);
 	fprintf(dest, "OPTIONS:\n");
 	fprintf(dest, "  -h, --help\tDisplay this help message\n");
 	fprintf(dest, "  -d, --debug\tEnable debug output\n");
+	fprintf(dest, "  -g, --gro\tEnable UDP generic receive offload on the data socket\n");
+	fprintf(dest, "  -t, --trace\tRecord streaming threads' events, dumped by TRACE_DUMP or SIGUSR1\n");
+	fprintf(dest, "  -s, --rx-shards N\tSend RX data from N sockets / cores (1 to %u, default 1)\n", THREAD_READ_MAX_SHARDS);
+	fprintf(dest, "  -b, --busy-poll MODE\tSpin waiting for data rather than sleeping, MODE being spin (never sleeping) or a budget in uS\n");
+	fprintf(dest, "  -c, --config FILE\tLoad tuning options from FILE (one \"option [value]\" per line)\n");
+	fprintf(dest, "      --cpus ROLE=LIST\tRun ROLE's threads on CPUs of LIST (e.g. 0-1,3), shard N taking its Nth CPU\n");
+	fprintf(dest, "      --sched ROLE=POLICY\tSchedule ROLE's threads by fifo:PRIO, rr:PRIO, other or deadline:RUNTIME/DEADLINE/PERIOD (uS)\n");
+	fprintf(dest, "      --mlock\tLock memory, such that streaming never waits on a page fault\n");
+	fprintf(dest, "      --prefault-stack BYTES\tFault in BYTES of each thread's stack as it starts\n");
+	fprintf(dest, "      --irq-affinity NAME=LIST\tSteer IRQs whose /proc/interrupts entry contains NAME to CPUs of LIST\n");
+	fprintf(dest, "    Roles are read, write, push and shard, each defaulting to rr at maximum priority on CPU 1\n");
 	fprintf(dest, "  -v, --version\tDisplay the version of the program\n");
 }
 
 static const char* cmd_name(uint32_t cmd)
 {
 	const char* name = "UNKNOWN";
-	const char* cmd_names[] = {"START_TX", "START_RX", "STOP_TX", "STOP_RX"};
+	const char* cmd_names[] = {"START_TX", "START_RX", "STOP_TX", "STOP_RX", "START_TX_GEN", "RECONFIGURE", "RF_SET", "FASTLOCK_STORE", "HOP", "HOP_CANCEL", "LOOPBACK", "GET_STATS", "TRACE_DUMP"};
 
 	if (cmd < ARRAY_SIZE(cmd_names))
 	{
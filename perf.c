@@ -0,0 +1,210 @@
+/* Public header */
+#include "perf.h"
+
+/* Standard / system libraries */
+#include <errno.h>
+#include <inttypes.h>
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* Macros */
+#define DEBUG_PRINT(...) if (debug) printf("Perf: "__VA_ARGS__)
+
+/* Definitions - ratio summary size (bytes) */
+#define RATIO_SIZE (24)
+
+/* Global variables */
+extern bool debug;
+
+/* Private variables - counter events and names */
+static const struct
+{
+	uint32_t type;
+	uint64_t config;
+	const char *name;
+
+} counter_info[PERF_COUNTERS] =
+{
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles" },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions" },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "cache misses" },
+	{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "context switches" }
+};
+
+/* Private functions */
+static int open_counter(unsigned int counter, int group_fd);
+static bool read_counters(const PERF_t *perf, uint64_t *counters);
+static const char *format_ratio(bool available, uint64_t total, uint64_t per, char *buffer);
+
+/* Public functions */
+bool PERF_Open(PERF_t *perf)
+{
+	memset(perf, 0x00, sizeof(*perf));
+	perf->leader = -1;
+
+	/* Open each counter into group led by the first available */
+	int err = 0;
+	for (unsigned int i = 0; i < PERF_COUNTERS; i++)
+	{
+		perf->index[i] = -1;
+		perf->fd[i] = open_counter(i, perf->leader);
+		if (perf->fd[i] < 0)
+		{
+			err = errno;
+			DEBUG_PRINT("Counter %s unavailable: %s\n", counter_info[i].name, strerror(err));
+			continue;
+		}
+		if (perf->leader < 0)
+		{
+			perf->leader = perf->fd[i];
+		}
+		perf->index[i] = (int)perf->count++;
+	}
+
+	if (perf->leader < 0)
+	{
+		fprintf(stderr, "Perf counters unavailable (%s), stages not counted\n", strerror(err));
+		return false;
+	}
+
+	return true;
+}
+
+void PERF_Close(PERF_t *perf)
+{
+	for (unsigned int i = 0; i < PERF_COUNTERS; i++)
+	{
+		if (perf->fd[i] >= 0)
+		{
+			/* Counter opened */
+			close(perf->fd[i]);
+		}
+		perf->fd[i] = -1;
+	}
+	perf->leader = -1;
+}
+
+void PERF_Begin(PERF_t *perf)
+{
+	if ((perf->leader >= 0) && !read_counters(perf, perf->start))
+	{
+		/* Unreadable, stop counting */
+		PERF_Close(perf);
+	}
+}
+
+void PERF_End(PERF_t *perf, PERF_Stage_t *stage)
+{
+	uint64_t now[PERF_COUNTERS];
+	if (perf->leader < 0)
+	{
+		return;
+	}
+	if (!read_counters(perf, now))
+	{
+		PERF_Close(perf);
+		return;
+	}
+
+	/* Accumulate section, which the next follows */
+	for (unsigned int i = 0; i < PERF_COUNTERS; i++)
+	{
+		stage->total[i] += now[i] - perf->start[i];
+		perf->start[i] = now[i];
+	}
+	stage->sections++;
+}
+
+void PERF_ResetStage(PERF_Stage_t *stage)
+{
+	memset(stage, 0x00, sizeof(*stage));
+}
+
+void PERF_Report(const char *prefix, const PERF_t *perf, PERF_Stage_t *stage, uint64_t buffers, uint64_t bytes)
+{
+	if ((perf->leader >= 0) && (stage->sections > 0))
+	{
+		char per_byte[RATIO_SIZE];
+		char ipc[RATIO_SIZE];
+		char per_buffer[RATIO_SIZE];
+		char switches[RATIO_SIZE];
+		bool cycles = (perf->index[PERF_COUNTER_CYCLES] >= 0);
+		if (perf->index[PERF_COUNTER_CONTEXT_SWITCHES] >= 0)
+		{
+			snprintf(switches, sizeof(switches), "%"PRIu64, stage->total[PERF_COUNTER_CONTEXT_SWITCHES]);
+		}
+		else
+		{
+			snprintf(switches, sizeof(switches), "n/a");
+		}
+		printf("%s perf: cycles/byte: %s, IPC: %s, cache misses/buffer: %s, context switches: %s\n",
+			   prefix,
+			   format_ratio(cycles, stage->total[PERF_COUNTER_CYCLES], bytes, per_byte),
+			   format_ratio(cycles && (perf->index[PERF_COUNTER_INSTRUCTIONS] >= 0),
+							stage->total[PERF_COUNTER_INSTRUCTIONS],
+							stage->total[PERF_COUNTER_CYCLES],
+							ipc),
+			   format_ratio(perf->index[PERF_COUNTER_CACHE_MISSES] >= 0, stage->total[PERF_COUNTER_CACHE_MISSES], buffers, per_buffer),
+			   switches);
+	}
+
+	PERF_ResetStage(stage);
+}
+
+/* Private functions */
+static int open_counter(unsigned int counter, int group_fd)
+{
+	/* Count calling thread on any CPU, read as a group through its leader */
+	struct perf_event_attr attr;
+	memset(&attr, 0x00, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = counter_info[counter].type;
+	attr.config = counter_info[counter].config;
+	attr.read_format = PERF_FORMAT_GROUP;
+	attr.exclude_hv = 1;
+	int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+	if ((fd < 0) && ((EACCES == errno) || (EPERM == errno)))
+	{
+		/* Not permitted to count the kernel (perf_event_paranoid), count user space alone */
+		attr.exclude_kernel = 1;
+		fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+	}
+
+	return fd;
+}
+
+static bool read_counters(const PERF_t *perf, uint64_t *counters)
+{
+	/* Group read, number of counters followed by their values in the order they were opened */
+	uint64_t values[1 + PERF_COUNTERS];
+	size_t len = sizeof(uint64_t) * (1U + perf->count);
+	if ((read(perf->leader, values, len) != (ssize_t)len) || (values[0] != perf->count))
+	{
+		perror("Failed to read perf counters");
+		return false;
+	}
+
+	for (unsigned int i = 0; i < PERF_COUNTERS; i++)
+	{
+		counters[i] = (perf->index[i] >= 0) ? values[1 + perf->index[i]] : 0;
+	}
+
+	return true;
+}
+
+static const char *format_ratio(bool available, uint64_t total, uint64_t per, char *buffer)
+{
+	if (!available || (0 == per))
+	{
+		return "n/a";
+	}
+
+	/* Two decimal places, cycles per byte (for one) often being less than one */
+	uint64_t hundredths = (total * 100U) / per;
+	snprintf(buffer, RATIO_SIZE, "%"PRIu64".%02u", hundredths / 100U, (unsigned int)(hundredths % 100U));
+
+	return buffer;
+}
@@ -0,0 +1,64 @@
+#ifndef __PERF_H__
+#define __PERF_H__
+
+/* Standard libraries */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Definitions - counters, each counting the calling thread alone */
+#define PERF_COUNTER_CYCLES (0)
+#define PERF_COUNTER_INSTRUCTIONS (1)
+#define PERF_COUNTER_CACHE_MISSES (2)
+#define PERF_COUNTER_CONTEXT_SWITCHES (3)
+#define PERF_COUNTERS (4)
+
+/*
+** Type definitions - hardware performance counters of one thread
+** Opened as a group with perf_event_open(), such that one read retrieves them all. Counters the kernel or CPU don't
+** provide (or aren't permitted) are left out, none at all leaving sections uncounted.
+*/
+typedef struct
+{
+	/* Group leader (negative if no counters are available) and members */
+	int fd[PERF_COUNTERS];
+	int leader;
+
+	/* Position of each counter within group's read (negative if unavailable) and counters in group */
+	int index[PERF_COUNTERS];
+	unsigned int count;
+
+	/* Counters at start of section */
+	uint64_t start[PERF_COUNTERS];
+
+} PERF_t;
+
+/* Type definitions - counters accumulated over a stage's sections */
+typedef struct
+{
+	uint64_t total[PERF_COUNTERS];
+	uint64_t sections;
+
+} PERF_Stage_t;
+
+/* Open counters of calling thread, returning false should none be available (sections then being uncounted) */
+bool PERF_Open(PERF_t *perf);
+
+/* Close counters */
+void PERF_Close(PERF_t *perf);
+
+/* Start section */
+void PERF_Begin(PERF_t *perf);
+
+/* End section, adding its counts to stage, the next section starting from here (without PERF_Begin()) */
+void PERF_End(PERF_t *perf, PERF_Stage_t *stage);
+
+/* Reset stage */
+void PERF_ResetStage(PERF_Stage_t *stage);
+
+/*
+** Report stage's counters since last report (prefixed), per byte and buffer processed meanwhile, resetting it
+** Nothing is reported without counters, those unavailable being reported as such.
+*/
+void PERF_Report(const char *prefix, const PERF_t *perf, PERF_Stage_t *stage, uint64_t buffers, uint64_t bytes);
+
+#endif
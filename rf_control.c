@@ -0,0 +1,388 @@
+/* Public header */
+#include "rf_control.h"
+
+/* Standard / system libraries */
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+/* Local modules */
+#include "sdr_ip_gadget_types.h"
+#include "iio_backend.h"
+#include "utils.h"
+
+/* Macros */
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+#define DEBUG_PRINT(...) if (debug) printf("RF: "__VA_ARGS__)
+
+/* Definitions - maximum age of sample clock anchor to schedule against (uS) */
+#define CLOCK_MAX_AGE_US (1000000U)
+
+/* Global variables */
+extern bool debug;
+
+/* Private functions */
+static bool recall(RF_CONTROL_t *rf, const RF_CONTROL_Hop_t *hop);
+static bool arm_timer(RF_CONTROL_t *rf, uint64_t delay_us);
+static void drop_hops(RF_CONTROL_t *rf, const char *reason);
+static bool refresh_sample_rate(RF_CONTROL_t *rf);
+static int write_gain(const struct iio_channel *channel, int64_t gain_mdb);
+
+/* Public functions */
+bool RF_CONTROL_Init(RF_CONTROL_t *rf, struct iio_context *ctx, SAMPLE_CLOCK_t *clock)
+{
+	memset(rf, 0x00, sizeof(*rf));
+	rf->sample_clock = clock;
+	rf->tag_fd = -1;
+	rf->timerfd = -1;
+
+	/* Find transceiver channels */
+	struct iio_device *phy = iio_context_find_device(ctx, "ad9361-phy");
+	if (!phy)
+	{
+		fprintf(stderr, "Failed to open iio phy dev\n");
+		return false;
+	}
+	rf->phy = phy;
+	rf->rx_lo = iio_device_find_channel(phy, "altvoltage0", true);
+	rf->tx_lo = iio_device_find_channel(phy, "altvoltage1", true);
+	rf->rx = iio_device_find_channel(phy, "voltage0", false);
+	rf->tx = iio_device_find_channel(phy, "voltage0", true);
+	if (!rf->rx_lo || !rf->tx_lo || !rf->rx || !rf->tx)
+	{
+		fprintf(stderr, "Failed to find iio phy channels\n");
+		return false;
+	}
+	if (!refresh_sample_rate(rf))
+	{
+		return false;
+	}
+
+	/* Create hop timer */
+	rf->timerfd = timerfd_create(CLOCK_MONOTONIC, 0);
+	if (rf->timerfd < 0)
+	{
+		perror("Failed to open hop timerfd");
+		return false;
+	}
+
+	return true;
+}
+
+void RF_CONTROL_Destroy(RF_CONTROL_t *rf)
+{
+	if (rf->timerfd >= 0)
+	{
+		/* Timer opened */
+		close(rf->timerfd);
+	}
+	rf->timerfd = -1;
+	rf->hop_count = 0;
+}
+
+int RF_CONTROL_GetTimerFd(RF_CONTROL_t *rf)
+{
+	return rf->timerfd;
+}
+
+bool RF_CONTROL_Set(RF_CONTROL_t *rf, uint8_t param, int64_t value)
+{
+	int rc;
+	switch (param)
+	{
+		case SDR_IP_GADGET_RF_PARAM_RX_LO_HZ:
+		{
+			rc = IIO_BACKEND_WriteChannelAttr(rf->rx_lo, "frequency", value);
+			break;
+		}
+		case SDR_IP_GADGET_RF_PARAM_TX_LO_HZ:
+		{
+			rc = IIO_BACKEND_WriteChannelAttr(rf->tx_lo, "frequency", value);
+			break;
+		}
+		case SDR_IP_GADGET_RF_PARAM_RX_SAMPLE_RATE_HZ:
+		case SDR_IP_GADGET_RF_PARAM_TX_SAMPLE_RATE_HZ:
+		{
+			/* RX and TX rates are derived from the same clock, so both may change, refresh rate timestamps count at */
+			bool tx = (SDR_IP_GADGET_RF_PARAM_TX_SAMPLE_RATE_HZ == param);
+			rc = IIO_BACKEND_WriteChannelAttr(tx ? rf->tx : rf->rx, "sampling_frequency", value);
+			if ((rc >= 0) && !refresh_sample_rate(rf))
+			{
+				return false;
+			}
+			break;
+		}
+		case SDR_IP_GADGET_RF_PARAM_RX_GAIN_MDB:
+		{
+			/* Gain may only be set with automatic gain control disabled */
+			rc = IIO_BACKEND_WriteChannelAttrString(rf->rx, "gain_control_mode", "manual");
+			if (rc >= 0)
+			{
+				rc = write_gain(rf->rx, value);
+			}
+			break;
+		}
+		case SDR_IP_GADGET_RF_PARAM_TX_GAIN_MDB:
+		{
+			rc = write_gain(rf->tx, value);
+			break;
+		}
+		default:
+		{
+			fprintf(stderr, "Unknown RF parameter %u\n", param);
+			return false;
+		}
+	}
+	if (rc < 0)
+	{
+		fprintf(stderr, "Failed to set RF parameter %u to %"PRId64" (%d)\n", param, value, rc);
+		return false;
+	}
+	DEBUG_PRINT("Set parameter %u to %"PRId64"\n", param, value);
+
+	return true;
+}
+
+bool RF_CONTROL_FastlockStore(RF_CONTROL_t *rf, bool tx, uint8_t profile, uint64_t frequency)
+{
+	struct iio_channel *lo = tx ? rf->tx_lo : rf->rx_lo;
+	if (profile >= SDR_IP_GADGET_FASTLOCK_PROFILES)
+	{
+		fprintf(stderr, "Fast lock profile %u out of range\n", profile);
+		return false;
+	}
+
+	/* Tune (calibrating synthesizer) then capture its calibration as profile */
+	int rc = 0;
+	if (frequency)
+	{
+		rc = IIO_BACKEND_WriteChannelAttr(lo, "frequency", (long long)frequency);
+	}
+	if (rc >= 0)
+	{
+		rc = IIO_BACKEND_WriteChannelAttr(lo, "fastlock_store", profile);
+	}
+	if (rc < 0)
+	{
+		fprintf(stderr, "Failed to store %s fast lock profile %u (%d)\n", tx ? "TX" : "RX", profile, rc);
+		return false;
+	}
+	DEBUG_PRINT("Stored %s fast lock profile %u (%"PRIu64" Hz)\n", tx ? "TX" : "RX", profile, frequency);
+
+	return true;
+}
+
+bool RF_CONTROL_SetLoopback(RF_CONTROL_t *rf, bool enable)
+{
+	/* Loopback modes are zero for none, one for digital TX to RX (two being RF RX to TX) */
+	int rc = IIO_BACKEND_WriteDebugAttr(rf->phy, "loopback", enable ? 1 : 0);
+	if (rc < 0)
+	{
+		fprintf(stderr, "Failed to %s digital loopback (%d)\n", enable ? "enable" : "disable", rc);
+		return false;
+	}
+	DEBUG_PRINT("Digital loopback %s\n", enable ? "enabled" : "disabled");
+
+	return true;
+}
+
+bool RF_CONTROL_Hop(RF_CONTROL_t *rf, const RF_CONTROL_Hop_t *hop)
+{
+	if (hop->profile >= SDR_IP_GADGET_FASTLOCK_PROFILES)
+	{
+		fprintf(stderr, "Fast lock profile %u out of range\n", hop->profile);
+		return false;
+	}
+
+	if (0 == hop->timestamp)
+	{
+		return recall(rf, hop);
+	}
+
+	/* Schedule against RX stream's clock */
+	uint64_t now;
+	if ((rf->tag_fd < 0) || !SAMPLE_CLOCK_Now(rf->sample_clock, rf->sample_rate, UTILS_GetMonotonicMicros(), CLOCK_MAX_AGE_US, &now))
+	{
+		fprintf(stderr, "Can't schedule hop without timestamped RX stream\n");
+		return false;
+	}
+	if (rf->hop_count >= ARRAY_SIZE(rf->hops))
+	{
+		fprintf(stderr, "Can't schedule hop, %u already scheduled\n", rf->hop_count);
+		return false;
+	}
+
+	/* Insert in order, after any hops due at the same time */
+	unsigned int i = rf->hop_count;
+	while ((i > 0) && (rf->hops[i - 1].timestamp > hop->timestamp))
+	{
+		rf->hops[i] = rf->hops[i - 1];
+		i--;
+	}
+	rf->hops[i] = *hop;
+	rf->hop_count++;
+	DEBUG_PRINT("Scheduled %s hop to profile %u at %"PRIu64" (now %"PRIu64"), %u scheduled\n",
+				hop->tx ? "TX" : "RX",
+				hop->profile,
+				hop->timestamp,
+				now,
+				rf->hop_count);
+
+	/* Rearm timer should this now be the first hop due (making it immediately if it already is) */
+	if (0 == i)
+	{
+		return (RF_CONTROL_HandleTimer(rf) >= 0);
+	}
+
+	return true;
+}
+
+void RF_CONTROL_CancelHops(RF_CONTROL_t *rf)
+{
+	DEBUG_PRINT("Cancelled %u scheduled hops\n", rf->hop_count);
+	rf->hop_count = 0;
+	arm_timer(rf, 0);
+}
+
+int RF_CONTROL_HandleTimer(RF_CONTROL_t *rf)
+{
+	/* Make each hop due, the clock being consulted again for each as it's refined by the RX stream */
+	while (rf->hop_count > 0)
+	{
+		uint64_t micros = UTILS_GetMonotonicMicros();
+		uint64_t now;
+		if (!SAMPLE_CLOCK_Now(rf->sample_clock, rf->sample_rate, micros, CLOCK_MAX_AGE_US, &now))
+		{
+			drop_hops(rf, "sample clock lost");
+			break;
+		}
+
+		RF_CONTROL_Hop_t *hop = &rf->hops[0];
+		if (hop->timestamp > now)
+		{
+			/* Not yet due, wait until it is (rounding up, such that we're never early) */
+			uint64_t samples = hop->timestamp - now;
+			uint64_t delay_us = ((samples / (uint64_t)rf->sample_rate) * 1000000U)
+								+ ((((samples % (uint64_t)rf->sample_rate) * 1000000U) + (uint64_t)rf->sample_rate - 1U) / (uint64_t)rf->sample_rate);
+			return arm_timer(rf, delay_us) ? 0 : -1;
+		}
+
+		/* Due, hop and remove from schedule */
+		RF_CONTROL_Hop_t due = *hop;
+		rf->hop_count--;
+		memmove(&rf->hops[0], &rf->hops[1], rf->hop_count * sizeof(rf->hops[0]));
+		recall(rf, &due);
+	}
+
+	/* Nothing scheduled */
+	return arm_timer(rf, 0) ? 0 : -1;
+}
+
+void RF_CONTROL_SetTagDestination(RF_CONTROL_t *rf, int fd, const struct sockaddr_in *addr)
+{
+	rf->tag_fd = fd;
+	if (addr)
+	{
+		rf->tag_addr = *addr;
+	}
+
+	/* Scheduled hops are meaningless without the stream they were timed against */
+	if ((fd < 0) && (rf->hop_count > 0))
+	{
+		drop_hops(rf, "RX stopped");
+	}
+}
+
+/* Private functions */
+static bool recall(RF_CONTROL_t *rf, const RF_CONTROL_Hop_t *hop)
+{
+	/* Recall profile, the synthesizer retuning without calibration */
+	int rc = IIO_BACKEND_WriteChannelAttr(hop->tx ? rf->tx_lo : rf->rx_lo, "fastlock_recall", hop->profile);
+	uint64_t micros = UTILS_GetMonotonicMicros();
+	if (rc < 0)
+	{
+		fprintf(stderr, "Failed to recall %s fast lock profile %u (%d)\n", hop->tx ? "TX" : "RX", hop->profile, rc);
+		return false;
+	}
+
+	/* Tag hop in RX stream, with the time it completed (zero if unknown) */
+	if (rf->tag_fd >= 0)
+	{
+		data_ip_hop_t tag;
+		memset(&tag, 0x00, sizeof(tag));
+		tag.magic = SDR_IP_GADGET_MAGIC;
+		tag.tx = hop->tx ? 1 : 0;
+		tag.profile = hop->profile;
+		tag.flags = SDR_IP_GADGET_DATA_FLAG_HOP;
+		if (!SAMPLE_CLOCK_Now(rf->sample_clock, rf->sample_rate, micros, CLOCK_MAX_AGE_US, &tag.seqno))
+		{
+			tag.seqno = 0;
+		}
+		tag.requested = hop->timestamp;
+		tag.tag = hop->tag;
+		if (sendto(rf->tag_fd, &tag, sizeof(tag), 0, (struct sockaddr*)&rf->tag_addr, sizeof(rf->tag_addr)) < 0)
+		{
+			perror("Failed to send hop tag");
+		}
+		DEBUG_PRINT("%s hop to profile %u at %"PRIu64" (requested %"PRIu64")\n",
+					hop->tx ? "TX" : "RX",
+					hop->profile,
+					tag.seqno,
+					hop->timestamp);
+	}
+
+	return true;
+}
+
+static bool arm_timer(RF_CONTROL_t *rf, uint64_t delay_us)
+{
+	struct itimerspec timer_period;
+	memset(&timer_period, 0x00, sizeof(timer_period));
+	if (rf->hop_count > 0)
+	{
+		if (0 == delay_us)
+		{
+			/* Zero delay disarms timer, so wait at least a microsecond */
+			delay_us = 1;
+		}
+		timer_period.it_value.tv_sec = delay_us / 1000000U;
+		timer_period.it_value.tv_nsec = (delay_us % 1000000U) * 1000U;
+	}
+	if (timerfd_settime(rf->timerfd, 0, &timer_period, NULL) < 0)
+	{
+		perror("Failed to set hop timerfd");
+		return false;
+	}
+
+	return true;
+}
+
+static void drop_hops(RF_CONTROL_t *rf, const char *reason)
+{
+	fprintf(stderr, "Dropping %u scheduled hops, %s\n", rf->hop_count, reason);
+	rf->hop_count = 0;
+	arm_timer(rf, 0);
+}
+
+static bool refresh_sample_rate(RF_CONTROL_t *rf)
+{
+	if (IIO_BACKEND_ReadChannelAttr(rf->rx, "sampling_frequency", &rf->sample_rate) < 0)
+	{
+		fprintf(stderr, "Failed to read RX sample rate\n");
+		return false;
+	}
+
+	return true;
+}
+
+static int write_gain(const struct iio_channel *channel, int64_t gain_mdb)
+{
+	/* Gains are in dB, TX attenuation having a resolution of 0.25 dB */
+	char str[32];
+	snprintf(str, sizeof(str), "%.3f", (double)gain_mdb / 1000.0);
+
+	return IIO_BACKEND_WriteChannelAttrString(channel, "hardwaregain", str);
+}
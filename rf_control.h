@@ -0,0 +1,101 @@
+#ifndef __RF_CONTROL_H__
+#define __RF_CONTROL_H__
+
+/* Standard libraries */
+#include <stdint.h>
+#include <stdbool.h>
+#include <netinet/in.h>
+
+/* libIIO */
+#include <iio.h>
+
+/* Local headers */
+#include "sample_clock.h"
+
+/* Definitions - maximum hops scheduled at once */
+#define RF_CONTROL_MAX_HOPS (64)
+
+/* Type definitions - scheduled hop */
+typedef struct
+{
+	/* RX timestamp (samples) to hop at, zero for immediately */
+	uint64_t timestamp;
+
+	/* Tag returned with hop */
+	uint32_t tag;
+
+	/* Fast lock profile to recall */
+	uint8_t profile;
+
+	/* LO to hop (TX rather than RX) */
+	bool tx;
+
+} RF_CONTROL_Hop_t;
+
+/*
+** Type definitions - RF control
+** Tunes the transceiver through the daemon's own IIO context, avoiding a round trip through iiod.
+** Hops recall AD9361 fast lock profiles, the synthesizer skipping its VCO calibration, and may be scheduled against
+** the RX stream's sample clock, a tag being sent alongside the RX stream's data as each is made.
+*/
+typedef struct
+{
+	/* Transceiver */
+	struct iio_device *phy;
+
+	/* Transceiver channels (LOs, and RX / TX of the first path) */
+	struct iio_channel *rx_lo;
+	struct iio_channel *tx_lo;
+	struct iio_channel *rx;
+	struct iio_channel *tx;
+
+	/* Sample clock, anchored by RX stream */
+	SAMPLE_CLOCK_t *sample_clock;
+
+	/* RX sample rate (Hz) */
+	long long sample_rate;
+
+	/* Scheduled hops, in order of timestamp */
+	RF_CONTROL_Hop_t hops[RF_CONTROL_MAX_HOPS];
+	unsigned int hop_count;
+
+	/* Timer expiring as next hop is due */
+	int timerfd;
+
+	/* Socket and address to send hop tags to (negative socket while RX isn't running) */
+	int tag_fd;
+	struct sockaddr_in tag_addr;
+
+} RF_CONTROL_t;
+
+/* Prepare RF control for transceiver of context, hops being scheduled against clock */
+bool RF_CONTROL_Init(RF_CONTROL_t *rf, struct iio_context *ctx, SAMPLE_CLOCK_t *clock);
+
+/* Release RF control */
+void RF_CONTROL_Destroy(RF_CONTROL_t *rf);
+
+/* Retrieve file descriptor readable as a scheduled hop is due, to be serviced by RF_CONTROL_HandleTimer() */
+int RF_CONTROL_GetTimerFd(RF_CONTROL_t *rf);
+
+/* Set parameter (SDR_IP_GADGET_RF_PARAM_*) */
+bool RF_CONTROL_Set(RF_CONTROL_t *rf, uint8_t param, int64_t value);
+
+/* Tune LO to frequency (Hz, zero for the current frequency) and store it as fast lock profile */
+bool RF_CONTROL_FastlockStore(RF_CONTROL_t *rf, bool tx, uint8_t profile, uint64_t frequency);
+
+/* Enable or disable the transceiver's digital loopback, its TX data port being returned to RX */
+bool RF_CONTROL_SetLoopback(RF_CONTROL_t *rf, bool enable);
+
+/* Hop immediately, or schedule hop should it carry a timestamp */
+bool RF_CONTROL_Hop(RF_CONTROL_t *rf, const RF_CONTROL_Hop_t *hop);
+
+/* Cancel scheduled hops */
+void RF_CONTROL_CancelHops(RF_CONTROL_t *rf);
+
+/* Make hops now due, returning negative on failure */
+int RF_CONTROL_HandleTimer(RF_CONTROL_t *rf);
+
+/* Set socket and address to send hop tags to, a negative socket disabling tags (and dropping scheduled hops) */
+void RF_CONTROL_SetTagDestination(RF_CONTROL_t *rf, int fd, const struct sockaddr_in *addr);
+
+#endif
@@ -0,0 +1,546 @@
+/* Use non portable functions */
+#define _GNU_SOURCE
+
+/* Public header */
+#include "rt_tune.h"
+
+/* Standard / system libraries */
+#include <errno.h>
+#include <inttypes.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/sysinfo.h>
+#include <unistd.h>
+
+/* Macros */
+#define DEBUG_PRINT(...) if (debug) printf("Tune: "__VA_ARGS__)
+
+/* Definitions - maximum IRQ steering rules */
+#define MAX_IRQ_RULES (8)
+
+/* Definitions - deadline policy (should libc headers predate it) */
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE (6)
+#endif
+
+/* Type definitions - sched_setattr() argument, which libc may not declare */
+typedef struct
+{
+	uint32_t size;
+	uint32_t sched_policy;
+	uint64_t sched_flags;
+	int32_t sched_nice;
+	uint32_t sched_priority;
+	uint64_t sched_runtime;
+	uint64_t sched_deadline;
+	uint64_t sched_period;
+
+} sched_attr_t;
+
+/* Type definitions - tuning of a role's threads */
+typedef struct
+{
+	/* CPUs to run on (default if none set) */
+	cpu_set_t cpus;
+	bool cpus_set;
+
+	/* Scheduling policy and priority (negative for the policy's maximum) */
+	int policy;
+	int priority;
+
+	/* Deadline parameters (uS) */
+	uint64_t runtime_us;
+	uint64_t deadline_us;
+	uint64_t period_us;
+
+} role_t;
+
+/* Type definitions - IRQ steering rule */
+typedef struct
+{
+	/* Text to find in /proc/interrupts entry */
+	char name[32];
+
+	/* CPU list to steer to */
+	char cpus[32];
+
+} irq_rule_t;
+
+/* Global variables */
+extern bool debug;
+
+/* Private functions */
+static bool parse_role(const char *value, RT_TUNE_Role_t *role, const char **rest);
+static bool parse_cpus(const char *list, cpu_set_t *cpus);
+static bool parse_sched(const char *value, role_t *role);
+static bool steer_irqs(const irq_rule_t *rule);
+static void prefault_stack(size_t bytes);
+
+/* Private variables */
+static const char *role_names[RT_TUNE_ROLE_COUNT] = {"read", "write", "push", "shard"};
+static role_t roles[RT_TUNE_ROLE_COUNT];
+static bool lock_memory;
+static size_t prefault_stack_bytes;
+static irq_rule_t irq_rules[MAX_IRQ_RULES];
+static unsigned int irq_rule_count;
+
+/* Public functions */
+void RT_TUNE_Reset(void)
+{
+	memset(roles, 0x00, sizeof(roles));
+	for (unsigned int i = 0; i < RT_TUNE_ROLE_COUNT; i++)
+	{
+		roles[i].policy = SCHED_RR;
+		roles[i].priority = -1;
+	}
+	lock_memory = false;
+	prefault_stack_bytes = 0;
+	irq_rule_count = 0;
+}
+
+bool RT_TUNE_SetOption(const char *name, const char *value)
+{
+	RT_TUNE_Role_t role;
+	const char *rest;
+
+	if (0 == strcmp(name, "cpus"))
+	{
+		if (!value || !parse_role(value, &role, &rest) || !parse_cpus(rest, &roles[role].cpus))
+		{
+			fprintf(stderr, "Error: cpus expects ROLE=LIST\n");
+			return false;
+		}
+		roles[role].cpus_set = true;
+		if (SCHED_DEADLINE == roles[role].policy)
+		{
+			fprintf(stderr, "Error: %s can't have cpus with deadline scheduling\n", role_names[role]);
+			return false;
+		}
+	}
+	else if (0 == strcmp(name, "sched"))
+	{
+		if (!value || !parse_role(value, &role, &rest) || !parse_sched(rest, &roles[role]))
+		{
+			fprintf(stderr, "Error: sched expects ROLE=fifo:PRIO, rr:PRIO, other or deadline:RUNTIME/DEADLINE/PERIOD\n");
+			return false;
+		}
+		if ((SCHED_DEADLINE == roles[role].policy) && roles[role].cpus_set)
+		{
+			fprintf(stderr, "Error: %s can't have cpus with deadline scheduling\n", role_names[role]);
+			return false;
+		}
+	}
+	else if (0 == strcmp(name, "mlock"))
+	{
+		lock_memory = true;
+	}
+	else if (0 == strcmp(name, "prefault-stack"))
+	{
+		char *end;
+		prefault_stack_bytes = value ? strtoul(value, &end, 0) : 0;
+		if (!value || ('\0' != *end) || (prefault_stack_bytes > (1U << 20)))
+		{
+			fprintf(stderr, "Error: prefault-stack expects up to 1 MiB\n");
+			return false;
+		}
+	}
+	else if (0 == strcmp(name, "irq-affinity"))
+	{
+		const char *sep = value ? strchr(value, '=') : NULL;
+		cpu_set_t cpus;
+		if (	!sep
+			 || (sep == value)
+			 || ((size_t)(sep - value) >= sizeof(irq_rules[0].name))
+			 || (strlen(sep + 1) >= sizeof(irq_rules[0].cpus))
+			 || !parse_cpus(sep + 1, &cpus))
+		{
+			fprintf(stderr, "Error: irq-affinity expects NAME=LIST\n");
+			return false;
+		}
+		if (irq_rule_count >= MAX_IRQ_RULES)
+		{
+			fprintf(stderr, "Error: irq-affinity limited to %u rules\n", MAX_IRQ_RULES);
+			return false;
+		}
+		irq_rule_t *rule = &irq_rules[irq_rule_count++];
+		memcpy(rule->name, value, sep - value);
+		rule->name[sep - value] = '\0';
+		strcpy(rule->cpus, sep + 1);
+	}
+	else
+	{
+		fprintf(stderr, "Error: Unknown tuning option %s\n", name);
+		return false;
+	}
+
+	return true;
+}
+
+bool RT_TUNE_LoadConfig(const char *path)
+{
+	FILE *file = fopen(path, "r");
+	if (!file)
+	{
+		fprintf(stderr, "Failed to open config %s: %s\n", path, strerror(errno));
+		return false;
+	}
+
+	bool result = true;
+	char line[128];
+	unsigned int line_no = 0;
+	while (fgets(line, sizeof(line), file))
+	{
+		line_no++;
+
+		/* Split into option and value, ignoring surrounding whitespace */
+		char *save;
+		char *name = strtok_r(line, " \t\r\n", &save);
+		char *value = strtok_r(NULL, " \t\r\n", &save);
+		if (!name || ('#' == name[0]))
+		{
+			continue;
+		}
+		if (!RT_TUNE_SetOption(name, value))
+		{
+			fprintf(stderr, "Error: %s line %u\n", path, line_no);
+			result = false;
+			break;
+		}
+	}
+	fclose(file);
+
+	return result;
+}
+
+bool RT_TUNE_ApplyProcess(void)
+{
+	if (lock_memory)
+	{
+		/* Keep freed memory and avoid mmap() for large allocations, such that buffers stay locked and faulted in */
+		mallopt(M_TRIM_THRESHOLD, -1);
+		mallopt(M_MMAP_MAX, 0);
+
+		/* Lock memory, future mappings (including DMA buffers) being faulted in as they're made */
+		if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0)
+		{
+			perror("Failed to lock memory");
+			return false;
+		}
+		DEBUG_PRINT("Locked memory :-)\n");
+	}
+
+	for (unsigned int i = 0; i < irq_rule_count; i++)
+	{
+		if (!steer_irqs(&irq_rules[i]))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void RT_TUNE_ApplyThread(RT_TUNE_Role_t role, unsigned int index)
+{
+	role_t *tune = &roles[role];
+
+	/* Select CPUs, shard N (from 1, the read thread sending the first share) taking the Nth CPU of its set */
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	if (tune->cpus_set)
+	{
+		if (0 == index)
+		{
+			cpus = tune->cpus;
+		}
+		else
+		{
+			int count = CPU_COUNT(&tune->cpus);
+			int n = (int)(index % (unsigned int)count);
+			for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+			{
+				if (CPU_ISSET(cpu, &tune->cpus) && (0 == n--))
+				{
+					CPU_SET(cpu, &cpus);
+					break;
+				}
+			}
+		}
+	}
+	else
+	{
+		/* Default to CPU 1 (leaving CPU 0 to interrupts), shards spreading over the CPUs from there */
+		CPU_SET((int)((1U + index) % (unsigned int)get_nprocs()), &cpus);
+	}
+
+	/*
+	** Set affinity, unless scheduling by deadline, the kernel refusing (EPERM) a deadline thread whose affinity is
+	** narrower than its root domain (for which an exclusive cpuset partition is required instead)
+	*/
+	int rc = 0;
+	if (SCHED_DEADLINE != tune->policy)
+	{
+		rc = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+		if (rc)
+		{
+			errno = rc;
+			perror("Failed to set affinity");
+		}
+	}
+
+	/* Set scheduling policy */
+	if (SCHED_DEADLINE == tune->policy)
+	{
+		sched_attr_t attr;
+		memset(&attr, 0x00, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.sched_policy = SCHED_DEADLINE;
+		attr.sched_runtime = tune->runtime_us * 1000U;
+		attr.sched_deadline = tune->deadline_us * 1000U;
+		attr.sched_period = tune->period_us * 1000U;
+		if (syscall(SYS_sched_setattr, 0, &attr, 0) < 0)
+		{
+			perror("Failed to set deadline scheduling");
+		}
+	}
+	else
+	{
+		struct sched_param sch;
+		sch.sched_priority = tune->priority;
+		if (sch.sched_priority < 0)
+		{
+			sch.sched_priority = sched_get_priority_max(tune->policy);
+		}
+		rc = pthread_setschedparam(pthread_self(), tune->policy, &sch);
+		if (rc)
+		{
+			errno = rc;
+			perror("Failed to set priority");
+		}
+	}
+
+	/* Fault in stack, which mlockall() then keeps */
+	if (prefault_stack_bytes > 0)
+	{
+		prefault_stack(prefault_stack_bytes);
+	}
+	DEBUG_PRINT("Tuned %s thread %u, policy: %d, priority: %d, CPUs: %d\n",
+				role_names[role], index, tune->policy, tune->priority, CPU_COUNT(&cpus));
+}
+
+void RT_TUNE_GetThreadStats(RT_TUNE_ThreadStats_t *stats)
+{
+	memset(stats, 0x00, sizeof(*stats));
+
+	/* Run queue delay, as accounted by the scheduler (zero should the kernel not offer it) */
+	FILE *file = fopen("/proc/thread-self/schedstat", "r");
+	if (file)
+	{
+		uint64_t run_ns;
+		if (3 != fscanf(file, "%"SCNu64" %"SCNu64" %"SCNu64, &run_ns, &stats->run_delay_ns, &stats->timeslices))
+		{
+			stats->run_delay_ns = 0;
+			stats->timeslices = 0;
+		}
+		fclose(file);
+	}
+
+	/* Context switches and page faults */
+	struct rusage usage;
+	if (0 == getrusage(RUSAGE_THREAD, &usage))
+	{
+		stats->preempted = (uint64_t)usage.ru_nivcsw;
+		stats->minor_faults = (uint64_t)usage.ru_minflt;
+		stats->major_faults = (uint64_t)usage.ru_majflt;
+	}
+}
+
+void RT_TUNE_ReportThreadStats(const char *prefix, RT_TUNE_ThreadStats_t *last)
+{
+	RT_TUNE_ThreadStats_t now;
+	RT_TUNE_GetThreadStats(&now);
+
+	uint64_t timeslices = now.timeslices - last->timeslices;
+	uint64_t run_delay_us = (now.run_delay_ns - last->run_delay_ns) / 1000U;
+	printf("%s sched: run delay: %"PRIu64", avg: %"PRIu64" (uS), preempted: %"PRIu64", faults: %"PRIu64" minor, %"PRIu64" major\n",
+		   prefix,
+		   run_delay_us,
+		   (timeslices > 0) ? (run_delay_us / timeslices) : 0,
+		   now.preempted - last->preempted,
+		   now.minor_faults - last->minor_faults,
+		   now.major_faults - last->major_faults);
+	*last = now;
+}
+
+/* Private functions */
+static bool parse_role(const char *value, RT_TUNE_Role_t *role, const char **rest)
+{
+	const char *sep = strchr(value, '=');
+	if (!sep)
+	{
+		return false;
+	}
+	for (unsigned int i = 0; i < RT_TUNE_ROLE_COUNT; i++)
+	{
+		if ((strlen(role_names[i]) == (size_t)(sep - value)) && (0 == strncmp(role_names[i], value, sep - value)))
+		{
+			*role = (RT_TUNE_Role_t)i;
+			*rest = sep + 1;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool parse_cpus(const char *list, cpu_set_t *cpus)
+{
+	/* Comma separated CPUs and ranges, as used by the kernel */
+	CPU_ZERO(cpus);
+	const char *p = list;
+	while ('\0' != *p)
+	{
+		char *end;
+		unsigned long first = strtoul(p, &end, 10);
+		unsigned long last = first;
+		if (end == p)
+		{
+			return false;
+		}
+		if ('-' == *end)
+		{
+			p = end + 1;
+			last = strtoul(p, &end, 10);
+			if ((end == p) || (last < first))
+			{
+				return false;
+			}
+		}
+		if (last >= CPU_SETSIZE)
+		{
+			return false;
+		}
+		for (unsigned long cpu = first; cpu <= last; cpu++)
+		{
+			CPU_SET(cpu, cpus);
+		}
+		p = end;
+		if (',' == *p)
+		{
+			p++;
+		}
+		else if ('\0' != *p)
+		{
+			return false;
+		}
+	}
+
+	return (CPU_COUNT(cpus) > 0);
+}
+
+static bool parse_sched(const char *value, role_t *role)
+{
+	const char *arg = strchr(value, ':');
+	size_t len = arg ? (size_t)(arg - value) : strlen(value);
+	char *end;
+
+	if (((2 == len) && (0 == strncmp(value, "rr", len))) || ((4 == len) && (0 == strncmp(value, "fifo", len))))
+	{
+		role->policy = (4 == len) ? SCHED_FIFO : SCHED_RR;
+		role->priority = -1;
+		if (arg)
+		{
+			long prio = strtol(arg + 1, &end, 10);
+			if (('\0' != *end) || (prio < sched_get_priority_min(role->policy)) || (prio > sched_get_priority_max(role->policy)))
+			{
+				return false;
+			}
+			role->priority = (int)prio;
+		}
+	}
+	else if ((5 == len) && (0 == strncmp(value, "other", len)) && !arg)
+	{
+		role->policy = SCHED_OTHER;
+		role->priority = 0;
+	}
+	else if ((8 == len) && (0 == strncmp(value, "deadline", len)) && arg)
+	{
+		role->policy = SCHED_DEADLINE;
+		role->priority = 0;
+		if (	(3 != sscanf(arg + 1, "%"SCNu64"/%"SCNu64"/%"SCNu64, &role->runtime_us, &role->deadline_us, &role->period_us))
+			 || (0 == role->runtime_us)
+			 || (role->runtime_us > role->deadline_us)
+			 || (role->deadline_us > role->period_us))
+		{
+			return false;
+		}
+	}
+	else
+	{
+		return false;
+	}
+
+	return true;
+}
+
+static bool steer_irqs(const irq_rule_t *rule)
+{
+	FILE *interrupts = fopen("/proc/interrupts", "r");
+	if (!interrupts)
+	{
+		perror("Failed to open /proc/interrupts");
+		return false;
+	}
+
+	/* Steer each numbered IRQ whose entry mentions the name */
+	unsigned int steered = 0;
+	char line[512];
+	while (fgets(line, sizeof(line), interrupts))
+	{
+		unsigned int irq;
+		if ((1 != sscanf(line, " %u:", &irq)) || !strstr(line, rule->name))
+		{
+			continue;
+		}
+
+		char path[64];
+		snprintf(path, sizeof(path), "/proc/irq/%u/smp_affinity_list", irq);
+		FILE *affinity = fopen(path, "w");
+		bool ok = (NULL != affinity);
+		if (affinity)
+		{
+			ok = (fprintf(affinity, "%s\n", rule->cpus) >= 0);
+			ok = (0 == fclose(affinity)) && ok;
+		}
+		if (!ok)
+		{
+			fprintf(stderr, "Failed to steer IRQ %u (%s) to CPUs %s: %s\n", irq, rule->name, rule->cpus, strerror(errno));
+			continue;
+		}
+		DEBUG_PRINT("Steered IRQ %u (%s) to CPUs %s\n", irq, rule->name, rule->cpus);
+		steered++;
+	}
+	fclose(interrupts);
+
+	if (0 == steered)
+	{
+		fprintf(stderr, "No IRQs matching %s steered\n", rule->name);
+	}
+
+	return true;
+}
+
+static void __attribute__((noinline)) prefault_stack(size_t bytes)
+{
+	/* Touch stack below us, preventing the compiler from eliding the writes */
+	uint8_t stack[bytes];
+	memset(stack, 0x00, bytes);
+	__asm__ __volatile__("" : : "r"(stack) : "memory");
+}
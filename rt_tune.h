@@ -0,0 +1,68 @@
+#ifndef __RT_TUNE_H__
+#define __RT_TUNE_H__
+
+/* Standard libraries */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Type definitions - thread roles, each tuned separately */
+typedef enum
+{
+	RT_TUNE_ROLE_READ,
+	RT_TUNE_ROLE_WRITE,
+	RT_TUNE_ROLE_PUSH,
+	RT_TUNE_ROLE_SHARD,
+	RT_TUNE_ROLE_COUNT
+
+} RT_TUNE_Role_t;
+
+/* Type definitions - thread scheduling counters (cumulative) */
+typedef struct
+{
+	/* Time spent runnable waiting for a CPU (nS) and times scheduled in */
+	uint64_t run_delay_ns;
+	uint64_t timeslices;
+
+	/* Involuntary context switches */
+	uint64_t preempted;
+
+	/* Page faults, minor (no I/O) and major */
+	uint64_t minor_faults;
+	uint64_t major_faults;
+
+} RT_TUNE_ThreadStats_t;
+
+/*
+** Reset tuning to the defaults, each thread running SCHED_RR at maximum priority on CPU 1 (shards spreading over the
+** CPUs from there), without memory locking
+*/
+void RT_TUNE_Reset(void);
+
+/*
+** Apply option given on the command line (long option name) or in a configuration file, returning false if invalid
+**   cpus ROLE=LIST          CPUs a role's threads may run on (e.g. read=1, shard=0-1), shards taking one each in turn
+**   sched ROLE=POLICY       fifo:PRIO, rr:PRIO, other or deadline:RUNTIME/DEADLINE/PERIOD (uS)
+**   mlock                   Lock all current and future memory, preventing page faults once allocated
+**   prefault-stack BYTES    Touch stack of each thread as it starts
+**   irq-affinity NAME=LIST  Steer IRQs whose /proc/interrupts entry contains NAME to CPUs
+** Roles are read, write, push and shard. A deadline role runs on any CPU of its root domain, so can't be given cpus
+** (confining it requires an exclusive cpuset partition).
+*/
+bool RT_TUNE_SetOption(const char *name, const char *value);
+
+/* Load configuration file of "option [value]" lines, blank lines and those starting with # being ignored */
+bool RT_TUNE_LoadConfig(const char *path);
+
+/* Apply process wide tuning (memory locking and IRQ steering), before threads are created */
+bool RT_TUNE_ApplyProcess(void);
+
+/* Apply tuning of role to calling thread, index selecting a CPU of its set in turn */
+void RT_TUNE_ApplyThread(RT_TUNE_Role_t role, unsigned int index);
+
+/* Retrieve calling thread's scheduling counters */
+void RT_TUNE_GetThreadStats(RT_TUNE_ThreadStats_t *stats);
+
+/* Report calling thread's scheduling latency and page faults since last report (prefixed), updating last */
+void RT_TUNE_ReportThreadStats(const char *prefix, RT_TUNE_ThreadStats_t *last);
+
+#endif
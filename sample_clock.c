@@ -0,0 +1,64 @@
+/* Public header */
+#include "sample_clock.h"
+
+/* Public functions */
+void SAMPLE_CLOCK_Reset(SAMPLE_CLOCK_t *clock)
+{
+	atomic_init(&clock->sequence, 0);
+	atomic_init(&clock->samples, 0);
+	atomic_init(&clock->micros, 0);
+}
+
+void SAMPLE_CLOCK_Anchor(SAMPLE_CLOCK_t *clock, uint64_t samples, uint64_t micros)
+{
+	/* Mark update in progress, ordering it before the stores that follow */
+	uint32_t sequence = atomic_load_explicit(&clock->sequence, memory_order_relaxed);
+	atomic_store_explicit(&clock->sequence, sequence + 1U, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	atomic_store_explicit(&clock->samples, samples, memory_order_relaxed);
+	atomic_store_explicit(&clock->micros, micros, memory_order_relaxed);
+
+	/* Mark update complete */
+	atomic_store_explicit(&clock->sequence, sequence + 2U, memory_order_release);
+}
+
+bool SAMPLE_CLOCK_Now(SAMPLE_CLOCK_t *clock, long long sample_rate, uint64_t micros, uint64_t max_age, uint64_t *samples)
+{
+	/* Take consistent copy of anchor, retrying should it be updated meanwhile */
+	uint32_t sequence;
+	uint64_t anchor_samples;
+	uint64_t anchor_micros;
+	do
+	{
+		sequence = atomic_load_explicit(&clock->sequence, memory_order_acquire);
+		anchor_samples = atomic_load_explicit(&clock->samples, memory_order_relaxed);
+		anchor_micros = atomic_load_explicit(&clock->micros, memory_order_relaxed);
+		atomic_thread_fence(memory_order_acquire);
+	} while ((sequence & 1U) || (sequence != atomic_load_explicit(&clock->sequence, memory_order_relaxed)));
+
+	if ((0 == anchor_micros) || (sample_rate <= 0))
+	{
+		return false;
+	}
+
+	/* Extrapolate (anchor may be marginally ahead of caller's time, having been taken after it) */
+	if (micros >= anchor_micros)
+	{
+		uint64_t elapsed = micros - anchor_micros;
+		if (elapsed > max_age)
+		{
+			return false;
+		}
+		*samples = anchor_samples
+				   + ((elapsed / 1000000U) * (uint64_t)sample_rate)
+				   + (((elapsed % 1000000U) * (uint64_t)sample_rate) / 1000000U);
+	}
+	else
+	{
+		uint64_t ahead = ((anchor_micros - micros) * (uint64_t)sample_rate) / 1000000U;
+		*samples = (anchor_samples > ahead) ? (anchor_samples - ahead) : 0;
+	}
+
+	return true;
+}
@@ -0,0 +1,39 @@
+#ifndef __SAMPLE_CLOCK_H__
+#define __SAMPLE_CLOCK_H__
+
+/* Standard libraries */
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+** Type definitions - sample clock estimate
+** Relates a sample count (timestamp) to monotonic time, the clock being extrapolated from its most recent anchor.
+** One thread may anchor the clock while others read it, readers retrying should they observe an update in progress.
+*/
+typedef struct
+{
+	/* Update sequence (odd while an update is in progress) */
+	_Atomic uint32_t sequence;
+
+	/* Sample count at anchor */
+	_Atomic uint64_t samples;
+
+	/* Monotonic time at anchor (uS, zero if never anchored) */
+	_Atomic uint64_t micros;
+
+} SAMPLE_CLOCK_t;
+
+/* Reset clock, such that it has no anchor */
+void SAMPLE_CLOCK_Reset(SAMPLE_CLOCK_t *clock);
+
+/* Anchor clock, samples having been reached at monotonic time micros */
+void SAMPLE_CLOCK_Anchor(SAMPLE_CLOCK_t *clock, uint64_t samples, uint64_t micros);
+
+/*
+** Estimate sample count at monotonic time micros, given sample rate (Hz)
+** Returns false if the clock has no anchor or its anchor is older than max_age (uS)
+*/
+bool SAMPLE_CLOCK_Now(SAMPLE_CLOCK_t *clock, long long sample_rate, uint64_t micros, uint64_t max_age, uint64_t *samples);
+
+#endif
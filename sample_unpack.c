@@ -0,0 +1,89 @@
+/* Public header */
+#include "sample_unpack.h"
+
+/* SIMD intrinsics (scalar code used for remainders and on other architectures) */
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+#endif
+
+/* Public functions */
+void SAMPLE_UNPACK_Int8(uint8_t *dst, const uint8_t *src, size_t len)
+{
+	size_t i = 0;
+
+	#if defined(__ARM_NEON)
+	/* Widen 16 components per iteration, the component becoming the high byte */
+	for (; (i + 16) <= len; i += 16)
+	{
+		uint8x16x2_t out;
+		out.val[0] = vdupq_n_u8(0);
+		out.val[1] = vld1q_u8(&src[i]);
+		vst2q_u8(&dst[2 * i], out);
+	}
+	#elif defined(__SSE2__)
+	/* Interleave 16 components per iteration with zero, the component becoming the high byte */
+	const __m128i zero = _mm_setzero_si128();
+	for (; (i + 16) <= len; i += 16)
+	{
+		__m128i in = _mm_loadu_si128((const __m128i*)&src[i]);
+		_mm_storeu_si128((__m128i*)&dst[2 * i], _mm_unpacklo_epi8(zero, in));
+		_mm_storeu_si128((__m128i*)&dst[(2 * i) + 16], _mm_unpackhi_epi8(zero, in));
+	}
+	#endif
+
+	/* Remaining components */
+	for (; i < len; i++)
+	{
+		dst[2 * i] = 0;
+		dst[(2 * i) + 1] = src[i];
+	}
+}
+
+void SAMPLE_UNPACK_Packed12(uint8_t *dst, const uint8_t *src, size_t len)
+{
+	size_t i = 0;
+	size_t o = 0;
+
+	#if defined(__ARM_NEON)
+	/* De-interleave 8 component pairs per iteration */
+	for (; (i + 24) <= len; i += 24, o += 32)
+	{
+		uint8x8x3_t in = vld3_u8(&src[i]);
+		uint16x8x2_t out;
+		out.val[0] = vorrq_u16(vshll_n_u8(in.val[0], 4),
+							   vshlq_n_u16(vmovl_u8(vand_u8(in.val[1], vdup_n_u8(0x0F))), 12));
+		out.val[1] = vorrq_u16(vmovl_u8(vand_u8(in.val[1], vdup_n_u8(0xF0))),
+							   vshll_n_u8(in.val[2], 8));
+		vst2q_u16((uint16_t*)&dst[o], out);
+	}
+	#elif defined(__SSSE3__)
+	/*
+	** Shuffle 4 component pairs per iteration into 16-bit lanes, even lanes holding x0[7:0], x1[3:0] << 4 | x0[11:8]
+	** (needing a shift left by 4) and odd lanes x1[3:0] << 4 | x0[11:8], x1[11:4] (needing x0's bits masked off)
+	** Loads are 16 bytes wide, of which 12 are used, so the loop stops short of the end of the source
+	*/
+	const __m128i shuffle = _mm_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11);
+	const __m128i even = _mm_setr_epi16(-1, 0, -1, 0, -1, 0, -1, 0);
+	const __m128i odd = _mm_setr_epi16(0, 0xFFF0, 0, 0xFFF0, 0, 0xFFF0, 0, 0xFFF0);
+	for (; (i + 16) <= len; i += 12, o += 16)
+	{
+		__m128i in = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&src[i]), shuffle);
+		__m128i out = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(in, 4), even), _mm_and_si128(in, odd));
+		_mm_storeu_si128((__m128i*)&dst[o], out);
+	}
+	#endif
+
+	/* Remaining component pairs */
+	for (; (i + 3) <= len; i += 3, o += 4)
+	{
+		dst[o] = (uint8_t)(src[i] << 4);
+		dst[o + 1] = (uint8_t)((src[i + 1] << 4) | (src[i] >> 4));
+		dst[o + 2] = (uint8_t)(src[i + 1] & 0xF0);
+		dst[o + 3] = src[i + 2];
+	}
+}
@@ -0,0 +1,21 @@
+#ifndef __SAMPLE_UNPACK_H__
+#define __SAMPLE_UNPACK_H__
+
+/* Standard libraries */
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+** Expand int8 components to MSB aligned little endian int16 (len source bytes, writing 2 * len bytes)
+** No alignment requirements
+*/
+void SAMPLE_UNPACK_Int8(uint8_t *dst, const uint8_t *src, size_t len);
+
+/*
+** Expand packed 12-bit components to MSB aligned little endian int16 (len source bytes, a multiple of 3, writing 4 * len / 3 bytes)
+** Each pair of components x0, x1 occupies three bytes: x0[7:0], x1[3:0] << 4 | x0[11:8], x1[11:4]
+** No alignment requirements
+*/
+void SAMPLE_UNPACK_Packed12(uint8_t *dst, const uint8_t *src, size_t len);
+
+#endif
@@ -2,6 +2,8 @@
 #define __SDR_IP_GADGET_TYPES_H__
 
 /* Standard libraries */
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 /* Definitions - packet magic number */
@@ -12,6 +14,116 @@
 #define SDR_IP_GADGET_COMMAND_START_RX (0x01)
 #define SDR_IP_GADGET_COMMAND_STOP_TX (0x02)
 #define SDR_IP_GADGET_COMMAND_STOP_RX (0x03)
+#define SDR_IP_GADGET_COMMAND_START_TX_GEN (0x04)
+#define SDR_IP_GADGET_COMMAND_RECONFIGURE (0x05)
+#define SDR_IP_GADGET_COMMAND_RF_SET (0x06)
+#define SDR_IP_GADGET_COMMAND_FASTLOCK_STORE (0x07)
+#define SDR_IP_GADGET_COMMAND_HOP (0x08)
+#define SDR_IP_GADGET_COMMAND_HOP_CANCEL (0x09)
+#define SDR_IP_GADGET_COMMAND_LOOPBACK (0x0A)
+#define SDR_IP_GADGET_COMMAND_GET_STATS (0x0B)
+#define SDR_IP_GADGET_COMMAND_TRACE_DUMP (0x0C)
+
+/* Generated waveforms */
+#define SDR_IP_GADGET_WAVEFORM_TONE (0x00)
+#define SDR_IP_GADGET_WAVEFORM_MULTITONE (0x01)
+#define SDR_IP_GADGET_WAVEFORM_CHIRP (0x02)
+#define SDR_IP_GADGET_WAVEFORM_PRBS (0x03)
+#define SDR_IP_GADGET_WAVEFORM_NOISE (0x04)
+
+/*
+** TX sample formats
+** Components are expanded to the 16-bit format expected by the DAC, MSB aligned such that
+** full scale is preserved. Packed 12-bit components are stored in pairs, x0 and x1 occupying
+** three bytes: x0[7:0], x1[3:0] << 4 | x0[11:8], x1[11:4].
+*/
+#define SDR_IP_GADGET_SAMPLE_FORMAT_S16 (0x00)
+#define SDR_IP_GADGET_SAMPLE_FORMAT_S8 (0x01)
+#define SDR_IP_GADGET_SAMPLE_FORMAT_S12_PACKED (0x02)
+
+/* Late TX buffer policies */
+#define SDR_IP_GADGET_LATE_POLICY_PUSH (0x00)
+#define SDR_IP_GADGET_LATE_POLICY_DROP (0x01)
+#define SDR_IP_GADGET_LATE_POLICY_TRUNCATE (0x02)
+
+/* Data packet flags */
+#define SDR_IP_GADGET_DATA_FLAG_FEC_PARITY (0x0001)
+#define SDR_IP_GADGET_DATA_FLAG_RETRANSMIT (0x0002)
+#define SDR_IP_GADGET_DATA_FLAG_NACK (0x0004)
+#define SDR_IP_GADGET_DATA_FLAG_STATUS (0x0008)
+#define SDR_IP_GADGET_DATA_FLAG_END_OF_BURST (0x0010)
+#define SDR_IP_GADGET_DATA_FLAG_HOP (0x0020)
+#define SDR_IP_GADGET_DATA_FLAG_MARKER (0x0040)
+#define SDR_IP_GADGET_DATA_FLAG_LOOPBACK (0x0080)
+
+/* RF parameters */
+#define SDR_IP_GADGET_RF_PARAM_RX_LO_HZ (0x00)
+#define SDR_IP_GADGET_RF_PARAM_TX_LO_HZ (0x01)
+#define SDR_IP_GADGET_RF_PARAM_RX_SAMPLE_RATE_HZ (0x02)
+#define SDR_IP_GADGET_RF_PARAM_TX_SAMPLE_RATE_HZ (0x03)
+#define SDR_IP_GADGET_RF_PARAM_RX_GAIN_MDB (0x04)
+#define SDR_IP_GADGET_RF_PARAM_TX_GAIN_MDB (0x05)
+
+/* Fast lock profiles per LO */
+#define SDR_IP_GADGET_FASTLOCK_PROFILES (8)
+
+/*
+** Statistics (GET_STATS response TLV types)
+** Each value is an unsigned 64-bit counter, cumulative since the daemon started, unless noted as a level sampled as
+** the request is handled. The upper byte of each type is its group (general, RX, TX reassembly, TX push).
+*/
+#define SDR_IP_GADGET_STAT_UPTIME_US (0x0000)
+#define SDR_IP_GADGET_STAT_TX_SOCKET_QUEUED (0x0001) // Level, bytes queued on TX data socket
+#define SDR_IP_GADGET_STAT_TX_SOCKET_DROPS (0x0002) // Datagrams dropped by kernel, TX data socket full
+#define SDR_IP_GADGET_STAT_RX_SOCKET_QUEUED (0x0003) // Level, bytes queued on RX data sockets
+
+#define SDR_IP_GADGET_STAT_RX_BUFFERS (0x0100)
+#define SDR_IP_GADGET_STAT_RX_DATAGRAMS (0x0101)
+#define SDR_IP_GADGET_STAT_RX_BYTES (0x0102) // Sample data sent
+#define SDR_IP_GADGET_STAT_RX_OVERFLOWS (0x0103) // Failed sends
+#define SDR_IP_GADGET_STAT_RX_REFILL_US (0x0104) // Total time spent dequeuing blocks
+#define SDR_IP_GADGET_STAT_RX_REFILL_MAX_US (0x0105)
+#define SDR_IP_GADGET_STAT_RX_SEND_US (0x0106) // Total time spent sending blocks
+#define SDR_IP_GADGET_STAT_RX_SEND_MAX_US (0x0107)
+
+#define SDR_IP_GADGET_STAT_TX_DATAGRAMS (0x0200)
+#define SDR_IP_GADGET_STAT_TX_BYTES (0x0201) // Sample data received
+#define SDR_IP_GADGET_STAT_TX_BUFFERS (0x0202) // Buffers assembled and queued
+#define SDR_IP_GADGET_STAT_TX_DROPPED_SEQ (0x0203)
+#define SDR_IP_GADGET_STAT_TX_DROPPED_INDEX (0x0204)
+#define SDR_IP_GADGET_STAT_TX_OUT_OF_ORDER (0x0205)
+#define SDR_IP_GADGET_STAT_TX_LATE_BUFFERS (0x0206)
+#define SDR_IP_GADGET_STAT_TX_RING_OVERFLOWS (0x0207)
+#define SDR_IP_GADGET_STAT_TX_FEC_RECOVERED (0x0208)
+#define SDR_IP_GADGET_STAT_TX_UNRECOVERABLE (0x0209)
+#define SDR_IP_GADGET_STAT_TX_NACKS_SENT (0x020A)
+#define SDR_IP_GADGET_STAT_TX_NACK_RECOVERED (0x020B)
+#define SDR_IP_GADGET_STAT_TX_NACK_LATE (0x020C)
+#define SDR_IP_GADGET_STAT_TX_BURST_FLUSHES (0x020D) // Partial buffers pushed, end of burst flagged
+#define SDR_IP_GADGET_STAT_TX_IDLE_FLUSHES (0x020E) // Partial buffers pushed, idle timeout
+
+#define SDR_IP_GADGET_STAT_PUSH_BUFFERS (0x0300)
+#define SDR_IP_GADGET_STAT_PUSH_UNDERFLOWS (0x0301) // Zero buffers pushed, client having fallen behind
+#define SDR_IP_GADGET_STAT_PUSH_OVERFLOWS (0x0302) // Failed submits
+#define SDR_IP_GADGET_STAT_PUSH_LATE_DROPPED (0x0303)
+#define SDR_IP_GADGET_STAT_PUSH_LATE_TRUNCATED (0x0304)
+#define SDR_IP_GADGET_STAT_PUSH_REFILL_US (0x0305) // Total time spent waiting for free blocks
+#define SDR_IP_GADGET_STAT_PUSH_REFILL_MAX_US (0x0306)
+#define SDR_IP_GADGET_STAT_PUSH_SUBMIT_US (0x0307) // Total time spent submitting blocks
+#define SDR_IP_GADGET_STAT_PUSH_SUBMIT_MAX_US (0x0308)
+
+/* Loopback modes */
+#define SDR_IP_GADGET_LOOPBACK_OFF (0x00)
+#define SDR_IP_GADGET_LOOPBACK_DIGITAL (0x01)
+#define SDR_IP_GADGET_LOOPBACK_EXTERNAL (0x02)
+
+/*
+** Minimum start request sizes
+** Fields appended to the request since its introduction are optional, older clients omitting them
+** will have them treated as zero.
+*/
+#define SDR_IP_GADGET_TX_START_MIN_SIZE (offsetof(cmd_ip_tx_start_req_t, jitter_buffers))
+#define SDR_IP_GADGET_RX_START_MIN_SIZE (offsetof(cmd_ip_rx_start_req_t, kernel_buffers))
 
 /* Type definitions */
 #pragma pack(push,1)
@@ -55,6 +167,124 @@ typedef struct
 	*/
 	uint32_t buffer_size;
 
+	/*
+	** Jitter buffer depth (in IIO buffers)
+	** If non-zero, this many assembled buffers are held before transmission starts. Buffers are then
+	** released at the rate the DAC consumes them, zero buffers being inserted should the client fall behind.
+	** If zero (and jitter_ms is zero) buffers are pushed as soon as they're assembled.
+	*/
+	uint8_t jitter_buffers;
+
+	/*
+	** Jitter buffer target latency (milliseconds)
+	** If non-zero, overrides jitter_buffers, the depth being calculated from the DAC sample rate.
+	*/
+	uint16_t jitter_ms;
+
+	/*
+	** IIO kernel buffer count
+	** Number of buffers the kernel queues for the DAC DMA, zero to use the IIO library default.
+	*/
+	uint8_t kernel_buffers;
+
+	/*
+	** UDP packet size (bytes)
+	** If non-zero, datagrams are placed in the buffer according to their block index, such that they may arrive
+	** out of order. Every block except a buffer's last must then carry (packet_size - sizeof(data_ip_hdr_t)) bytes.
+	** If zero, datagrams must arrive in order, although their size is unconstrained.
+	*/
+	uint16_t packet_size;
+
+	/*
+	** FEC group size (in blocks)
+	** If non-zero (requires packet_size), the client follows each group of fec_group_size data blocks
+	** (a buffer's last group may be shorter) with a parity block, flagged with SDR_IP_GADGET_DATA_FLAG_FEC_PARITY.
+	** A parity block's block_index holds its group index and its payload the XOR of the group's data payloads,
+	** each zero padded to the full payload size. A single lost block per group is then reconstructed.
+	*/
+	uint8_t fec_group_size;
+
+	/*
+	** NACK window (in IIO buffers)
+	** If non-zero (requires packet_size), up to this many buffers are reassembled concurrently, missing blocks
+	** being requested from the client by sending a data_ip_nack_t to the address its data arrived from.
+	** The client should resend requested blocks, flagged with SDR_IP_GADGET_DATA_FLAG_RETRANSMIT.
+	** A buffer is abandoned once the window is exhausted or (timestamping and jitter buffer enabled) once its
+	** playout time has passed, the jitter buffer therefore needing to cover at least one round trip.
+	*/
+	uint8_t nack_window;
+
+	/*
+	** Status report interval (milliseconds)
+	** If non-zero, a data_ip_status_t is sent at this interval to the address data arrives from, allowing the
+	** client to pace itself to the DAC's consumption rather than transmitting open loop.
+	*/
+	uint16_t status_interval_ms;
+
+	/*
+	** Sample format (SDR_IP_GADGET_SAMPLE_FORMAT_*)
+	** Format of the sample data carried by datagrams, expanded into the IIO buffer as it's received.
+	** When packet_size is set, each block except a buffer's last carries as many whole samples as fit.
+	** Packed 12-bit requires an even number of components per sample (I / Q pairs).
+	*/
+	uint8_t sample_format;
+
+	/*
+	** Cyclic mode
+	** If set, the first complete buffer received (the waveform, which may span many datagrams) is loaded into a
+	** cyclic IIO buffer, which the DAC then repeats without further network traffic. Should another buffer
+	** be received it replaces the waveform, the DAC briefly falling silent as the cyclic buffer is recreated.
+	** The jitter buffer is unused in this mode.
+	*/
+	bool cyclic;
+
+	/*
+	** Release horizon (milliseconds)
+	** If non-zero (requires timestamping), buffers are released to the DAC against an estimate of the hardware
+	** sample clock (taken from the RX stream's timestamps while it's running, otherwise extrapolated from the first
+	** buffer released). Buffers timestamped more than this far ahead are held until within it.
+	*/
+	uint16_t release_horizon_ms;
+
+	/*
+	** Late buffer policy (SDR_IP_GADGET_LATE_POLICY_*, requires release_horizon_ms)
+	** Buffers whose timestamp has already passed are pushed regardless, dropped, or truncated (only the samples
+	** yet to be due being pushed, any buffer entirely in the past being dropped).
+	*/
+	uint8_t late_policy;
+
+	/*
+	** Burst idle timeout (microseconds)
+	** If non-zero, a partially filled buffer is zero padded and pushed once no data has arrived for this long,
+	** rather than waiting for the next burst to fill it. Regardless of this setting, a datagram flagged with
+	** SDR_IP_GADGET_DATA_FLAG_END_OF_BURST has its buffer pushed immediately, any blocks following it (packet_size
+	** set) being taken as zero. FEC parity for such a buffer covers only the blocks sent, zero blocks not affecting it.
+	*/
+	uint16_t burst_idle_us;
+
+	/*
+	** Interpolation factor
+	** If greater than one, buffers carry samples at the DAC rate divided by this factor (up to 16), which are
+	** interpolated by a polyphase FIR filter as they're pushed, reducing network traffic by the same factor.
+	** buffer_size and timestamps remain in DAC samples, buffer_size less any timestamp being a multiple of the factor.
+	** Each buffer therefore carries (buffer_size less timestamp) / factor samples following its timestamp.
+	** The filter (a windowed sinc, cut off at half the reduced rate) delays the output by half its length.
+	** Not available in cyclic mode.
+	*/
+	uint8_t interp_factor;
+
+	/*
+	** Interpolation filter taps per phase (zero for the default of 8)
+	** Longer filters offer a sharper transition band, at a proportional CPU cost (up to 64).
+	*/
+	uint8_t interp_taps;
+
+	/*
+	** Interpolation frequency shift (Hz)
+	** If non-zero, each interpolated I / Q pair is shifted by this frequency (positive or negative) by an NCO.
+	*/
+	int32_t interp_nco_hz;
+
 } cmd_ip_tx_start_req_t;
 
 typedef struct
@@ -95,8 +325,51 @@ typedef struct
 	*/
 	uint16_t packet_size;
 
+	/*
+	** IIO kernel buffer count
+	** Number of buffers the kernel queues for the ADC DMA, zero to use the IIO library default.
+	*/
+	uint8_t kernel_buffers;
+
 } cmd_ip_rx_start_req_t;
 
+typedef struct
+{
+	/* Command header */
+	cmd_ip_header_t hdr;
+
+	/* Bitmask of enabled channels (each enabled I / Q pair receiving the same waveform) */
+	uint32_t enabled_channels;
+
+	/* Buffer size (in samples) to request from IIO library */
+	uint32_t buffer_size;
+
+	/* IIO kernel buffer count (zero to use the IIO library default) */
+	uint8_t kernel_buffers;
+
+	/* Waveform (SDR_IP_GADGET_WAVEFORM_*) */
+	uint8_t waveform;
+
+	/* Peak amplitude of each component (MSB aligned, full scale being 32767) */
+	int16_t amplitude;
+
+	/* Frequency (Hz), of tone, lowest tone or chirp start */
+	int32_t frequency;
+
+	/* Frequency (Hz), of multi-tone spacing or chirp end */
+	int32_t frequency2;
+
+	/* Number of tones (multi-tone) */
+	uint8_t tones;
+
+	/* Period (samples), of chirp sweep or PRBS symbol */
+	uint32_t period;
+
+	/* Seed of PRBS / noise generator (zero for default) */
+	uint32_t seed;
+
+} cmd_ip_tx_gen_req_t;
+
 typedef struct
 {
 	/* Command header */
@@ -106,12 +379,165 @@ typedef struct
 
 } cmd_ip_stop_req_t;
 
+typedef struct
+{
+	/* Command header */
+	cmd_ip_header_t hdr;
+
+	/* Direction to reconfigure (set for TX, clear for RX) */
+	bool tx;
+
+	/*
+	** Buffer size (in samples, including any timestamp) and UDP packet size (bytes), zero keeping current value
+	** RX streams switch at a buffer boundary without interruption where the IIO backend supports resizing blocks
+	** in place (the sequence number continuing across the switch), otherwise the buffer is recreated, losing the
+	** samples queued in it (which timestamps reflect). TX streams switch in place once the buffer being reassembled
+	** has been queued, buffers already queued being pushed at their own size, the sequence number continuing.
+	** The request has no reply, and a TX request the running stream can't follow is ignored (reported by the daemon
+	** alone), the stream continuing with its current sizes. Clients should instead stop and start the stream to:
+	**   - enlarge the buffer beyond the size the stream was started with (the DAC buffer being fixed);
+	**   - change sizes of a cyclic or generator stream;
+	**   - set a packet size for a stream started without one (switching to indexed reassembly).
+	*/
+	uint32_t buffer_size;
+	uint16_t packet_size;
+
+} cmd_ip_reconfigure_req_t;
+
+typedef struct
+{
+	/* Command header */
+	cmd_ip_header_t hdr;
+
+	/* Parameter (SDR_IP_GADGET_RF_PARAM_*) */
+	uint8_t param;
+
+	/*
+	** Value, in the parameter's units
+	** LO frequencies and sample rates are in Hz. Gains are in milli-dB, RX gain switching its gain control to manual
+	** and TX gain being the (negative) attenuation of the transmitter.
+	*/
+	int64_t value;
+
+} cmd_ip_rf_set_req_t;
+
+typedef struct
+{
+	/* Command header */
+	cmd_ip_header_t hdr;
+
+	/* LO to store (set for TX, clear for RX) */
+	bool tx;
+
+	/* Profile (0 to SDR_IP_GADGET_FASTLOCK_PROFILES - 1) */
+	uint8_t profile;
+
+	/*
+	** Frequency (Hz) to tune and calibrate before storing, zero storing the current frequency
+	** The LO is left tuned to this frequency. Profiles are held by the transceiver, remaining valid until it's reset.
+	*/
+	uint64_t frequency;
+
+} cmd_ip_fastlock_store_req_t;
+
+typedef struct
+{
+	/* Command header */
+	cmd_ip_header_t hdr;
+
+	/* LO to hop (set for TX, clear for RX) */
+	bool tx;
+
+	/* Fast lock profile to recall, as previously stored */
+	uint8_t profile;
+
+	/*
+	** RX hardware timestamp (samples) at which to hop, zero hopping immediately
+	** Scheduled hops require a running RX stream with timestamping enabled, against which the time is estimated.
+	** Each hop is tagged in the RX stream by a data_ip_hop_t datagram once made, so a hopping receiver can
+	** locate it without a round trip per hop. Hops which are due when the RX stream stops are dropped.
+	*/
+	uint64_t timestamp;
+
+	/* Tag, returned with the hop's data_ip_hop_t */
+	uint32_t tag;
+
+} cmd_ip_hop_req_t;
+
+typedef struct
+{
+	/* Command header */
+	cmd_ip_header_t hdr;
+
+	/* No arguments, all scheduled hops being cancelled */
+
+} cmd_ip_hop_cancel_req_t;
+
+typedef struct
+{
+	/* Command header */
+	cmd_ip_header_t hdr;
+
+	/*
+	** Mode (SDR_IP_GADGET_LOOPBACK_*)
+	** Digital loops the transceiver's TX data port back to RX, external leaving the transceiver be (TX being cabled or
+	** radiated to RX), both enabling latency probes. While enabled, a TX buffer carrying a datagram flagged with
+	** SDR_IP_GADGET_DATA_FLAG_MARKER is timed through the daemon, the RX stream being searched for its arrival once
+	** pushed to the DAC. The marker is the first RX sample of either component of the first channel whose magnitude
+	** reaches the threshold, so the client should send a pulse at the start of the marked buffer, preceded by silence.
+	** Once found, a data_ip_loopback_t is sent to the RX client. Only one probe is in flight at a time, markers
+	** pushed meanwhile being ignored, and one not found within a second is abandoned.
+	*/
+	uint8_t mode;
+
+	/* Marker threshold (RX component magnitude, zero for half of the ADC's 12-bit full scale) */
+	uint16_t threshold;
+
+} cmd_ip_loopback_req_t;
+
+typedef struct
+{
+	/* Command header */
+	cmd_ip_header_t hdr;
+
+	/*
+	** No arguments
+	** The response, sent to the requesting address, is a cmd_ip_header_t (magic and command) followed by a
+	** stat_ip_tlv_t and value for each statistic.
+	*/
+
+} cmd_ip_get_stats_req_t;
+
+typedef struct
+{
+	/* Command header */
+	cmd_ip_header_t hdr;
+
+	/*
+	** Period dumped (seconds, zero for five)
+	** Each thread's most recent events within the period are written to /tmp/sdr_ip_gadget_trace.json on the
+	** device, in Chrome trace event format (viewed by Perfetto or chrome://tracing). As many are kept as fit each
+	** thread's ring, so a busy thread's trace may cover less.
+	*/
+	uint16_t seconds;
+
+} cmd_ip_trace_dump_req_t;
+
 typedef union
 {
 	cmd_ip_header_t hdr;
 	cmd_ip_tx_start_req_t start_tx;
 	cmd_ip_rx_start_req_t start_rx;
+	cmd_ip_tx_gen_req_t start_tx_gen;
 	cmd_ip_stop_req_t stop;
+	cmd_ip_reconfigure_req_t reconfigure;
+	cmd_ip_rf_set_req_t rf_set;
+	cmd_ip_fastlock_store_req_t fastlock_store;
+	cmd_ip_hop_req_t hop;
+	cmd_ip_hop_cancel_req_t hop_cancel;
+	cmd_ip_loopback_req_t loopback;
+	cmd_ip_get_stats_req_t get_stats;
+	cmd_ip_trace_dump_req_t trace_dump;
 
 } cmd_ip_t;
 
@@ -124,13 +550,128 @@ typedef struct
 	uint8_t block_index;
 	uint8_t block_count;
 
-	/* Spare */
-	uint16_t unused;
+	/* Flags (SDR_IP_GADGET_DATA_FLAG_*) */
+	uint16_t flags;
 
 	/* Timestamp / sequence number */
 	uint64_t seqno;
 
 } data_ip_hdr_t;
+
+typedef struct
+{
+	/* Magic word, most basic protection against stray packets */
+	uint32_t magic;
+
+	/* Unused (zero) */
+	uint8_t unused;
+
+	/* Block count of buffer */
+	uint8_t block_count;
+
+	/* Flags (SDR_IP_GADGET_DATA_FLAG_NACK) */
+	uint16_t flags;
+
+	/* Timestamp / sequence number of buffer */
+	uint64_t seqno;
+
+	/* Bitmap of missing blocks, block n being requested if bit (n % 8) of byte (n / 8) is set */
+	uint8_t missing[32];
+
+} data_ip_nack_t;
+
+typedef struct
+{
+	/* Magic word, most basic protection against stray packets */
+	uint32_t magic;
+
+	/* Unused (zero) */
+	uint16_t unused;
+
+	/* Flags (SDR_IP_GADGET_DATA_FLAG_STATUS) */
+	uint16_t flags;
+
+	/* Timestamp / sequence number of last buffer pushed to the DAC */
+	uint64_t seqno;
+
+	/* Buffers which may still be queued before the daemon starts dropping them (credit) */
+	uint16_t free_buffers;
+
+	/* Buffers queued awaiting the DAC */
+	uint16_t queued_buffers;
+
+	/* Bytes waiting in the daemon's socket receive queue (including kernel overhead) */
+	uint32_t socket_queued;
+
+	/* Zero buffers pushed due to the client falling behind (since start, wrapping) */
+	uint32_t underflows;
+
+} data_ip_status_t;
+
+typedef struct
+{
+	/* Magic word, most basic protection against stray packets */
+	uint32_t magic;
+
+	/* LO hopped (non-zero for TX) */
+	uint8_t tx;
+
+	/* Fast lock profile recalled */
+	uint8_t profile;
+
+	/* Flags (SDR_IP_GADGET_DATA_FLAG_HOP) */
+	uint16_t flags;
+
+	/* Estimated RX timestamp / sequence number at which the hop completed */
+	uint64_t seqno;
+
+	/* RX timestamp requested (zero for immediate hops) */
+	uint64_t requested;
+
+	/* Tag from request */
+	uint32_t tag;
+
+} data_ip_hop_t;
+
+typedef struct
+{
+	/* Magic word, most basic protection against stray packets */
+	uint32_t magic;
+
+	/* Unused (zero) */
+	uint16_t unused;
+
+	/* Flags (SDR_IP_GADGET_DATA_FLAG_LOOPBACK) */
+	uint16_t flags;
+
+	/* RX timestamp / sequence number of marker */
+	uint64_t seqno;
+
+	/* Timestamp / sequence number of marked TX buffer */
+	uint64_t tx_seqno;
+
+	/*
+	** Time (uS) from first marked datagram being received to its buffer being assembled, pushed to the DAC,
+	** the marker being captured by the ADC (estimated from RX timestamps, zero unless timestamping), its block
+	** being dequeued and sent
+	*/
+	uint32_t assembled_us;
+	uint32_t pushed_us;
+	uint32_t captured_us;
+	uint32_t dequeued_us;
+	uint32_t sent_us;
+
+} data_ip_loopback_t;
+
+typedef struct
+{
+	/* Statistic (SDR_IP_GADGET_STAT_*) */
+	uint16_t type;
+
+	/* Length of value following (bytes, little endian), types unknown to the client may be skipped by it */
+	uint16_t length;
+
+} stat_ip_tlv_t;
 #pragma pack(pop)
 
 #endif
@@ -0,0 +1,428 @@
+/* Standard / system libraries */
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/sysinfo.h>
+#include <unistd.h>
+
+/* Local modules */
+#include "thread_read.h"
+#include "utils.h"
+
+/* Definitions - defaults, matching a typical RX stream (8 kB datagrams) sent to the daemon's first RX port */
+#define DEFAULT_PACKETS (64U)
+#define DEFAULT_PACKET_SIZE (8192U)
+#define DEFAULT_SECONDS (2U)
+#define DEFAULT_ADDRESS "127.0.0.1"
+#define DEFAULT_PORT (30434U)
+
+/* Type definitions - sender shard, as in the read thread */
+typedef struct
+{
+	/* Worker thread */
+	pthread_t thread;
+	bool started;
+
+	/* Index, selecting the worker's CPU */
+	unsigned int index;
+
+	/* Eventfd signalling worker to send its share (or quit) */
+	int start_fd;
+
+	/* Eventfd signalled by worker having sent its share */
+	int done_fd;
+
+	/* Socket and share of each buffer's datagrams */
+	int fd;
+	struct mmsghdr *msgs;
+	size_t count;
+
+	/* Stop request */
+	atomic_bool quit;
+
+	/* Failed sends */
+	atomic_uint failures;
+
+} shard_t;
+
+/* Private functions */
+static bool run(unsigned int shard_count, struct mmsghdr *msgs, size_t packets, size_t packet_size, unsigned int seconds);
+static void *shard_entrypoint(void *args);
+static void shard_send(shard_t *shard);
+static void pin(unsigned int index);
+static void print_usage(const char *program_name, FILE *dest);
+
+/* Public functions */
+int main(int argc, char *argv[])
+{
+	/* Long options array, mapping options to their short equivalents */
+	struct option long_options[] = {
+		{"address", required_argument, NULL, 'a'},
+		{"port", required_argument, NULL, 'o'},
+		{"shards", required_argument, NULL, 's'},
+		{"packets", required_argument, NULL, 'p'},
+		{"packet-size", required_argument, NULL, 'l'},
+		{"duration", required_argument, NULL, 'd'},
+		{"version", no_argument, NULL, 'v'},
+		{"help", no_argument, NULL, 'h'},
+		{0, 0, 0, 0} // Terminate the options array
+	};
+
+	/* Basic argument parsing */
+	int opt_c;
+	bool err = false;
+	const char *address = DEFAULT_ADDRESS;
+	unsigned long port = DEFAULT_PORT;
+	unsigned long max_shards = THREAD_READ_MAX_SHARDS;
+	unsigned long packets = DEFAULT_PACKETS;
+	unsigned long packet_size = DEFAULT_PACKET_SIZE;
+	unsigned long seconds = DEFAULT_SECONDS;
+	int opt_index = 0;
+	while ((opt_c = getopt_long(argc, argv, "a:d:hl:o:p:s:v", long_options, &opt_index)) != -1)
+	{
+		switch (opt_c)
+		{
+			case 'a':
+			{
+				address = optarg;
+				break;
+			}
+			case 'o':
+			{
+				port = strtoul(optarg, NULL, 0);
+				if ((port < 1) || (port > 65535))
+				{
+					fprintf(stderr, "Error: Port must be 1 to 65535\n");
+					err = true;
+				}
+				break;
+			}
+			case 's':
+			{
+				max_shards = strtoul(optarg, NULL, 0);
+				if ((max_shards < 1) || (max_shards > THREAD_READ_MAX_SHARDS))
+				{
+					fprintf(stderr, "Error: Shards must be 1 to %u\n", THREAD_READ_MAX_SHARDS);
+					err = true;
+				}
+				break;
+			}
+			case 'p':
+			{
+				packets = strtoul(optarg, NULL, 0);
+				if ((packets < 1) || (packets > 1024))
+				{
+					fprintf(stderr, "Error: Packets must be 1 to 1024\n");
+					err = true;
+				}
+				break;
+			}
+			case 'l':
+			{
+				packet_size = strtoul(optarg, NULL, 0);
+				if ((packet_size < 64) || (packet_size > 65507))
+				{
+					fprintf(stderr, "Error: Packet size must be 64 to 65507\n");
+					err = true;
+				}
+				break;
+			}
+			case 'd':
+			{
+				seconds = strtoul(optarg, NULL, 0);
+				if ((seconds < 1) || (seconds > 60))
+				{
+					fprintf(stderr, "Error: Duration must be 1 to 60\n");
+					err = true;
+				}
+				break;
+			}
+			case 'v':
+			{
+				printf("Version %s\n", PROGRAM_VERSION);
+				return 0;
+			}
+			case 'h':
+			{
+				print_usage(argv[0], stdout);
+				return 0;
+			}
+			case '?':
+			default:
+			{
+				err = true;
+				break;
+			}
+		}
+	}
+
+	/* Destination, shared by every datagram */
+	struct sockaddr_in addr;
+	memset(&addr, 0x00, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons((uint16_t)port);
+	if (!err && (inet_pton(AF_INET, address, &addr.sin_addr) != 1))
+	{
+		fprintf(stderr, "Error: Invalid address %s\n", address);
+		err = true;
+	}
+	if (err)
+	{
+		print_usage(argv[0], stderr);
+		return 1;
+	}
+
+	/* One buffer's datagrams, each with a single io vector onto the same payload */
+	struct mmsghdr *msgs = calloc(packets, sizeof(struct mmsghdr));
+	struct iovec *iovs = calloc(packets, sizeof(struct iovec));
+	uint8_t *payload = calloc(1, packet_size);
+	if (!msgs || !iovs || !payload)
+	{
+		perror("Failed to allocate benchmark");
+		return 1;
+	}
+	for (size_t i = 0; i < packets; i++)
+	{
+		iovs[i].iov_base = payload;
+		iovs[i].iov_len = packet_size;
+		msgs[i].msg_hdr.msg_name = &addr;
+		msgs[i].msg_hdr.msg_namelen = sizeof(addr);
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	/* Run with each shard count in turn, the sending thread pinned as the read thread's first shard would be */
+	printf("%lu x %lu byte datagrams per buffer to %s:%lu, %lu s per shard count\n", packets, packet_size, address, port, seconds);
+	pin(0);
+	int ret = 0;
+	for (unsigned int shard_count = 1; shard_count <= max_shards; shard_count++)
+	{
+		if (!run(shard_count, msgs, packets, packet_size, (unsigned int)seconds))
+		{
+			ret = 1;
+			break;
+		}
+	}
+
+	free(payload);
+	free(iovs);
+	free(msgs);
+
+	return ret;
+}
+
+/* Private functions */
+static bool run(unsigned int shard_count, struct mmsghdr *msgs, size_t packets, size_t packet_size, unsigned int seconds)
+{
+	/* Each shard sending at least one datagram */
+	if (shard_count > packets)
+	{
+		return true;
+	}
+
+	/* Split datagrams into contiguous shares, each sent from its own socket */
+	shard_t shards[THREAD_READ_MAX_SHARDS];
+	memset(shards, 0x00, sizeof(shards));
+	for (unsigned int i = 0; i < shard_count; i++)
+	{
+		shards[i].fd = -1;
+		shards[i].start_fd = -1;
+	}
+	bool ok = true;
+	int done_fd = eventfd(0, 0);
+	if (done_fd < 0)
+	{
+		perror("Failed to open shard eventfd");
+		return false;
+	}
+	for (unsigned int i = 0; i < shard_count; i++)
+	{
+		shard_t *shard = &shards[i];
+		size_t first = (i * packets) / shard_count;
+		size_t last = ((i + 1) * packets) / shard_count;
+		shard->index = i;
+		shard->msgs = &msgs[first];
+		shard->count = last - first;
+		shard->done_fd = done_fd;
+		shard->fd = socket(AF_INET, SOCK_DGRAM, 0);
+		if (shard->fd < 0)
+		{
+			perror("Failed to open socket");
+			ok = false;
+			break;
+		}
+	}
+
+	/* Start workers for all but the first share */
+	for (unsigned int i = 1; ok && (i < shard_count); i++)
+	{
+		shard_t *shard = &shards[i];
+		shard->start_fd = eventfd(0, 0);
+		if (shard->start_fd < 0)
+		{
+			perror("Failed to open shard eventfd");
+			ok = false;
+			break;
+		}
+		if (0 != pthread_create(&shard->thread, NULL, shard_entrypoint, shard))
+		{
+			fprintf(stderr, "Failed to start shard %u\n", i);
+			ok = false;
+			break;
+		}
+		shard->started = true;
+	}
+
+	/* Send buffers as the read thread does, handing out shares, sending the first and waiting for the rest */
+	uint64_t buffers = 0;
+	uint64_t start = UTILS_GetMonotonicMicros();
+	uint64_t now = start;
+	uint64_t event;
+	while (ok && ((now - start) < (seconds * 1000000ULL)))
+	{
+		event = 1;
+		for (unsigned int i = 1; i < shard_count; i++)
+		{
+			if (write(shards[i].start_fd, &event, sizeof(event)) < 0)
+			{
+				perror("Failed to signal shard");
+				ok = false;
+			}
+		}
+		shard_send(&shards[0]);
+		for (unsigned int done = 1; ok && (done < shard_count); done += (unsigned int)event)
+		{
+			if (read(done_fd, &event, sizeof(event)) < 0)
+			{
+				perror("Failed to wait for shards");
+				ok = false;
+			}
+		}
+		buffers++;
+		now = UTILS_GetMonotonicMicros();
+	}
+
+	/* Report throughput and mean send time per buffer */
+	unsigned int failures = 0;
+	for (unsigned int i = 0; i < shard_count; i++)
+	{
+		failures += atomic_load(&shards[i].failures);
+	}
+	if (ok && (buffers > 0))
+	{
+		uint64_t elapsed = now - start;
+		printf("Shards %u: %"PRIu64" buffers/s, %"PRIu64" datagrams/s, %"PRIu64" MB/s, %"PRIu64" uS per buffer, %u failed sends\n",
+			shard_count,
+			(buffers * 1000000U) / elapsed,
+			(buffers * packets * 1000000U) / elapsed,
+			(buffers * packets * packet_size) / elapsed,
+			elapsed / buffers,
+			failures);
+	}
+
+	/* Stop and join workers, then close everything */
+	for (unsigned int i = 1; i < shard_count; i++)
+	{
+		shard_t *shard = &shards[i];
+		if (shard->started)
+		{
+			atomic_store(&shard->quit, true);
+			event = 1;
+			if (write(shard->start_fd, &event, sizeof(event)) < 0)
+			{
+				perror("Failed to stop shard");
+			}
+			pthread_join(shard->thread, NULL);
+		}
+	}
+	for (unsigned int i = 0; i < shard_count; i++)
+	{
+		if (shards[i].start_fd >= 0)
+		{
+			close(shards[i].start_fd);
+		}
+		if (shards[i].fd >= 0)
+		{
+			close(shards[i].fd);
+		}
+	}
+	close(done_fd);
+
+	return ok;
+}
+
+static void *shard_entrypoint(void *args)
+{
+	shard_t *shard = (shard_t*)args;
+
+	/* Pinned round-robin, as the read thread's shards are by default */
+	pin(shard->index);
+
+	/* Send share of each buffer when signalled */
+	uint64_t event;
+	while (read(shard->start_fd, &event, sizeof(event)) >= 0)
+	{
+		if (atomic_load(&shard->quit))
+		{
+			break;
+		}
+
+		shard_send(shard);
+
+		event = 1;
+		if (write(shard->done_fd, &event, sizeof(event)) < 0)
+		{
+			perror("Failed to signal shard done");
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+static void shard_send(shard_t *shard)
+{
+	/* Send share with single system call */
+	int sent = sendmmsg(shard->fd, shard->msgs, shard->count, 0);
+	if ((int)shard->count != sent)
+	{
+		atomic_fetch_add(&shard->failures, 1);
+	}
+}
+
+static void pin(unsigned int index)
+{
+	/* From CPU 1 (leaving CPU 0 to interrupts), as the read thread defaults to */
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	CPU_SET((int)((1U + index) % (unsigned int)get_nprocs()), &cpus);
+	if (0 != pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus))
+	{
+		perror("Failed to set affinity");
+	}
+}
+
+static void print_usage(const char *program_name, FILE *dest)
+{
+	fprintf(dest, "Usage: %s [OPTIONS]\n", program_name);
+	fprintf(dest, "Measure RX send throughput sharded over 1 to N sockets / cores, as with the daemon's --rx-shards\n");
+	fprintf(dest, "OPTIONS:\n");
+	fprintf(dest, "  -a, --address ADDR\tSend to ADDR (default %s)\n", DEFAULT_ADDRESS);
+	fprintf(dest, "  -d, --duration S\tRun for S seconds per shard count (default %u)\n", DEFAULT_SECONDS);
+	fprintf(dest, "  -h, --help\tDisplay this help message\n");
+	fprintf(dest, "  -l, --packet-size N\tSend N byte datagrams (default %u)\n", DEFAULT_PACKET_SIZE);
+	fprintf(dest, "  -o, --port PORT\tSend to PORT (default %u)\n", DEFAULT_PORT);
+	fprintf(dest, "  -p, --packets N\tSend N datagrams per buffer (default %u)\n", DEFAULT_PACKETS);
+	fprintf(dest, "  -s, --shards N\tMeasure 1 to N shards (default %u)\n", THREAD_READ_MAX_SHARDS);
+	fprintf(dest, "  -v, --version\tDisplay the version of the program\n");
+}
@@ -0,0 +1,288 @@
+/* Public header */
+#include "stats.h"
+
+/* Standard / system libraries */
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Local modules */
+#include "sdr_ip_gadget_types.h"
+#include "utils.h"
+
+/* Macros */
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+
+/* Private variables - counters defined per group (SDR_IP_GADGET_STAT_* of each group being numbered from zero) */
+static const uint8_t group_counters[STATS_GROUPS] =
+{
+	SDR_IP_GADGET_STAT_RX_SOCKET_QUEUED + 1,
+	(SDR_IP_GADGET_STAT_RX_SEND_MAX_US & 0xFF) + 1,
+	(SDR_IP_GADGET_STAT_TX_IDLE_FLUSHES & 0xFF) + 1,
+	(SDR_IP_GADGET_STAT_PUSH_SUBMIT_MAX_US & 0xFF) + 1
+};
+
+/* Private variables - counter names (and whether they're levels), per group */
+static const struct
+{
+	const char *name;
+	bool level;
+
+} counter_info[STATS_GROUPS][STATS_GROUP_SIZE] =
+{
+	{
+		{ "uptime_us", true },
+		{ "tx_socket_queued", true },
+		{ "tx_socket_drops", false },
+		{ "rx_socket_queued", true },
+	},
+	{
+		{ "rx_buffers", false },
+		{ "rx_datagrams", false },
+		{ "rx_bytes", false },
+		{ "rx_overflows", false },
+		{ "rx_refill_us", false },
+		{ "rx_refill_max_us", true },
+		{ "rx_send_us", false },
+		{ "rx_send_max_us", true },
+	},
+	{
+		{ "tx_datagrams", false },
+		{ "tx_bytes", false },
+		{ "tx_buffers", false },
+		{ "tx_dropped_seq", false },
+		{ "tx_dropped_index", false },
+		{ "tx_out_of_order", false },
+		{ "tx_late_buffers", false },
+		{ "tx_ring_overflows", false },
+		{ "tx_fec_recovered", false },
+		{ "tx_unrecoverable", false },
+		{ "tx_nacks_sent", false },
+		{ "tx_nack_recovered", false },
+		{ "tx_nack_late", false },
+		{ "tx_burst_flushes", false },
+		{ "tx_idle_flushes", false },
+	},
+	{
+		{ "push_buffers", false },
+		{ "push_underflows", false },
+		{ "push_overflows", false },
+		{ "push_late_dropped", false },
+		{ "push_late_truncated", false },
+		{ "push_refill_us", false },
+		{ "push_refill_max_us", true },
+		{ "push_submit_us", false },
+		{ "push_submit_max_us", true },
+	}
+};
+
+/* Private variables - histogram names */
+static const char *const histogram_names[STATS_HISTOGRAMS] =
+{
+	"rx_refill_duration_us",
+	"rx_send_duration_us",
+	"push_refill_duration_us",
+	"push_submit_duration_us"
+};
+
+/* Public functions */
+STATS_t *STATS_Open(void)
+{
+	/* Publish in shared memory, replacing any left behind by a previous run (readers keeping its mapping) */
+	STATS_t *stats = MAP_FAILED;
+	shm_unlink(STATS_SHM_NAME);
+	int fd = shm_open(STATS_SHM_NAME, O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (fd < 0)
+	{
+		perror("Failed to open stats shared memory");
+	}
+	else if (ftruncate(fd, sizeof(STATS_t)) < 0)
+	{
+		perror("Failed to size stats shared memory");
+	}
+	else
+	{
+		stats = mmap(NULL, sizeof(STATS_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (MAP_FAILED == stats)
+		{
+			perror("Failed to map stats shared memory");
+		}
+	}
+	if (fd >= 0)
+	{
+		close(fd);
+	}
+
+	if (MAP_FAILED == stats)
+	{
+		/* Keep statistics privately, they're still available over the control port */
+		fprintf(stderr, "Stats not published, continuing without\n");
+		shm_unlink(STATS_SHM_NAME);
+		stats = mmap(NULL, sizeof(STATS_t), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (MAP_FAILED == stats)
+		{
+			perror("Failed to allocate stats");
+			return NULL;
+		}
+	}
+
+	/* Reset, then identify layout for readers */
+	STATS_Reset(stats);
+	stats->version = STATS_VERSION;
+	stats->size = sizeof(STATS_t);
+	stats->pid = (uint32_t)getpid();
+	atomic_store_explicit(&stats->magic, STATS_MAGIC, memory_order_release);
+
+	return stats;
+}
+
+void STATS_Close(STATS_t *stats)
+{
+	atomic_store_explicit(&stats->magic, 0, memory_order_relaxed);
+	munmap(stats, sizeof(STATS_t));
+	shm_unlink(STATS_SHM_NAME);
+}
+
+const STATS_t *STATS_Attach(void)
+{
+	int fd = shm_open(STATS_SHM_NAME, O_RDONLY, 0);
+	if (fd < 0)
+	{
+		perror("Failed to open stats shared memory (is sdr_ip_gadget running?)");
+		return NULL;
+	}
+
+	/* Check size before mapping, such that the layout checks below can't fault */
+	struct stat st;
+	if ((fstat(fd, &st) < 0) || (st.st_size != sizeof(STATS_t)))
+	{
+		fprintf(stderr, "Stats shared memory size mismatch, daemon and reader versions differ\n");
+		close(fd);
+		return NULL;
+	}
+	const STATS_t *stats = mmap(NULL, sizeof(STATS_t), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (MAP_FAILED == stats)
+	{
+		perror("Failed to map stats shared memory");
+		return NULL;
+	}
+
+	/* Check layout */
+	if (	(STATS_MAGIC != atomic_load_explicit(&stats->magic, memory_order_acquire))
+		 || (STATS_VERSION != stats->version)
+		 || (sizeof(STATS_t) != stats->size)
+	   )
+	{
+		fprintf(stderr, "Stats shared memory not published, or daemon and reader versions differ\n");
+		munmap((void*)stats, sizeof(STATS_t));
+		return NULL;
+	}
+
+	return stats;
+}
+
+void STATS_Reset(STATS_t *stats)
+{
+	for (unsigned int i = 0; i < STATS_GROUPS; i++)
+	{
+		for (unsigned int j = 0; j < STATS_GROUP_SIZE; j++)
+		{
+			atomic_init(&stats->group[i].counter[j], 0);
+		}
+	}
+	for (unsigned int i = 0; i < STATS_HISTOGRAMS; i++)
+	{
+		atomic_init(&stats->histogram[i].sequence, 0);
+		UTILS_ResetHistogram(&stats->histogram[i].histogram);
+	}
+	stats->start_time = UTILS_GetMonotonicMicros();
+}
+
+void STATS_Set(STATS_t *stats, uint16_t stat, uint64_t value)
+{
+	atomic_store_explicit(&stats->group[stat >> 8].counter[stat & 0xFF], value, memory_order_relaxed);
+}
+
+uint64_t STATS_Get(const STATS_t *stats, uint16_t stat)
+{
+	return atomic_load_explicit(&stats->group[stat >> 8].counter[stat & 0xFF], memory_order_relaxed);
+}
+
+void STATS_GetHistogram(const STATS_t *stats, unsigned int histogram, UTILS_Histogram_t *copy)
+{
+	/* Take consistent copy, retrying should it be updated meanwhile */
+	const STATS_Histogram_t *hist = &stats->histogram[histogram];
+	uint32_t sequence;
+	do
+	{
+		sequence = atomic_load_explicit(&hist->sequence, memory_order_acquire);
+		memcpy(copy, &hist->histogram, sizeof(*copy));
+		atomic_thread_fence(memory_order_acquire);
+	} while ((sequence & 1U) || (sequence != atomic_load_explicit(&hist->sequence, memory_order_relaxed)));
+}
+
+unsigned int STATS_GroupCounters(unsigned int group)
+{
+	return (group < STATS_GROUPS) ? group_counters[group] : 0;
+}
+
+const char *STATS_Name(uint16_t stat)
+{
+	return ((stat >> 8) < STATS_GROUPS) && ((stat & 0xFF) < group_counters[stat >> 8])
+		   ? counter_info[stat >> 8][stat & 0xFF].name
+		   : "unknown";
+}
+
+const char *STATS_HistogramName(unsigned int histogram)
+{
+	return (histogram < STATS_HISTOGRAMS) ? histogram_names[histogram] : "unknown";
+}
+
+bool STATS_IsLevel(uint16_t stat)
+{
+	return ((stat >> 8) < STATS_GROUPS) && ((stat & 0xFF) < STATS_GROUP_SIZE) && counter_info[stat >> 8][stat & 0xFF].level;
+}
+
+void STATS_Snapshot(const STATS_t *stats, unsigned int group, uint64_t *snapshot)
+{
+	for (unsigned int i = 0; i < STATS_GROUP_SIZE; i++)
+	{
+		snapshot[i] = atomic_load_explicit(&stats->group[group].counter[i], memory_order_relaxed);
+	}
+}
+
+uint64_t STATS_Since(const STATS_t *stats, uint16_t stat, const uint64_t *snapshot)
+{
+	return STATS_Get(stats, stat) - snapshot[stat & 0xFF];
+}
+
+size_t STATS_Encode(STATS_t *stats, uint8_t *buffer, size_t size)
+{
+	/* Uptime is derived rather than counted */
+	STATS_Set(stats, SDR_IP_GADGET_STAT_UPTIME_US, UTILS_GetMonotonicMicros() - stats->start_time);
+
+	size_t used = 0;
+	for (unsigned int i = 0; i < ARRAY_SIZE(group_counters); i++)
+	{
+		for (unsigned int j = 0; j < group_counters[i]; j++)
+		{
+			stat_ip_tlv_t tlv = { .type = (uint16_t)((i << 8) | j), .length = sizeof(uint64_t) };
+			if ((size - used) < (sizeof(tlv) + sizeof(uint64_t)))
+			{
+				/* Out of space */
+				return used;
+			}
+
+			uint64_t value = atomic_load_explicit(&stats->group[i].counter[j], memory_order_relaxed);
+			memcpy(buffer + used, &tlv, sizeof(tlv));
+			memcpy(buffer + used + sizeof(tlv), &value, sizeof(value));
+			used += sizeof(tlv) + sizeof(value);
+		}
+	}
+
+	return used;
+}
@@ -0,0 +1,170 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+
+/* Standard libraries */
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Local modules */
+#include "utils.h"
+
+/* Definitions - shared memory region (under /dev/shm) publishing statistics, and its layout identification */
+#define STATS_SHM_NAME "/sdr_ip_gadget_stats"
+#define STATS_MAGIC (0x53544154) // "STAT"
+#define STATS_VERSION (1)
+
+/* Definitions - statistic groups (upper byte of SDR_IP_GADGET_STAT_*) and counters per group */
+#define STATS_GROUPS (4)
+#define STATS_GROUP_SIZE (16)
+
+/* Definitions - cache line size, each group occupying lines of its own */
+#define STATS_LINE_SIZE (64)
+
+/*
+** Type definitions - counters of one group
+** Each group is maintained by a single thread, its counters being updated with relaxed atomics (and read likewise
+** by the main thread). Groups are cache line aligned such that threads don't contend for lines.
+*/
+typedef struct
+{
+	_Atomic uint64_t counter[STATS_GROUP_SIZE];
+
+} __attribute__((aligned(STATS_LINE_SIZE))) STATS_Group_t;
+
+/* Definitions - histograms of times (uS), always maintained */
+#define STATS_HISTOGRAM_RX_REFILL (0) // Dequeuing RX blocks
+#define STATS_HISTOGRAM_RX_SEND (1) // Sending RX blocks
+#define STATS_HISTOGRAM_PUSH_REFILL (2) // Waiting for free TX blocks
+#define STATS_HISTOGRAM_PUSH_SUBMIT (3) // Submitting TX blocks
+#define STATS_HISTOGRAMS (4)
+
+/*
+** Type definitions - histogram of one thread
+** Updated by its thread alone, readers (which may be other processes) retrying should they observe an update in
+** progress.
+*/
+typedef struct
+{
+	/* Update sequence (odd while an update is in progress) */
+	_Atomic uint32_t sequence;
+
+	/* Histogram */
+	UTILS_Histogram_t histogram;
+
+} __attribute__((aligned(STATS_LINE_SIZE))) STATS_Histogram_t;
+
+/*
+** Type definitions - statistics, always maintained (cumulative since reset)
+** Published in shared memory, such that they may be monitored without disturbing the threads maintaining them.
+*/
+typedef struct
+{
+	/* Layout identification (STATS_MAGIC, STATS_VERSION and sizeof(STATS_t)), magic being set last */
+	_Atomic uint32_t magic;
+	uint32_t version;
+	uint32_t size;
+
+	/* Publishing process */
+	uint32_t pid;
+
+	/* Time of reset (uS, monotonic) */
+	uint64_t start_time;
+
+	/* Counters and histograms */
+	STATS_Group_t group[STATS_GROUPS];
+	STATS_Histogram_t histogram[STATS_HISTOGRAMS];
+
+} STATS_t;
+
+/* Create statistics, published in shared memory (or private should it be unavailable), returning NULL on failure */
+STATS_t *STATS_Open(void);
+
+/* Destroy statistics, unpublishing them */
+void STATS_Close(STATS_t *stats);
+
+/* Attach to statistics published by another process, read only, returning NULL on failure */
+const STATS_t *STATS_Attach(void);
+
+/* Reset statistics */
+void STATS_Reset(STATS_t *stats);
+
+/* Add to counter (SDR_IP_GADGET_STAT_*) */
+static inline void STATS_Add(STATS_t *stats, uint16_t stat, uint64_t value)
+{
+	atomic_fetch_add_explicit(&stats->group[stat >> 8].counter[stat & 0xFF], value, memory_order_relaxed);
+}
+
+/* Increment counter (SDR_IP_GADGET_STAT_*) */
+static inline void STATS_Inc(STATS_t *stats, uint16_t stat)
+{
+	STATS_Add(stats, stat, 1);
+}
+
+/* Raise counter (SDR_IP_GADGET_STAT_*) to value, should it be lower (its group's thread alone updating it) */
+static inline void STATS_Max(STATS_t *stats, uint16_t stat, uint64_t value)
+{
+	_Atomic uint64_t *counter = &stats->group[stat >> 8].counter[stat & 0xFF];
+	if (value > atomic_load_explicit(counter, memory_order_relaxed))
+	{
+		atomic_store_explicit(counter, value, memory_order_relaxed);
+	}
+}
+
+/* Record time (uS) in histogram (STATS_HISTOGRAM_*), its thread alone updating it */
+static inline void STATS_Record(STATS_t *stats, unsigned int histogram, uint64_t value)
+{
+	STATS_Histogram_t *hist = &stats->histogram[histogram];
+
+	/* Mark update in progress, ordering it before the update that follows */
+	uint32_t sequence = atomic_load_explicit(&hist->sequence, memory_order_relaxed);
+	atomic_store_explicit(&hist->sequence, sequence + 1U, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	UTILS_RecordHistogram(&hist->histogram, value);
+
+	/* Mark update complete */
+	atomic_store_explicit(&hist->sequence, sequence + 2U, memory_order_release);
+}
+
+/*
+** Record duration (uS) in total counter (SDR_IP_GADGET_STAT_*_US), raising the maximum counter following it, and in
+** histogram (STATS_HISTOGRAM_*)
+*/
+static inline void STATS_Duration(STATS_t *stats, uint16_t stat, unsigned int histogram, uint64_t duration)
+{
+	STATS_Add(stats, stat, duration);
+	STATS_Max(stats, stat + 1, duration);
+	STATS_Record(stats, histogram, duration);
+}
+
+/* Set counter (SDR_IP_GADGET_STAT_*), for levels */
+void STATS_Set(STATS_t *stats, uint16_t stat, uint64_t value);
+
+/* Retrieve counter (SDR_IP_GADGET_STAT_*) */
+uint64_t STATS_Get(const STATS_t *stats, uint16_t stat);
+
+/* Retrieve consistent copy of histogram (STATS_HISTOGRAM_*) */
+void STATS_GetHistogram(const STATS_t *stats, unsigned int histogram, UTILS_Histogram_t *copy);
+
+/* Retrieve number of counters defined in group */
+unsigned int STATS_GroupCounters(unsigned int group);
+
+/* Retrieve name of counter (SDR_IP_GADGET_STAT_*) or histogram (STATS_HISTOGRAM_*) */
+const char *STATS_Name(uint16_t stat);
+const char *STATS_HistogramName(unsigned int histogram);
+
+/* Check whether counter (SDR_IP_GADGET_STAT_*) is a level or maximum, rather than a running total */
+bool STATS_IsLevel(uint16_t stat);
+
+/* Take snapshot of group's counters (STATS_GROUP_SIZE of them), for STATS_Since() */
+void STATS_Snapshot(const STATS_t *stats, unsigned int group, uint64_t *snapshot);
+
+/* Retrieve increase in counter (SDR_IP_GADGET_STAT_*) since snapshot of its group */
+uint64_t STATS_Since(const STATS_t *stats, uint16_t stat, const uint64_t *snapshot);
+
+/* Encode statistics as TLVs (stat_ip_tlv_t, each followed by its value) into buffer, returning length used */
+size_t STATS_Encode(STATS_t *stats, uint8_t *buffer, size_t size);
+
+#endif
@@ -0,0 +1,244 @@
+/* Standard / system libraries */
+#include <getopt.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Local modules */
+#include "sdr_ip_gadget_types.h"
+#include "stats.h"
+#include "utils.h"
+
+/* Definitions - metric name prefix (Prometheus format) */
+#define METRIC_PREFIX "sdr_ip_gadget_"
+
+/* Private functions */
+static void print_text(const STATS_t *stats, const uint64_t *previous, uint64_t elapsed_us);
+static void print_prometheus(const STATS_t *stats);
+static void snapshot(const STATS_t *stats, uint64_t *counters);
+static void signal_handler(int signum);
+static void print_usage(const char *program_name, FILE *dest);
+
+/* Private variables */
+static volatile sig_atomic_t keep_running = 1;
+
+/* Public functions */
+int main(int argc, char *argv[])
+{
+	/* Long options array, mapping options to their short equivalents */
+	struct option long_options[] = {
+		{"interval", required_argument, NULL, 'i'},
+		{"prometheus", no_argument, NULL, 'p'},
+		{"version", no_argument, NULL, 'v'},
+		{"help", no_argument, NULL, 'h'},
+		{0, 0, 0, 0} // Terminate the options array
+	};
+
+	/* Basic argument parsing */
+	int opt_c;
+	bool err = false;
+	bool prometheus = false;
+	long interval_ms = 0;
+	int opt_index = 0;
+	while ((opt_c = getopt_long(argc, argv, "hi:pv", long_options, &opt_index)) != -1)
+	{
+		switch (opt_c)
+		{
+			case 'i':
+			{
+				interval_ms = strtol(optarg, NULL, 0);
+				if ((interval_ms < 1) || (interval_ms > 3600000))
+				{
+					fprintf(stderr, "Error: Interval must be 1 to 3600000 ms\n");
+					err = true;
+				}
+				break;
+			}
+			case 'p':
+			{
+				prometheus = true;
+				break;
+			}
+			case 'v':
+			{
+				printf("Version %s\n", PROGRAM_VERSION);
+				return 0;
+			}
+			case 'h':
+			{
+				print_usage(argv[0], stdout);
+				return 0;
+			}
+			case '?':
+			default:
+			{
+				err = true;
+				break;
+			}
+		}
+	}
+	if (err)
+	{
+		print_usage(argv[0], stderr);
+		return 1;
+	}
+
+	/* Attach to daemon's statistics */
+	const STATS_t *stats = STATS_Attach();
+	if (!stats)
+	{
+		return 1;
+	}
+
+	/* Register signal handler, such that repeated sampling may be interrupted */
+	signal(SIGINT, signal_handler);
+	signal(SIGTERM, signal_handler);
+
+	/* Sample statistics, once or each interval (reading memory alone, the daemon is undisturbed) */
+	uint64_t previous[STATS_GROUPS * STATS_GROUP_SIZE];
+	snapshot(stats, previous);
+	uint64_t previous_time = UTILS_GetMonotonicMicros();
+	do
+	{
+		if (interval_ms > 0)
+		{
+			struct timespec delay = { .tv_sec = interval_ms / 1000, .tv_nsec = (interval_ms % 1000) * 1000000L };
+			nanosleep(&delay, NULL);
+		}
+		if (!keep_running)
+		{
+			break;
+		}
+
+		uint64_t now = UTILS_GetMonotonicMicros();
+		if (prometheus)
+		{
+			print_prometheus(stats);
+		}
+		else
+		{
+			print_text(stats, (interval_ms > 0) ? previous : NULL, now - previous_time);
+		}
+		fflush(stdout);
+
+		snapshot(stats, previous);
+		previous_time = now;
+	} while ((interval_ms > 0) && keep_running);
+
+	return 0;
+}
+
+/* Private functions */
+static void print_text(const STATS_t *stats, const uint64_t *previous, uint64_t elapsed_us)
+{
+	printf("sdr_ip_gadget (pid %"PRIu32"), up %"PRIu64" s\n",
+		   stats->pid,
+		   (UTILS_GetMonotonicMicros() - stats->start_time) / 1000000U);
+
+	/* Counters, with rate since previous sample when repeating */
+	for (unsigned int group = 0; group < STATS_GROUPS; group++)
+	{
+		for (unsigned int i = 0; i < STATS_GroupCounters(group); i++)
+		{
+			uint16_t stat = (uint16_t)((group << 8) | i);
+			if (SDR_IP_GADGET_STAT_UPTIME_US == stat)
+			{
+				/* Only updated on request, reported above */
+				continue;
+			}
+
+			uint64_t value = STATS_Get(stats, stat);
+			printf("  %-24s %20"PRIu64, STATS_Name(stat), value);
+			if (previous && !STATS_IsLevel(stat) && (elapsed_us > 0))
+			{
+				printf("  %"PRIu64"/s", ((value - previous[(group * STATS_GROUP_SIZE) + i]) * 1000000U) / elapsed_us);
+			}
+			printf("\n");
+		}
+	}
+
+	/* Histograms, since daemon started */
+	for (unsigned int i = 0; i < STATS_HISTOGRAMS; i++)
+	{
+		UTILS_Histogram_t hist;
+		char summary[UTILS_HISTOGRAM_SUMMARY_SIZE];
+		STATS_GetHistogram(stats, i, &hist);
+		printf("  %-24s count: %"PRIu64", %s (uS)\n", STATS_HistogramName(i), hist.count, UTILS_FormatHistogram(&hist, summary));
+	}
+	printf("\n");
+}
+
+static void print_prometheus(const STATS_t *stats)
+{
+	printf("# TYPE "METRIC_PREFIX"uptime_seconds gauge\n");
+	printf(METRIC_PREFIX"uptime_seconds %"PRIu64"\n", (UTILS_GetMonotonicMicros() - stats->start_time) / 1000000U);
+
+	/* Counters, levels and maxima being gauges */
+	for (unsigned int group = 0; group < STATS_GROUPS; group++)
+	{
+		for (unsigned int i = 0; i < STATS_GroupCounters(group); i++)
+		{
+			uint16_t stat = (uint16_t)((group << 8) | i);
+			if (SDR_IP_GADGET_STAT_UPTIME_US == stat)
+			{
+				continue;
+			}
+
+			const char *name = STATS_Name(stat);
+			bool level = STATS_IsLevel(stat);
+			printf("# TYPE "METRIC_PREFIX"%s%s %s\n", name, level ? "" : "_total", level ? "gauge" : "counter");
+			printf(METRIC_PREFIX"%s%s %"PRIu64"\n", name, level ? "" : "_total", STATS_Get(stats, stat));
+		}
+	}
+
+	/* Histograms as summaries */
+	static const unsigned int quantiles[] = { 500, 990, 999 };
+	for (unsigned int i = 0; i < STATS_HISTOGRAMS; i++)
+	{
+		UTILS_Histogram_t hist;
+		STATS_GetHistogram(stats, i, &hist);
+		const char *name = STATS_HistogramName(i);
+		printf("# TYPE "METRIC_PREFIX"%s summary\n", name);
+		for (unsigned int q = 0; q < (sizeof(quantiles) / sizeof(quantiles[0])); q++)
+		{
+			printf(METRIC_PREFIX"%s{quantile=\"%u.%03u\"} %"PRIu64"\n",
+				   name,
+				   quantiles[q] / 1000U,
+				   quantiles[q] % 1000U,
+				   UTILS_CalcPercentileHistogram(&hist, quantiles[q]));
+		}
+		printf(METRIC_PREFIX"%s_sum %"PRIu64"\n", name, hist.total);
+		printf(METRIC_PREFIX"%s_count %"PRIu64"\n", name, hist.count);
+	}
+}
+
+static void snapshot(const STATS_t *stats, uint64_t *counters)
+{
+	for (unsigned int group = 0; group < STATS_GROUPS; group++)
+	{
+		STATS_Snapshot(stats, group, &counters[group * STATS_GROUP_SIZE]);
+	}
+}
+
+static void signal_handler(int signum)
+{
+	(void)signum;
+
+	/* Clear running flag */
+	keep_running = 0;
+}
+
+static void print_usage(const char *program_name, FILE *dest)
+{
+	fprintf(dest, "Usage: %s [OPTIONS]\n", program_name);
+	fprintf(dest, "Display statistics published by a running sdr_ip_gadget, without disturbing it\n");
+	fprintf(dest, "OPTIONS:\n");
+	fprintf(dest, "  -h, --help\tDisplay this help message\n");
+	fprintf(dest, "  -i, --interval MS\tSample every MS milliseconds (with rates) rather than once\n");
+	fprintf(dest, "  -p, --prometheus\tOutput in Prometheus text exposition format\n");
+	fprintf(dest, "  -v, --version\tDisplay the version of the program\n");
+}
@@ -0,0 +1,1081 @@
+/* Use non portable functions */
+#define _GNU_SOURCE
+
+/* Public header */
+#include "thread_push.h"
+
+/* Standard / system libraries */
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Local modules */
+#include "sdr_ip_gadget_types.h"
+#include "epoll_loop.h"
+#include "iio_backend.h"
+#include "perf.h"
+#include "rt_tune.h"
+#include "stats.h"
+#include "trace.h"
+#include "utils.h"
+
+/* Set the following to periodically report statistics */
+#ifndef GENERATE_STATS
+#define GENERATE_STATS (0)
+#endif
+
+/* Set stats period */
+#ifndef STATS_PERIOD_SECS
+#define STATS_PERIOD_SECS (5)
+#endif
+
+/* Macros */
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+#define DEBUG_PRINT(...) if (debug) printf("Push: "__VA_ARGS__)
+#define COUNT(state, stat) STATS_Inc((state)->thread_args->stats, SDR_IP_GADGET_STAT_PUSH_##stat)
+#define DROP(state, stat) (COUNT(state, stat), TRACE_Record(TRACE_EVENT_DROP, SDR_IP_GADGET_STAT_PUSH_##stat, TRACE_Now()))
+
+/* Definitions - age beyond which the RX thread's sample clock anchor is considered stale (uS) */
+#define CLOCK_MAX_AGE_US (1000000U)
+
+/* Definitions - timeout waiting for buffers to be queued (mS) */
+#define IDLE_TIMEOUT_MS (30000)
+
+/* Type definitions */
+typedef struct
+{
+	/* Thread args */
+	THREAD_PUSH_Args_t *thread_args;
+
+	/* Keep running */
+	bool keep_running;
+
+	/* DAC is being fed continuously (jitter buffer has reached target depth at least once) */
+	bool started;
+
+	/* Jitter buffer currently at or above target depth */
+	bool primed;
+
+	/* Sequence number / timestamp of next buffer to be pushed */
+	uint64_t playout_seqno;
+
+	/* Size of buffers being pushed (bytes, including timestamp) and samples (excluding timestamp), following the ring's */
+	size_t iio_buffer_size;
+	size_t buffer_size_samples;
+
+	/* Cyclic buffer has been loaded with a waveform */
+	bool cyclic_loaded;
+
+	/* Sample clock estimate, anchored at first release, used while the RX thread isn't providing hardware time */
+	SAMPLE_CLOCK_t local_clock;
+
+	/* Monotonic time (uS) until which early buffer at head of ring is held (zero if not held) */
+	uint64_t hold_until;
+
+	#if GENERATE_STATS
+	/* Stats reporting timer */
+	int stats_timerfd;
+
+	/* Counters (buffers, overflows etc, maintained regardless of stats) at last report */
+	uint64_t reported[STATS_GROUP_SIZE];
+
+	/* Jitter buffer fill level (sampled at each push) */
+	size_t jitter_fill_min;
+	size_t jitter_fill_max;
+	size_t jitter_fill_total;
+	uint32_t jitter_fill_count;
+
+	/* Queue latency (time from buffer being queued to it being pushed) */
+	UTILS_Histogram_t queue_latency;
+
+	/* Write period timer */
+	UTILS_Histogram_t write_period;
+
+	/* Write duration timer */
+	UTILS_Histogram_t write_dur;
+
+	/* Write period and duration over whole stream (periods being merged as they're reported) */
+	UTILS_Histogram_t stream_period;
+	UTILS_Histogram_t stream_dur;
+
+	/* Waveforms loaded (cyclic mode) */
+	uint32_t waveforms;
+
+	/* Generation duration timer (waveform generator) */
+	UTILS_Histogram_t generate_dur;
+
+	/* Interpolation duration timer */
+	UTILS_Histogram_t interp_dur;
+
+	/* Waveform replacement duration timer (cyclic mode, time DAC is silent) */
+	UTILS_Histogram_t replace_dur;
+
+	/* Burst latency (time from final datagram of burst being received to its buffer being submitted to the DMA) */
+	UTILS_Histogram_t burst_latency;
+
+	/* Scheduling counters at last report */
+	RT_TUNE_ThreadStats_t sched_stats;
+
+	/* Hardware counters, with those of pushing buffers (waiting for, filling and submitting blocks) since last report */
+	PERF_t perf;
+	PERF_Stage_t perf_push;
+
+	/* Timed release, early buffers held and lateness of late ones (uS) */
+	uint32_t early_holds;
+	UTILS_Histogram_t lateness;
+
+	/* First buffer of stream pushed (start latency reported) */
+	bool first_pushed;
+	#endif
+
+} state_t;
+
+/* Epoll event handler */
+typedef int (*epoll_event_handler)(state_t *state);
+
+/* Global variables */
+extern bool debug;
+
+/* Private functions */
+static int handle_eventfd_thread(state_t *state);
+static int handle_eventfd_ready(state_t *state);
+static bool can_push(state_t *state);
+static int wait_timeout(state_t *state);
+static int push_next(state_t *state);
+static bool release_check(state_t *state, size_t *truncate);
+static uint64_t clock_now(state_t *state, uint64_t micros, uint64_t seqno);
+static void follow_geometry(state_t *state, const BUFFER_RING_Slot_t *slot);
+static int push_cyclic(state_t *state);
+static int push_generated(state_t *state);
+#if GENERATE_STATS
+static void report_first_push(state_t *state);
+static int handle_stats_timer(state_t *state);
+#endif
+
+/* Public functions */
+void *THREAD_PUSH_Entrypoint(void *args)
+{
+	THREAD_PUSH_Args_t *thread_args = (THREAD_PUSH_Args_t*)args;
+
+	/* Enter */
+	DEBUG_PRINT("Push thread enter (tid: %ld)\n", syscall(SYS_gettid));
+
+	/* Set name, priority and CPU affinity */
+	pthread_setname_np(pthread_self(), "IP_SDR_GAD_PU");
+	RT_TUNE_ApplyThread(RT_TUNE_ROLE_PUSH, 0);
+	TRACE_Register(thread_args->trace, "IP_SDR_GAD_PU");
+
+	/* Reset state */
+	state_t state;
+	memset(&state, 0x00, sizeof(state));
+
+	/* Store args */
+	state.thread_args = thread_args;
+	state.iio_buffer_size = thread_args->iio_buffer_size;
+	state.buffer_size_samples = thread_args->buffer_size_samples;
+	SAMPLE_CLOCK_Reset(&state.local_clock);
+
+	/* Create epoll instance */
+	int epoll_fd = epoll_create1(0);
+	if (epoll_fd < 0)
+	{
+		perror("Failed to create epoll instance");
+		return NULL;
+	}
+	else
+	{
+		DEBUG_PRINT("Opened epoll :-)\n");
+	}
+
+	struct epoll_event epoll_event;
+
+	/* Register thread quit eventfd with epoll */
+	epoll_event.events = EPOLLIN;
+	epoll_event.data.ptr = handle_eventfd_thread;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, thread_args->quit_event_fd, &epoll_event) < 0)
+	{
+		perror("Failed to register thread quit eventfd with epoll");
+		return NULL;
+	}
+	else
+	{
+		DEBUG_PRINT("Registered thread quit eventfd with with epoll :-)\n");
+	}
+
+	/* Register buffer ready eventfd with epoll */
+	epoll_event.events = EPOLLIN;
+	epoll_event.data.ptr = handle_eventfd_ready;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, thread_args->ready_event_fd, &epoll_event) < 0)
+	{
+		perror("Failed to register buffer ready eventfd with epoll");
+		return NULL;
+	}
+	else
+	{
+		DEBUG_PRINT("Registered buffer ready eventfd with with epoll :-)\n");
+	}
+
+	#if GENERATE_STATS
+	/* Create stats reporting timer */
+	state.stats_timerfd = timerfd_create(CLOCK_MONOTONIC, 0);
+	if (state.stats_timerfd < 0)
+	{
+		perror("Failed to open timerfd");
+		return NULL;
+	}
+	else
+	{
+		DEBUG_PRINT("Opened timerfd :-)\n");
+	}
+	struct itimerspec timer_period =
+	{
+		.it_value = { .tv_sec = STATS_PERIOD_SECS, .tv_nsec = 0 },
+		.it_interval = { .tv_sec = STATS_PERIOD_SECS, .tv_nsec = 0 }
+	};
+	if (timerfd_settime(state.stats_timerfd, 0, &timer_period, NULL) < 0)
+	{
+		perror("Failed to set timerfd");
+		return NULL;
+	}
+	else
+	{
+		DEBUG_PRINT("Set timerfd :-)\n");
+	}
+
+	/* Register timer with epoll */
+	epoll_event.events = EPOLLIN;
+	epoll_event.data.ptr = handle_stats_timer;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, state.stats_timerfd, &epoll_event) < 0)
+	{
+		/* Failed to register timer with epoll */
+		perror("Failed to register timer eventfd with epoll");
+		return NULL;
+	}
+	else
+	{
+		DEBUG_PRINT("Registered timer with with epoll :-)\n");
+	}
+
+	/* Init timers */
+	UTILS_ResetHistogram(&state.queue_latency);
+	UTILS_ResetHistogram(&state.write_period);
+	UTILS_ResetHistogram(&state.write_dur);
+	UTILS_ResetHistogram(&state.stream_period);
+	UTILS_ResetHistogram(&state.stream_dur);
+	UTILS_ResetHistogram(&state.replace_dur);
+	UTILS_ResetHistogram(&state.generate_dur);
+	UTILS_ResetHistogram(&state.interp_dur);
+	UTILS_ResetHistogram(&state.burst_latency);
+	UTILS_ResetHistogram(&state.lateness);
+	RT_TUNE_GetThreadStats(&state.sched_stats);
+	PERF_Open(&state.perf);
+	PERF_ResetStage(&state.perf_push);
+	STATS_Snapshot(thread_args->stats, SDR_IP_GADGET_STAT_PUSH_BUFFERS >> 8, state.reported);
+	state.jitter_fill_min = SIZE_MAX;
+	#endif
+
+	/* Enter main loop */
+	DEBUG_PRINT("Enter push loop..\n");
+	state.keep_running = true;
+	while (state.keep_running)
+	{
+		/* Poll for events if there's something to push, otherwise wait for the reassembly thread */
+		bool ready = can_push(&state);
+		if (EPOLL_LOOP_RunPolled(epoll_fd, ready ? 0 : wait_timeout(&state), ready ? 0 : thread_args->busy_poll_us, &state) < 0)
+		{
+			/* Epoll failed...bail */
+			break;
+		}
+
+		/* Push next buffer (paced by the DMA freeing blocks) */
+		if (ready && state.keep_running && (push_next(&state) < 0))
+		{
+			break;
+		}
+	}
+	DEBUG_PRINT("Exit push loop..\n");
+
+	#if GENERATE_STATS
+	/* Report write period and duration over whole stream, revealing outliers of the rarest periods */
+	UTILS_MergeHistogram(&state.stream_period, &state.write_period);
+	UTILS_MergeHistogram(&state.stream_dur, &state.write_dur);
+	if (state.stream_period.count > 0)
+	{
+		char summary[UTILS_HISTOGRAM_SUMMARY_SIZE];
+		printf("Write stream period: %s (uS)\n", UTILS_FormatHistogram(&state.stream_period, summary));
+		printf("Write stream dur: %s (uS)\n", UTILS_FormatHistogram(&state.stream_dur, summary));
+	}
+	#endif
+
+	/* Close / destroy everything */
+	#if GENERATE_STATS
+	close(state.stats_timerfd);
+	PERF_Close(&state.perf);
+	#endif
+	close(epoll_fd);
+
+	/* Exit */
+	DEBUG_PRINT("Push thread exit\n");
+
+	return NULL;
+}
+
+/* Private functions */
+static int handle_eventfd_thread(state_t *state)
+{
+	/* Quit having detected write on eventfd */
+	DEBUG_PRINT("Stop request received\n");
+	state->keep_running = false;
+
+	return 0;
+}
+
+static int handle_eventfd_ready(state_t *state)
+{
+	/* Read eventfd to acknowledge it, the ring itself tells us how many buffers are waiting */
+	uint64_t eventfd_val;
+	if (read(state->thread_args->ready_event_fd, &eventfd_val, sizeof(eventfd_val)) < 0)
+	{
+		perror("Failed to read buffer ready eventfd");
+		return -1;
+	}
+
+	return 0;
+}
+
+static bool can_push(state_t *state)
+{
+	size_t count = BUFFER_RING_Count(state->thread_args->ring);
+
+	if (state->thread_args->wavegen)
+	{
+		/* Generator never runs dry */
+		return true;
+	}
+
+	if (	(state->hold_until > 0)
+		 && !state->started
+		 && (UTILS_GetMonotonicMicros() < state->hold_until)
+	   )
+	{
+		/* Early buffer held until within release horizon */
+		return false;
+	}
+
+	if (state->started)
+	{
+		/* DAC is being fed, pushing zero buffers should we run dry */
+		return true;
+	}
+
+	if (0 == state->thread_args->jitter_target)
+	{
+		/* No jitter buffer, push whatever is waiting */
+		return (count > 0);
+	}
+
+	/* Wait for jitter buffer to reach target depth */
+	return (count >= state->thread_args->jitter_target);
+}
+
+static int wait_timeout(state_t *state)
+{
+	if (state->hold_until > 0)
+	{
+		/* Wake once held buffer is within release horizon (rounding up) */
+		uint64_t micros = UTILS_GetMonotonicMicros();
+		uint64_t remaining_ms = (state->hold_until > micros) ? (((state->hold_until - micros) + 999U) / 1000U) : 0;
+		return (remaining_ms < IDLE_TIMEOUT_MS) ? (int)remaining_ms : IDLE_TIMEOUT_MS;
+	}
+
+	return IDLE_TIMEOUT_MS;
+}
+
+static int push_next(state_t *state)
+{
+	THREAD_PUSH_Args_t *args = state->thread_args;
+
+	if (args->wavegen)
+	{
+		/* Generate rather than streaming */
+		return push_generated(state);
+	}
+
+	/* Discard buffers abandoned by the reassembly thread */
+	BUFFER_RING_Slot_t *head;
+	while ((NULL != (head = BUFFER_RING_ReadSlot(args->ring))) && !head->valid)
+	{
+		BUFFER_RING_Release(args->ring);
+	}
+
+	size_t count = BUFFER_RING_Count(args->ring);
+	if (!state->started && ((0 == count) || (count < args->jitter_target)))
+	{
+		/* Nothing left to push */
+		return 0;
+	}
+
+	if (args->cyclic)
+	{
+		/* Load waveform rather than streaming */
+		return push_cyclic(state);
+	}
+
+	/* Hold early buffers and drop / truncate late ones, against the hardware sample clock */
+	size_t truncate = 0;
+	bool held = false;
+	if (args->release_horizon > 0)
+	{
+		held = !release_check(state, &truncate);
+		count = BUFFER_RING_Count(args->ring);
+		if (!state->started && (held || (0 == count) || (count < args->jitter_target)))
+		{
+			/* Nothing to release yet */
+			return 0;
+		}
+	}
+
+	if (args->jitter_target > 0)
+	{
+		if (!state->started)
+		{
+			/* Target depth reached for the first time, start feeding the DAC */
+			DEBUG_PRINT("Jitter buffer primed with %zu buffers\n", count);
+			state->playout_seqno = BUFFER_RING_ReadSlot(args->ring)->seqno;
+			state->started = true;
+			atomic_store_explicit(&args->started, true, memory_order_relaxed);
+		}
+
+		#if GENERATE_STATS
+		/* Sample fill level */
+		if (count < state->jitter_fill_min)
+		{
+			/* New lowest */
+			state->jitter_fill_min = count;
+		}
+		if (count > state->jitter_fill_max)
+		{
+			/* New highest */
+			state->jitter_fill_max = count;
+		}
+		state->jitter_fill_total += count;
+		state->jitter_fill_count++;
+		#endif
+
+		/* Re-prime having run dry, such that the target latency is restored */
+		if (0 == count)
+		{
+			state->primed = false;
+		}
+		else if (count >= args->jitter_target)
+		{
+			state->primed = true;
+		}
+	}
+	else
+	{
+		/* Without a jitter buffer we're only called with buffers waiting */
+		state->primed = true;
+	}
+
+	#if GENERATE_STATS
+	/* Record counters at start of push */
+	PERF_Begin(&state->perf);
+	#endif
+
+	/* Dequeue free block (waiting for the DMA to finish with it) */
+	uint64_t refill_start = UTILS_GetMonotonicMicros();
+	TRACE_Record(TRACE_EVENT_PUSH_REFILL_BEGIN, 0, refill_start);
+	uint8_t *buffer = IIO_BACKEND_Dequeue(args->iio_tx_buffer);
+	uint64_t refill_end = UTILS_GetMonotonicMicros();
+	TRACE_Record(TRACE_EVENT_PUSH_REFILL_END, 0, refill_end);
+	if (!buffer)
+	{
+		return -1;
+	}
+	STATS_Duration(args->stats, SDR_IP_GADGET_STAT_PUSH_REFILL_US, STATS_HISTOGRAM_PUSH_REFILL, refill_end - refill_start);
+
+	/* Loopback marker of buffer pushed (time zero unless marked) */
+	uint64_t marker_time = 0;
+	uint64_t marker_commit_time = 0;
+	uint64_t marker_seqno = 0;
+
+	/* End of burst of buffer pushed (time zero unless it ends one) */
+	uint64_t burst_time = 0;
+
+	if (state->primed && !held)
+	{
+		/* Copy oldest buffer from ring */
+		BUFFER_RING_Slot_t *slot = BUFFER_RING_ReadSlot(args->ring);
+		follow_geometry(state, slot);
+		if (args->interp)
+		{
+			/* Interpolate into block, restarting the filter should the buffer not follow the last */
+			size_t header = args->timestamping_enabled ? sizeof(uint64_t) : 0;
+			if (slot->seqno != state->playout_seqno)
+			{
+				INTERP_Reset(args->interp);
+			}
+
+			#if GENERATE_STATS
+			uint64_t interp_start = UTILS_GetMonotonicMicros();
+			#endif
+
+			INTERP_Process(args->interp,
+						   buffer + header,
+						   slot->data + header,
+						   state->buffer_size_samples / args->interp->factor);
+
+			#if GENERATE_STATS
+			UTILS_RecordHistogram(&state->interp_dur, UTILS_GetMonotonicMicros() - interp_start);
+			#endif
+
+			/* Keep only samples yet to be due, timestamped accordingly */
+			if (args->timestamping_enabled)
+			{
+				*((uint64_t*)buffer) = slot->seqno + truncate;
+			}
+			if (truncate > 0)
+			{
+				size_t skip = truncate * args->sample_size;
+				memmove(buffer + header, buffer + header + skip, state->iio_buffer_size - header - skip);
+			}
+		}
+		else if (truncate > 0)
+		{
+			/* Keep only samples yet to be due, timestamped accordingly */
+			size_t skip = sizeof(uint64_t) + (truncate * args->sample_size);
+			*((uint64_t*)buffer) = slot->seqno + truncate;
+			memcpy(buffer + sizeof(uint64_t), slot->data + skip, state->iio_buffer_size - skip);
+		}
+		else
+		{
+			memcpy(buffer, slot->data, state->iio_buffer_size);
+		}
+		state->playout_seqno = slot->seqno;
+		marker_time = slot->marker_time;
+		marker_commit_time = slot->commit_time;
+		marker_seqno = slot->seqno;
+
+		burst_time = slot->burst_time;
+
+		#if GENERATE_STATS
+		/* Capture time spent queued */
+		UTILS_RecordHistogram(&state->queue_latency, UTILS_GetMonotonicMicros() - slot->commit_time);
+		#endif
+
+		BUFFER_RING_Release(args->ring);
+	}
+	else
+	{
+		/* Client has fallen behind (or is ahead), insert zero buffer rather than letting the DMA underrun */
+		memset(buffer, 0x00, state->iio_buffer_size);
+		if (args->interp)
+		{
+			INTERP_Reset(args->interp);
+		}
+		if (args->timestamping_enabled)
+		{
+			*((uint64_t*)buffer) = state->playout_seqno;
+		}
+		if (!held)
+		{
+			atomic_fetch_add_explicit(&args->underflows, 1, memory_order_relaxed);
+
+			/* Count zero buffer */
+			DROP(state, UNDERFLOWS);
+		}
+	}
+
+	/* Advance playout sequence number past buffer, sharing it with reassembly thread */
+	atomic_store_explicit(&args->pushed_seqno, state->playout_seqno, memory_order_relaxed);
+	state->playout_seqno += state->buffer_size_samples;
+	atomic_store_explicit(&args->playout_seqno, state->playout_seqno, memory_order_relaxed);
+
+	#if GENERATE_STATS
+	/* Capture write period */
+	UTILS_UpdateHistogram(&state->write_period);
+
+	/* Record write start time */
+	UTILS_StartHistogram(&state->write_dur);
+	#endif
+
+	/* Submit block (less any truncated samples) */
+	uint64_t submit_start = UTILS_GetMonotonicMicros();
+	TRACE_Record(TRACE_EVENT_PUSH_SUBMIT_BEGIN, 0, submit_start);
+	int ret = IIO_BACKEND_EnqueuePartial(args->iio_tx_buffer, state->iio_buffer_size - (truncate * args->sample_size));
+	if ((ret >= 0) && (burst_time > 0))
+	{
+		/* Burst over, its tail mustn't wait for the DMA's backlog to fill */
+		ret = IIO_BACKEND_Flush(args->iio_tx_buffer);
+	}
+	uint64_t submit_end = UTILS_GetMonotonicMicros();
+	TRACE_Record(TRACE_EVENT_PUSH_SUBMIT_END, (uint32_t)(state->buffer_size_samples - truncate), submit_end);
+	if (ret < 0)
+	{
+		/* Count overflow */
+		DROP(state, OVERFLOWS);
+	}
+	STATS_Duration(args->stats, SDR_IP_GADGET_STAT_PUSH_SUBMIT_US, STATS_HISTOGRAM_PUSH_SUBMIT, submit_end - submit_start);
+
+	#if GENERATE_STATS
+	/* Capture counters of push */
+	PERF_End(&state->perf, &state->perf_push);
+	#endif
+
+	/* Arm loopback probe with marked buffer, the RX thread searching for its arrival */
+	if ((marker_time > 0) && args->loopback)
+	{
+		LOOPBACK_Arm(args->loopback, marker_seqno, marker_time, marker_commit_time, UTILS_GetMonotonicMicros());
+	}
+
+	/* Count buffer */
+	COUNT(state, BUFFERS);
+
+	#if GENERATE_STATS
+	/* Capture latency from end of burst */
+	report_first_push(state);
+	if (burst_time > 0)
+	{
+		UTILS_RecordHistogram(&state->burst_latency, UTILS_GetMonotonicMicros() - burst_time);
+	}
+	#endif
+
+	#if GENERATE_STATS
+	/* Capture write end time */
+	UTILS_UpdateHistogram(&state->write_dur);
+
+	/* Record period start time (to subtract write time above) */
+	UTILS_StartHistogram(&state->write_period);
+	#endif
+
+	return 0;
+}
+
+static bool release_check(state_t *state, size_t *truncate)
+{
+	THREAD_PUSH_Args_t *args = state->thread_args;
+	BUFFER_RING_Slot_t *head;
+
+	#if GENERATE_STATS
+	bool was_held = (state->hold_until > 0);
+	#endif
+	state->hold_until = 0;
+	*truncate = 0;
+
+	while (NULL != (head = BUFFER_RING_ReadSlot(args->ring)))
+	{
+		if (!head->valid)
+		{
+			/* Discard buffer abandoned by the reassembly thread */
+			BUFFER_RING_Release(args->ring);
+			continue;
+		}
+		follow_geometry(state, head);
+
+		uint64_t micros = UTILS_GetMonotonicMicros();
+		uint64_t now = clock_now(state, micros, head->seqno);
+		if (head->seqno >= now)
+		{
+			uint64_t lead = head->seqno - now;
+			if (lead <= args->release_horizon)
+			{
+				/* Due within horizon, release */
+				return true;
+			}
+
+			/* Early, hold until within horizon */
+			state->hold_until = micros + (((lead - args->release_horizon) * 1000000U) / (uint64_t)args->sample_rate);
+
+			#if GENERATE_STATS
+			/* Count buffer held */
+			if (!was_held)
+			{
+				/* First hold of buffer */
+				state->early_holds++;
+			}
+			#endif
+
+			return false;
+		}
+
+		/* Late */
+		uint64_t lateness = now - head->seqno;
+
+		#if GENERATE_STATS
+		/* Record lateness (in uS) */
+		UTILS_RecordHistogram(&state->lateness, (lateness * 1000000U) / (uint64_t)args->sample_rate);
+		#endif
+
+		if (SDR_IP_GADGET_LATE_POLICY_PUSH == args->late_policy)
+		{
+			/* Push regardless */
+			return true;
+		}
+
+		if (	(SDR_IP_GADGET_LATE_POLICY_TRUNCATE == args->late_policy)
+			 && (lateness < state->buffer_size_samples)
+		   )
+		{
+			/* Push only samples yet to be due */
+			*truncate = (size_t)lateness;
+
+			/* Count buffer truncated */
+			DROP(state, LATE_TRUNCATED);
+
+			return true;
+		}
+
+		/* Drop buffer, such that stale data doesn't hold up fresh data behind it */
+		BUFFER_RING_Release(args->ring);
+
+		/* Count buffer dropped */
+		DROP(state, LATE_DROPPED);
+	}
+
+	/* Ring empty */
+	return true;
+}
+
+static uint64_t clock_now(state_t *state, uint64_t micros, uint64_t seqno)
+{
+	THREAD_PUSH_Args_t *args = state->thread_args;
+	uint64_t now;
+
+	/* Prefer hardware time, from timestamps of the RX stream */
+	if (	(args->sample_clock)
+		 && SAMPLE_CLOCK_Now(args->sample_clock, args->sample_rate, micros, CLOCK_MAX_AGE_US, &now)
+	   )
+	{
+		return now;
+	}
+
+	/* Otherwise extrapolate from first release, the buffer being released now being taken as due */
+	if (!SAMPLE_CLOCK_Now(&state->local_clock, args->sample_rate, micros, UINT64_MAX, &now))
+	{
+		DEBUG_PRINT("Sample clock anchored at %"PRIu64"\n", seqno);
+		SAMPLE_CLOCK_Anchor(&state->local_clock, seqno, micros);
+		now = seqno;
+	}
+
+	return now;
+}
+
+static void follow_geometry(state_t *state, const BUFFER_RING_Slot_t *slot)
+{
+	/* Buffers queued after a reconfiguration differ in size, those before it having been pushed at their own */
+	if (slot->samples != state->buffer_size_samples)
+	{
+		DEBUG_PRINT("Buffer size now %zu samples\n", slot->samples);
+		state->iio_buffer_size = slot->size;
+		state->buffer_size_samples = slot->samples;
+	}
+}
+
+static int push_generated(state_t *state)
+{
+	THREAD_PUSH_Args_t *args = state->thread_args;
+
+	#if GENERATE_STATS
+	/* Record counters at start of push */
+	PERF_Begin(&state->perf);
+	#endif
+
+	/* Dequeue free block (waiting for the DMA to finish with it) */
+	uint64_t refill_start = UTILS_GetMonotonicMicros();
+	TRACE_Record(TRACE_EVENT_PUSH_REFILL_BEGIN, 0, refill_start);
+	uint8_t *buffer = IIO_BACKEND_Dequeue(args->iio_tx_buffer);
+	uint64_t refill_end = UTILS_GetMonotonicMicros();
+	TRACE_Record(TRACE_EVENT_PUSH_REFILL_END, 0, refill_end);
+	if (!buffer)
+	{
+		return -1;
+	}
+	STATS_Duration(args->stats, SDR_IP_GADGET_STAT_PUSH_REFILL_US, STATS_HISTOGRAM_PUSH_REFILL, refill_end - refill_start);
+
+	#if GENERATE_STATS
+	/* Record generation start time */
+	UTILS_StartHistogram(&state->generate_dur);
+	#endif
+
+	/* Synthesise directly into block */
+	WAVEGEN_Fill(args->wavegen, buffer, args->iio_buffer_size / (args->channel_pairs * 2 * sizeof(int16_t)), args->channel_pairs);
+
+	#if GENERATE_STATS
+	/* Capture generation duration and write period */
+	UTILS_UpdateHistogram(&state->generate_dur);
+	UTILS_UpdateHistogram(&state->write_period);
+
+	/* Record write start time */
+	UTILS_StartHistogram(&state->write_dur);
+	#endif
+
+	/* Submit block */
+	uint64_t submit_start = UTILS_GetMonotonicMicros();
+	TRACE_Record(TRACE_EVENT_PUSH_SUBMIT_BEGIN, 0, submit_start);
+	int ret = IIO_BACKEND_Enqueue(args->iio_tx_buffer);
+	uint64_t submit_end = UTILS_GetMonotonicMicros();
+	TRACE_Record(TRACE_EVENT_PUSH_SUBMIT_END, (uint32_t)args->buffer_size_samples, submit_end);
+	if (ret < 0)
+	{
+		/* Count overflow */
+		DROP(state, OVERFLOWS);
+	}
+	STATS_Duration(args->stats, SDR_IP_GADGET_STAT_PUSH_SUBMIT_US, STATS_HISTOGRAM_PUSH_SUBMIT, submit_end - submit_start);
+
+	#if GENERATE_STATS
+	/* Capture counters of push */
+	PERF_End(&state->perf, &state->perf_push);
+	#endif
+
+	/* Count buffer */
+	COUNT(state, BUFFERS);
+
+	#if GENERATE_STATS
+	/* Capture write end time */
+	UTILS_UpdateHistogram(&state->write_dur);
+	UTILS_StartHistogram(&state->write_period);
+	report_first_push(state);
+	#endif
+
+	return 0;
+}
+
+static int push_cyclic(state_t *state)
+{
+	THREAD_PUSH_Args_t *args = state->thread_args;
+
+	/*
+	** Only the newest complete waveform matters, skip any superseded while we were busy
+	** Abandoned uploads (invalid slots) are skipped too, without discarding a complete waveform queued behind them.
+	*/
+	size_t count = BUFFER_RING_Count(args->ring);
+	size_t newest = count;
+	for (size_t i = count; i-- > 0;)
+	{
+		if (BUFFER_RING_PeekSlot(args->ring, i)->valid)
+		{
+			newest = i;
+			break;
+		}
+	}
+	for (size_t i = 0; i < newest; i++)
+	{
+		BUFFER_RING_Release(args->ring);
+	}
+	if (newest == count)
+	{
+		/* Nothing complete, the DAC keeps repeating any waveform already loaded */
+		return 0;
+	}
+	BUFFER_RING_Slot_t *slot = BUFFER_RING_ReadSlot(args->ring);
+
+	#if GENERATE_STATS
+	uint64_t replace_start = UTILS_GetMonotonicMicros();
+	#endif
+
+	if (state->cyclic_loaded)
+	{
+		/*
+		** A cyclic buffer can't be refilled once pushed and the kernel permits only one buffer per device,
+		** so replace it (the DAC falling silent until the new one is pushed)
+		*/
+		IIO_BACKEND_DestroyBuffer(args->iio_tx_buffer);
+		args->iio_tx_buffer = IIO_BACKEND_CreateBuffer(args->iio_dev,
+													   args->iio_channels,
+													   args->iio_buffer_samples,
+													   0,
+													   true,
+													   true);
+		if (!args->iio_tx_buffer)
+		{
+			fprintf(stderr, "Failed to recreate cyclic tx buffer\n");
+			return -1;
+		}
+	}
+
+	/* Load waveform and hand it to the DAC to be repeated */
+	uint8_t *buffer = IIO_BACKEND_Dequeue(args->iio_tx_buffer);
+	if (!buffer)
+	{
+		return -1;
+	}
+	memcpy(buffer, slot->data, args->iio_buffer_size);
+	atomic_store_explicit(&args->pushed_seqno, slot->seqno, memory_order_relaxed);
+	BUFFER_RING_Release(args->ring);
+	if (IIO_BACKEND_Enqueue(args->iio_tx_buffer) < 0)
+	{
+		fprintf(stderr, "Failed to push cyclic tx buffer\n");
+		return -1;
+	}
+	DEBUG_PRINT("Cyclic waveform %s\n", state->cyclic_loaded ? "replaced" : "loaded");
+
+	#if GENERATE_STATS
+	/* Count waveform and capture time taken to replace it */
+	state->waveforms++;
+	report_first_push(state);
+	if (state->cyclic_loaded)
+	{
+		UTILS_RecordHistogram(&state->replace_dur, UTILS_GetMonotonicMicros() - replace_start);
+	}
+	#endif
+
+	state->cyclic_loaded = true;
+
+	return 0;
+}
+
+#if GENERATE_STATS
+static void report_first_push(state_t *state)
+{
+	/* Report start latency with stream's first buffer reaching the DMA */
+	if (!state->first_pushed)
+	{
+		printf("Write start: first buffer pushed: %"PRIu64" (uS after request)\n",
+			   UTILS_GetMonotonicMicros() - state->thread_args->start_time);
+		state->first_pushed = true;
+	}
+}
+
+static int handle_stats_timer(state_t *state)
+{
+	/* Read timer to acknowledge it */
+	uint64_t timerfd_val;
+	if (read(state->stats_timerfd, &timerfd_val, sizeof(timerfd_val)) < 0)
+	{
+		perror("Failed to read timerfd");
+		return 1;
+	}
+
+	/* Summary of histogram being reported */
+	char summary[UTILS_HISTOGRAM_SUMMARY_SIZE];
+
+	/* Report percentiles of write period */
+	printf("Write period: %s (uS)\n", UTILS_FormatHistogram(&state->write_period, summary));
+
+	/* Report percentiles of write duration */
+	printf("Write dur: %s (uS)\n", UTILS_FormatHistogram(&state->write_dur, summary));
+
+	/* Report percentiles of queue latency */
+	if (state->queue_latency.count > 0)
+	{
+		printf("Write queue: %s (uS)\n", UTILS_FormatHistogram(&state->queue_latency, summary));
+	}
+
+	/* Report percentiles of burst latency */
+	if (state->burst_latency.count > 0)
+	{
+		printf("Write burst latency: %s (uS)\n", UTILS_FormatHistogram(&state->burst_latency, summary));
+	}
+
+	/* Report sustained push rate */
+	STATS_t *stats = state->thread_args->stats;
+	uint64_t pushed = STATS_Since(stats, SDR_IP_GADGET_STAT_PUSH_BUFFERS, state->reported);
+	printf("Write push rate: %"PRIu64" buffers/s, %"PRIu64" samples/s\n",
+		   pushed / STATS_PERIOD_SECS,
+		   (pushed * state->buffer_size_samples) / STATS_PERIOD_SECS);
+
+	/* Report percentiles of generation duration */
+	if (state->generate_dur.count > 0)
+	{
+		printf("Write generate: %s (uS)\n", UTILS_FormatHistogram(&state->generate_dur, summary));
+	}
+
+	/* Report percentiles of interpolation duration, with average per output sample */
+	if (state->interp_dur.count > 0)
+	{
+		printf("Write interpolate: %s (uS), %"PRIu64" (nS per sample)\n",
+			   UTILS_FormatHistogram(&state->interp_dur, summary),
+			   (state->interp_dur.total * 1000U) / ((uint64_t)state->interp_dur.count * state->buffer_size_samples)
+		);
+	}
+
+	/* Report waveforms loaded and time DAC was silent while replacing them */
+	if (state->waveforms > 0)
+	{
+		printf("Write waveforms: %u loaded", state->waveforms);
+		if (state->replace_dur.count > 0)
+		{
+			printf(", replace %s (uS)", UTILS_FormatHistogram(&state->replace_dur, summary));
+		}
+		printf("\n");
+	}
+
+	/* Check for overflows */
+	uint64_t overflows = STATS_Since(stats, SDR_IP_GADGET_STAT_PUSH_OVERFLOWS, state->reported);
+	if (overflows > 0)
+	{
+		printf("Write overflows: %"PRIu64" in last 5s period\n", overflows);
+	}
+
+	if (state->thread_args->release_horizon > 0)
+	{
+		/* Report timed release, with percentiles of lateness */
+		printf("Write release: early held: %u, late dropped: %"PRIu64", late truncated: %"PRIu64"\n",
+			   state->early_holds,
+			   STATS_Since(stats, SDR_IP_GADGET_STAT_PUSH_LATE_DROPPED, state->reported),
+			   STATS_Since(stats, SDR_IP_GADGET_STAT_PUSH_LATE_TRUNCATED, state->reported));
+		if (state->lateness.count > 0)
+		{
+			printf("Write lateness: %s (uS)\n", UTILS_FormatHistogram(&state->lateness, summary));
+		}
+	}
+
+	if (state->thread_args->jitter_target > 0)
+	{
+		/* Report min/max/average jitter buffer fill level */
+		if (state->jitter_fill_count > 0)
+		{
+			printf("Write jitter fill: min: %zu, max: %zu, avg: %zu (buffers)\n",
+				   state->jitter_fill_min,
+				   state->jitter_fill_max,
+				   state->jitter_fill_total / state->jitter_fill_count
+			);
+		}
+
+		/* Check for zero buffers */
+		uint64_t zero_buffers = STATS_Since(stats, SDR_IP_GADGET_STAT_PUSH_UNDERFLOWS, state->reported);
+		if (zero_buffers > 0)
+		{
+			printf("Write zero_buffers: %"PRIu64" in last 5s period\n", zero_buffers);
+		}
+	}
+
+	/* Report scheduling latency and page faults */
+	RT_TUNE_ReportThreadStats("Push", &state->sched_stats);
+
+	/* Report hardware counters of pushing, per buffer and byte pushed */
+	PERF_Report("Push", &state->perf, &state->perf_push, pushed, pushed * state->iio_buffer_size);
+
+	/* Collect period into stream, then reset stats */
+	UTILS_MergeHistogram(&state->stream_period, &state->write_period);
+	UTILS_MergeHistogram(&state->stream_dur, &state->write_dur);
+	UTILS_ResetHistogram(&state->queue_latency);
+	UTILS_ResetHistogram(&state->write_period);
+	UTILS_ResetHistogram(&state->write_dur);
+	UTILS_ResetHistogram(&state->replace_dur);
+	UTILS_ResetHistogram(&state->generate_dur);
+	UTILS_ResetHistogram(&state->interp_dur);
+	UTILS_ResetHistogram(&state->burst_latency);
+	state->waveforms = 0;
+	state->jitter_fill_min = SIZE_MAX;
+	state->jitter_fill_max = 0;
+	state->jitter_fill_total = 0;
+	state->jitter_fill_count = 0;
+	state->early_holds = 0;
+	STATS_Snapshot(stats, SDR_IP_GADGET_STAT_PUSH_BUFFERS >> 8, state->reported);
+	UTILS_ResetHistogram(&state->lateness);
+
+	return 0;
+}
+#endif
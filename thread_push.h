@@ -0,0 +1,107 @@
+#ifndef __THREAD_PUSH_H__
+#define __THREAD_PUSH_H__
+
+/* Standard libraries */
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Local modules */
+#include "buffer_ring.h"
+#include "interp.h"
+#include "loopback.h"
+#include "sample_clock.h"
+#include "stats.h"
+#include "trace.h"
+#include "wavegen.h"
+
+/* Forward declarations */
+struct iio_device;
+typedef struct IIO_BACKEND_Buffer IIO_BACKEND_Buffer_t;
+
+/* Type definitions - thread args */
+typedef struct
+{
+	/* Eventfd used to signal thread to quit */
+	int quit_event_fd;
+
+	/* Eventfd signalled by reassembly thread having queued a buffer */
+	int ready_event_fd;
+
+	/* Ring of assembled buffers to push */
+	BUFFER_RING_t *ring;
+
+	/* IIO sample buffer (replaced by push thread in cyclic mode) */
+	IIO_BACKEND_Buffer_t *iio_tx_buffer;
+
+	/* Waveform generator, filling every buffer in place of the ring (NULL if unused) */
+	WAVEGEN_t *wavegen;
+	size_t channel_pairs;
+
+	/* Interpolator, expanding each buffer from the ring (holding buffer_size_samples / factor samples) to the DAC rate (NULL if unused) */
+	INTERP_t *interp;
+
+	/* Cyclic mode, the newest buffer being loaded into a cyclic IIO buffer (recreated from the following) */
+	bool cyclic;
+	struct iio_device *iio_dev;
+	uint32_t iio_channels;
+	size_t iio_buffer_samples;
+
+	/* IIO buffer size (bytes) */
+	size_t iio_buffer_size;
+
+	/* Buffer size in (samples, excluding timestamp) */
+	size_t buffer_size_samples;
+
+	/* Timestamping enabled */
+	bool timestamping_enabled;
+
+	/* Jitter buffer target depth (in buffers, zero to push buffers as soon as they're queued) */
+	size_t jitter_target;
+
+	/* Size of one sample of all enabled channels (bytes) */
+	size_t sample_size;
+
+	/*
+	** Timed release horizon (samples, zero to push buffers regardless of timestamp), late buffer policy
+	** (SDR_IP_GADGET_LATE_POLICY_*) and hardware sample clock, anchored by the RX thread while it's running
+	*/
+	uint64_t release_horizon;
+	uint8_t late_policy;
+	SAMPLE_CLOCK_t *sample_clock;
+	long long sample_rate;
+
+	/* Time stream start was requested (uS, monotonic, for start latency stats) */
+	uint64_t start_time;
+
+	/* Loopback latency probe, armed as marked buffers are pushed (NULL if unused) */
+	LOOPBACK_t *loopback;
+
+	/* Statistics, the push group being maintained by this thread */
+	STATS_t *stats;
+
+	/* Trace, this thread recording its events (NULL if unused) */
+	TRACE_t *trace;
+
+	/* Busy poll budget (uS) spun before blocking for events, zero never spinning, EPOLL_LOOP_SPIN_FOREVER never blocking */
+	int32_t busy_poll_us;
+
+	/* DAC is being fed continuously (set by push thread) */
+	_Atomic bool started;
+
+	/* Sequence number / timestamp of next buffer to be pushed (set by push thread) */
+	_Atomic uint64_t playout_seqno;
+
+	/* Sequence number / timestamp of last buffer pushed (set by push thread) */
+	_Atomic uint64_t pushed_seqno;
+
+	/* Zero buffers pushed due to underflow (set by push thread) */
+	_Atomic uint32_t underflows;
+
+} THREAD_PUSH_Args_t;
+
+/* Public functions - Thread entrypoint */
+void *THREAD_PUSH_Entrypoint(void *args);
+
+#endif
@@ -8,6 +8,7 @@
 #include <errno.h>
 #include <inttypes.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -19,12 +20,15 @@
 #include <time.h>
 #include <unistd.h>
 
-/* libIIO */
-#include <iio.h>
-
 /* Local modules */
 #include "sdr_ip_gadget_types.h"
 #include "epoll_loop.h"
+#include "iio_backend.h"
+#include "iio_cache.h"
+#include "perf.h"
+#include "rt_tune.h"
+#include "stats.h"
+#include "trace.h"
 #include "utils.h"
 
 /* Set the following to periodically report statistics */
@@ -41,20 +45,44 @@
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
 #define DEBUG_PRINT(...) if (debug) printf("Read: "__VA_ARGS__)
 
-/* Type definitions */
+/* Type definitions - sender shard */
 typedef struct
 {
-	/* Thread args */
-	THREAD_READ_Args_t *thread_args;
+	/* Worker thread */
+	pthread_t thread;
+	bool started;
 
-	/* Keep running */
-	bool keep_running;
+	/* Index, selecting the worker's CPU */
+	unsigned int index;
 
-	/* IIO sample buffer */
-	struct iio_buffer *iio_rx_buffer;
+	/* Eventfd signalling worker to send its share (or quit) */
+	int start_fd;
 
-	/* Sample size (bytes) */
-	size_t sample_size;
+	/* Eventfd signalled by worker having sent its share */
+	int done_fd;
+
+	/* Socket and share of each buffer's datagrams */
+	int fd;
+	struct mmsghdr *msgs;
+	size_t count;
+
+	/* Stop request */
+	atomic_bool quit;
+
+	/* Failed sends */
+	atomic_uint failures;
+
+	/* Trace, registered with by worker */
+	TRACE_t *trace;
+
+} shard_t;
+
+/* Type definitions - buffer geometry, along with the packet arrays prepared for it */
+typedef struct
+{
+	/* Buffer size (samples, including any timestamp) and UDP packet size (bytes) */
+	size_t buffer_samples;
+	size_t udp_packet_size;
 
 	/* Expected IIO buffer size (bytes) */
 	size_t iio_buffer_size;
@@ -73,21 +101,82 @@ typedef struct
 	struct iovec *arr_iovs;
 	data_ip_hdr_t *arr_pkt_hdrs;
 
+} geometry_t;
+
+/* Type definitions */
+typedef struct
+{
+	/* Thread args */
+	THREAD_READ_Args_t *thread_args;
+
+	/* Keep running */
+	bool keep_running;
+
+	/* IIO device and sample buffer, kept between streams by the cache */
+	struct iio_device *iio_dev_rx;
+	IIO_CACHE_t iio_cache;
+	IIO_BACKEND_Buffer_t *iio_rx_buffer;
+
+	/* Epoll instance of stream and buffer's poll fd registered with it (-1 if none) */
+	int epoll_fd;
+	int iio_poll_fd;
+
+	/* Sample size (bytes) */
+	size_t sample_size;
+
+	/* Current geometry and timestamping mode its packet arrays were prepared for (kept between streams) */
+	geometry_t geo;
+	bool prepared_timestamping;
+
+	/* Geometry prepared by reconfiguration, taking effect once blocks of the previous size have been sent */
+	geometry_t next;
+	bool switch_pending;
+	unsigned int switch_in;
+
 	/* Current sequence number / timestamp */
 	uint64_t seqno;
 
+	/* ADC sample rate (Hz, zero if unknown), estimating when loopback markers (and samples preceding them) were captured */
+	long long sample_rate;
+
+	/* Sender shards, the first being serviced by this thread */
+	shard_t shards[THREAD_READ_MAX_SHARDS];
+	unsigned int shard_count;
+
+	/* Eventfd signalled by shard workers having sent their share */
+	int shard_done_fd;
+
 	#if GENERATE_STATS
 	/* Stats reporting timer */
 	int stats_timerfd;
 
-	/* Overflow count */
-	uint32_t overflows;
+	/* Counters (buffers, overflows etc, maintained regardless of stats) at last report */
+	uint64_t reported[STATS_GROUP_SIZE];
 
 	/* Read period timer */
-	UTILS_TimeStats_t read_period;
+	UTILS_Histogram_t read_period;
 
 	/* Read duration timer */
-	UTILS_TimeStats_t read_dur;
+	UTILS_Histogram_t read_dur;
+
+	/* Send duration timer */
+	UTILS_Histogram_t send_dur;
+
+	/* Read period and duration over whole stream (periods being merged as they're reported) */
+	UTILS_Histogram_t stream_period;
+	UTILS_Histogram_t stream_dur;
+
+	/* Scheduling counters at last report */
+	RT_TUNE_ThreadStats_t sched_stats;
+
+	/* Hardware counters, with those of dequeuing and of packetizing / sending blocks since last report */
+	PERF_t perf;
+	PERF_Stage_t perf_refill;
+	PERF_Stage_t perf_send;
+
+	/* Time stream was ready (uS, monotonic) and first packets sent */
+	uint64_t ready_time;
+	bool first_sent;
 	#endif
 
 } state_t;
@@ -99,8 +188,19 @@ typedef int (*epoll_event_handler)(state_t *state);
 extern bool debug;
 
 /* Private functions */
+static bool stream(state_t *state);
+static bool prepare_geometry(state_t *state, geometry_t *geo, size_t buffer_samples, size_t udp_packet_size);
+static void release_geometry(geometry_t *geo);
+static bool switch_geometry(state_t *state);
+static void release_packets(state_t *state);
 static int handle_eventfd_thread(state_t *state);
+static int handle_eventfd_reconfig(state_t *state);
 static int handle_iio_buffer(state_t *state);
+static size_t loopback_first(state_t *state, const LOOPBACK_t *lb, size_t samples, uint64_t dequeued);
+static bool shards_start(state_t *state);
+static void shards_stop(state_t *state);
+static void *shard_entrypoint(void *args);
+static void shard_send(shard_t *shard);
 #if GENERATE_STATS
 static int handle_stats_timer(state_t *state);
 #endif
@@ -115,22 +215,134 @@ void *THREAD_READ_Entrypoint(void *args)
 
 	/* Set name, priority and CPU affinity */
 	pthread_setname_np(pthread_self(), "IP_SDR_GAD_RD");
-	UTILS_SetThreadRealtimePriority();
-	UTILS_SetThreadAffinity(1);
+	RT_TUNE_ApplyThread(RT_TUNE_ROLE_READ, 0);
+	TRACE_Register(thread_args->trace, "IP_SDR_GAD_RD");
 
-	/* Reset state */
+	/* Reset state, which persists between streams such that their buffer and packet arrays may be reused */
 	state_t state;
 	memset(&state, 0x00, sizeof(state));
+	state.shard_done_fd = -1;
 
 	/* Store args */
 	state.thread_args = thread_args;
 
+	/* Run a stream each time we're started, until asked to terminate */
+	uint64_t event;
+	while (read(thread_args->start_event_fd, &event, sizeof(event)) >= 0)
+	{
+		if (atomic_load(&thread_args->terminate))
+		{
+			break;
+		}
+
+		if (!stream(&state))
+		{
+			/* Don't reuse anything left behind by a failed stream */
+			release_packets(&state);
+			IIO_CACHE_Flush(&state.iio_cache);
+		}
+
+		/* Report stream ended */
+		event = 1;
+		if (write(thread_args->idle_event_fd, &event, sizeof(event)) < 0)
+		{
+			perror("Failed to signal read thread idle");
+			break;
+		}
+	}
+
+	/* Release everything kept between streams */
+	release_packets(&state);
+	IIO_CACHE_Flush(&state.iio_cache);
+
+	/* Exit */
+	DEBUG_PRINT("Read thread exit\n");
+
+	return NULL;
+}
+
+/* Private functions */
+static bool stream(state_t *state)
+{
+	THREAD_READ_Args_t *thread_args = state->thread_args;
+	bool result = false;
+
+	/* Reset stream state */
+	state->keep_running = true;
+	state->seqno = 0;
+
+	/* Retrieve RX streaming device */
+	state->iio_dev_rx = iio_context_find_device(thread_args->iio_ctx, "cf-ad9361-lpc");
+	if (!state->iio_dev_rx)
+	{
+		fprintf(stderr, "Failed to open iio rx dev\n");
+		return false;
+	}
+
+	/* Enable required channels and create non-cyclic buffer, reusing that of the previous stream if it matches */
+	bool reused;
+	state->iio_rx_buffer = IIO_CACHE_Get(&state->iio_cache,
+										 state->iio_dev_rx,
+										 thread_args->iio_channels,
+										 thread_args->iio_buffer_size,
+										 thread_args->kernel_buffers,
+										 false,
+										 &reused);
+	if (!state->iio_rx_buffer)
+	{
+		fprintf(stderr, "Failed to create rx buffer for %zu samples\n", thread_args->iio_buffer_size);
+		return false;
+	}
+
+	/* Retrieve size of one sample of all enabled channels */
+	state->sample_size = IIO_BACKEND_GetSampleSize(state->iio_rx_buffer);
+
+	/* Query ADC sample rate if timing loopback markers */
+	state->sample_rate = 0;
+	if (thread_args->loopback)
+	{
+		struct iio_channel *channel = iio_device_find_channel(state->iio_dev_rx, "voltage0", false);
+		if (	(!channel)
+			 || (IIO_BACKEND_ReadChannelAttr(channel, "sampling_frequency", &state->sample_rate) < 0)
+			 || (state->sample_rate <= 0)
+		   )
+		{
+			fprintf(stderr, "Failed to read rx sample rate, loopback markers won't be timed\n");
+			state->sample_rate = 0;
+		}
+	}
+
+	/* Prepare packet arrays and shards, unless those of the previous stream match */
+	if (	!reused
+		 || !state->geo.arr_mmsg_hdrs
+		 || (thread_args->timestamping_enabled != state->prepared_timestamping)
+		 || (thread_args->iio_buffer_size != state->geo.buffer_samples)
+		 || (thread_args->udp_packet_size != state->geo.udp_packet_size))
+	{
+		release_packets(state);
+		if (	!prepare_geometry(state, &state->geo, thread_args->iio_buffer_size, thread_args->udp_packet_size)
+			 || !shards_start(state))
+		{
+			return false;
+		}
+		state->prepared_timestamping = thread_args->timestamping_enabled;
+	}
+	else
+	{
+		DEBUG_PRINT("Reusing packet arrays and shards\n");
+	}
+
 	/* Create epoll instance */
-	int epoll_fd = epoll_create1(0);
-	if (epoll_fd < 0)
+	state->iio_poll_fd = -1;
+	#if GENERATE_STATS
+	state->stats_timerfd = -1;
+	PERF_Open(&state->perf);
+	#endif
+	state->epoll_fd = epoll_create1(0);
+	if (state->epoll_fd < 0)
 	{
 		perror("Failed to create epoll instance");
-		return NULL;
+		goto done;
 	}
 	else
 	{
@@ -142,95 +354,195 @@ void *THREAD_READ_Entrypoint(void *args)
 	/* Register thread quit eventfd with epoll */
 	epoll_event.events = EPOLLIN;
 	epoll_event.data.ptr = handle_eventfd_thread;
-	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, thread_args->quit_event_fd, &epoll_event) < 0)
+	if (epoll_ctl(state->epoll_fd, EPOLL_CTL_ADD, thread_args->quit_event_fd, &epoll_event) < 0)
 	{
 		perror("Failed to register thread quit eventfd with epoll");
-		return NULL;
+		goto done;
 	}
 	else
 	{
 		DEBUG_PRINT("Registered thread quit eventfd with with epoll :-)\n");
 	}
 
-	/* Create IIO context */
-	struct iio_context *iio_ctx = iio_create_local_context();
-	if (!iio_ctx)
+	/* Register reconfiguration eventfd with epoll */
+	epoll_event.events = EPOLLIN;
+	epoll_event.data.ptr = handle_eventfd_reconfig;
+	if (epoll_ctl(state->epoll_fd, EPOLL_CTL_ADD, thread_args->reconfig_event_fd, &epoll_event) < 0)
+	{
+		perror("Failed to register reconfiguration eventfd with epoll");
+		goto done;
+	}
+	else
 	{
-		fprintf(stderr, "Failed to open iio\n");
-		return NULL;
+		DEBUG_PRINT("Registered reconfiguration eventfd with with epoll :-)\n");
 	}
 
-	/* Retrieve RX streaming device */
-	struct iio_device *iio_dev_rx = iio_context_find_device(iio_ctx, "cf-ad9361-lpc");
-	if (!iio_dev_rx)
+	/* Register buffer with epoll, if the backend offers a poll fd (otherwise we'll block dequeuing) */
+	state->iio_poll_fd = IIO_BACKEND_GetPollFd(state->iio_rx_buffer);
+	if (state->iio_poll_fd >= 0)
 	{
-		fprintf(stderr, "Failed to open iio rx dev\n");
-		return NULL;
+		epoll_event.events = EPOLLIN;
+		epoll_event.data.ptr = handle_iio_buffer;
+		if (epoll_ctl(state->epoll_fd, EPOLL_CTL_ADD, state->iio_poll_fd, &epoll_event) < 0)
+		{
+			/* Failed to register IIO buffer with epoll */
+			perror("Failed to register IIO buffer with epoll");
+			goto done;
+		}
+		else
+		{
+			DEBUG_PRINT("Registered IIO buffer with with epoll :-)\n");
+		}
 	}
 
-	/* Disable all channels */
-	unsigned int nb_channels = iio_device_get_channels_count(iio_dev_rx);
-	DEBUG_PRINT("Found %i RX channels\n", nb_channels);
-	for (unsigned int i = 0; i < nb_channels; i++)
+	/* Summarize info */
+	DEBUG_PRINT("RX sample count: %zu, iio sample size: %zu, UDP packet size: %zu, shards: %u, reused: %s\n",
+				thread_args->iio_buffer_size,
+				state->sample_size,
+				thread_args->udp_packet_size,
+				state->shard_count,
+				reused ? "yes" : "no");
+
+	#if GENERATE_STATS
+	/* Create stats reporting timer */
+	state->stats_timerfd = timerfd_create(CLOCK_MONOTONIC, 0);
+	if (state->stats_timerfd < 0)
 	{
-		iio_channel_disable(iio_device_get_channel(iio_dev_rx, i));
+		perror("Failed to open timerfd");
+		goto done;
+	}
+	else
+	{
+		DEBUG_PRINT("Opened timerfd :-)\n");
+	}
+	struct itimerspec timer_period =
+	{
+		.it_value = { .tv_sec = STATS_PERIOD_SECS, .tv_nsec = 0 },
+		.it_interval = { .tv_sec = STATS_PERIOD_SECS, .tv_nsec = 0 }
+	};
+	if (timerfd_settime(state->stats_timerfd, 0, &timer_period, NULL) < 0)
+	{
+		perror("Failed to set timerfd");
+		goto done;
+	}
+	else
+	{
+		DEBUG_PRINT("Set timerfd :-)\n");
 	}
 
-	/* Enable required channels */
-	for (unsigned int i = 0; i < 32; i++)
+	/* Register timer with epoll */
+	epoll_event.events = EPOLLIN;
+	epoll_event.data.ptr = handle_stats_timer;
+	if (epoll_ctl(state->epoll_fd, EPOLL_CTL_ADD, state->stats_timerfd, &epoll_event) < 0)
 	{
-		/* Enable channel if required */
-		if (thread_args->iio_channels & (1U << i))
+		/* Failed to register timer with epoll */
+		perror("Failed to register timer eventfd with epoll");
+		goto done;
+	}
+	else
+	{
+		DEBUG_PRINT("Registered timer with with epoll :-)\n");
+	}
+
+	/* Init timers */
+	UTILS_ResetHistogram(&state->read_period);
+	UTILS_ResetHistogram(&state->read_dur);
+	UTILS_ResetHistogram(&state->send_dur);
+	UTILS_ResetHistogram(&state->stream_period);
+	UTILS_ResetHistogram(&state->stream_dur);
+	STATS_Snapshot(thread_args->stats, SDR_IP_GADGET_STAT_RX_BUFFERS >> 8, state->reported);
+	RT_TUNE_GetThreadStats(&state->sched_stats);
+	PERF_ResetStage(&state->perf_refill);
+	PERF_ResetStage(&state->perf_send);
+
+	/* Note time stream was ready, to report start latency with first packets */
+	state->ready_time = UTILS_GetMonotonicMicros();
+	state->first_sent = false;
+	#endif
+
+	/* Enter main loop */
+	DEBUG_PRINT("Enter read loop..\n");
+	result = true;
+	while (state->keep_running)
+	{
+		/* Spin on the poll fd if busy polling, without one the dequeue below blocks regardless */
+		int spin_us = (state->iio_poll_fd >= 0) ? state->thread_args->busy_poll_us : 0;
+		if (EPOLL_LOOP_RunPolled(state->epoll_fd, (state->iio_poll_fd >= 0) ? 30000 : 0, spin_us, state) < 0)
 		{
-			/* Retrieve channel */
-			struct iio_channel *channel = iio_device_get_channel(iio_dev_rx, i);
-			if (!channel)
-			{
-				fprintf(stderr, "Failed to find iio rx chan %u\n", i);
-				return false;
-			}
+			/* Epoll failed...bail */
+			result = false;
+			break;
+		}
 
-			/* Enable channels */
-			DEBUG_PRINT("Enable channel: %s, is scan element: %s\n",
-						iio_channel_get_id(channel),
-						iio_channel_is_scan_element(channel) ? "true" : "false");
-			iio_channel_enable(channel);
+		/* Without a poll fd, wait for the next block here having checked for other events */
+		if ((state->iio_poll_fd < 0) && state->keep_running && (handle_iio_buffer(state) < 0))
+		{
+			result = false;
+			break;
 		}
 	}
+	DEBUG_PRINT("Exit read loop..\n");
 
-	/* Create non-cyclic buffer */
-	state.iio_rx_buffer = iio_device_create_buffer(iio_dev_rx, thread_args->iio_buffer_size, false);
-	if (!state.iio_rx_buffer)
+	#if GENERATE_STATS
+	/* Report read period and duration over whole stream, revealing outliers of the rarest periods */
+	UTILS_MergeHistogram(&state->stream_period, &state->read_period);
+	UTILS_MergeHistogram(&state->stream_dur, &state->read_dur);
+	if (state->stream_period.count > 0)
 	{
-		fprintf(stderr, "Failed to create rx buffer for %zu samples\n", thread_args->iio_buffer_size);
-		return NULL;
+		char summary[UTILS_HISTOGRAM_SUMMARY_SIZE];
+		printf("Read stream period: %s (uS)\n", UTILS_FormatHistogram(&state->stream_period, summary));
+		printf("Read stream dur: %s (uS)\n", UTILS_FormatHistogram(&state->stream_dur, summary));
 	}
+	#endif
 
-	/* Register buffer with epoll */
-	epoll_event.events = EPOLLIN;
-	epoll_event.data.ptr = handle_iio_buffer;
-	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, iio_buffer_get_poll_fd(state.iio_rx_buffer), &epoll_event) < 0)
+done:
+	/* Close everything opened for stream (buffer and packet arrays being kept for the next) */
+	#if GENERATE_STATS
+	if (state->stats_timerfd >= 0)
 	{
-		/* Failed to register IIO buffer with epoll */
-		perror("Failed to register IIO buffer with epoll");
-		return NULL;
+		/* Timer opened */
+		close(state->stats_timerfd);
 	}
-	else
+	PERF_Close(&state->perf);
+	#endif
+	if (state->epoll_fd >= 0)
+	{
+		/* Epoll opened */
+		close(state->epoll_fd);
+	}
+	state->epoll_fd = -1;
+
+	/* Abandon any reconfiguration yet to take effect, the buffer's size is restored by the next stream if required */
+	if (state->switch_pending)
 	{
-		DEBUG_PRINT("Registered IIO buffer with with epoll :-)\n");
+		release_geometry(&state->next);
+		state->switch_pending = false;
 	}
 
-	/* Retrieve number of bytes between two samples of the same channel (aka size of one sample of all enabled channels) */
-	state.sample_size = iio_buffer_step(state.iio_rx_buffer);
+	return result;
+}
+
+static bool prepare_geometry(state_t *state, geometry_t *geo, size_t buffer_samples, size_t udp_packet_size)
+{
+	THREAD_READ_Args_t *thread_args = state->thread_args;
+
+	memset(geo, 0x00, sizeof(*geo));
+	geo->buffer_samples = buffer_samples;
+	geo->udp_packet_size = udp_packet_size;
 
 	/* Calculate expected buffer size */
-	state.iio_buffer_size = state.sample_size * thread_args->iio_buffer_size;
+	geo->iio_buffer_size = state->sample_size * buffer_samples;
 
 	/* Calculate how many payload bytes fit into a packet */
-	state.packet_payload_size = thread_args->udp_packet_size - sizeof(data_ip_hdr_t);
+	if (udp_packet_size <= sizeof(data_ip_hdr_t))
+	{
+		fprintf(stderr, "RX packet size %zu too small\n", udp_packet_size);
+		return false;
+	}
+	geo->packet_payload_size = udp_packet_size - sizeof(data_ip_hdr_t);
 
 	/* Calculate how many payload bytes are in an iio buffer */
-	size_t iio_payload_size = state.iio_buffer_size;
+	size_t iio_payload_size = geo->iio_buffer_size;
 	if (thread_args->timestamping_enabled)
 	{
 		/* Timestamp is included in IIO sample count by client library, we'll be moving it to the header, so subtract */
@@ -238,136 +550,210 @@ void *THREAD_READ_Entrypoint(void *args)
 	}
 
 	/* Calculate packets required to transfer a buffer, rounding up */
-	state.packets_per_buffer = (iio_payload_size + (state.packet_payload_size - 1U)) / state.packet_payload_size;
+	geo->packets_per_buffer = (iio_payload_size + (geo->packet_payload_size - 1U)) / geo->packet_payload_size;
 
 	/* Allocate multiple message header structure, which will hold pointers to individual messages and send results */
-	state.arr_mmsg_hdrs = calloc(state.packets_per_buffer, sizeof(struct mmsghdr));
+	geo->arr_mmsg_hdrs = calloc(geo->packets_per_buffer, sizeof(struct mmsghdr));
 
 	/* For each msg we require two io vectors (one for the header and one for the data) */
-	state.arr_iovs = calloc(2 * state.packets_per_buffer, sizeof(struct iovec));
+	geo->arr_iovs = calloc(2 * geo->packets_per_buffer, sizeof(struct iovec));
 
 	/* We require a fixed header for each data block */
-	state.arr_pkt_hdrs = calloc(state.packets_per_buffer, sizeof(data_ip_hdr_t));
+	geo->arr_pkt_hdrs = calloc(geo->packets_per_buffer, sizeof(data_ip_hdr_t));
+
+	if (!geo->arr_mmsg_hdrs || !geo->arr_iovs || !geo->arr_pkt_hdrs)
+	{
+		fprintf(stderr, "Failed to allocate packet arrays for %zu packets\n", geo->packets_per_buffer);
+		release_geometry(geo);
+		return false;
+	}
 
 	/* Pre-populate fixed fields */
-	for (size_t i = 0; i < state.packets_per_buffer; i++)
+	for (size_t i = 0; i < geo->packets_per_buffer; i++)
 	{
 		/* Each message will be sent to the same address */
-		state.arr_mmsg_hdrs[i].msg_hdr.msg_name = &state.thread_args->addr;
-		state.arr_mmsg_hdrs[i].msg_hdr.msg_namelen = sizeof(state.thread_args->addr);
+		geo->arr_mmsg_hdrs[i].msg_hdr.msg_name = &thread_args->addr;
+		geo->arr_mmsg_hdrs[i].msg_hdr.msg_namelen = sizeof(thread_args->addr);
 
 		/* Each message makes use of two IOVs (one for the header and one for the data) */
-		state.arr_mmsg_hdrs[i].msg_hdr.msg_iov = &state.arr_iovs[2 * i];
-		state.arr_mmsg_hdrs[i].msg_hdr.msg_iovlen = 2;
+		geo->arr_mmsg_hdrs[i].msg_hdr.msg_iov = &geo->arr_iovs[2 * i];
+		geo->arr_mmsg_hdrs[i].msg_hdr.msg_iovlen = 2;
 
 		/* First IOV of each pair points at packet header, next will point at payload and be updated just before tranmission */
-		state.arr_iovs[(2 * i) + 0].iov_base = &state.arr_pkt_hdrs[i];
-		state.arr_iovs[(2 * i) + 0].iov_len = sizeof(data_ip_hdr_t);
-		state.arr_iovs[(2 * i) + 1].iov_base = NULL;
-		if (i < (state.packets_per_buffer - 1))
+		geo->arr_iovs[(2 * i) + 0].iov_base = &geo->arr_pkt_hdrs[i];
+		geo->arr_iovs[(2 * i) + 0].iov_len = sizeof(data_ip_hdr_t);
+		geo->arr_iovs[(2 * i) + 1].iov_base = NULL;
+		if (i < (geo->packets_per_buffer - 1))
 		{
 			/* Not the last packet, therefore must be full */
-			state.arr_iovs[(2 * i) + 1].iov_len = state.thread_args->udp_packet_size - sizeof(data_ip_hdr_t);
+			geo->arr_iovs[(2 * i) + 1].iov_len = geo->packet_payload_size;
 		}
 		else
 		{
 			/* Last packet, work out how many bytes of the payload it will contain */
-			size_t iio_buffer_size_exc_timestamp = state.iio_buffer_size;
-			if (state.thread_args->timestamping_enabled) iio_buffer_size_exc_timestamp -= sizeof(uint64_t);
-			state.arr_iovs[(2 * i) + 1].iov_len = sizeof(data_ip_hdr_t) + (iio_buffer_size_exc_timestamp % state.packet_payload_size);
+			geo->arr_iovs[(2 * i) + 1].iov_len = sizeof(data_ip_hdr_t) + (iio_payload_size % geo->packet_payload_size);
 		}
 
 		/* Prepare packet headers, just need to fill in the sequence number at transmission time */
-		state.arr_pkt_hdrs[i].magic = SDR_IP_GADGET_MAGIC;
-		state.arr_pkt_hdrs[i].block_index = (uint8_t)i;
-		state.arr_pkt_hdrs[i].block_count = (uint8_t)state.packets_per_buffer;
+		geo->arr_pkt_hdrs[i].magic = SDR_IP_GADGET_MAGIC;
+		geo->arr_pkt_hdrs[i].block_index = (uint8_t)i;
+		geo->arr_pkt_hdrs[i].block_count = (uint8_t)geo->packets_per_buffer;
 	}
 
-	/* Summarize info */
-	DEBUG_PRINT("RX sample count: %zu, iio sample size: %zu, UDP packet size: %zu\n",
-				thread_args->iio_buffer_size,
-				state.sample_size,
-				thread_args->udp_packet_size);
+	return true;
+}
 
-	#if GENERATE_STATS
-	/* Create stats reporting timer */
-	state.stats_timerfd = timerfd_create(CLOCK_MONOTONIC, 0);
-	if (state.stats_timerfd < 0)
+static void release_geometry(geometry_t *geo)
+{
+	free(geo->arr_mmsg_hdrs);
+	free(geo->arr_iovs);
+	free(geo->arr_pkt_hdrs);
+	memset(geo, 0x00, sizeof(*geo));
+}
+
+static bool switch_geometry(state_t *state)
+{
+	/* Swap in prepared geometry, shards being idle between blocks */
+	release_geometry(&state->geo);
+	state->geo = state->next;
+	memset(&state->next, 0x00, sizeof(state->next));
+	state->switch_pending = false;
+	DEBUG_PRINT("Switched to RX sample count: %zu, UDP packet size: %zu, packets per buffer: %zu\n",
+				state->geo.buffer_samples,
+				state->geo.udp_packet_size,
+				state->geo.packets_per_buffer);
+
+	/* Share new datagrams between the running shards, only restarting them should their number change */
+	unsigned int shard_count = (state->thread_args->output_fd_count > 0) ? state->thread_args->output_fd_count : 1;
+	if (shard_count > THREAD_READ_MAX_SHARDS)
 	{
-		perror("Failed to open timerfd");
-		return NULL;
+		/* More sockets than shards */
+		shard_count = THREAD_READ_MAX_SHARDS;
 	}
-	else
+	if (shard_count > state->geo.packets_per_buffer)
 	{
-		DEBUG_PRINT("Opened timerfd :-)\n");
+		/* More shards than datagrams */
+		shard_count = (unsigned int)state->geo.packets_per_buffer;
 	}
-	struct itimerspec timer_period =
+	if (shard_count != state->shard_count)
 	{
-		.it_value = { .tv_sec = STATS_PERIOD_SECS, .tv_nsec = 0 },
-		.it_interval = { .tv_sec = STATS_PERIOD_SECS, .tv_nsec = 0 }
-	};
-	if (timerfd_settime(state.stats_timerfd, 0, &timer_period, NULL) < 0)
+		shards_stop(state);
+		return shards_start(state);
+	}
+	for (unsigned int i = 0; i < state->shard_count; i++)
 	{
-		perror("Failed to set timerfd");
-		return NULL;
+		shard_t *shard = &state->shards[i];
+		size_t first = (i * state->geo.packets_per_buffer) / state->shard_count;
+		size_t last = ((i + 1) * state->geo.packets_per_buffer) / state->shard_count;
+		shard->msgs = &state->geo.arr_mmsg_hdrs[first];
+		shard->count = last - first;
 	}
-	else
+
+	return true;
+}
+
+static void release_packets(state_t *state)
+{
+	/* Stop shards before freeing the arrays they send from */
+	shards_stop(state);
+	release_geometry(&state->geo);
+	release_geometry(&state->next);
+	state->switch_pending = false;
+}
+
+static int handle_eventfd_thread(state_t *state)
+{
+	/* Quit having detected write on eventfd */
+	DEBUG_PRINT("Stop request received\n");
+	state->keep_running = false;
+
+	return 0;
+}
+
+static int handle_eventfd_reconfig(state_t *state)
+{
+	THREAD_READ_Args_t *thread_args = state->thread_args;
+
+	/* Clear event, the request itself having been stored in our args */
+	uint64_t event;
+	if (read(thread_args->reconfig_event_fd, &event, sizeof(event)) < 0)
 	{
-		DEBUG_PRINT("Set timerfd :-)\n");
+		perror("Failed to read reconfig eventfd");
+		return -1;
 	}
 
-	/* Register timer with epoll */
-	epoll_event.events = EPOLLIN;
-	epoll_event.data.ptr = handle_stats_timer;
-	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, state.stats_timerfd, &epoll_event) < 0)
+	/* Zero retains current value */
+	size_t buffer_samples = thread_args->reconfig_buffer_size ? thread_args->reconfig_buffer_size : state->geo.buffer_samples;
+	size_t udp_packet_size = thread_args->reconfig_packet_size ? thread_args->reconfig_packet_size : state->geo.udp_packet_size;
+	if (state->switch_pending)
 	{
-		/* Failed to register timer with epoll */
-		perror("Failed to register timer eventfd with epoll");
-		return NULL;
+		fprintf(stderr, "RX reconfiguration already in progress, ignoring\n");
+		return 0;
 	}
-	else
+	if ((buffer_samples == state->geo.buffer_samples) && (udp_packet_size == state->geo.udp_packet_size))
 	{
-		DEBUG_PRINT("Registered timer with with epoll :-)\n");
+		return 0;
 	}
+	DEBUG_PRINT("Reconfigure request, RX sample count: %zu, UDP packet size: %zu\n", buffer_samples, udp_packet_size);
 
-	/* Init timer */
-	UTILS_ResetTimeStats(&state.read_period);
-	UTILS_ResetTimeStats(&state.read_dur);
-	#endif
+	/* Prepare packet arrays for new geometry, while the current ones continue to be used */
+	if (!prepare_geometry(state, &state->next, buffer_samples, udp_packet_size))
+	{
+		/* Keep streaming as before */
+		return 0;
+	}
 
-	/* Enter main loop */
-	DEBUG_PRINT("Enter read loop..\n");
-	state.keep_running = true;
-	while (state.keep_running)
+	/* Resize buffer, blocks already queued keeping their size */
+	int pending = 0;
+	if (buffer_samples != state->geo.buffer_samples)
 	{
-		if (EPOLL_LOOP_Run(epoll_fd, 30000, &state) < 0)
+		pending = IIO_CACHE_Resize(&state->iio_cache, buffer_samples);
+		if (pending < 0)
 		{
-			/* Epoll failed...bail */
-			break;
+			/* Backend can't resize in place, recreate buffer (dropping samples queued in the old one) */
+			DEBUG_PRINT("Recreating rx buffer for %zu samples\n", buffer_samples);
+			if (state->iio_poll_fd >= 0)
+			{
+				epoll_ctl(state->epoll_fd, EPOLL_CTL_DEL, state->iio_poll_fd, NULL);
+				state->iio_poll_fd = -1;
+			}
+			IIO_CACHE_Flush(&state->iio_cache);
+			bool reused;
+			state->iio_rx_buffer = IIO_CACHE_Get(&state->iio_cache,
+												 state->iio_dev_rx,
+												 thread_args->iio_channels,
+												 buffer_samples,
+												 thread_args->kernel_buffers,
+												 false,
+												 &reused);
+			if (!state->iio_rx_buffer)
+			{
+				fprintf(stderr, "Failed to create rx buffer for %zu samples\n", buffer_samples);
+				return -1;
+			}
+			state->iio_poll_fd = IIO_BACKEND_GetPollFd(state->iio_rx_buffer);
+			if (state->iio_poll_fd >= 0)
+			{
+				struct epoll_event epoll_event;
+				epoll_event.events = EPOLLIN;
+				epoll_event.data.ptr = handle_iio_buffer;
+				if (epoll_ctl(state->epoll_fd, EPOLL_CTL_ADD, state->iio_poll_fd, &epoll_event) < 0)
+				{
+					perror("Failed to register iio buffer with epoll");
+					return -1;
+				}
+			}
+			pending = 0;
 		}
 	}
-	DEBUG_PRINT("Exit read loop..\n");
-
-	/* Close / destroy everything */
-	#if GENERATE_STATS
-	close(state.stats_timerfd);
-	#endif
-	iio_buffer_destroy(state.iio_rx_buffer);
-	iio_context_destroy(iio_ctx);
-	close(epoll_fd);
-
-	/* Exit */
-	DEBUG_PRINT("Read thread exit\n");
-
-	return NULL;
-}
 
-/* Private functions */
-static int handle_eventfd_thread(state_t *state)
-{
-	/* Quit having detected write on eventfd */
-	DEBUG_PRINT("Stop request received\n");
-	state->keep_running = false;
+	/* Switch now, or once blocks of the previous size have been sent */
+	state->switch_pending = true;
+	state->switch_in = (unsigned int)pending;
+	if ((0 == pending) && !switch_geometry(state))
+	{
+		return -1;
+	}
 
 	return 0;
 }
@@ -376,31 +762,37 @@ static int handle_iio_buffer(state_t *state)
 {
 	#if GENERATE_STATS
 	/* Capture read period */
-	UTILS_UpdateTimeStats(&state->read_period);
+	UTILS_UpdateHistogram(&state->read_period);
 
-	/* Record read start time */
-	UTILS_StartTimeStats(&state->read_dur);
+	/* Record read start time and counters */
+	UTILS_StartHistogram(&state->read_dur);
+	PERF_Begin(&state->perf);
 	#endif
 
-	/* Refill buffer */
-	ssize_t nbytes = iio_buffer_refill(state->iio_rx_buffer);
-	if (nbytes != (ssize_t)state->iio_buffer_size)
+	/* Dequeue filled block */
+	STATS_t *stats = state->thread_args->stats;
+	uint64_t refill_start = UTILS_GetMonotonicMicros();
+	TRACE_Record(TRACE_EVENT_RX_REFILL_BEGIN, 0, refill_start);
+	uint8_t *buffer = IIO_BACKEND_Dequeue(state->iio_rx_buffer);
+	uint64_t refill_end = UTILS_GetMonotonicMicros();
+	TRACE_Record(TRACE_EVENT_RX_REFILL_END, 0, refill_end);
+	if (!buffer)
 	{
-		fprintf(stderr, "RX buffer read failed, expected %zu, read %zd bytes\n", state->iio_buffer_size, nbytes);
 		return -1;
 	}
+	STATS_Duration(stats, SDR_IP_GADGET_STAT_RX_REFILL_US, STATS_HISTOGRAM_RX_REFILL, refill_end - refill_start);
 
 	#if GENERATE_STATS
-	/* Capture read end time */
-	UTILS_UpdateTimeStats(&state->read_dur);
+	/* Capture read end time and counters */
+	UTILS_UpdateHistogram(&state->read_dur);
+	PERF_End(&state->perf, &state->perf_refill);
 
 	/* Record period start time (to subtract read time above) */
-	UTILS_StartTimeStats(&state->read_period);
+	UTILS_StartHistogram(&state->read_period);
 	#endif
 
-	/* Retrieve buffer ptr */
-	uint8_t *buffer = iio_buffer_start(state->iio_rx_buffer);
-	size_t buffer_remaining = state->iio_buffer_size;
+	/* Packetize block in place */
+	size_t buffer_remaining = state->geo.iio_buffer_size;
 
 	if (state->thread_args->timestamping_enabled)
 	{
@@ -408,38 +800,325 @@ static int handle_iio_buffer(state_t *state)
 		state->seqno = *((uint64_t*)buffer);
 		buffer += sizeof(uint64_t);
 		buffer_remaining -= sizeof(uint64_t);
+
+		/* Block has just completed, so the hardware clock has reached the end of it */
+		if (state->thread_args->sample_clock)
+		{
+			SAMPLE_CLOCK_Anchor(state->thread_args->sample_clock,
+								state->seqno + (buffer_remaining / state->sample_size),
+								UTILS_GetMonotonicMicros());
+		}
+	}
+
+	/* Search block for loopback marker while a probe is in flight */
+	LOOPBACK_t *loopback = state->thread_args->loopback;
+	size_t samples = buffer_remaining / state->sample_size;
+	ptrdiff_t marker = -1;
+	uint64_t dequeued = 0;
+	if (loopback && LOOPBACK_Armed(loopback))
+	{
+		dequeued = refill_end;
+		marker = LOOPBACK_Find(loopback,
+							   buffer,
+							   loopback_first(state, loopback, samples, dequeued),
+							   samples,
+							   state->sample_size);
 	}
 
 	/* Prepare multi-message send structures */
-	for (size_t i = 0; i < state->packets_per_buffer; i++)
+	for (size_t i = 0; i < state->geo.packets_per_buffer; i++)
 	{
 		/* Set sequence number for packet */
-		state->arr_pkt_hdrs[i].seqno = state->seqno;
+		state->geo.arr_pkt_hdrs[i].seqno = state->seqno;
 
 		/* Set data pointer for packet */
-		state->arr_iovs[(2 * i) + 1].iov_base = buffer;
-		buffer += state->packet_payload_size;
+		state->geo.arr_iovs[(2 * i) + 1].iov_base = buffer;
+		buffer += state->geo.packet_payload_size;
+	}
+
+	#if GENERATE_STATS
+	/* Record send start time */
+	UTILS_StartHistogram(&state->send_dur);
+	#endif
+
+	/* Have workers send their share of the datagrams */
+	uint64_t send_start = UTILS_GetMonotonicMicros();
+	uint64_t event = 1;
+	for (unsigned int i = 1; i < state->shard_count; i++)
+	{
+		if (write(state->shards[i].start_fd, &event, sizeof(event)) < 0)
+		{
+			perror("Failed to signal shard");
+			return -1;
+		}
+	}
+
+	/* Send first share ourselves, all datagrams with single system call :-) */
+	shard_send(&state->shards[0]);
+
+	/* Wait for workers, as the block is about to be handed back */
+	uint64_t done = 0;
+	while (done < (state->shard_count - 1U))
+	{
+		if (read(state->shard_done_fd, &event, sizeof(event)) < 0)
+		{
+			perror("Failed to wait for shards");
+			return -1;
+		}
+		done += event;
 	}
 
-	/* Send all datagrams with single system call :-) */
-	if (state->packets_per_buffer != sendmmsg(state->thread_args->output_fd,
-											  state->arr_mmsg_hdrs,
-											  state->packets_per_buffer,
-											  0))
+	/* Count block, its datagrams and failed sends (each shard's count being stable once it has signalled) */
+	STATS_Duration(stats, SDR_IP_GADGET_STAT_RX_SEND_US, STATS_HISTOGRAM_RX_SEND, UTILS_GetMonotonicMicros() - send_start);
+	STATS_Inc(stats, SDR_IP_GADGET_STAT_RX_BUFFERS);
+	STATS_Add(stats, SDR_IP_GADGET_STAT_RX_DATAGRAMS, state->geo.packets_per_buffer);
+	STATS_Add(stats, SDR_IP_GADGET_STAT_RX_BYTES, buffer_remaining);
+	for (unsigned int i = 0; i < state->shard_count; i++)
 	{
-		/* Send failed */
-		#if GENERATE_STATS
-		/* Count overflow */
-		state->overflows++;
-		#endif
+		unsigned int failures = atomic_exchange(&state->shards[i].failures, 0);
+		if (failures > 0)
+		{
+			/* Count failed sends as overflows */
+			STATS_Add(stats, SDR_IP_GADGET_STAT_RX_OVERFLOWS, failures);
+		}
+	}
+
+	#if GENERATE_STATS
+	/* Capture send end time, and counters since read (packetizing and sending) */
+	UTILS_UpdateHistogram(&state->send_dur);
+	PERF_End(&state->perf, &state->perf_send);
+
+	/* Report start latency with stream's first packets */
+	if (!state->first_sent)
+	{
+		uint64_t now = UTILS_GetMonotonicMicros();
+		printf("Read start: ready: %"PRIu64", first packets sent: %"PRIu64" (uS after request)\n",
+			   state->ready_time - state->thread_args->start_time,
+			   now - state->thread_args->start_time);
+		state->first_sent = true;
+	}
+	#endif
+
+	/* Complete loopback probe having sent its marker, or abandon it should the marker be overdue */
+	uint64_t captured = 0;
+	if ((marker >= 0) && (state->sample_rate > 0))
+	{
+		/* Block completed as it was dequeued, the marker having been captured the samples following it earlier */
+		uint64_t following = (uint64_t)(samples - (size_t)marker);
+		captured = dequeued - ((following * 1000000U) / (uint64_t)state->sample_rate);
+		if (captured < loopback->pushed)
+		{
+			/* Captured before it was pushed, not the marker */
+			DEBUG_PRINT("Ignoring loopback marker captured before it was pushed\n");
+			marker = -1;
+		}
+	}
+	if (marker >= 0)
+	{
+		LOOPBACK_Complete(loopback,
+						  state->seqno + (uint64_t)marker,
+						  captured,
+						  dequeued,
+						  UTILS_GetMonotonicMicros(),
+						  state->thread_args->output_fds[0],
+						  &state->thread_args->addr);
+	}
+	else if (dequeued > 0)
+	{
+		LOOPBACK_CheckTimeout(loopback, dequeued);
 	}
 
 	/* Advance sequence number */
-	state->seqno += state->thread_args->iio_buffer_size;
+	state->seqno += state->geo.buffer_samples;
+
+	/* Hand block back to DMA, having been copied into the socket buffer by the send */
+	if (IIO_BACKEND_Enqueue(state->iio_rx_buffer) < 0)
+	{
+		fprintf(stderr, "Failed to enqueue rx block\n");
+		return -1;
+	}
+
+	/* Switch to new geometry once the last block of the previous size has been sent */
+	if (state->switch_pending && (0 == --state->switch_in) && !switch_geometry(state))
+	{
+		return -1;
+	}
 
 	return 0;
 }
 
+static size_t loopback_first(state_t *state, const LOOPBACK_t *lb, size_t samples, uint64_t dequeued)
+{
+	/* Block completed as it was dequeued, samples captured before the marker was pushed preceding it */
+	if (dequeued <= lb->pushed)
+	{
+		return samples;
+	}
+	size_t first = 0;
+	if (state->sample_rate > 0)
+	{
+		uint64_t after = ((dequeued - lb->pushed) * (uint64_t)state->sample_rate) / 1000000U;
+		first = (after < samples) ? (samples - (size_t)after) : 0;
+	}
+
+	/* Nor can the marker precede the hardware timestamp its buffer was scheduled at */
+	if (state->thread_args->timestamping_enabled && (lb->tx_seqno > (state->seqno + first)))
+	{
+		uint64_t before = lb->tx_seqno - state->seqno;
+		first = (before < samples) ? (size_t)before : samples;
+	}
+
+	return first;
+}
+
+static bool shards_start(state_t *state)
+{
+	THREAD_READ_Args_t *thread_args = state->thread_args;
+
+	/* Use as many shards as sockets, each sending at least one datagram */
+	state->shard_count = (thread_args->output_fd_count > 0) ? thread_args->output_fd_count : 1;
+	if (state->shard_count > THREAD_READ_MAX_SHARDS)
+	{
+		/* More sockets than shards */
+		state->shard_count = THREAD_READ_MAX_SHARDS;
+	}
+	if (state->shard_count > state->geo.packets_per_buffer)
+	{
+		/* More shards than datagrams */
+		state->shard_count = (unsigned int)state->geo.packets_per_buffer;
+	}
+
+	/* Split datagrams into contiguous shares */
+	for (unsigned int i = 0; i < state->shard_count; i++)
+	{
+		shard_t *shard = &state->shards[i];
+		size_t first = (i * state->geo.packets_per_buffer) / state->shard_count;
+		size_t last = ((i + 1) * state->geo.packets_per_buffer) / state->shard_count;
+		shard->index = i;
+		shard->fd = thread_args->output_fds[i];
+		shard->msgs = &state->geo.arr_mmsg_hdrs[first];
+		shard->count = last - first;
+		shard->start_fd = -1;
+		shard->trace = thread_args->trace;
+	}
+	state->shard_done_fd = -1;
+	if (state->shard_count < 2)
+	{
+		/* Everything sent from this thread */
+		return true;
+	}
+
+	state->shard_done_fd = eventfd(0, 0);
+	if (state->shard_done_fd < 0)
+	{
+		perror("Failed to open shard eventfd");
+		return false;
+	}
+
+	/* Start workers for all but the first share */
+	for (unsigned int i = 1; i < state->shard_count; i++)
+	{
+		shard_t *shard = &state->shards[i];
+		shard->done_fd = state->shard_done_fd;
+		shard->start_fd = eventfd(0, 0);
+		if (shard->start_fd < 0)
+		{
+			perror("Failed to open shard eventfd");
+			return false;
+		}
+		if (0 != pthread_create(&shard->thread, NULL, shard_entrypoint, shard))
+		{
+			fprintf(stderr, "Failed to start shard %u\n", i);
+			return false;
+		}
+		shard->started = true;
+	}
+
+	return true;
+}
+
+static void shards_stop(state_t *state)
+{
+	/* Stop and join workers */
+	uint64_t event = 1;
+	for (unsigned int i = 1; i < state->shard_count; i++)
+	{
+		shard_t *shard = &state->shards[i];
+		if (shard->started)
+		{
+			atomic_store(&shard->quit, true);
+			if (write(shard->start_fd, &event, sizeof(event)) < 0)
+			{
+				perror("Failed to signal shard");
+			}
+			pthread_join(shard->thread, NULL);
+		}
+		if (shard->start_fd >= 0)
+		{
+			/* Worker eventfd opened */
+			close(shard->start_fd);
+		}
+		shard->start_fd = -1;
+		shard->started = false;
+		atomic_store(&shard->quit, false);
+	}
+	if (state->shard_done_fd >= 0)
+	{
+		/* Done eventfd opened */
+		close(state->shard_done_fd);
+	}
+	state->shard_done_fd = -1;
+	state->shard_count = 0;
+}
+
+static void *shard_entrypoint(void *args)
+{
+	shard_t *shard = (shard_t*)args;
+
+	/* Set name, priority and CPU affinity (spreading shards over the cores as tuned) */
+	char name[16];
+	snprintf(name, sizeof(name), "IP_SDR_GAD_RD%u", shard->index);
+	pthread_setname_np(pthread_self(), name);
+	RT_TUNE_ApplyThread(RT_TUNE_ROLE_SHARD, shard->index);
+	TRACE_Register(shard->trace, name);
+
+	/* Send share of each buffer when signalled */
+	uint64_t event;
+	while (read(shard->start_fd, &event, sizeof(event)) >= 0)
+	{
+		if (atomic_load(&shard->quit))
+		{
+			break;
+		}
+
+		shard_send(shard);
+
+		event = 1;
+		if (write(shard->done_fd, &event, sizeof(event)) < 0)
+		{
+			perror("Failed to signal shard done");
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+static void shard_send(shard_t *shard)
+{
+	/* Send share with single system call */
+	TRACE_Record(TRACE_EVENT_RX_SEND_BEGIN, 0, TRACE_Now());
+	int sent = sendmmsg(shard->fd, shard->msgs, shard->count, 0);
+	uint64_t send_end = TRACE_Now();
+	TRACE_Record(TRACE_EVENT_RX_SEND_END, (sent > 0) ? (uint32_t)sent : 0, send_end);
+	if ((int)shard->count != sent)
+	{
+		/* Send failed, counted as an overflow */
+		TRACE_Record(TRACE_EVENT_DROP, SDR_IP_GADGET_STAT_RX_OVERFLOWS, send_end);
+		atomic_fetch_add(&shard->failures, 1);
+	}
+}
+
 #if GENERATE_STATS
 static int handle_stats_timer(state_t *state)
 {
@@ -451,30 +1130,42 @@ static int handle_stats_timer(state_t *state)
 		return 1;
 	}
 
-	/* Report min/max/average read period */
-	printf("Read period: min: %"PRIu64", max: %"PRIu64", avg: %"PRIu64" (uS)\n",
-		   state->read_period.min,
-		   state->read_period.max,
-		   UTILS_CalcAverageTimeStats(&state->read_period)
-	);
+	/* Summary of histogram being reported */
+	char summary[UTILS_HISTOGRAM_SUMMARY_SIZE];
+
+	/* Report percentiles of read period */
+	printf("Read period: %s (uS)\n", UTILS_FormatHistogram(&state->read_period, summary));
+
+	/* Report percentiles of read duration */
+	printf("Read dur: %s (uS)\n", UTILS_FormatHistogram(&state->read_dur, summary));
 
-	/* Report min/max/average read duration */
-	printf("Read dur: min: %"PRIu64", max: %"PRIu64", avg: %"PRIu64" (uS)\n",
-		   state->read_dur.min,
-		   state->read_dur.max,
-		   UTILS_CalcAverageTimeStats(&state->read_dur)
-	);
+	/* Report percentiles of send duration */
+	printf("Read send: %s (uS), shards: %u\n", UTILS_FormatHistogram(&state->send_dur, summary), state->shard_count);
 
 	/* Check for overflows */
-	if (state->overflows > 0)
+	STATS_t *stats = state->thread_args->stats;
+	uint64_t overflows = STATS_Since(stats, SDR_IP_GADGET_STAT_RX_OVERFLOWS, state->reported);
+	if (overflows > 0)
 	{
-		printf("Read overflows: %u in last 5s period\n", state->overflows);
+		printf("Read overflows: %"PRIu64" in last 5s period\n", overflows);
 	}
 
-	/* Reset stats */
-	UTILS_ResetTimeStats(&state->read_period);
-	UTILS_ResetTimeStats(&state->read_dur);
-	state->overflows = 0;
+	/* Report scheduling latency and page faults */
+	RT_TUNE_ReportThreadStats("Read", &state->sched_stats);
+
+	/* Report hardware counters of each stage, per block and byte read */
+	uint64_t buffers = STATS_Since(stats, SDR_IP_GADGET_STAT_RX_BUFFERS, state->reported);
+	uint64_t bytes = STATS_Since(stats, SDR_IP_GADGET_STAT_RX_BYTES, state->reported);
+	PERF_Report("Read refill", &state->perf, &state->perf_refill, buffers, bytes);
+	PERF_Report("Read send", &state->perf, &state->perf_send, buffers, bytes);
+
+	/* Collect period into stream, then reset stats */
+	UTILS_MergeHistogram(&state->stream_period, &state->read_period);
+	UTILS_MergeHistogram(&state->stream_dur, &state->read_dur);
+	UTILS_ResetHistogram(&state->read_period);
+	UTILS_ResetHistogram(&state->read_dur);
+	UTILS_ResetHistogram(&state->send_dur);
+	STATS_Snapshot(stats, SDR_IP_GADGET_STAT_RX_BUFFERS >> 8, state->reported);
 
 	return 0;
 }
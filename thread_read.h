@@ -2,19 +2,52 @@
 #define __THREAD_READ_H__
 
 /* Standard libraries */
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <netinet/in.h>
 
+/* Local modules */
+#include "loopback.h"
+#include "sample_clock.h"
+#include "stats.h"
+#include "trace.h"
+
+/* Definitions - maximum sender shards */
+#define THREAD_READ_MAX_SHARDS (8)
+
 /* Type definitions - thread args */
 typedef struct
 {
-	/* Eventfd used to signal thread to quit */
+	/*
+	** Eventfds used to signal thread to start a stream (with the args below) and signalled by thread having ended it
+	** The thread is created once and waits between streams, exiting if signalled to start with terminate set.
+	*/
+	int start_event_fd;
+	int idle_event_fd;
+	atomic_bool terminate;
+
+	/* Eventfd used to signal thread to end stream */
 	int quit_event_fd;
 
-	/* UDP socket to write to */
-	int output_fd;
+	/*
+	** Eventfd used to signal thread to reconfigure running stream, with the new buffer size (samples) and UDP packet
+	** size (bytes) stored beforehand (zero keeping current value). The latest request wins should they overlap.
+	*/
+	int reconfig_event_fd;
+	atomic_size_t reconfig_buffer_size;
+	atomic_size_t reconfig_packet_size;
+
+	/* IIO context, shared by threads for their lifetime */
+	struct iio_context *iio_ctx;
+
+	/* Time stream start was requested (uS, monotonic) */
+	uint64_t start_time;
+
+	/* UDP sockets to write to, one per sender shard (each buffer's datagrams being shared between them) */
+	int output_fds[THREAD_READ_MAX_SHARDS];
+	unsigned int output_fd_count;
 
 	/* Client address */
 	struct sockaddr_in addr;
@@ -31,6 +64,24 @@ typedef struct
 	/* UDP packet size (in bytes) */
 	size_t udp_packet_size;
 
+	/* IIO kernel buffer / block count (zero for library default) */
+	unsigned int kernel_buffers;
+
+	/* Hardware sample clock, anchored from each buffer's timestamp (NULL if unused) */
+	SAMPLE_CLOCK_t *sample_clock;
+
+	/* Loopback latency probe, completed as its marker arrives in the RX stream (NULL if unused) */
+	LOOPBACK_t *loopback;
+
+	/* Statistics, the RX group being maintained by this thread */
+	STATS_t *stats;
+
+	/* Trace, the read thread and its workers recording their events (NULL if unused) */
+	TRACE_t *trace;
+
+	/* Busy poll budget (uS) spun before blocking for IIO or socket events (legacy backend only), zero never spinning, EPOLL_LOOP_SPIN_FOREVER never blocking */
+	int32_t busy_poll_us;
+
 } THREAD_READ_Args_t;
 
 /* Public functions - Thread entrypoint */
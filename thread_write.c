@@ -14,17 +14,28 @@
 #include <string.h>
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
+#include <sys/socket.h>
 #include <sys/timerfd.h>
+#include <linux/sock_diag.h>
+#include <netinet/udp.h>
 #include <syscall.h>
 #include <time.h>
 #include <unistd.h>
 
-/* libIIO */
-#include <iio.h>
-
 /* Local modules */
 #include "sdr_ip_gadget_types.h"
+#include "buffer_ring.h"
 #include "epoll_loop.h"
+#include "fec.h"
+#include "iio_backend.h"
+#include "iio_cache.h"
+#include "interp.h"
+#include "perf.h"
+#include "sample_unpack.h"
+#include "stats.h"
+#include "trace.h"
+#include "thread_push.h"
+#include "rt_tune.h"
 #include "utils.h"
 
 /* Set the following to periodically report statistics */
@@ -40,8 +51,68 @@
 /* Macros */
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
 #define DEBUG_PRINT(...) if (debug) printf("Write: "__VA_ARGS__)
+#define COUNT(state, stat) STATS_Inc((state)->thread_args->stats, SDR_IP_GADGET_STAT_TX_##stat)
+#define DROP(state, stat) (COUNT(state, stat), TRACE_Record(TRACE_EVENT_DROP, SDR_IP_GADGET_STAT_TX_##stat, TRACE_Now()))
+
+/* Definitions - jitter buffer limits */
+#define JITTER_MAX_BUFFERS (64)
+
+/* Definitions - ring size used when jitter buffer is disabled */
+#define RING_DEFAULT_BUFFERS (4)
+
+/* Definitions - maximum blocks per buffer (limited by data_ip_hdr_t's 8-bit block count) */
+#define MAX_BLOCKS (255)
+
+/* Macros - block bitmap access */
+#define BITMAP_TEST(map, i) (((map)[(i) / 64] >> ((i) % 64)) & 1U)
+#define BITMAP_SET(map, i) ((map)[(i) / 64] |= ((uint64_t)1U << ((i) % 64)))
+
+/* Definitions - UDP GRO option (should libc headers predate it) and coalesced datagram buffer size */
+#ifndef UDP_GRO
+#define UDP_GRO (104)
+#endif
+#define GRO_BUFFER_SIZE (65536)
+
+/* Definitions - NACK window limit, requests per buffer and minimum interval between requests for a buffer */
+#define NACK_MAX_WINDOW (16)
+#define NACK_MAX_REQUESTS (4)
+#define NACK_HOLDOFF_US (500)
 
 /* Type definitions */
+typedef struct
+{
+	/* Sequence number / timestamp */
+	uint64_t seqno;
+
+	/* Blocks received (or recovered), their count and index of first missing */
+	uint64_t received[(MAX_BLOCKS + 63) / 64];
+	size_t received_count;
+	size_t next;
+
+	/* One beyond highest block index received */
+	size_t highest;
+
+	/* FEC parity blocks received (one per group) */
+	uint64_t parity_received[(MAX_BLOCKS + 63) / 64];
+	uint8_t *parity;
+
+	/* Retransmission requests sent and time of last */
+	unsigned int nacks;
+	uint64_t nack_time;
+
+	/* Time final datagram of burst was received (zero unless buffer ends a burst) */
+	uint64_t burst_time;
+
+	/* Time first loopback marker datagram was received (zero unless buffer is marked) */
+	uint64_t marker_time;
+
+	#if GENERATE_STATS
+	/* Time first datagram was received */
+	uint64_t start_time;
+	#endif
+
+} assembly_t;
+
 typedef struct
 {
 	/* Thread args */
@@ -51,17 +122,45 @@ typedef struct
 	bool keep_running;
 
 	/* IIO sample buffer */
-	struct iio_buffer *iio_tx_buffer;
+	IIO_BACKEND_Buffer_t *iio_tx_buffer;
 
 	/* Sample size */
 	size_t sample_size;
 
-	/* Expected IIO buffer size (bytes) */
+	/* Sample format and size as received from the client */
+	uint8_t sample_format;
+	size_t wire_sample_size;
+
+	/* Buffer size (samples, including timestamp) and UDP packet size (bytes, zero if datagrams must arrive in order) */
+	size_t iio_buffer_samples;
+	size_t udp_packet_size;
+
+	/* Expected buffer size as received (bytes, that of the IIO buffer unless interpolating) */
 	size_t iio_buffer_size;
 
 	/* Buffer size in (samples, excluding timestamp) */
 	size_t buffer_size_samples;
 
+	/* Buffer size as pushed to the DAC (bytes, including timestamp), no larger than the IIO buffer */
+	size_t push_buffer_size;
+
+	/* Reconfiguration to be applied once no buffer is part way through reassembly */
+	bool reconfig_pending;
+	size_t reconfig_buffer_samples;
+	size_t reconfig_packet_size;
+
+	/* Interpolator, run by push thread */
+	INTERP_t interp;
+
+	/* Ring of assembled buffers, shared with push thread */
+	BUFFER_RING_t ring;
+
+	/* Push thread args */
+	THREAD_PUSH_Args_t push_args;
+
+	/* Waveform generator (used in place of data socket if requested) */
+	WAVEGEN_t wavegen;
+
 	/* Current block index / count */
 	uint8_t block_index;
 	uint8_t block_count;
@@ -72,27 +171,87 @@ typedef struct
 	/* Current amount of IIO buffer space used (bytes) */
 	size_t iio_buffer_used;
 
+	/*
+	** Indexed reassembly (used when packet size is known)
+	** Blocks are placed according to their index, a buffer being complete once every block has been
+	** received or recovered. Several buffers may be in progress (the window), each being assembled in the
+	** ring slot matching its position, such that the oldest is always the next slot to be committed.
+	*/
+	size_t packet_payload_size;
+	size_t wire_payload_size;
+	size_t blocks_per_buffer;
+	assembly_t *asm_window;
+	size_t asm_window_size;
+	size_t asm_active_count;
+
+	/* Scratch space for a datagram's payload, should no slot be available to receive into or it need expanding */
+	uint8_t *scratch;
+
+	/* Receive buffer for coalesced datagrams (UDP GRO) */
+	uint8_t *gro_buffer;
+
+	/* FEC group size and groups per buffer */
+	size_t fec_group_size;
+	size_t fec_groups;
+	uint8_t *fec_parity;
+
+	/* Retransmission requests enabled */
+	bool nack_enabled;
+
+	/* Address data is being received from (retransmission requests and status reports are sent to it) */
+	struct sockaddr_in data_addr;
+
+	/* Status report timer */
+	int status_timerfd;
+
+	/* Burst idle timer (armed while a partial buffer is pending) */
+	int burst_timerfd;
+	bool burst_timer_armed;
+
+	/* Time final datagram of burst was received, for the buffer next queued (zero unless it ends a burst) */
+	uint64_t burst_time;
+
+	/* Time first loopback marker datagram was received, for the buffer next queued (zero unless it's marked) */
+	uint64_t marker_time;
+
+	/* Time data was last received */
+	uint64_t data_time;
+
 	#if GENERATE_STATS
 	/* Stats reporting timer */
 	int stats_timerfd;
 
-	/* Drop count (due to bad seq no) */
-	uint32_t dropped_seq;
+	/* Counters (drops, recoveries etc, maintained regardless of stats) at last report */
+	uint64_t reported[STATS_GROUP_SIZE];
+
+	/* Status reports sent */
+	uint32_t status_sent;
+
+	/* Receives and datagrams (segments) received by them (UDP GRO) */
+	uint32_t gro_receives;
+	uint32_t gro_segments;
+
+	/* Status report duration timer */
+	UTILS_Histogram_t status_dur;
 
-	/* Drop count (due to bad index) */
-	uint32_t dropped_index;
+	/* Blocks zero filled for partial buffers pushed */
+	uint32_t burst_zero_blocks;
 
-	/* Partial buffer pushes (due to out of order seq no) */
-	uint32_t out_of_order;
+	/* Time first datagram of current buffer was received */
+	uint64_t assembly_start;
 
-	/* Overflow count */
-	uint32_t overflows;
+	/* Reassembly duration timer (first datagram to buffer queued) */
+	UTILS_Histogram_t assembly_dur;
 
-	/* Write period timer */
-	UTILS_TimeStats_t write_period;
+	/* Scheduling counters at last report */
+	RT_TUNE_ThreadStats_t sched_stats;
 
-	/* Write duration timer */
-	UTILS_TimeStats_t write_dur;
+	/* Hardware counters, with those of receiving and reassembling datagrams since last report */
+	PERF_t perf;
+	PERF_Stage_t perf_receive;
+
+	/* Wakeup latency (datagram arriving to thread handling it) */
+	UTILS_Histogram_t wakeup;
 	#endif
 
 } state_t;
@@ -104,9 +263,38 @@ typedef int (*epoll_event_handler)(state_t *state);
 extern bool debug;
 
 /* Private functions */
+static bool stream(THREAD_WRITE_Args_t *thread_args, IIO_CACHE_t *cache);
+static bool set_geometry(state_t *state, size_t iio_buffer_samples, size_t udp_packet_size);
 static int handle_eventfd_thread(state_t *state);
+static int handle_eventfd_reconfig(state_t *state);
+static void reconfigure_check(state_t *state);
 static int handle_socket(state_t *state);
+static size_t sequential_offset(state_t *state);
+static bool handle_datagram(state_t *state, const data_ip_hdr_t *pkt_hdr, const uint8_t *payload, size_t len);
+static int handle_socket_indexed(state_t *state);
+static bool handle_datagram_indexed(state_t *state, const data_ip_hdr_t *pkt_hdr, const uint8_t *payload, size_t len);
+static int handle_socket_gro(state_t *state);
+static uint8_t *assembly_buffer(state_t *state, size_t pos);
+static assembly_t *assembly_open(state_t *state, uint64_t seqno);
+static void assembly_retire(state_t *state, bool complete);
+static void send_nack(state_t *state, size_t pos, size_t limit);
+static size_t block_offset(state_t *state, size_t index);
+static uint8_t *block_ptr(state_t *state, uint8_t *buffer, size_t index);
+static size_t block_len(state_t *state, size_t index);
+static size_t wire_len(state_t *state, size_t len);
+static void place_payload(state_t *state, uint8_t *dest, const uint8_t *payload, size_t len);
+static void mark_received(state_t *state, assembly_t *ctx, size_t index);
+static void fec_recover(state_t *state, assembly_t *ctx, uint8_t *buffer, size_t group);
+static void queue_buffer(state_t *state, bool valid);
+static void flush_partial(state_t *state);
+static void flush_blocks(state_t *state, size_t pos, size_t from);
+static void burst_timer_update(state_t *state, bool pending);
+static int handle_burst_timer(state_t *state);
+static int handle_status_timer(state_t *state);
+static long long read_sample_rate(struct iio_device *iio_dev_tx);
+static size_t jitter_target_from_ms(struct iio_device *iio_dev_tx, size_t buffer_size_samples, uint32_t jitter_ms);
 #if GENERATE_STATS
+static void record_wakeup(state_t *state);
 static int handle_stats_timer(state_t *state);
 #endif
 
@@ -120,8 +308,51 @@ void *THREAD_WRITE_Entrypoint(void *args)
 
 	/* Set name, priority and CPU affinity */
 	pthread_setname_np(pthread_self(), "IP_SDR_GAD_WR");
-	UTILS_SetThreadRealtimePriority();
-	UTILS_SetThreadAffinity(1);
+	RT_TUNE_ApplyThread(RT_TUNE_ROLE_WRITE, 0);
+	TRACE_Register(thread_args->trace, "IP_SDR_GAD_WR");
+
+	/* Buffer kept between streams */
+	IIO_CACHE_t cache;
+	memset(&cache, 0x00, sizeof(cache));
+
+	/* Run a stream each time we're started, until asked to terminate */
+	uint64_t event;
+	while (read(thread_args->start_event_fd, &event, sizeof(event)) >= 0)
+	{
+		if (atomic_load(&thread_args->terminate))
+		{
+			break;
+		}
+
+		if (!stream(thread_args, &cache))
+		{
+			/* Don't reuse a buffer left behind by a failed stream */
+			IIO_CACHE_Flush(&cache);
+		}
+
+		/* Report stream ended */
+		event = 1;
+		if (write(thread_args->idle_event_fd, &event, sizeof(event)) < 0)
+		{
+			perror("Failed to signal write thread idle");
+			break;
+		}
+	}
+
+	/* Release buffer kept between streams */
+	IIO_CACHE_Flush(&cache);
+
+	/* Exit */
+	DEBUG_PRINT("Write thread exit\n");
+
+	return NULL;
+}
+
+/* Private functions */
+static bool stream(THREAD_WRITE_Args_t *thread_args, IIO_CACHE_t *cache)
+{
+	bool result = false;
+	bool reused = false;
 
 	/* Reset state */
 	state_t state;
@@ -131,11 +362,20 @@ void *THREAD_WRITE_Entrypoint(void *args)
 	state.thread_args = thread_args;
 
 	/* Create epoll instance */
+	pthread_t thread_push;
+	bool push_started = false;
+	state.status_timerfd = -1;
+	state.burst_timerfd = -1;
+	state.push_args.ready_event_fd = -1;
+	#if GENERATE_STATS
+	state.stats_timerfd = -1;
+	PERF_Open(&state.perf);
+	#endif
 	int epoll_fd = epoll_create1(0);
 	if (epoll_fd < 0)
 	{
 		perror("Failed to create epoll instance");
-		return NULL;
+		goto done;
 	}
 	else
 	{
@@ -150,105 +390,371 @@ void *THREAD_WRITE_Entrypoint(void *args)
 	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, thread_args->quit_event_fd, &epoll_event) < 0)
 	{
 		perror("Failed to register thread quit eventfd with epoll");
-		return NULL;
+		goto done;
 	}
 	else
 	{
 		DEBUG_PRINT("Registered thread quit eventfd with with epoll :-)\n");
 	}
 
-	/* Create IIO context */
-	struct iio_context *iio_ctx = iio_create_local_context();
-	if (!iio_ctx)
+	/* Register reconfiguration eventfd with epoll */
+	epoll_event.events = EPOLLIN;
+	epoll_event.data.ptr = handle_eventfd_reconfig;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, thread_args->reconfig_event_fd, &epoll_event) < 0)
 	{
-		fprintf(stderr, "Failed to open iio\n");
-		return NULL;
+		perror("Failed to register reconfiguration eventfd with epoll");
+		goto done;
+	}
+	else
+	{
+		DEBUG_PRINT("Registered reconfiguration eventfd with with epoll :-)\n");
 	}
 
 	/* Retrieve TX streaming device */
-	struct iio_device *iio_dev_tx = iio_context_find_device(iio_ctx, "cf-ad9361-dds-core-lpc");
+	struct iio_device *iio_dev_tx = iio_context_find_device(thread_args->iio_ctx, "cf-ad9361-dds-core-lpc");
 	if (!iio_dev_tx)
 	{
 		fprintf(stderr, "Failed to open iio tx dev\n");
-		return NULL;
+		goto done;
 	}
 
-	/* Disable all channels */
-	unsigned int nb_channels = iio_device_get_channels_count(iio_dev_tx);
-	DEBUG_PRINT("Found %i TX channels\n", nb_channels);
-	for (unsigned int i = 0; i < nb_channels; i++)
+	/*
+	** Enable required channels and create buffer, with several kernel blocks so the DMA is kept busy unless cyclic
+	** A non-cyclic buffer is kept between streams by the cache, whereas a cyclic one is replaced with each waveform.
+	*/
+	if (thread_args->cyclic)
+	{
+		/* Device permits only one buffer, release that kept from the last stream */
+		IIO_CACHE_Flush(cache);
+		state.iio_tx_buffer = IIO_BACKEND_CreateBuffer(iio_dev_tx,
+													   thread_args->iio_channels,
+													   thread_args->iio_buffer_size,
+													   thread_args->kernel_buffers,
+													   true,
+													   true);
+	}
+	else
+	{
+		state.iio_tx_buffer = IIO_CACHE_Get(cache,
+											iio_dev_tx,
+											thread_args->iio_channels,
+											thread_args->iio_buffer_size,
+											thread_args->kernel_buffers,
+											true,
+											&reused);
+	}
+	state.push_args.iio_tx_buffer = state.iio_tx_buffer;
+	if (!state.iio_tx_buffer)
 	{
-		iio_channel_disable(iio_device_get_channel(iio_dev_tx, i));
+		fprintf(stderr, "Failed to create tx buffer for %zu samples\n", thread_args->iio_buffer_size);
+		goto done;
 	}
 
-	/* Enable required channels */
-	for (unsigned int i = 0; i < 32; i++)
+	/* Retrieve size of one sample of all enabled channels */
+	state.sample_size = IIO_BACKEND_GetSampleSize(state.iio_tx_buffer);
+
+	/* Determine size of one sample as received from client */
+	state.sample_format = thread_args->sample_format;
+	switch (state.sample_format)
 	{
-		/* Enable channel if required */
-		if (thread_args->iio_channels & (1U << i))
-		{
-			/* Retrieve channel */
-			struct iio_channel *channel = iio_device_get_channel(iio_dev_tx, i);
-			if (!channel)
+		case SDR_IP_GADGET_SAMPLE_FORMAT_S16:
+			state.wire_sample_size = state.sample_size;
+			break;
+
+		case SDR_IP_GADGET_SAMPLE_FORMAT_S8:
+			state.wire_sample_size = state.sample_size / 2;
+			break;
+
+		case SDR_IP_GADGET_SAMPLE_FORMAT_S12_PACKED:
+			if (0 != (state.sample_size % 4))
 			{
-				fprintf(stderr, "Failed to find iio rx chan %u\n", i);
-				return NULL;
+				fprintf(stderr, "Packed 12-bit TX samples require I / Q pairs\n");
+				goto done;
 			}
+			state.wire_sample_size = (state.sample_size * 3) / 4;
+			break;
 
-			/* Enable channels */
-			DEBUG_PRINT("Enable channel: %s, is scan element: %s\n",
-						iio_channel_get_id(channel),
-						iio_channel_is_scan_element(channel) ? "true" : "false");
-			iio_channel_enable(channel);
-		}
+		default:
+			fprintf(stderr, "Unsupported TX sample format %u\n", state.sample_format);
+			goto done;
 	}
 
-	/* Create non-cyclic buffer */
-	state.iio_tx_buffer = iio_device_create_buffer(iio_dev_tx, thread_args->iio_buffer_size, false);
-	if (!state.iio_tx_buffer)
+	/* Prepare interpolator, buffers then carrying samples at the reduced rate (timestamps remaining at the DAC rate) */
+	if ((thread_args->interp_factor > 1) || (0 != thread_args->interp_nco_hz))
 	{
-		fprintf(stderr, "Failed to create tx buffer for %zu samples\n", thread_args->iio_buffer_size);
-		return NULL;
+		unsigned int factor = (thread_args->interp_factor > 1) ? thread_args->interp_factor : 1;
+		long long sample_rate = read_sample_rate(iio_dev_tx);
+		if (thread_args->cyclic || thread_args->generate)
+		{
+			fprintf(stderr, "Interpolation unavailable in cyclic or generator mode\n");
+			goto done;
+		}
+		if ((0 != thread_args->interp_nco_hz) && (sample_rate <= 0))
+		{
+			fprintf(stderr, "Interpolation NCO requires sample rate\n");
+			goto done;
+		}
+		if (!INTERP_Init(&state.interp,
+						 factor,
+						 thread_args->interp_taps,
+						 state.sample_size / sizeof(int16_t),
+						 (0 != thread_args->interp_nco_hz) ? ((double)thread_args->interp_nco_hz / (double)sample_rate) : 0.0))
+		{
+			goto done;
+		}
+		state.push_args.interp = &state.interp;
+		DEBUG_PRINT("TX interpolation factor: %u, taps per phase: %u, NCO: %"PRId32" Hz\n",
+					state.interp.factor,
+					state.interp.taps,
+					thread_args->interp_nco_hz);
 	}
 
-	/* Retrieve number of bytes between two samples of the same channel (aka size of one sample of all enabled channels) */
-	state.sample_size = iio_buffer_step(state.iio_tx_buffer);
+	/* Summarize info */
+	DEBUG_PRINT("TX sample count: %zu, iio sample size: %zu, client sample size: %zu, reused: %s\n",
+				thread_args->iio_buffer_size,
+				state.sample_size,
+				state.wire_sample_size,
+				reused ? "yes" : "no");
 
-	/* Calculate expected buffer size */
-	state.iio_buffer_size = state.sample_size * thread_args->iio_buffer_size;
+	/* Prepare for indexed reassembly if packet size is known */
+	if (thread_args->udp_packet_size > 0)
+	{
+		/* Size window, buffers only being reassembled concurrently when retransmission is enabled */
+		state.nack_enabled = (thread_args->nack_window > 0);
+		state.asm_window_size = state.nack_enabled ? thread_args->nack_window : 1;
+		if (state.asm_window_size > NACK_MAX_WINDOW)
+		{
+			state.asm_window_size = NACK_MAX_WINDOW;
+		}
+		state.asm_window = calloc(state.asm_window_size, sizeof(assembly_t));
+		if (!state.asm_window)
+		{
+			fprintf(stderr, "Failed to allocate reassembly window\n");
+			goto done;
+		}
+		state.fec_group_size = thread_args->fec_group_size;
+	}
+	else if ((thread_args->fec_group_size > 0) || (thread_args->nack_window > 0))
+	{
+		fprintf(stderr, "FEC / NACK require packet size, disabled\n");
+	}
 
-	/* Calculate buffer size, excluding timestamp */
-	state.buffer_size_samples = thread_args->iio_buffer_size;
-	if (thread_args->timestamping_enabled)
+	/* Size buffers and their datagrams */
+	if (!set_geometry(&state, thread_args->iio_buffer_size, thread_args->udp_packet_size))
 	{
-		state.buffer_size_samples -= (sizeof(uint64_t) / state.sample_size);
+		goto done;
 	}
 
-	/* Summarize info */
-	DEBUG_PRINT("TX sample count: %zu, iio sample size: %zu\n",
-				thread_args->iio_buffer_size,
-				state.sample_size);
+	/* Size jitter buffer, from target latency if provided */
+	size_t jitter_target = thread_args->jitter_buffers;
+	if (thread_args->jitter_ms > 0)
+	{
+		jitter_target = jitter_target_from_ms(iio_dev_tx, state.buffer_size_samples, thread_args->jitter_ms);
+	}
+	if (jitter_target > (JITTER_MAX_BUFFERS / 2))
+	{
+		jitter_target = JITTER_MAX_BUFFERS / 2;
+	}
+	if (thread_args->cyclic || thread_args->generate)
+	{
+		/* Waveform is loaded as soon as it's assembled, or generated as required */
+		jitter_target = 0;
+	}
 
-	/* Register data socket with epoll */
-	epoll_event.events = EPOLLIN;
-	epoll_event.data.ptr = handle_socket;
-	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, state.thread_args->input_fd, &epoll_event) < 0)
+	/*
+	** Allocate ring, allowing for bursts of up to the target depth beyond the target, plus slots for reassembly
+	** Each slot is padded by a packet payload, such that a full sized datagram may be received into any block's position
+	*/
+	size_t ring_capacity = (jitter_target > 0) ? ((2 * jitter_target) + 1) : RING_DEFAULT_BUFFERS;
+	if (state.asm_window_size > 1)
 	{
-		perror("Failed to register data socket readable with epoll");
-		return NULL;
+		ring_capacity += state.asm_window_size - 1U;
+	}
+	if (!BUFFER_RING_Init(&state.ring, ring_capacity, state.iio_buffer_size + state.packet_payload_size))
+	{
+		fprintf(stderr, "Failed to allocate ring of %zu buffers\n", ring_capacity);
+		goto done;
+	}
+	DEBUG_PRINT("Jitter buffer target: %zu buffers, ring capacity: %zu buffers\n",
+				jitter_target,
+				ring_capacity - 1);
+
+	/* Prepare push thread args */
+	state.push_args.quit_event_fd = thread_args->quit_event_fd;
+	state.push_args.ring = &state.ring;
+	if (thread_args->generate)
+	{
+		/* Prepare generator */
+		long long sample_rate = read_sample_rate(iio_dev_tx);
+		if (!WAVEGEN_Init(&state.wavegen, &thread_args->wavegen, sample_rate))
+		{
+			fprintf(stderr, "Failed to prepare waveform generator\n");
+			goto done;
+		}
+		state.push_args.wavegen = &state.wavegen;
+		state.push_args.channel_pairs = state.sample_size / (2 * sizeof(int16_t));
+		DEBUG_PRINT("Generating waveform %u at %lld Hz\n", thread_args->wavegen.waveform, sample_rate);
+	}
+	state.push_args.cyclic = thread_args->cyclic;
+	state.push_args.iio_dev = iio_dev_tx;
+	state.push_args.iio_channels = thread_args->iio_channels;
+	state.push_args.iio_buffer_samples = thread_args->iio_buffer_size;
+	state.push_args.iio_buffer_size = state.push_buffer_size;
+	state.push_args.buffer_size_samples = state.buffer_size_samples;
+	state.push_args.timestamping_enabled = thread_args->timestamping_enabled;
+	state.push_args.jitter_target = jitter_target;
+	state.push_args.sample_size = state.sample_size;
+	state.push_args.start_time = thread_args->start_time;
+	state.push_args.busy_poll_us = thread_args->busy_poll_us;
+	state.push_args.loopback = thread_args->loopback;
+	state.push_args.stats = thread_args->stats;
+	state.push_args.trace = thread_args->trace;
+	if (thread_args->release_horizon_ms > 0)
+	{
+		/* Prepare timed release, buffers being held / dropped against the hardware sample clock */
+		long long sample_rate = read_sample_rate(iio_dev_tx);
+		if (!thread_args->timestamping_enabled || thread_args->cyclic || (0 == sample_rate))
+		{
+			fprintf(stderr, "Timed release requires timestamping (and not cyclic mode), disabled\n");
+		}
+		else
+		{
+			state.push_args.sample_clock = thread_args->sample_clock;
+			state.push_args.sample_rate = sample_rate;
+			state.push_args.release_horizon = ((uint64_t)sample_rate * thread_args->release_horizon_ms) / 1000U;
+			state.push_args.late_policy = thread_args->late_policy;
+			DEBUG_PRINT("Timed release horizon: %"PRIu64" samples, late policy: %u\n",
+						state.push_args.release_horizon,
+						state.push_args.late_policy);
+		}
+	}
+	atomic_init(&state.push_args.started, false);
+	atomic_init(&state.push_args.playout_seqno, 0);
+	atomic_init(&state.push_args.pushed_seqno, 0);
+	atomic_init(&state.push_args.underflows, 0);
+
+	/* Prepare eventfd to notify push thread of queued buffers */
+	state.push_args.ready_event_fd = eventfd(0, 0);
+	if (state.push_args.ready_event_fd < 0)
+	{
+		perror("Failed to open buffer ready eventfd");
+		goto done;
 	}
 	else
 	{
-		DEBUG_PRINT("Registered data socket readable with epoll :-)\n");
+		DEBUG_PRINT("Opened buffer ready eventfd :-)\n");
+	}
+
+	/* Start push thread, such that blocking pushes don't hold up draining the socket */
+	if (0 != pthread_create(&thread_push, NULL, &THREAD_PUSH_Entrypoint, &state.push_args))
+	{
+		perror("Failed to start push thread");
+		goto done;
+	}
+	push_started = true;
+
+	/* Prepare to receive coalesced datagrams, which are split before being placed */
+	if (thread_args->udp_gro && !thread_args->generate)
+	{
+		state.gro_buffer = malloc(GRO_BUFFER_SIZE);
+		if (!state.gro_buffer)
+		{
+			fprintf(stderr, "Failed to allocate GRO buffer\n");
+			goto done;
+		}
+	}
+
+	/* Register data socket with epoll (unless generating) */
+	if (!thread_args->generate)
+	{
+		epoll_event.events = EPOLLIN;
+		if (state.gro_buffer)
+		{
+			epoll_event.data.ptr = handle_socket_gro;
+		}
+		else
+		{
+			epoll_event.data.ptr = (state.packet_payload_size > 0) ? handle_socket_indexed : handle_socket;
+		}
+		if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, state.thread_args->input_fd, &epoll_event) < 0)
+		{
+			perror("Failed to register data socket readable with epoll");
+			goto done;
+		}
+		else
+		{
+			DEBUG_PRINT("Registered data socket readable with epoll :-)\n");
+		}
+	}
+
+	/* Create status report timer, if requested */
+	if (thread_args->status_interval_ms > 0)
+	{
+		state.status_timerfd = timerfd_create(CLOCK_MONOTONIC, 0);
+		if (state.status_timerfd < 0)
+		{
+			perror("Failed to open status timerfd");
+			goto done;
+		}
+		struct itimerspec status_period =
+		{
+			.it_value = { .tv_sec = thread_args->status_interval_ms / 1000U, .tv_nsec = (thread_args->status_interval_ms % 1000U) * 1000000L },
+			.it_interval = { .tv_sec = thread_args->status_interval_ms / 1000U, .tv_nsec = (thread_args->status_interval_ms % 1000U) * 1000000L }
+		};
+		if (timerfd_settime(state.status_timerfd, 0, &status_period, NULL) < 0)
+		{
+			perror("Failed to set status timerfd");
+			goto done;
+		}
+
+		/* Register timer with epoll */
+		epoll_event.events = EPOLLIN;
+		epoll_event.data.ptr = handle_status_timer;
+		if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, state.status_timerfd, &epoll_event) < 0)
+		{
+			perror("Failed to register status timer with epoll");
+			goto done;
+		}
+		else
+		{
+			DEBUG_PRINT("Registered status timer with epoll, period %u ms :-)\n", thread_args->status_interval_ms);
+		}
+	}
+
+	/* Create burst idle timer, if requested (armed once a partial buffer is pending) */
+	if ((thread_args->burst_idle_us > 0) && !thread_args->generate && !thread_args->cyclic)
+	{
+		state.burst_timerfd = timerfd_create(CLOCK_MONOTONIC, 0);
+		if (state.burst_timerfd < 0)
+		{
+			perror("Failed to open burst timerfd");
+			goto done;
+		}
+
+		/* Register timer with epoll */
+		epoll_event.events = EPOLLIN;
+		epoll_event.data.ptr = handle_burst_timer;
+		if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, state.burst_timerfd, &epoll_event) < 0)
+		{
+			perror("Failed to register burst timer with epoll");
+			goto done;
+		}
+		else
+		{
+			DEBUG_PRINT("Registered burst timer with epoll, idle timeout %u us :-)\n", thread_args->burst_idle_us);
+		}
 	}
 
 	#if GENERATE_STATS
+	/* Reported counters are those since stream start */
+	STATS_Snapshot(thread_args->stats, SDR_IP_GADGET_STAT_TX_DATAGRAMS >> 8, state.reported);
+
 	/* Create stats reporting timer */
 	state.stats_timerfd = timerfd_create(CLOCK_MONOTONIC, 0);
 	if (state.stats_timerfd < 0)
 	{
 		perror("Failed to open timerfd");
-		return NULL;
+		goto done;
 	}
 	else
 	{
@@ -262,7 +768,7 @@ void *THREAD_WRITE_Entrypoint(void *args)
 	if (timerfd_settime(state.stats_timerfd, 0, &timer_period, NULL) < 0)
 	{
 		perror("Failed to set timerfd");
-		return NULL;
+		goto done;
 	}
 	else
 	{
@@ -276,95 +782,872 @@ void *THREAD_WRITE_Entrypoint(void *args)
 	{
 		/* Failed to register timer with epoll */
 		perror("Failed to register timer eventfd with epoll");
-		return NULL;
+		goto done;
 	}
 	else
 	{
 		DEBUG_PRINT("Registered timer with with epoll :-)\n");
 	}
 
+	/* Timestamp datagrams as they arrive, to measure wakeup latency */
+	if (!thread_args->generate)
+	{
+		int enable = 1;
+		if (setsockopt(thread_args->input_fd, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)) < 0)
+		{
+			perror("Failed to enable data socket timestamps, wakeup latency won't be reported");
+		}
+	}
+
 	/* Init timers */
-	UTILS_ResetTimeStats(&state.write_period);
-	UTILS_ResetTimeStats(&state.write_dur);
+	UTILS_ResetHistogram(&state.assembly_dur);
+	UTILS_ResetHistogram(&state.status_dur);
+	RT_TUNE_GetThreadStats(&state.sched_stats);
+	PERF_ResetStage(&state.perf_receive);
+	UTILS_ResetHistogram(&state.wakeup);
+
+	/* Report start latency, stream now being ready to receive */
+	printf("Write start: ready: %"PRIu64" (uS after request)\n", UTILS_GetMonotonicMicros() - thread_args->start_time);
 	#endif
 
 	/* Enter main loop */
 	DEBUG_PRINT("Enter write loop..\n");
+	result = true;
 	state.keep_running = true;
 	while (state.keep_running)
 	{
-		if (EPOLL_LOOP_Run(epoll_fd, 30000, &state) < 0)
+		if (EPOLL_LOOP_RunPolled(epoll_fd, 30000, thread_args->busy_poll_us, &state) < 0)
 		{
 			/* Epoll failed...bail */
+			result = false;
 			break;
 		}
 	}
 	DEBUG_PRINT("Exit write loop..\n");
 
-	/* Close / destroy everything */
+done:
+	/* Wait for push thread (which watches the same quit eventfd, signalled here should we have failed) */
+	if (push_started)
+	{
+		if (!result)
+		{
+			uint64_t eventfd_val = 1;
+			if (write(thread_args->quit_event_fd, &eventfd_val, sizeof(eventfd_val)) < 0)
+			{
+				perror("Failed to signal push thread");
+			}
+		}
+		pthread_join(thread_push, NULL);
+	}
+
+	/* Close / destroy everything (a non-cyclic buffer being kept for the next stream) */
 	#if GENERATE_STATS
-	close(state.stats_timerfd);
+	if (state.stats_timerfd >= 0)
+	{
+		close(state.stats_timerfd);
+	}
+	PERF_Close(&state.perf);
+	if (!thread_args->generate)
+	{
+		int disable = 0;
+		setsockopt(thread_args->input_fd, SOL_SOCKET, SO_TIMESTAMPNS, &disable, sizeof(disable));
+	}
 	#endif
-	iio_buffer_destroy(state.iio_tx_buffer);
-	iio_context_destroy(iio_ctx);
-	close(epoll_fd);
-
-	/* Exit */
-	DEBUG_PRINT("Write thread exit\n");
-
-	return NULL;
-}
-
-/* Private functions */
-static int handle_eventfd_thread(state_t *state)
-{
-	/* Quit having detected write on eventfd */
-	DEBUG_PRINT("Stop request received\n");
-	state->keep_running = false;
+	if (state.status_timerfd >= 0)
+	{
+		close(state.status_timerfd);
+	}
+	if (state.burst_timerfd >= 0)
+	{
+		close(state.burst_timerfd);
+	}
+	if (state.push_args.ready_event_fd >= 0)
+	{
+		close(state.push_args.ready_event_fd);
+	}
+	if (thread_args->cyclic)
+	{
+		IIO_BACKEND_DestroyBuffer(state.push_args.iio_tx_buffer);
+	}
+	BUFFER_RING_Free(&state.ring);
+	free(state.scratch);
+	free(state.gro_buffer);
+	free(state.fec_parity);
+	free(state.asm_window);
+	INTERP_Destroy(&state.interp);
+	if (epoll_fd >= 0)
+	{
+		close(epoll_fd);
+	}
 
-	return 0;
+	return result;
 }
 
-static int handle_socket(state_t *state)
+static bool set_geometry(state_t *state, size_t iio_buffer_samples, size_t udp_packet_size)
 {
-	/* Prepare scatter/gather structures */
-	struct iovec iov[2];
-	struct msghdr msg;
-	memset(&msg, 0, sizeof(msg));
-	msg.msg_iov = iov;
-	msg.msg_iovlen = 2;
-
-	/* Prepare data packet header */
-	data_ip_hdr_t pkt_hdr;
-	iov[0].iov_base = &pkt_hdr;
-	iov[0].iov_len = sizeof(pkt_hdr);
+	THREAD_WRITE_Args_t *thread_args = state->thread_args;
+	size_t timestamp_samples = thread_args->timestamping_enabled ? (sizeof(uint64_t) / state->sample_size) : 0;
+	if (iio_buffer_samples <= timestamp_samples)
+	{
+		fprintf(stderr, "TX buffer of %zu samples too small\n", iio_buffer_samples);
+		return false;
+	}
 
-	/* Retrieve buffer address */
-	uint8_t *buffer = iio_buffer_start(state->iio_tx_buffer);
+	/* Calculate buffer size, excluding timestamp, and size as pushed */
+	size_t buffer_size_samples = iio_buffer_samples - timestamp_samples;
+	size_t push_buffer_size = state->sample_size * iio_buffer_samples;
 
-	/* Read until socket exhausted (hoping to receive enough packets to fill the buffer) */
-	for (;;)
+	/* Calculate expected buffer size, interpolated buffers carrying samples at the reduced rate (timestamps remaining at the DAC rate) */
+	size_t iio_buffer_size = push_buffer_size;
+	if (state->push_args.interp)
 	{
-		size_t buffer_offset = state->iio_buffer_used;
-
-		if (	(0 == state->iio_buffer_used)
-			 && (state->thread_args->timestamping_enabled)
-		   )
+		unsigned int factor = state->interp.factor;
+		if (0 != (buffer_size_samples % factor))
 		{
-			/* Reserve space at head of buffer for timestamp */
-			buffer_offset += sizeof(uint64_t);
+			fprintf(stderr, "Interpolation requires buffer size to be a multiple of factor %u\n", factor);
+			return false;
 		}
+		iio_buffer_size = (state->sample_size * (buffer_size_samples / factor))
+						  + (thread_args->timestamping_enabled ? sizeof(uint64_t) : 0);
+	}
 
-		/* Prepare buffer pointer */
-		iov[1].iov_base = &buffer[buffer_offset];
-		iov[1].iov_len = state->iio_buffer_size - buffer_offset;
-
-		/* Receive into buffers */
-		int rc = recvmsg(state->thread_args->input_fd, &msg, 0);
-		if (-1 == rc)
+	/* Size blocks if packet size is known, allocating scratch and parity storage aside until all succeeds */
+	size_t wire_payload_size = 0;
+	size_t packet_payload_size = 0;
+	size_t blocks_per_buffer = 0;
+	size_t fec_groups = 0;
+	uint8_t *scratch = NULL;
+	uint8_t *fec_parity = NULL;
+	if (udp_packet_size > 0)
+	{
+		size_t data_size = iio_buffer_size - (thread_args->timestamping_enabled ? sizeof(uint64_t) : 0);
+		if (udp_packet_size <= sizeof(data_ip_hdr_t))
 		{
-			/* Receive failed, check for EAGAIN, which is fine, we ran out of data */
-			if ((EWOULDBLOCK != errno) && (EAGAIN != errno))
+			fprintf(stderr, "TX packet size %zu too small\n", udp_packet_size);
+			return false;
+		}
+		wire_payload_size = udp_packet_size - sizeof(data_ip_hdr_t);
+		packet_payload_size = wire_payload_size;
+		if (SDR_IP_GADGET_SAMPLE_FORMAT_S16 != state->sample_format)
+		{
+			/* Blocks carry whole samples, which expand as they're placed */
+			packet_payload_size = (wire_payload_size / state->wire_sample_size) * state->sample_size;
+			wire_payload_size = wire_len(state, packet_payload_size);
+			if (0 == packet_payload_size)
+			{
+				fprintf(stderr, "TX packet size %zu too small\n", udp_packet_size);
+				return false;
+			}
+		}
+		blocks_per_buffer = (data_size + (packet_payload_size - 1U)) / packet_payload_size;
+		if (blocks_per_buffer > MAX_BLOCKS)
+		{
+			fprintf(stderr, "TX buffer requires %zu blocks, exceeding limit of %u\n", blocks_per_buffer, MAX_BLOCKS);
+			return false;
+		}
+		scratch = malloc(wire_payload_size);
+		if (!scratch)
+		{
+			fprintf(stderr, "Failed to allocate scratch buffer\n");
+			return false;
+		}
+
+		/* Prepare FEC parity storage */
+		if (state->fec_group_size > 0)
+		{
+			fec_groups = (blocks_per_buffer + (state->fec_group_size - 1U)) / state->fec_group_size;
+			fec_parity = malloc(state->asm_window_size * fec_groups * packet_payload_size);
+			if (!fec_parity)
+			{
+				fprintf(stderr, "Failed to allocate FEC parity buffer\n");
+				free(scratch);
+				return false;
+			}
+		}
+	}
+	else if (SDR_IP_GADGET_SAMPLE_FORMAT_S16 != state->sample_format)
+	{
+		/* Compressed samples are received aside before being expanded into the buffer */
+		scratch = malloc(wire_len(state, iio_buffer_size));
+		if (!scratch)
+		{
+			fprintf(stderr, "Failed to allocate scratch buffer\n");
+			return false;
+		}
+	}
+
+	/* Buffers must fit the ring's slots once allocated, which are padded by a packet payload */
+	if (state->ring.mem && ((iio_buffer_size + packet_payload_size) > state->ring.buffer_size))
+	{
+		fprintf(stderr, "TX buffer of %zu bytes (plus payload of %zu) exceeds ring slots of %zu\n",
+				iio_buffer_size,
+				packet_payload_size,
+				state->ring.buffer_size);
+		free(scratch);
+		free(fec_parity);
+		return false;
+	}
+
+	/* Adopt geometry */
+	free(state->scratch);
+	free(state->fec_parity);
+	state->iio_buffer_samples = iio_buffer_samples;
+	state->udp_packet_size = udp_packet_size;
+	state->iio_buffer_size = iio_buffer_size;
+	state->buffer_size_samples = buffer_size_samples;
+	state->push_buffer_size = push_buffer_size;
+	state->wire_payload_size = wire_payload_size;
+	state->packet_payload_size = packet_payload_size;
+	state->blocks_per_buffer = blocks_per_buffer;
+	state->fec_groups = fec_groups;
+	state->scratch = scratch;
+	state->fec_parity = fec_parity;
+	for (size_t i = 0; fec_parity && (i < state->asm_window_size); i++)
+	{
+		state->asm_window[i].parity = &fec_parity[i * fec_groups * packet_payload_size];
+	}
+	if (udp_packet_size > 0)
+	{
+		DEBUG_PRINT("TX blocks per buffer: %zu, payload size: %zu, fec groups: %zu, window: %zu buffers\n",
+					blocks_per_buffer,
+					packet_payload_size,
+					fec_groups,
+					state->asm_window_size);
+	}
+
+	return true;
+}
+
+static int handle_eventfd_thread(state_t *state)
+{
+	/* Quit having detected write on eventfd */
+	DEBUG_PRINT("Stop request received\n");
+	state->keep_running = false;
+
+	return 0;
+}
+
+static int handle_eventfd_reconfig(state_t *state)
+{
+	THREAD_WRITE_Args_t *thread_args = state->thread_args;
+
+	/* Clear event, the request itself having been stored in our args */
+	uint64_t event;
+	if (read(thread_args->reconfig_event_fd, &event, sizeof(event)) < 0)
+	{
+		perror("Failed to read reconfig eventfd");
+		return -1;
+	}
+
+	/* Zero retains current value */
+	size_t iio_buffer_samples = thread_args->reconfig_buffer_size ? thread_args->reconfig_buffer_size : state->iio_buffer_samples;
+	size_t udp_packet_size = thread_args->reconfig_packet_size ? thread_args->reconfig_packet_size : state->udp_packet_size;
+	if (thread_args->cyclic || thread_args->generate)
+	{
+		fprintf(stderr, "TX reconfiguration unavailable in cyclic or generator mode, ignoring\n");
+		return 0;
+	}
+	if (iio_buffer_samples > thread_args->iio_buffer_size)
+	{
+		/* Output blocks can't be resized in place, though they may be pushed partially filled */
+		fprintf(stderr, "TX buffer of %zu samples exceeds stream's DAC buffer of %zu, ignoring (stop and start to enlarge it)\n",
+				iio_buffer_samples,
+				thread_args->iio_buffer_size);
+		return 0;
+	}
+	if ((0 == state->udp_packet_size) && (udp_packet_size > 0))
+	{
+		fprintf(stderr, "TX reconfiguration can't switch to indexed reassembly, ignoring (stop and start with packet size)\n");
+		return 0;
+	}
+	DEBUG_PRINT("Reconfigure request, TX sample count: %zu, UDP packet size: %zu\n", iio_buffer_samples, udp_packet_size);
+
+	/* Switch now, or once the buffer being reassembled has been queued (replacing any request yet to take effect) */
+	state->reconfig_pending = true;
+	state->reconfig_buffer_samples = iio_buffer_samples;
+	state->reconfig_packet_size = udp_packet_size;
+	reconfigure_check(state);
+
+	return 0;
+}
+
+static void reconfigure_check(state_t *state)
+{
+	/*
+	** Switch geometry between buffers, none being part way through reassembly
+	** Buffers already queued keep their own size, which the push thread follows, so neither samples nor the DAC buffer
+	** are lost.
+	*/
+	if (!state->reconfig_pending || (state->iio_buffer_used > 0) || (state->asm_active_count > 0))
+	{
+		return;
+	}
+	state->reconfig_pending = false;
+	if (	(state->reconfig_buffer_samples == state->iio_buffer_samples)
+		 && (state->reconfig_packet_size == state->udp_packet_size)
+	   )
+	{
+		return;
+	}
+
+	if (!set_geometry(state, state->reconfig_buffer_samples, state->reconfig_packet_size))
+	{
+		fprintf(stderr, "TX reconfiguration failed, keeping current sizes\n");
+		return;
+	}
+	DEBUG_PRINT("Switched to TX sample count: %zu, UDP packet size: %zu\n", state->iio_buffer_samples, state->udp_packet_size);
+}
+
+static int handle_socket(state_t *state)
+{
+	#if GENERATE_STATS
+	record_wakeup(state);
+	PERF_Begin(&state->perf);
+	#endif
+
+	/* Prepare scatter/gather structures */
+	struct iovec iov[2];
+	struct msghdr msg;
+	struct sockaddr_in src_addr;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 2;
+	msg.msg_name = &src_addr;
+
+	/* Prepare data packet header */
+	data_ip_hdr_t pkt_hdr;
+	iov[0].iov_base = &pkt_hdr;
+	iov[0].iov_len = sizeof(pkt_hdr);
+
+	/* Retrieve buffer address (ring slot following last queued buffer) */
+	uint8_t *buffer = BUFFER_RING_WriteSlot(&state->ring, 0)->data;
+
+	/* Read until socket exhausted (hoping to receive enough packets to fill the buffer) */
+	for (;;)
+	{
+		size_t buffer_offset = sequential_offset(state);
+
+		/* Prepare buffer pointer (compressed samples being received aside, to be expanded into place) */
+		if (state->scratch)
+		{
+			iov[1].iov_base = state->scratch;
+			iov[1].iov_len = wire_len(state, state->iio_buffer_size - buffer_offset);
+		}
+		else
+		{
+			iov[1].iov_base = &buffer[buffer_offset];
+			iov[1].iov_len = state->iio_buffer_size - buffer_offset;
+		}
+		msg.msg_namelen = sizeof(src_addr);
+
+		/* Receive into buffers */
+		int rc = recvmsg(state->thread_args->input_fd, &msg, 0);
+		if (-1 == rc)
+		{
+			/* Receive failed, check for EAGAIN, which is fine, we ran out of data */
+			if ((EWOULDBLOCK != errno) && (EAGAIN != errno))
+			{
+				/* Oh dear, a "bad" error */
+				perror("Receive failed");
+				return 1;
+			}
+			break;
+		}
+
+		/* Receive succeeded, what did we win? Check magic */
+		if (	((size_t)rc < sizeof(data_ip_hdr_t))
+			 || (SDR_IP_GADGET_MAGIC != pkt_hdr.magic)
+		   )
+		{
+			/* Wrong header size or bad magic, possibly a naughty network application or an honest mistake */
+			continue;
+		}
+
+		/* Remember where data is coming from, for status reports */
+		state->data_addr = src_addr;
+
+		/* Place payload, breaking to main loop having handled an entire iio buffer */
+		if (handle_datagram(state, &pkt_hdr, iov[1].iov_base, (size_t)rc - sizeof(data_ip_hdr_t)))
+		{
+			break;
+		}
+	}
+
+	/* Apply reconfiguration should buffer have been completed */
+	reconfigure_check(state);
+
+	/* (Re)start idle timeout while a partial buffer is pending */
+	burst_timer_update(state, (state->iio_buffer_used > 0));
+
+	#if GENERATE_STATS
+	/* Capture counters of receive */
+	PERF_End(&state->perf, &state->perf_receive);
+	#endif
+
+	return 0;
+}
+
+static size_t sequential_offset(state_t *state)
+{
+	/* Next datagram follows those already received, reserving space at head of buffer for timestamp */
+	size_t buffer_offset = state->iio_buffer_used;
+	if (	(0 == state->iio_buffer_used)
+		 && (state->thread_args->timestamping_enabled)
+	   )
+	{
+		buffer_offset += sizeof(uint64_t);
+	}
+
+	return buffer_offset;
+}
+
+static bool handle_datagram(state_t *state, const data_ip_hdr_t *pkt_hdr, const uint8_t *payload, size_t len)
+{
+	/* Count datagram */
+	COUNT(state, DATAGRAMS);
+	STATS_Add(state->thread_args->stats, SDR_IP_GADGET_STAT_TX_BYTES, len);
+
+	/* Retrieve buffer address (ring slot following last queued buffer) */
+	uint8_t *buffer = BUFFER_RING_WriteSlot(&state->ring, 0)->data;
+	size_t buffer_offset = sequential_offset(state);
+
+	/* Truncate payload exceeding space remaining */
+	size_t len_max = wire_len(state, state->iio_buffer_size - buffer_offset);
+	if (len > len_max)
+	{
+		len = len_max;
+	}
+
+	/* Check packet carries whole samples, if they're to be expanded */
+	if ((state->scratch) && (0 != (len % state->wire_sample_size)))
+	{
+		/* Count dropped datagram */
+		DROP(state, DROPPED_INDEX);
+		return false;
+	}
+
+	if (0 == state->iio_buffer_used)
+	{
+		/* Check packet starts sequence */
+		if (0 != pkt_hdr->block_index)
+		{
+			/* Count dropped datagram */
+			DROP(state, DROPPED_INDEX);
+
+			/* Drop packet, waiting for sequence start */
+			return false;
+		}
+
+		/*
+		** Check packet sequence number / timestamp, discarding any out of order packets
+		** Note this is fragile against time warps
+		*/
+		if (pkt_hdr->seqno < state->seqno)
+		{
+			/* Count dropped datagram */
+			DROP(state, DROPPED_SEQ);
+			return false;
+		}
+
+		/* Reset index and store total */
+		state->block_index = 0;
+		state->block_count = pkt_hdr->block_count;
+
+		/* Is timestamping enabled? */
+		if (state->thread_args->timestamping_enabled)
+		{
+			/* Yes, copy timestamp from header to working data and start of buffer */
+			state->seqno = pkt_hdr->seqno;
+			*((uint64_t*)buffer) = state->seqno;
+		}
+
+		#if GENERATE_STATS
+		/* Record reassembly start time */
+		state->assembly_start = UTILS_GetMonotonicMicros();
+		#endif
+	}
+	else
+	{
+		/* Check index, total and timestamp match */
+		if (	(state->block_index != pkt_hdr->block_index)
+			 || (state->block_count != pkt_hdr->block_count)
+			 || (state->seqno != pkt_hdr->seqno)
+		   )
+		{
+			/* Either an out of order, or duplicate block */
+			/* Count out-of-order datagram */
+			COUNT(state, OUT_OF_ORDER);
+
+			/* Reset buffer */
+			state->iio_buffer_used = 0;
+
+			/* Drop packet */
+			return false;
+		}
+	}
+
+	/* Move payload into place (unless received there), expanding compressed samples */
+	place_payload(state, &buffer[buffer_offset], payload, len);
+	if (state->scratch)
+	{
+		len = (len / state->wire_sample_size) * state->sample_size;
+	}
+
+	/* Update buffer used */
+	if (	(0 == state->iio_buffer_used)
+		 && (state->thread_args->timestamping_enabled)
+	   )
+	{
+		state->iio_buffer_used += sizeof(uint64_t);
+	}
+	state->iio_buffer_used += len;
+
+	/* Advance index */
+	state->block_index++;
+
+	/* Note first marked datagram, the buffer being timed as a loopback probe */
+	if ((pkt_hdr->flags & SDR_IP_GADGET_DATA_FLAG_MARKER) && (0 == state->marker_time))
+	{
+		state->marker_time = UTILS_GetMonotonicMicros();
+	}
+
+	/* Note end of burst */
+	bool end_of_burst = (0 != (pkt_hdr->flags & SDR_IP_GADGET_DATA_FLAG_END_OF_BURST));
+	if (end_of_burst)
+	{
+		state->burst_time = UTILS_GetMonotonicMicros();
+	}
+
+	/* Is buffer full? */
+	if (state->iio_buffer_size == state->iio_buffer_used)
+	{
+		/* Yep, queue it for the push thread */
+		queue_buffer(state, true);
+
+		/* Reset buffer used */
+		state->iio_buffer_used = 0;
+
+		/* Advance sequence number */
+		state->seqno += state->buffer_size_samples;
+
+		return true;
+	}
+
+	if (end_of_burst)
+	{
+		/* Burst ended part way through buffer, push it rather than waiting for the next burst to fill it */
+		flush_partial(state);
+
+		/* Count burst */
+		COUNT(state, BURST_FLUSHES);
+		return true;
+	}
+
+	return false;
+}
+
+static int handle_socket_indexed(state_t *state)
+{
+	#if GENERATE_STATS
+	record_wakeup(state);
+	PERF_Begin(&state->perf);
+	#endif
+
+	/* Prepare scatter/gather structures */
+	struct iovec iov[2];
+	struct msghdr msg;
+	struct sockaddr_in src_addr;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 2;
+	msg.msg_name = &src_addr;
+
+	/* Prepare data packet header */
+	data_ip_hdr_t pkt_hdr;
+	iov[0].iov_base = &pkt_hdr;
+	iov[0].iov_len = sizeof(pkt_hdr);
+
+	/* Read until socket exhausted (hoping to receive enough packets to fill a buffer) */
+	for (;;)
+	{
+		/*
+		** Receive beyond the newest buffer's highest block, such that in order datagrams need no copying
+		** Should it be complete, receive into the slot a following buffer would occupy
+		** Slots are padded, so a full payload fits even at the last block's position
+		** Compressed samples are always received aside, being expanded into place
+		*/
+		size_t count = state->asm_active_count;
+		uint8_t *payload = state->scratch;
+		if (SDR_IP_GADGET_SAMPLE_FORMAT_S16 == state->sample_format)
+		{
+			if ((count > 0) && (state->asm_window[count - 1].highest < state->blocks_per_buffer))
+			{
+				payload = block_ptr(state, assembly_buffer(state, count - 1), state->asm_window[count - 1].highest);
+			}
+			else if ((count < state->asm_window_size) && (count < BUFFER_RING_Space(&state->ring)))
+			{
+				payload = block_ptr(state, assembly_buffer(state, count), 0);
+			}
+		}
+		iov[1].iov_base = payload;
+		iov[1].iov_len = state->wire_payload_size;
+		msg.msg_namelen = sizeof(src_addr);
+
+		/* Receive into buffers */
+		int rc = recvmsg(state->thread_args->input_fd, &msg, 0);
+		if (-1 == rc)
+		{
+			/* Receive failed, check for EAGAIN, which is fine, we ran out of data */
+			if ((EWOULDBLOCK != errno) && (EAGAIN != errno))
+			{
+				/* Oh dear, a "bad" error */
+				perror("Receive failed");
+				return 1;
+			}
+			break;
+		}
+
+		/* Receive succeeded, what did we win? Check magic */
+		if (	((size_t)rc < sizeof(data_ip_hdr_t))
+			 || (SDR_IP_GADGET_MAGIC != pkt_hdr.magic)
+		   )
+		{
+			/* Wrong header size or bad magic, possibly a naughty network application or an honest mistake */
+			continue;
+		}
+
+		/* Remember where data is coming from, for retransmission requests */
+		state->data_addr = src_addr;
+
+		/* Place block, breaking to main loop having handled an entire iio buffer */
+		if (handle_datagram_indexed(state, &pkt_hdr, payload, (size_t)rc - sizeof(data_ip_hdr_t)))
+		{
+			break;
+		}
+	}
+
+	/* Apply reconfiguration should buffer have been completed */
+	reconfigure_check(state);
+
+	/* (Re)start idle timeout while a partial buffer is pending */
+	burst_timer_update(state, (state->asm_active_count > 0));
+
+	#if GENERATE_STATS
+	/* Capture counters of receive */
+	PERF_End(&state->perf, &state->perf_receive);
+	#endif
+
+	return 0;
+}
+
+static bool handle_datagram_indexed(state_t *state, const data_ip_hdr_t *pkt_hdr, const uint8_t *payload, size_t len)
+{
+	/* Count datagram */
+	COUNT(state, DATAGRAMS);
+	STATS_Add(state->thread_args->stats, SDR_IP_GADGET_STAT_TX_BYTES, len);
+
+	bool parity = (0 != (pkt_hdr->flags & SDR_IP_GADGET_DATA_FLAG_FEC_PARITY));
+
+	/* Abandon buffers whose playout time has passed, as they can no longer be completed in time */
+	if (	(state->thread_args->timestamping_enabled)
+		 && (atomic_load_explicit(&state->push_args.started, memory_order_relaxed))
+	   )
+	{
+		uint64_t playout_seqno = atomic_load_explicit(&state->push_args.playout_seqno, memory_order_relaxed);
+		while ((state->asm_active_count > 0) && (state->asm_window[0].seqno < playout_seqno))
+		{
+			assembly_retire(state, false);
+		}
+	}
+
+	/* Find buffer within window */
+	size_t pos = 0;
+	while ((pos < state->asm_active_count) && (state->asm_window[pos].seqno != pkt_hdr->seqno))
+	{
+		pos++;
+	}
+
+	if (pos == state->asm_active_count)
+	{
+		/*
+		** Check packet sequence number / timestamp, discarding any out of order packets
+		** Buffers older than the newest in progress have already been queued or abandoned
+		** Note this is fragile against time warps
+		*/
+		if (	(pkt_hdr->seqno < state->seqno)
+			 || ((pos > 0) && (pkt_hdr->seqno < state->asm_window[pos - 1].seqno))
+		   )
+		{
+			if (pkt_hdr->flags & SDR_IP_GADGET_DATA_FLAG_RETRANSMIT)
+			{
+				/* Count retransmission arriving too late */
+				DROP(state, NACK_LATE);
+			}
+			else if (!parity)
+			{
+				/* Count dropped datagram (parity for a buffer completed without it is expected) */
+				DROP(state, DROPPED_SEQ);
+			}
+			return false;
+		}
+
+		/* Check buffer geometry matches that negotiated */
+		if (pkt_hdr->block_count != state->blocks_per_buffer)
+		{
+			/* Count dropped datagram */
+			DROP(state, DROPPED_INDEX);
+			return false;
+		}
+
+		/* Next buffer has started, request any blocks missing from the end of the previous */
+		if (pos > 0)
+		{
+			send_nack(state, pos - 1, state->blocks_per_buffer);
+		}
+
+		/* Start new buffer */
+		if (!assembly_open(state, pkt_hdr->seqno))
+		{
+			return false;
+		}
+		pos = state->asm_active_count - 1;
+	}
+	else if (pkt_hdr->block_count != state->blocks_per_buffer)
+	{
+		/* Count out-of-order datagram */
+		COUNT(state, OUT_OF_ORDER);
+		return false;
+	}
+
+	assembly_t *ctx = &state->asm_window[pos];
+	uint8_t *buffer = assembly_buffer(state, pos);
+	if (parity)
+	{
+		/* Check parity block is expected and complete */
+		size_t group = pkt_hdr->block_index;
+		if (	(0 == state->fec_group_size)
+			 || (group >= state->fec_groups)
+			 || (len != state->wire_payload_size)
+		   )
+		{
+			/* Count dropped datagram */
+			DROP(state, DROPPED_INDEX);
+			return false;
+		}
+		if (!BITMAP_TEST(ctx->parity_received, group))
+		{
+			/* Store parity (expanding it, which as a bit rearrangement preserves XOR) and attempt recovery of group */
+			place_payload(state, &ctx->parity[group * state->packet_payload_size], payload, state->wire_payload_size);
+			BITMAP_SET(ctx->parity_received, group);
+			fec_recover(state, ctx, buffer, group);
+		}
+	}
+	else
+	{
+		/* Check block index is within buffer and block is complete */
+		size_t index = pkt_hdr->block_index;
+		if (	(index >= state->blocks_per_buffer)
+			 || (len != wire_len(state, block_len(state, index)))
+		   )
+		{
+			/* Count dropped datagram */
+			DROP(state, DROPPED_INDEX);
+			return false;
+		}
+		if (!BITMAP_TEST(ctx->received, index))
+		{
+			if (index != ctx->highest)
+			{
+				/* Count out-of-order datagram */
+				COUNT(state, OUT_OF_ORDER);
+			}
+
+			/* Move block into position (if it wasn't received there) */
+			place_payload(state, block_ptr(state, buffer, index), payload, len);
+			mark_received(state, ctx, index);
+
+			if (pkt_hdr->flags & SDR_IP_GADGET_DATA_FLAG_RETRANSMIT)
+			{
+				/* Count block recovered by retransmission */
+				COUNT(state, NACK_RECOVERED);
+			}
+
+			/* Block may complete a group which lost another */
+			if (state->fec_group_size > 0)
+			{
+				fec_recover(state, ctx, buffer, index / state->fec_group_size);
+			}
+
+			/* Request blocks skipped over */
+			if (ctx->next < ctx->highest)
+			{
+				send_nack(state, pos, ctx->highest);
+			}
+		}
+
+		/* Note first marked datagram, the buffer being timed as a loopback probe */
+		if ((pkt_hdr->flags & SDR_IP_GADGET_DATA_FLAG_MARKER) && (0 == ctx->marker_time))
+		{
+			ctx->marker_time = UTILS_GetMonotonicMicros();
+		}
+
+		if (pkt_hdr->flags & SDR_IP_GADGET_DATA_FLAG_END_OF_BURST)
+		{
+			/* Burst ended part way through buffer, blocks beyond this one won't be sent */
+			ctx->burst_time = UTILS_GetMonotonicMicros();
+			flush_blocks(state, pos, index + 1U);
+
+			/* Count burst */
+			COUNT(state, BURST_FLUSHES);
+		}
+	}
+
+	/* Queue completed buffers, in order */
+	bool queued = false;
+	while (	(state->asm_active_count > 0)
+			&& (state->asm_window[0].received_count == state->blocks_per_buffer)
+		  )
+	{
+		assembly_retire(state, true);
+		queued = true;
+	}
+
+	return queued;
+}
+
+static int handle_socket_gro(state_t *state)
+{
+	#if GENERATE_STATS
+	record_wakeup(state);
+	PERF_Begin(&state->perf);
+	#endif
+
+	/* Prepare message structures, with space for the segment size */
+	struct iovec iov;
+	struct msghdr msg;
+	struct sockaddr_in src_addr;
+	uint8_t control[CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(struct timespec))];
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_name = &src_addr;
+	iov.iov_base = state->gro_buffer;
+	iov.iov_len = GRO_BUFFER_SIZE;
+	bool indexed = (state->packet_payload_size > 0);
+
+	/* Read until socket exhausted (hoping to receive enough packets to fill a buffer) */
+	for (;;)
+	{
+		msg.msg_namelen = sizeof(src_addr);
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		/* Receive (one or more datagrams) */
+		int rc = recvmsg(state->thread_args->input_fd, &msg, 0);
+		if (-1 == rc)
+		{
+			/* Receive failed, check for EAGAIN, which is fine, we ran out of data */
+			if ((EWOULDBLOCK != errno) && (EAGAIN != errno))
 			{
 				/* Oh dear, a "bad" error */
 				perror("Receive failed");
@@ -373,135 +1656,637 @@ static int handle_socket(state_t *state)
 			break;
 		}
 
-		/* Receive succeeded, what did we win? Check magic */
-		if (	((size_t)rc < sizeof(data_ip_hdr_t))
-			 || (SDR_IP_GADGET_MAGIC != pkt_hdr.magic)
-		   )
+		/* Retrieve segment size, absent if a single datagram was received */
+		size_t segment_size = (size_t)rc;
+		for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+		{
+			if ((SOL_UDP == cmsg->cmsg_level) && (UDP_GRO == cmsg->cmsg_type))
+			{
+				int gso_size;
+				memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(gso_size));
+				if (gso_size > 0)
+				{
+					/* Coalesced by GRO */
+					segment_size = (size_t)gso_size;
+				}
+			}
+		}
+
+		/* Handle each datagram in turn (all equal in size, bar possibly the last) */
+		bool queued = false;
+		for (size_t offset = 0; offset < (size_t)rc; offset += segment_size)
+		{
+			size_t len = (size_t)rc - offset;
+			if (len > segment_size)
+			{
+				/* All but the last segment are full */
+				len = segment_size;
+			}
+
+			#if GENERATE_STATS
+			/* Count segment */
+			state->gro_segments++;
+			#endif
+
+			/* Check magic (header copied out, as segments needn't be aligned) */
+			data_ip_hdr_t pkt_hdr;
+			if (len < sizeof(data_ip_hdr_t))
+			{
+				continue;
+			}
+			memcpy(&pkt_hdr, &state->gro_buffer[offset], sizeof(pkt_hdr));
+			if (SDR_IP_GADGET_MAGIC != pkt_hdr.magic)
+			{
+				/* Bad magic, possibly a naughty network application or an honest mistake */
+				continue;
+			}
+
+			/* Remember where data is coming from, for retransmission requests and status reports */
+			state->data_addr = src_addr;
+
+			/* Place payload */
+			const uint8_t *payload = &state->gro_buffer[offset + sizeof(data_ip_hdr_t)];
+			len -= sizeof(data_ip_hdr_t);
+			if (indexed)
+			{
+				queued |= handle_datagram_indexed(state, &pkt_hdr, payload, len);
+			}
+			else
+			{
+				queued |= handle_datagram(state, &pkt_hdr, payload, len);
+			}
+		}
+
+		#if GENERATE_STATS
+		/* Count receive */
+		state->gro_receives++;
+		#endif
+
+		if (queued)
+		{
+			/* Break to main loop having handled an entire iio buffer */
+			break;
+		}
+	}
+
+	/* Apply reconfiguration should buffer have been completed */
+	reconfigure_check(state);
+
+	/* (Re)start idle timeout while a partial buffer is pending */
+	burst_timer_update(state, indexed ? (state->asm_active_count > 0) : (state->iio_buffer_used > 0));
+
+	#if GENERATE_STATS
+	/* Capture counters of receive */
+	PERF_End(&state->perf, &state->perf_receive);
+	#endif
+
+	return 0;
+}
+
+static uint8_t *assembly_buffer(state_t *state, size_t pos)
+{
+	/* Buffers in the window occupy consecutive slots, starting with the next to be committed */
+	return BUFFER_RING_WriteSlot(&state->ring, pos)->data;
+}
+
+static assembly_t *assembly_open(state_t *state, uint64_t seqno)
+{
+	/* Abandon oldest buffer if window is exhausted */
+	if (state->asm_active_count == state->asm_window_size)
+	{
+		assembly_retire(state, false);
+	}
+
+	/* Check ring has a slot for the buffer */
+	if (state->asm_active_count >= BUFFER_RING_Space(&state->ring))
+	{
+		/* No space remains (client is running faster than the DAC), drop buffer */
+		DROP(state, RING_OVERFLOWS);
+		return NULL;
+	}
+
+	/* Reset context, keeping its parity storage */
+	size_t pos = state->asm_active_count++;
+	assembly_t *ctx = &state->asm_window[pos];
+	ctx->seqno = seqno;
+	memset(ctx->received, 0x00, sizeof(ctx->received));
+	ctx->received_count = 0;
+	ctx->next = 0;
+	ctx->highest = 0;
+	memset(ctx->parity_received, 0x00, sizeof(ctx->parity_received));
+	ctx->nacks = 0;
+	ctx->nack_time = 0;
+	ctx->burst_time = 0;
+	ctx->marker_time = 0;
+
+	/* Is timestamping enabled? */
+	if (state->thread_args->timestamping_enabled)
+	{
+		/* Yes, copy timestamp to start of buffer */
+		*((uint64_t*)assembly_buffer(state, pos)) = seqno;
+	}
+
+	#if GENERATE_STATS
+	/* Record reassembly start time */
+	ctx->start_time = UTILS_GetMonotonicMicros();
+	#endif
+
+	return ctx;
+}
+
+static void assembly_retire(state_t *state, bool complete)
+{
+	assembly_t *head = &state->asm_window[0];
+
+	state->seqno = head->seqno;
+	if (complete)
+	{
+		/* Queue it for the push thread */
+		state->burst_time = head->burst_time;
+		state->marker_time = head->marker_time;
+		#if GENERATE_STATS
+		state->assembly_start = head->start_time;
+		#endif
+		queue_buffer(state, true);
+	}
+	else
+	{
+		/* Count buffer lost to missing blocks */
+		DROP(state, UNRECOVERABLE);
+
+		/* Later buffers occupy the following slots, so the abandoned slot must be queued (to be skipped) */
+		if (state->asm_active_count > 1)
 		{
-			/* Wrong header size or bad magic, possibly a naughty network application or an honest mistake */
-			continue;
+			queue_buffer(state, false);
 		}
+	}
+
+	/* Advance sequence number */
+	state->seqno += state->buffer_size_samples;
+
+	/* Shift window, the retired context (and its parity storage) moving to the first unused position */
+	assembly_t retired = *head;
+	memmove(&state->asm_window[0], &state->asm_window[1], (state->asm_active_count - 1U) * sizeof(assembly_t));
+	state->asm_window[--state->asm_active_count] = retired;
+}
 
-		/* Remove packet header length from data remaining */
-		rc -= sizeof(data_ip_hdr_t);
+static void send_nack(state_t *state, size_t pos, size_t limit)
+{
+	assembly_t *ctx = &state->asm_window[pos];
+
+	/* Limit requests per buffer, allowing time for a retransmission to arrive before repeating one */
+	uint64_t now = UTILS_GetMonotonicMicros();
+	if (	(!state->nack_enabled)
+		 || (ctx->nacks >= NACK_MAX_REQUESTS)
+		 || ((ctx->nacks > 0) && ((now - ctx->nack_time) < NACK_HOLDOFF_US))
+	   )
+	{
+		return;
+	}
 
-		if (0 == state->iio_buffer_used)
+	/* Build bitmap of blocks missing below limit */
+	data_ip_nack_t nack;
+	memset(&nack, 0x00, sizeof(nack));
+	nack.magic = SDR_IP_GADGET_MAGIC;
+	nack.block_count = state->blocks_per_buffer;
+	nack.flags = SDR_IP_GADGET_DATA_FLAG_NACK;
+	nack.seqno = ctx->seqno;
+	bool missing = false;
+	for (size_t i = ctx->next; i < limit; i++)
+	{
+		if (!BITMAP_TEST(ctx->received, i))
 		{
-			/* Check packet starts sequence */
-			if (0 != pkt_hdr.block_index)
-			{
-				#if GENERATE_STATS
-				/* Count dropped datagram */
-				state->dropped_index++;
-				#endif
+			nack.missing[i / 8] |= (uint8_t)(1U << (i % 8));
+			missing = true;
+		}
+	}
+	if (!missing)
+	{
+		return;
+	}
 
-				/* Drop packet, waiting for sequence start */
-				continue;
-			}
+	/* Send request to client (dropping it should the socket be full, as another will follow) */
+	if (sendto(state->thread_args->input_fd,
+			   &nack,
+			   sizeof(nack),
+			   0,
+			   (struct sockaddr*)&state->data_addr,
+			   sizeof(state->data_addr)) < 0)
+	{
+		if ((EWOULDBLOCK != errno) && (EAGAIN != errno))
+		{
+			perror("Failed to send NACK");
+		}
+		return;
+	}
+	ctx->nacks++;
+	ctx->nack_time = now;
+
+	/* Count request */
+	COUNT(state, NACKS_SENT);
+}
+
+static size_t block_offset(state_t *state, size_t index)
+{
+	/* Blocks follow timestamp (if present) */
+	size_t offset = index * state->packet_payload_size;
+	if (state->thread_args->timestamping_enabled)
+	{
+		/* Skip timestamp */
+		offset += sizeof(uint64_t);
+	}
+
+	return offset;
+}
+
+static uint8_t *block_ptr(state_t *state, uint8_t *buffer, size_t index)
+{
+	return &buffer[block_offset(state, index)];
+}
+
+static size_t block_len(state_t *state, size_t index)
+{
+	/* Every block is full, except possibly the last */
+	size_t remaining = state->iio_buffer_size - block_offset(state, index);
+
+	return (remaining < state->packet_payload_size) ? remaining : state->packet_payload_size;
+}
+
+static size_t wire_len(state_t *state, size_t len)
+{
+	/* Bytes of client sample data carrying len bytes of buffer */
+	if (SDR_IP_GADGET_SAMPLE_FORMAT_S16 == state->sample_format)
+	{
+		return len;
+	}
+
+	return (len / state->sample_size) * state->wire_sample_size;
+}
+
+static void place_payload(state_t *state, uint8_t *dest, const uint8_t *payload, size_t len)
+{
+	/* Expand compressed samples into place, otherwise copying them unless already in place */
+	switch (state->sample_format)
+	{
+		case SDR_IP_GADGET_SAMPLE_FORMAT_S8:
+			SAMPLE_UNPACK_Int8(dest, payload, len);
+			break;
+
+		case SDR_IP_GADGET_SAMPLE_FORMAT_S12_PACKED:
+			SAMPLE_UNPACK_Packed12(dest, payload, len);
+			break;
 
-			/*
-			** Check packet sequence number / timestamp, discarding any out of order packets
-			** Note this is fragile against time warps
-			*/
-			if (pkt_hdr.seqno < state->seqno)
+		default:
+			if (dest != payload)
 			{
-				#if GENERATE_STATS
-				/* Count dropped datagram */
-				state->dropped_seq++;
-				#endif
-				continue;
+				/* Copy unless received in place */
+				memcpy(dest, payload, len);
 			}
+			break;
+	}
+}
+
+static void mark_received(state_t *state, assembly_t *ctx, size_t index)
+{
+	BITMAP_SET(ctx->received, index);
+	ctx->received_count++;
+	if (index >= ctx->highest)
+	{
+		/* Extend past highest block received */
+		ctx->highest = index + 1U;
+	}
+
+	/* Advance to next missing block */
+	while (	(ctx->next < state->blocks_per_buffer)
+			&& BITMAP_TEST(ctx->received, ctx->next)
+		  )
+	{
+		ctx->next++;
+	}
+}
 
-			/* Reset index and store total */
-			state->block_index = 0;
-			state->block_count = pkt_hdr.block_count;
+static void fec_recover(state_t *state, assembly_t *ctx, uint8_t *buffer, size_t group)
+{
+	/* Parity required */
+	if (!BITMAP_TEST(ctx->parity_received, group))
+	{
+		return;
+	}
 
-			/* Is timestamping enabled? */
-			if (state->thread_args->timestamping_enabled)
+	/* Find group's missing block, recovery being possible only if there's exactly one */
+	size_t first = group * state->fec_group_size;
+	size_t last = first + state->fec_group_size;
+	if (last > state->blocks_per_buffer)
+	{
+		/* Last group may be short */
+		last = state->blocks_per_buffer;
+	}
+	size_t missing = SIZE_MAX;
+	for (size_t i = first; i < last; i++)
+	{
+		if (!BITMAP_TEST(ctx->received, i))
+		{
+			if (SIZE_MAX != missing)
 			{
-				/* Yes, copy timestamp from header to working data and start of buffer */
-				state->seqno = pkt_hdr.seqno;
-				*((uint64_t*)buffer) = state->seqno;
+				/* More than one missing */
+				return;
 			}
+			missing = i;
 		}
-		else
+	}
+	if (SIZE_MAX == missing)
+	{
+		/* Nothing missing */
+		return;
+	}
+
+	/* Reconstruct from parity XOR the group's other blocks (padding overflows into slot padding if last block) */
+	uint8_t *dest = block_ptr(state, buffer, missing);
+	memcpy(dest, &ctx->parity[group * state->packet_payload_size], state->packet_payload_size);
+	for (size_t i = first; i < last; i++)
+	{
+		if (i != missing)
 		{
-			/* Check index, total and timestamp match */
-			if (	(state->block_index != pkt_hdr.block_index)
-				 || (state->block_count != pkt_hdr.block_count)
-				 || (state->seqno != pkt_hdr.seqno)
-			   )
-			{
-				/* Either an out of order, or duplicate block */
-				#if GENERATE_STATS
-				/* Count out-of-order datagram */
-				state->out_of_order++;
-				#endif
+			FEC_XorBlock(dest, block_ptr(state, buffer, i), block_len(state, i));
+		}
+	}
+	mark_received(state, ctx, missing);
 
-				/* Reset buffer */
-				state->iio_buffer_used = 0;
+	/* Count recovered block */
+	COUNT(state, FEC_RECOVERED);
+}
 
-				/* Drop packet */
-				continue;
-			}
+static void queue_buffer(state_t *state, bool valid)
+{
+	if (	(valid)
+		 && (state->thread_args->timestamping_enabled)
+		 && (atomic_load_explicit(&state->push_args.started, memory_order_relaxed))
+		 && (state->seqno < atomic_load_explicit(&state->push_args.playout_seqno, memory_order_relaxed))
+	   )
+	{
+		/*
+		** Buffer arrived after its playout time (zero buffer sent in its place), drop it
+		** It's still queued (to be skipped), as buffers being reassembled beyond it occupy the following slots
+		*/
+		DROP(state, LATE_BUFFERS);
+		valid = false;
+	}
+
+	/* Fill in slot details */
+	BUFFER_RING_Slot_t *slot = BUFFER_RING_WriteSlot(&state->ring, 0);
+	slot->valid = valid;
+	slot->seqno = state->seqno;
+	slot->size = state->push_buffer_size;
+	slot->samples = state->buffer_size_samples;
+	slot->commit_time = UTILS_GetMonotonicMicros();
+	slot->burst_time = valid ? state->burst_time : 0;
+	slot->marker_time = valid ? state->marker_time : 0;
+	state->burst_time = 0;
+	state->marker_time = 0;
+
+	/* Queue slot (data already in place) */
+	if (!BUFFER_RING_Commit(&state->ring))
+	{
+		/* No space remains (client is running faster than the DAC), drop buffer */
+		DROP(state, RING_OVERFLOWS);
+		return;
+	}
+
+	if (valid)
+	{
+		/* Count buffer */
+		COUNT(state, BUFFERS);
+	}
+
+	#if GENERATE_STATS
+	if (valid)
+	{
+		/* Capture reassembly duration */
+		UTILS_RecordHistogram(&state->assembly_dur, slot->commit_time - state->assembly_start);
+	}
+	#endif
+
+	/* Wake push thread */
+	uint64_t eventfd_val = 0x1;
+	if (write(state->push_args.ready_event_fd, &eventfd_val, sizeof(eventfd_val)) < 0)
+	{
+		perror("Failed to write to buffer ready eventfd");
+	}
+}
+
+static void flush_partial(state_t *state)
+{
+	/* Zero pad remainder of buffer and queue it */
+	uint8_t *buffer = BUFFER_RING_WriteSlot(&state->ring, 0)->data;
+	memset(&buffer[state->iio_buffer_used], 0x00, state->iio_buffer_size - state->iio_buffer_used);
+	queue_buffer(state, true);
+
+	/* Reset buffer used, advancing sequence number past buffer */
+	state->iio_buffer_used = 0;
+	state->seqno += state->buffer_size_samples;
+}
+
+static void flush_blocks(state_t *state, size_t pos, size_t from)
+{
+	/* Zero blocks yet to be received, from index onwards */
+	assembly_t *ctx = &state->asm_window[pos];
+	uint8_t *buffer = assembly_buffer(state, pos);
+	for (size_t i = from; i < state->blocks_per_buffer; i++)
+	{
+		if (!BITMAP_TEST(ctx->received, i))
+		{
+			memset(block_ptr(state, buffer, i), 0x00, block_len(state, i));
+			mark_received(state, ctx, i);
+
+			#if GENERATE_STATS
+			/* Count block */
+			state->burst_zero_blocks++;
+			#endif
 		}
+	}
+}
 
-		/* Update buffer used */
-		if (	(0 == state->iio_buffer_used)
-			 && (state->thread_args->timestamping_enabled)
-		   )
+static void burst_timer_update(state_t *state, bool pending)
+{
+	if (state->burst_timerfd < 0)
+	{
+		return;
+	}
+
+	/* Arm (one shot) from the latest data while pending, otherwise disarm */
+	if (pending)
+	{
+		uint32_t idle_us = state->thread_args->burst_idle_us;
+		struct itimerspec idle =
+		{
+			.it_value = { .tv_sec = idle_us / 1000000U, .tv_nsec = (idle_us % 1000000U) * 1000L },
+			.it_interval = { .tv_sec = 0, .tv_nsec = 0 }
+		};
+		state->data_time = UTILS_GetMonotonicMicros();
+		if (timerfd_settime(state->burst_timerfd, 0, &idle, NULL) < 0)
+		{
+			perror("Failed to set burst timerfd");
+			return;
+		}
+		state->burst_timer_armed = true;
+	}
+	else if (state->burst_timer_armed)
+	{
+		struct itimerspec disarm;
+		memset(&disarm, 0x00, sizeof(disarm));
+		if (timerfd_settime(state->burst_timerfd, 0, &disarm, NULL) < 0)
 		{
-			state->iio_buffer_used += sizeof(uint64_t);
+			perror("Failed to disarm burst timerfd");
+			return;
 		}
-		state->iio_buffer_used += (size_t)rc;
+		state->burst_timer_armed = false;
+	}
+}
+
+static int handle_burst_timer(state_t *state)
+{
+	/* Read timer to acknowledge it */
+	uint64_t timerfd_val;
+	if (read(state->burst_timerfd, &timerfd_val, sizeof(timerfd_val)) < 0)
+	{
+		perror("Failed to read burst timerfd");
+		return 1;
+	}
+	state->burst_timer_armed = false;
 
-		/* Advance index */
-		state->block_index++;
+	/* Client has gone quiet part way through a buffer, burst has ended without being flagged */
+	if (state->packet_payload_size > 0)
+	{
+		/* Complete every buffer in progress, missing blocks being zero, and queue them */
+		for (size_t pos = 0; pos < state->asm_active_count; pos++)
+		{
+			flush_blocks(state, pos, 0);
+		}
+		if (state->asm_active_count > 0)
+		{
+			state->asm_window[state->asm_active_count - 1U].burst_time = state->data_time;
 
-		/* Is buffer full? */
-		if (state->iio_buffer_size == state->iio_buffer_used)
+			/* Count burst */
+			COUNT(state, IDLE_FLUSHES);
+		}
+		while (state->asm_active_count > 0)
 		{
-			/* Yep, get ready to send it */
-			#if GENERATE_STATS
-			/* Capture write period */
-			UTILS_UpdateTimeStats(&state->write_period);
+			assembly_retire(state, true);
+		}
+	}
+	else if (state->iio_buffer_used > 0)
+	{
+		/* Pad and queue buffer */
+		state->burst_time = state->data_time;
+		flush_partial(state);
 
-			/* Record write start time */
-			UTILS_StartTimeStats(&state->write_dur);
-			#endif
+		/* Count burst */
+		COUNT(state, IDLE_FLUSHES);
+	}
 
-			/* Perform blocking write */
-			ssize_t nbytes = iio_buffer_push(state->iio_tx_buffer);
-			if (nbytes != (ssize_t)state->iio_buffer_size)
-			{
-				#if GENERATE_STATS
-				/* Count overflow */
-				state->overflows++;
-				#endif
-			}
+	/* Apply reconfiguration held up by buffer */
+	reconfigure_check(state);
 
-			#if GENERATE_STATS
-			/* Capture write end time */
-			UTILS_UpdateTimeStats(&state->write_dur);
+	return 0;
+}
 
-			/* Record period start time (to subtract write time above) */
-			UTILS_StartTimeStats(&state->write_period);
-			#endif
+static int handle_status_timer(state_t *state)
+{
+	/* Read timer to acknowledge it */
+	uint64_t timerfd_val;
+	if (read(state->status_timerfd, &timerfd_val, sizeof(timerfd_val)) < 0)
+	{
+		perror("Failed to read status timerfd");
+		return 1;
+	}
 
-			/* Reset buffer used */
-			state->iio_buffer_used = 0;
+	/* Nowhere to send report until client has sent data */
+	if (AF_INET != state->data_addr.sin_family)
+	{
+		return 0;
+	}
 
-			/* Advance sequence number */
-			state->seqno += state->buffer_size_samples;
+	#if GENERATE_STATS
+	uint64_t start = UTILS_GetMonotonicMicros();
+	#endif
 
-			/* Break to main loop having handled an entire iio buffer */
-			break;
+	/* Build report */
+	data_ip_status_t status;
+	memset(&status, 0x00, sizeof(status));
+	status.magic = SDR_IP_GADGET_MAGIC;
+	status.flags = SDR_IP_GADGET_DATA_FLAG_STATUS;
+	status.seqno = atomic_load_explicit(&state->push_args.pushed_seqno, memory_order_relaxed);
+	status.free_buffers = BUFFER_RING_Space(&state->ring);
+	status.queued_buffers = BUFFER_RING_Count(&state->ring);
+	status.underflows = atomic_load_explicit(&state->push_args.underflows, memory_order_relaxed);
+
+	/* Query socket receive queue usage (reported as zero if kernel doesn't support it) */
+	uint32_t meminfo[SK_MEMINFO_VARS];
+	socklen_t meminfo_len = sizeof(meminfo);
+	if (0 == getsockopt(state->thread_args->input_fd, SOL_SOCKET, SO_MEMINFO, meminfo, &meminfo_len))
+	{
+		status.socket_queued = meminfo[SK_MEMINFO_RMEM_ALLOC];
+	}
+
+	/* Send report (dropping it should the socket be full, as another will follow) */
+	if (sendto(state->thread_args->input_fd,
+			   &status,
+			   sizeof(status),
+			   0,
+			   (struct sockaddr*)&state->data_addr,
+			   sizeof(state->data_addr)) < 0)
+	{
+		if ((EWOULDBLOCK != errno) && (EAGAIN != errno))
+		{
+			perror("Failed to send status");
 		}
+		return 0;
 	}
 
+	#if GENERATE_STATS
+	/* Capture report duration */
+	UTILS_RecordHistogram(&state->status_dur, UTILS_GetMonotonicMicros() - start);
+	state->status_sent++;
+	#endif
+
 	return 0;
 }
 
+static long long read_sample_rate(struct iio_device *iio_dev_tx)
+{
+	/* Query DAC sample rate, returning zero if unknown */
+	long long sample_rate = 0;
+	struct iio_channel *channel = iio_device_find_channel(iio_dev_tx, "voltage0", true);
+	if (	(!channel)
+		 || (IIO_BACKEND_ReadChannelAttr(channel, "sampling_frequency", &sample_rate) < 0)
+		 || (sample_rate <= 0)
+	   )
+	{
+		fprintf(stderr, "Failed to read tx sample rate\n");
+		return 0;
+	}
+
+	return sample_rate;
+}
+
+static size_t jitter_target_from_ms(struct iio_device *iio_dev_tx, size_t buffer_size_samples, uint32_t jitter_ms)
+{
+	/* Query DAC sample rate */
+	long long sample_rate = read_sample_rate(iio_dev_tx);
+	if (0 == sample_rate)
+	{
+		fprintf(stderr, "Jitter buffer disabled\n");
+		return 0;
+	}
+
+	/* Calculate buffers required to cover target, rounding up */
+	uint64_t samples = ((uint64_t)sample_rate * jitter_ms) / 1000U;
+	size_t buffers = (samples + (buffer_size_samples - 1U)) / buffer_size_samples;
+	DEBUG_PRINT("Jitter buffer of %u ms at %lld Hz requires %zu buffers\n", jitter_ms, sample_rate, buffers);
+
+	return (buffers > 0) ? buffers : 1;
+}
+
 #if GENERATE_STATS
 static int handle_stats_timer(state_t *state)
 {
@@ -513,52 +2298,157 @@ static int handle_stats_timer(state_t *state)
 		return 1;
 	}
 
-	/* Report min/max/average write period */
-	printf("Write period: min: %"PRIu64", max: %"PRIu64", avg: %"PRIu64" (uS)\n",
-		   state->write_period.min,
-		   state->write_period.max,
-		   UTILS_CalcAverageTimeStats(&state->write_period)
-	);
+	/* Summary of histogram being reported */
+	char summary[UTILS_HISTOGRAM_SUMMARY_SIZE];
+
+	/* Retrieve increase in counters since last report */
+	STATS_t *stats = state->thread_args->stats;
+	uint32_t dropped_seq = (uint32_t)STATS_Since(stats, SDR_IP_GADGET_STAT_TX_DROPPED_SEQ, state->reported);
+	uint32_t dropped_index = (uint32_t)STATS_Since(stats, SDR_IP_GADGET_STAT_TX_DROPPED_INDEX, state->reported);
+	uint32_t out_of_order = (uint32_t)STATS_Since(stats, SDR_IP_GADGET_STAT_TX_OUT_OF_ORDER, state->reported);
+	uint32_t late_buffers = (uint32_t)STATS_Since(stats, SDR_IP_GADGET_STAT_TX_LATE_BUFFERS, state->reported);
+	uint32_t ring_overflows = (uint32_t)STATS_Since(stats, SDR_IP_GADGET_STAT_TX_RING_OVERFLOWS, state->reported);
+	uint32_t fec_recovered = (uint32_t)STATS_Since(stats, SDR_IP_GADGET_STAT_TX_FEC_RECOVERED, state->reported);
+	uint32_t unrecoverable = (uint32_t)STATS_Since(stats, SDR_IP_GADGET_STAT_TX_UNRECOVERABLE, state->reported);
+	uint32_t nacks_sent = (uint32_t)STATS_Since(stats, SDR_IP_GADGET_STAT_TX_NACKS_SENT, state->reported);
+	uint32_t nack_recovered = (uint32_t)STATS_Since(stats, SDR_IP_GADGET_STAT_TX_NACK_RECOVERED, state->reported);
+	uint32_t nack_late = (uint32_t)STATS_Since(stats, SDR_IP_GADGET_STAT_TX_NACK_LATE, state->reported);
+	uint32_t burst_flushes = (uint32_t)STATS_Since(stats, SDR_IP_GADGET_STAT_TX_BURST_FLUSHES, state->reported);
+	uint32_t idle_flushes = (uint32_t)STATS_Since(stats, SDR_IP_GADGET_STAT_TX_IDLE_FLUSHES, state->reported);
+
+	/* Report percentiles of reassembly duration */
+	printf("Write assembly: %s (uS)\n", UTILS_FormatHistogram(&state->assembly_dur, summary));
+
+	/* Check for dropped due to seq no */
+	if (dropped_seq > 0)
+	{
+		printf("Write dropped_seq: %u in last 5s period\n", dropped_seq);
+	}
 
-	/* Report min/max/average write duration */
-	printf("Write dur: min: %"PRIu64", max: %"PRIu64", avg: %"PRIu64" (uS)\n",
-		   state->write_dur.min,
-		   state->write_dur.max,
-		   UTILS_CalcAverageTimeStats(&state->write_dur)
-	);
+	/* Check for dropped due to index */
+	if (dropped_index > 0)
+	{
+		printf("Write dropped_index: %u in last 5s period\n", dropped_index);
+	}
 
-	/* Check for overflows */
-	if (state->overflows > 0)
+	/* Check for out of order */
+	if (out_of_order > 0)
 	{
-		printf("Write overflows: %u in last 5s period\n", state->overflows);
+		printf("Write out_of_order: %u in last 5s period\n", out_of_order);
 	}
 
-	/* Check for dropped due to seq no */
-	if (state->dropped_seq > 0)
+	/* Check for late buffers */
+	if (late_buffers > 0)
 	{
-		printf("Write dropped_seq: %u in last 5s period\n", state->dropped_seq);
+		printf("Write late_buffers: %u in last 5s period\n", late_buffers);
 	}
 
-	/* Check for dropped due to index */
-	if (state->dropped_index > 0)
+	/* Check for ring overflows */
+	if (ring_overflows > 0)
 	{
-		printf("Write dropped_index: %u in last 5s period\n", state->dropped_index);
+		printf("Write ring_overflows: %u in last 5s period\n", ring_overflows);
 	}
 
-	/* Check for out of order */
-	if (state->out_of_order > 0)
+	/* Check for recovered blocks */
+	if (fec_recovered > 0)
+	{
+		printf("Write fec_recovered: %u in last 5s period\n", fec_recovered);
+	}
+
+	/* Check for unrecoverable buffers */
+	if (unrecoverable > 0)
+	{
+		printf("Write unrecoverable: %u in last 5s period\n", unrecoverable);
+	}
+
+	/* Check for retransmission requests */
+	if (nacks_sent > 0)
+	{
+		printf("Write nacks_sent: %u, nack_recovered: %u, nack_late: %u in last 5s period\n",
+			   nacks_sent,
+			   nack_recovered,
+			   nack_late);
+	}
+
+	/* Report percentiles of status report duration */
+	if (state->status_sent > 0)
+	{
+		printf("Write status: %u sent, %s (uS)\n", state->status_sent, UTILS_FormatHistogram(&state->status_dur, summary));
+	}
+
+	/* Report average datagrams per receive */
+	if (state->gro_receives > 0)
+	{
+		printf("Write GRO: %u receives, avg %u.%02u segments per receive\n",
+			   state->gro_receives,
+			   state->gro_segments / state->gro_receives,
+			   ((state->gro_segments % state->gro_receives) * 100U) / state->gro_receives);
+	}
+
+	/* Check for partial buffers pushed at end of burst */
+	if ((burst_flushes > 0) || (idle_flushes > 0))
+	{
+		printf("Write bursts: %u flagged, %u idle, %u blocks zero filled in last 5s period\n",
+			   burst_flushes,
+			   idle_flushes,
+			   state->burst_zero_blocks);
+	}
+
+	/* Report percentiles of wakeup latency */
+	if (state->wakeup.count > 0)
 	{
-		printf("Write out_of_order: %u in last 5s period\n", state->out_of_order);
+		printf("Write wakeup: %s (uS)\n", UTILS_FormatHistogram(&state->wakeup, summary));
 	}
 
+	/* Report scheduling latency and page faults */
+	RT_TUNE_ReportThreadStats("Write", &state->sched_stats);
+
+	/* Report hardware counters of receiving, per buffer queued and byte received */
+	PERF_Report("Write receive",
+				&state->perf,
+				&state->perf_receive,
+				STATS_Since(stats, SDR_IP_GADGET_STAT_TX_BUFFERS, state->reported),
+				STATS_Since(stats, SDR_IP_GADGET_STAT_TX_BYTES, state->reported));
+
 	/* Reset stats */
-	UTILS_ResetTimeStats(&state->write_period);
-	UTILS_ResetTimeStats(&state->write_dur);
-	state->overflows = 0;
-	state->dropped_seq = 0;
-	state->dropped_index = 0;
-	state->out_of_order = 0;
+	UTILS_ResetHistogram(&state->assembly_dur);
+	UTILS_ResetHistogram(&state->status_dur);
+	state->status_sent = 0;
+	state->gro_receives = 0;
+	state->gro_segments = 0;
+	state->burst_zero_blocks = 0;
+	STATS_Snapshot(stats, SDR_IP_GADGET_STAT_TX_DATAGRAMS >> 8, state->reported);
+	UTILS_ResetHistogram(&state->wakeup);
 
 	return 0;
 }
+
+static void record_wakeup(state_t *state)
+{
+	/* Peek at arrival time of first datagram queued, without receiving it */
+	struct msghdr msg;
+	uint8_t control[CMSG_SPACE(sizeof(struct timespec))];
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	if (recvmsg(state->thread_args->input_fd, &msg, MSG_PEEK | MSG_DONTWAIT) < 0)
+	{
+		/* Nothing queued (or timestamps unavailable) */
+		return;
+	}
+
+	/* Time since arrival (kernel timestamps being wall clock) */
+	for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+	{
+		if ((SOL_SOCKET == cmsg->cmsg_level) && (SO_TIMESTAMPNS == cmsg->cmsg_type))
+		{
+			struct timespec arrived, now;
+			memcpy(&arrived, CMSG_DATA(cmsg), sizeof(arrived));
+			clock_gettime(CLOCK_REALTIME, &now);
+			int64_t latency_ns = ((int64_t)(now.tv_sec - arrived.tv_sec) * 1000000000) + (now.tv_nsec - arrived.tv_nsec);
+			UTILS_RecordHistogram(&state->wakeup, (latency_ns > 0) ? ((uint64_t)latency_ns / 1000U) : 0U);
+			break;
+		}
+	}
+}
 #endif
@@ -2,20 +2,53 @@
 #define __THREAD_WRITE_H__
 
 /* Standard libraries */
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <netinet/in.h>
 
+/* Local modules */
+#include "loopback.h"
+#include "sample_clock.h"
+#include "stats.h"
+#include "trace.h"
+#include "wavegen.h"
+
 /* Type definitions - thread args */
 typedef struct
 {
-	/* Eventfd used to signal thread to quit */
+	/*
+	** Eventfds used to signal thread to start a stream (with the args below) and signalled by thread having ended it
+	** The thread is created once and waits between streams, exiting if signalled to start with terminate set.
+	*/
+	int start_event_fd;
+	int idle_event_fd;
+	atomic_bool terminate;
+
+	/* Eventfd used to signal thread to end stream */
 	int quit_event_fd;
 
+	/*
+	** Eventfd used to signal thread to reconfigure running stream, with the new buffer size (samples) and UDP packet
+	** size (bytes) stored beforehand (zero keeping current value). The latest request wins should they overlap.
+	*/
+	int reconfig_event_fd;
+	atomic_size_t reconfig_buffer_size;
+	atomic_size_t reconfig_packet_size;
+
+	/* IIO context, shared by threads for their lifetime */
+	struct iio_context *iio_ctx;
+
+	/* Time stream start was requested (uS, monotonic) */
+	uint64_t start_time;
+
 	/* UDP socket to read from */
 	int input_fd;
 
+	/* UDP socket has generic receive offload enabled (datagrams arriving coalesced into segments) */
+	bool udp_gro;
+
 	/* Client address */
 	struct sockaddr_in addr;
 
@@ -28,6 +61,64 @@ typedef struct
 	/* Sample buffer size (in samples) */
 	size_t iio_buffer_size;
 
+	/* Jitter buffer depth (in buffers, zero to disable) */
+	size_t jitter_buffers;
+
+	/* Jitter buffer target latency (milliseconds, overrides depth when non-zero) */
+	uint32_t jitter_ms;
+
+	/* IIO kernel buffer count (zero for library default) */
+	unsigned int kernel_buffers;
+
+	/* UDP packet size (in bytes, zero if datagrams must arrive in order) */
+	size_t udp_packet_size;
+
+	/* FEC group size (in blocks, zero to disable) */
+	size_t fec_group_size;
+
+	/* NACK window (in buffers, zero to disable retransmission requests) */
+	size_t nack_window;
+
+	/* Status report interval (milliseconds, zero to disable) */
+	uint32_t status_interval_ms;
+
+	/* Sample format of datagrams (SDR_IP_GADGET_SAMPLE_FORMAT_*) */
+	uint8_t sample_format;
+
+	/* Cyclic mode (a received buffer being repeated by the DAC until replaced) */
+	bool cyclic;
+
+	/* Timed release horizon (milliseconds, zero to push buffers regardless of timestamp) and late buffer policy */
+	uint32_t release_horizon_ms;
+	uint8_t late_policy;
+
+	/* Burst idle timeout (microseconds, zero to push partial buffers only on end of burst) */
+	uint32_t burst_idle_us;
+
+	/* Interpolation factor (zero or one to receive samples at the DAC rate), filter taps per phase and NCO shift (Hz) */
+	uint8_t interp_factor;
+	uint8_t interp_taps;
+	int32_t interp_nco_hz;
+
+	/* Hardware sample clock, anchored by RX thread while running */
+	SAMPLE_CLOCK_t *sample_clock;
+
+	/* Generate waveform rather than receiving samples from the data socket */
+	bool generate;
+	WAVEGEN_Config_t wavegen;
+
+	/* Loopback latency probe, armed by push thread as marked buffers are pushed (NULL if unused) */
+	LOOPBACK_t *loopback;
+
+	/* Statistics, the TX and push groups being maintained by this thread and its push thread */
+	STATS_t *stats;
+
+	/* Trace, this thread and its push thread recording their events (NULL if unused) */
+	TRACE_t *trace;
+
+	/* Busy poll budget (uS) spun before blocking for events, zero never spinning, EPOLL_LOOP_SPIN_FOREVER never blocking */
+	int32_t busy_poll_us;
+
 } THREAD_WRITE_Args_t;
 
 /* Public functions - Thread entrypoint */
@@ -0,0 +1,243 @@
+/* Public header */
+#include "trace.h"
+
+/* Standard / system libraries */
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* Local modules */
+#include "stats.h"
+
+/* Macros */
+#define DEBUG_PRINT(...) if (debug) printf("Trace: "__VA_ARGS__)
+
+/* Definitions - Chrome trace event phases */
+#define PHASE_INSTANT 'i'
+#define PHASE_BEGIN 'B'
+#define PHASE_END 'E'
+
+/* Global variables */
+extern bool debug;
+__thread TRACE_Ring_t *trace_ring;
+
+/* Private variables - event names, phases and argument names (NULL if argument unused) */
+static const struct
+{
+	const char *name;
+	char phase;
+	const char *arg;
+
+} event_info[TRACE_EVENTS] =
+{
+	{ "epoll_wake", PHASE_INSTANT, "events" },
+	{ "drop", PHASE_INSTANT, "reason" },
+	{ "rx_refill", PHASE_BEGIN, NULL },
+	{ "rx_refill", PHASE_END, NULL },
+	{ "rx_send", PHASE_BEGIN, NULL },
+	{ "rx_send", PHASE_END, "datagrams" },
+	{ "push_refill", PHASE_BEGIN, NULL },
+	{ "push_refill", PHASE_END, NULL },
+	{ "push_submit", PHASE_BEGIN, NULL },
+	{ "push_submit", PHASE_END, "samples" }
+};
+
+/* Private functions */
+static size_t copy_ring(const TRACE_Ring_t *ring, TRACE_Entry_t *copy, uint64_t *first);
+static long write_ring(FILE *file, const TRACE_Ring_t *ring, TRACE_Entry_t *copy, uint64_t since, bool *separate);
+
+/* Public functions */
+void TRACE_Init(TRACE_t *trace)
+{
+	memset(trace, 0x00, sizeof(*trace));
+	pthread_mutex_init(&trace->lock, NULL);
+}
+
+void TRACE_Destroy(TRACE_t *trace)
+{
+	for (unsigned int i = 0; i < trace->ring_count; i++)
+	{
+		free(trace->ring[i]);
+	}
+	trace->ring_count = 0;
+	pthread_mutex_destroy(&trace->lock);
+}
+
+void TRACE_Register(TRACE_t *trace, const char *name)
+{
+	if (!trace)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&trace->lock);
+
+	/* Reuse ring of previous thread of same name */
+	TRACE_Ring_t *ring = NULL;
+	for (unsigned int i = 0; i < trace->ring_count; i++)
+	{
+		if (0 == strcmp(trace->ring[i]->name, name))
+		{
+			ring = trace->ring[i];
+			break;
+		}
+	}
+
+	if (!ring)
+	{
+		/* Allocate ring, entries being faulted in now rather than by the first events */
+		if (trace->ring_count >= TRACE_MAX_RINGS)
+		{
+			fprintf(stderr, "Trace ring limit reached, not tracing thread %s\n", name);
+		}
+		else if (!(ring = malloc(sizeof(TRACE_Ring_t))))
+		{
+			perror("Failed to allocate trace ring");
+		}
+		else
+		{
+			memset(ring, 0x00, sizeof(*ring));
+			atomic_init(&ring->head, 0);
+			snprintf(ring->name, sizeof(ring->name), "%s", name);
+			trace->ring[trace->ring_count++] = ring;
+		}
+	}
+	if (ring)
+	{
+		ring->tid = (pid_t)syscall(SYS_gettid);
+		DEBUG_PRINT("Tracing thread %s (tid: %ld)\n", name, (long)ring->tid);
+	}
+
+	pthread_mutex_unlock(&trace->lock);
+
+	trace_ring = ring;
+}
+
+long TRACE_Dump(TRACE_t *trace, const char *path, unsigned int seconds)
+{
+	/* Working copy of each ring in turn, such that its thread is left undisturbed while events are formatted */
+	TRACE_Entry_t *copy = malloc(sizeof(((TRACE_Ring_t*)NULL)->entry));
+	if (!copy)
+	{
+		perror("Failed to allocate trace copy");
+		return -1;
+	}
+
+	FILE *file = fopen(path, "w");
+	if (!file)
+	{
+		perror("Failed to open trace file");
+		free(copy);
+		return -1;
+	}
+
+	/* Dump events since */
+	uint64_t now = UTILS_GetMonotonicMicros();
+	uint64_t period = (uint64_t)seconds * 1000000U;
+	uint64_t since = (now > period) ? (now - period) : 0;
+
+	/* Rings registered so far (which persist until destroyed), registration not waiting on the dump */
+	pthread_mutex_lock(&trace->lock);
+	unsigned int ring_count = trace->ring_count;
+	TRACE_Ring_t *ring[TRACE_MAX_RINGS];
+	memcpy(ring, trace->ring, sizeof(ring));
+	pthread_mutex_unlock(&trace->lock);
+
+	long events = 0;
+	bool separate = false;
+	fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	for (unsigned int i = 0; i < ring_count; i++)
+	{
+		events += write_ring(file, ring[i], copy, since, &separate);
+	}
+	fprintf(file, "\n]}\n");
+
+	free(copy);
+	if (0 != fclose(file))
+	{
+		perror("Failed to write trace file");
+		return -1;
+	}
+
+	return events;
+}
+
+/* Private functions */
+static size_t copy_ring(const TRACE_Ring_t *ring, TRACE_Entry_t *copy, uint64_t *first)
+{
+	uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+	memcpy(copy, ring->entry, sizeof(ring->entry));
+	atomic_thread_fence(memory_order_acquire);
+	uint64_t after = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+	/*
+	** Keep entries written before the copy, less those overwritten since (along with the one which may have been
+	** being written as it completed)
+	*/
+	uint64_t oldest = (head > TRACE_RING_ENTRIES) ? (head - TRACE_RING_ENTRIES) : 0;
+	if (after >= TRACE_RING_ENTRIES)
+	{
+		uint64_t overwritten = after - TRACE_RING_ENTRIES + 1U;
+		if (overwritten > oldest)
+		{
+			/* Entries overwritten during copy */
+			oldest = overwritten;
+		}
+	}
+
+	*first = oldest;
+	return (head > oldest) ? (size_t)(head - oldest) : 0;
+}
+
+static long write_ring(FILE *file, const TRACE_Ring_t *ring, TRACE_Entry_t *copy, uint64_t since, bool *separate)
+{
+	pid_t pid = getpid();
+
+	/* Name thread */
+	fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%ld,\"args\":{\"name\":\"%s\"}}",
+			*separate ? ",\n" : "",
+			(long)pid,
+			(long)ring->tid,
+			ring->name);
+	*separate = true;
+
+	uint64_t first;
+	size_t count = copy_ring(ring, copy, &first);
+	long events = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		const TRACE_Entry_t *entry = &copy[(first + i) & (TRACE_RING_ENTRIES - 1)];
+		if ((entry->time < since) || (entry->event >= TRACE_EVENTS))
+		{
+			continue;
+		}
+
+		/* Event, timestamped in uS */
+		fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%"PRIu64",\"pid\":%ld,\"tid\":%ld",
+				event_info[entry->event].name,
+				event_info[entry->event].phase,
+				entry->time,
+				(long)pid,
+				(long)ring->tid);
+		if (PHASE_INSTANT == event_info[entry->event].phase)
+		{
+			/* Scoped to thread */
+			fprintf(file, ",\"s\":\"t\"");
+		}
+		if (TRACE_EVENT_DROP == entry->event)
+		{
+			fprintf(file, ",\"args\":{\"reason\":\"%s\"}", STATS_Name((uint16_t)entry->arg));
+		}
+		else if (event_info[entry->event].arg)
+		{
+			fprintf(file, ",\"args\":{\"%s\":%"PRIu32"}", event_info[entry->event].arg, entry->arg);
+		}
+		fprintf(file, "}");
+		events++;
+	}
+
+	return events;
+}
@@ -0,0 +1,135 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+/* Standard libraries */
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+/* Local modules */
+#include "utils.h"
+
+/* Definitions - events per thread's ring (power of two), the oldest being overwritten */
+#ifndef TRACE_RING_ENTRIES
+#define TRACE_RING_ENTRIES (16384)
+#endif
+
+/* Definitions - threads traced (read, write, push and read shards) */
+#define TRACE_MAX_RINGS (16)
+
+/* Definitions - dump destination, and period dumped unless requested otherwise (seconds) */
+#define TRACE_DUMP_PATH "/tmp/sdr_ip_gadget_trace.json"
+#define TRACE_DUMP_DEFAULT_SECS (5)
+
+/* Definitions - events (TRACE_EVENT_*_BEGIN and TRACE_EVENT_*_END bracketing a slice), with their argument */
+#define TRACE_EVENT_WAKE (0) // Epoll wake, events ready
+#define TRACE_EVENT_DROP (1) // Data dropped, SDR_IP_GADGET_STAT_* counting it
+#define TRACE_EVENT_RX_REFILL_BEGIN (2) // Dequeuing RX block
+#define TRACE_EVENT_RX_REFILL_END (3)
+#define TRACE_EVENT_RX_SEND_BEGIN (4) // Sending RX block (or shard's share of it)
+#define TRACE_EVENT_RX_SEND_END (5) // Datagrams sent
+#define TRACE_EVENT_PUSH_REFILL_BEGIN (6) // Waiting for free TX block
+#define TRACE_EVENT_PUSH_REFILL_END (7)
+#define TRACE_EVENT_PUSH_SUBMIT_BEGIN (8) // Submitting TX block
+#define TRACE_EVENT_PUSH_SUBMIT_END (9) // Samples submitted
+#define TRACE_EVENTS (10)
+
+/* Type definitions - traced event */
+typedef struct
+{
+	/* Time (uS, monotonic) */
+	uint64_t time;
+
+	/* Argument, per event */
+	uint32_t arg;
+
+	/* Event (TRACE_EVENT_*) */
+	uint16_t event;
+
+} TRACE_Entry_t;
+
+/*
+** Type definitions - ring of one thread's events
+** Written by its thread alone, which publishes each entry by advancing head. Readers copy the ring, discarding
+** entries which may have been overwritten while copying.
+*/
+typedef struct
+{
+	/* Entries written */
+	_Atomic uint64_t head;
+
+	/* Thread */
+	char name[16];
+	pid_t tid;
+
+	/* Entries, indexed by their number modulo TRACE_RING_ENTRIES */
+	TRACE_Entry_t entry[TRACE_RING_ENTRIES];
+
+} TRACE_Ring_t;
+
+/*
+** Type definitions - trace, rings of all threads
+** Each thread registers once it starts, the ring of a previous thread of the same name being reused (such that
+** threads created per stream don't exhaust them). Tracing is enabled on request, threads otherwise being left
+** unregistered.
+*/
+typedef struct
+{
+	/* Protects registration */
+	pthread_mutex_t lock;
+
+	/* Rings registered */
+	unsigned int ring_count;
+	TRACE_Ring_t *ring[TRACE_MAX_RINGS];
+
+} TRACE_t;
+
+/* Ring of calling thread (NULL if unregistered, events being ignored) */
+extern __thread TRACE_Ring_t *trace_ring;
+
+/* Initialise trace, without rings */
+void TRACE_Init(TRACE_t *trace);
+
+/* Destroy trace, freeing its rings */
+void TRACE_Destroy(TRACE_t *trace);
+
+/* Register calling thread, its events being recorded from now (ignored should trace be NULL) */
+void TRACE_Register(TRACE_t *trace, const char *name);
+
+/*
+** Record event (TRACE_EVENT_*) with argument in calling thread's ring, at time micros (uS, monotonic)
+** Times are those the caller has already taken for its stats (UTILS_GetMonotonicMicros()), an event costing a few
+** stores rather than a read of the clock (a system call on some targets).
+*/
+static inline void TRACE_Record(uint16_t event, uint32_t arg, uint64_t micros)
+{
+	TRACE_Ring_t *ring = trace_ring;
+	if (!ring)
+	{
+		return;
+	}
+
+	/* Fill in entry, publishing it */
+	uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	TRACE_Entry_t *entry = &ring->entry[head & (TRACE_RING_ENTRIES - 1)];
+	entry->time = micros;
+	entry->arg = arg;
+	entry->event = event;
+	atomic_store_explicit(&ring->head, head + 1U, memory_order_release);
+}
+
+/* Retrieve time (uS, monotonic) for an event its caller hasn't timed, the clock only being read while traced */
+static inline uint64_t TRACE_Now(void)
+{
+	return trace_ring ? UTILS_GetMonotonicMicros() : 0;
+}
+
+/*
+** Dump events of the last seconds of all threads to file, in Chrome trace event (JSON) format as viewed by Perfetto
+** or chrome://tracing, returning number of events written or negative on failure
+*/
+long TRACE_Dump(TRACE_t *trace, const char *path, unsigned int seconds);
+
+#endif
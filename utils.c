@@ -5,8 +5,7 @@
 #include "utils.h"
 
 /* Standard libraries */
-#include <errno.h>
-#include <pthread.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
@@ -16,10 +15,11 @@
 #define NS_PER_US (1000)
 
 /* Private functions */
-static uint64_t GetMonotonicMicros(void);
+static inline unsigned int histogram_bucket(uint64_t value);
+static uint64_t histogram_bucket_highest(unsigned int bucket);
 
 /* Public functions */
-void UTILS_ResetTimeStats(UTILS_TimeStats_t *ctx)
+void UTILS_ResetHistogram(UTILS_Histogram_t *ctx)
 {
     /* Zero structure */
     memset(ctx, 0x00, sizeof(*ctx));
@@ -28,27 +28,21 @@ void UTILS_ResetTimeStats(UTILS_TimeStats_t *ctx)
     ctx->min = UINT64_MAX;
 }
 
-void UTILS_StartTimeStats(UTILS_TimeStats_t *ctx)
+void UTILS_StartHistogram(UTILS_Histogram_t *ctx)
 {
     /* Set last timestamp and flag initialized */
-    ctx->last_time = GetMonotonicMicros();
+    ctx->last_time = UTILS_GetMonotonicMicros();
     ctx->initialized = true;
 }
 
-void UTILS_UpdateTimeStats(UTILS_TimeStats_t *ctx)
+void UTILS_UpdateHistogram(UTILS_Histogram_t *ctx)
 {
-    uint64_t curr_time = GetMonotonicMicros();
+    uint64_t curr_time = UTILS_GetMonotonicMicros();
 
     if (ctx->initialized)
     {
-        /* Calculate time difference */
-        uint64_t diff = curr_time - ctx->last_time;
-
-        /* Update stats */
-        ctx->total += diff;
-        ctx->count++;
-        if (diff < ctx->min) ctx->min = diff;
-        if (diff > ctx->max) ctx->max = diff;
+        /* Update stats with time difference */
+        UTILS_RecordHistogram(ctx, curr_time - ctx->last_time);
     }
 
     /* Set last timestamp and flag initialized */
@@ -56,54 +50,98 @@ void UTILS_UpdateTimeStats(UTILS_TimeStats_t *ctx)
     ctx->initialized = true;
 }
 
-uint64_t UTILS_CalcAverageTimeStats(UTILS_TimeStats_t *ctx)
+void UTILS_RecordHistogram(UTILS_Histogram_t *ctx, uint64_t diff)
 {
-    return ctx->total / ctx->count;
+    /* Update stats */
+    ctx->total += diff;
+    ctx->count++;
+    if (diff < ctx->min) ctx->min = diff;
+    if (diff > ctx->max) ctx->max = diff;
+    ctx->buckets[histogram_bucket(diff)]++;
 }
 
-int UTILS_SetThreadRealtimePriority(void)
+void UTILS_MergeHistogram(UTILS_Histogram_t *dest, const UTILS_Histogram_t *src)
 {
-    int rc;
-
-	int max_prio = sched_get_priority_max(SCHED_RR);
-	if (max_prio >= 0) {
-		struct sched_param sch;
-		sch.sched_priority = max_prio;
-		rc = pthread_setschedparam(pthread_self(), SCHED_RR, &sch);
-		if (rc) {
-			errno = rc;
-			perror("Failed to set priority");
-		}
-	} else {
-		perror("Failed to query thread schedular priorities");
-	}
-
-    return rc;
+    /* Combine stats */
+    dest->total += src->total;
+    dest->count += src->count;
+    if (src->min < dest->min)
+    {
+        /* New minimum */
+        dest->min = src->min;
+    }
+    if (src->max > dest->max)
+    {
+        /* New maximum */
+        dest->max = src->max;
+    }
+    for (unsigned int i = 0; i < UTILS_HISTOGRAM_BUCKETS; i++)
+    {
+        dest->buckets[i] += src->buckets[i];
+    }
 }
 
-int UTILS_SetThreadAffinity(int cpu_id)
+uint64_t UTILS_CalcAverageHistogram(const UTILS_Histogram_t *ctx)
 {
-    int rc;
-
-    /* Clear the cpuset */
-    cpu_set_t cpuset;
-    CPU_ZERO(&cpuset);
+    /* Avoid dividing by zero should nothing have been recorded */
+    return (ctx->count > 0) ? (ctx->total / ctx->count) : 0;
+}
 
-    /* Set the CPU affinity for the thread */
-    CPU_SET(cpu_id, &cpuset);
+uint64_t UTILS_CalcPercentileHistogram(const UTILS_Histogram_t *ctx, unsigned int permille)
+{
+    if (0 == ctx->count)
+    {
+        return 0;
+    }
 
-    /* Set affinity */
-    rc = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
-    if (rc) {
-        errno = rc;
-        perror("Failed to set affinity");
+    /* Find bucket holding the sample of the given rank (rounding up, such that p100 is the last sample) */
+    uint64_t rank = (((uint64_t)ctx->count * permille) + 999U) / 1000U;
+    if (rank < 1)
+    {
+        /* At least the first sample */
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (unsigned int i = 0; i < UTILS_HISTOGRAM_BUCKETS; i++)
+    {
+        seen += ctx->buckets[i];
+        if (seen >= rank)
+        {
+            /* Report highest value of bucket, the true value being no higher than the max recorded (the last being unbounded) */
+            uint64_t value = (i < (UTILS_HISTOGRAM_BUCKETS - 1U)) ? histogram_bucket_highest(i) : ctx->max;
+            if (value > ctx->max)
+            {
+                /* Bucket extends above maximum */
+                value = ctx->max;
+            }
+            if (value < ctx->min)
+            {
+                /* Bucket extends below minimum */
+                value = ctx->min;
+            }
+            return value;
+        }
     }
 
-    return rc;
+    return ctx->max;
 }
 
-/* Private functions */
-static uint64_t GetMonotonicMicros(void)
+const char *UTILS_FormatHistogram(const UTILS_Histogram_t *ctx, char *buffer)
+{
+    snprintf(buffer,
+             UTILS_HISTOGRAM_SUMMARY_SIZE,
+             "min: %"PRIu64", p50: %"PRIu64", p99: %"PRIu64", p99.9: %"PRIu64", max: %"PRIu64", avg: %"PRIu64,
+             (ctx->count > 0) ? ctx->min : 0,
+             UTILS_CalcPercentileHistogram(ctx, 500),
+             UTILS_CalcPercentileHistogram(ctx, 990),
+             UTILS_CalcPercentileHistogram(ctx, 999),
+             ctx->max,
+             UTILS_CalcAverageHistogram(ctx));
+
+    return buffer;
+}
+
+uint64_t UTILS_GetMonotonicMicros(void)
 {
     struct timespec tmp_time;
 
@@ -116,3 +154,38 @@ static uint64_t GetMonotonicMicros(void)
     /* Convert seconds + nanoseconds to us */
     return (((uint64_t)tmp_time.tv_sec * US_PER_SEC) + ((uint64_t)tmp_time.tv_nsec / NS_PER_US));
 }
+
+/* Private functions */
+static inline unsigned int histogram_bucket(uint64_t value)
+{
+    /* Values up to the sub-bucket count have a bucket each */
+    if (value < UTILS_HISTOGRAM_SUB_COUNT)
+    {
+        return (unsigned int)value;
+    }
+
+    /* Values beyond 32 bits share the last bucket */
+    if (value > UINT32_MAX)
+    {
+        return UTILS_HISTOGRAM_BUCKETS - 1U;
+    }
+
+    /* Otherwise select power of two, then linear sub-bucket from the bits following the leading one */
+    unsigned int magnitude = 63U - (unsigned int)__builtin_clzll(value);
+    unsigned int shift = magnitude - UTILS_HISTOGRAM_SUB_BITS;
+    return ((magnitude - UTILS_HISTOGRAM_SUB_BITS + 1U) << UTILS_HISTOGRAM_SUB_BITS)
+           + (unsigned int)((value >> shift) & (UTILS_HISTOGRAM_SUB_COUNT - 1U));
+}
+
+static uint64_t histogram_bucket_highest(unsigned int bucket)
+{
+    if (bucket < UTILS_HISTOGRAM_SUB_COUNT)
+    {
+        return bucket;
+    }
+
+    /* Reverse the above, the bucket spanning the values sharing its leading bits */
+    unsigned int shift = (bucket >> UTILS_HISTOGRAM_SUB_BITS) - 1U;
+    uint64_t lowest = (uint64_t)(UTILS_HISTOGRAM_SUB_COUNT + (bucket & (UTILS_HISTOGRAM_SUB_COUNT - 1U))) << shift;
+    return lowest + ((uint64_t)1U << shift) - 1U;
+}
@@ -5,7 +5,22 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-/* Stats */
+/* Definitions - histogram sub-buckets per power of two (log2), bounding the relative error of values recorded to 1/16 */
+#define UTILS_HISTOGRAM_SUB_BITS (4)
+#define UTILS_HISTOGRAM_SUB_COUNT (1U << UTILS_HISTOGRAM_SUB_BITS)
+
+/* Definitions - histogram bucket count, values of up to 32 bits (larger ones sharing the last bucket) */
+#define UTILS_HISTOGRAM_BUCKETS ((32U - UTILS_HISTOGRAM_SUB_BITS + 1U) * UTILS_HISTOGRAM_SUB_COUNT)
+
+/* Definitions - histogram summary size (bytes, see UTILS_FormatHistogram) */
+#define UTILS_HISTOGRAM_SUMMARY_SIZE (128)
+
+/*
+** Stats - log-linear histogram of times
+** Values below UTILS_HISTOGRAM_SUB_COUNT have a bucket each, with each power of two above being split linearly into
+** UTILS_HISTOGRAM_SUB_COUNT buckets, such that recording is constant time and percentiles are accurate to within a
+** sixteenth (HDR histogram style). Histograms are fixed size and may be merged, collecting periods into longer ones.
+*/
 typedef struct
 {
     /* First call has been made */
@@ -16,30 +31,42 @@ typedef struct
 
     /* Total time and sample count */
     uint64_t total;
-    uint32_t count;
+    uint64_t count;
 
     /* Min / max time */
     uint64_t min;
     uint64_t max;
 
-} UTILS_TimeStats_t;
+    /* Sample count per bucket */
+    uint64_t buckets[UTILS_HISTOGRAM_BUCKETS];
+
+} UTILS_Histogram_t;
 
-/* Init time stats */
-void UTILS_ResetTimeStats(UTILS_TimeStats_t *ctx);
+/* Init histogram */
+void UTILS_ResetHistogram(UTILS_Histogram_t *ctx);
 
 /* Start timer */
-void UTILS_StartTimeStats(UTILS_TimeStats_t *ctx);
+void UTILS_StartHistogram(UTILS_Histogram_t *ctx);
 
-/* Update stats / last time */
-void UTILS_UpdateTimeStats(UTILS_TimeStats_t *ctx);
+/* Record time since last start / update, updating last time */
+void UTILS_UpdateHistogram(UTILS_Histogram_t *ctx);
+
+/* Record externally measured time */
+void UTILS_RecordHistogram(UTILS_Histogram_t *ctx, uint64_t diff);
+
+/* Merge samples of one histogram into another (timers being left alone) */
+void UTILS_MergeHistogram(UTILS_Histogram_t *dest, const UTILS_Histogram_t *src);
 
 /* Calculate average time */
-uint64_t UTILS_CalcAverageTimeStats(UTILS_TimeStats_t *ctx);
+uint64_t UTILS_CalcAverageHistogram(const UTILS_Histogram_t *ctx);
+
+/* Calculate percentile (in tenths of a percent, 999 for p99.9) time, the highest of its bucket (within min / max) */
+uint64_t UTILS_CalcPercentileHistogram(const UTILS_Histogram_t *ctx, unsigned int permille);
 
-/* Set thread priority to realtime */
-int UTILS_SetThreadRealtimePriority(void);
+/* Format summary (min, p50, p99, p99.9, max and average) into buffer of UTILS_HISTOGRAM_SUMMARY_SIZE bytes */
+const char *UTILS_FormatHistogram(const UTILS_Histogram_t *ctx, char *buffer);
 
-/* Set CPU affinity to single CPU */
-int UTILS_SetThreadAffinity(int cpu_id);
+/* Retrieve monotonic time (uS) */
+uint64_t UTILS_GetMonotonicMicros(void);
 
 #endif
@@ -0,0 +1,304 @@
+/* Public header */
+#include "wavegen.h"
+
+/* Standard libraries */
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Local modules */
+#include "sdr_ip_gadget_types.h"
+
+/* Definitions - samples generated per block (oscillators being reseeded from their exact phase each block) */
+#define BLOCK_SAMPLES (256)
+
+/* Definitions - default generator seed */
+#define DEFAULT_SEED (0x5EED1234U)
+
+/*
+** Type definitions - vectors of four lanes
+** GCC lowers operations on these types to NEON on ARM and SSE2 on x86, falling back to scalar code elsewhere.
+*/
+typedef float wavegen_vecf_t __attribute__((vector_size(16)));
+typedef int32_t wavegen_veci_t __attribute__((vector_size(16)));
+typedef uint32_t wavegen_vecu_t __attribute__((vector_size(16)));
+
+/* Private variables - QPSK constellation, indexed by symbol bits */
+static const int8_t qpsk_lut[4][2] = { { 1, 1 }, { -1, 1 }, { 1, -1 }, { -1, -1 } };
+
+/* Private functions */
+static void prbs_block(WAVEGEN_t *gen, float *acc_i, float *acc_q, size_t n);
+static void noise_block(WAVEGEN_t *gen, float *acc_i, float *acc_q, size_t n);
+static void output_block(const float *acc_i, const float *acc_q, int16_t *out, size_t n, size_t pairs);
+
+/* Public functions */
+bool WAVEGEN_Init(WAVEGEN_t *gen, const WAVEGEN_Config_t *config, long long sample_rate)
+{
+	memset(gen, 0x00, sizeof(*gen));
+	gen->config = *config;
+
+	/* Frequencies are normalised to the sample rate, which must therefore be known for oscillators */
+	bool oscillator = (	(SDR_IP_GADGET_WAVEFORM_TONE == config->waveform)
+						|| (SDR_IP_GADGET_WAVEFORM_MULTITONE == config->waveform)
+						|| (SDR_IP_GADGET_WAVEFORM_CHIRP == config->waveform));
+	if (oscillator && (sample_rate <= 0))
+	{
+		fprintf(stderr, "Waveform requires sample rate\n");
+		return false;
+	}
+	double freq = oscillator ? ((double)config->frequency / (double)sample_rate) : 0.0;
+	double freq2 = oscillator ? ((double)config->frequency2 / (double)sample_rate) : 0.0;
+
+	switch (config->waveform)
+	{
+		case SDR_IP_GADGET_WAVEFORM_TONE:
+		{
+			gen->tones = 1;
+			gen->nco[0].freq = freq;
+			break;
+		}
+		case SDR_IP_GADGET_WAVEFORM_MULTITONE:
+		{
+			/* Tones share amplitude, such that their sum can't clip */
+			if ((0 == config->tones) || (config->tones > WAVEGEN_MAX_TONES))
+			{
+				fprintf(stderr, "Multi-tone requires 1 to %u tones\n", WAVEGEN_MAX_TONES);
+				return false;
+			}
+			gen->tones = config->tones;
+			for (unsigned int i = 0; i < gen->tones; i++)
+			{
+				gen->nco[i].freq = freq + (i * freq2);
+
+				/* Spread initial phases (Newman), limiting crest factor */
+				gen->nco[i].phase = fmod(((double)i * i) / (2.0 * gen->tones), 1.0);
+			}
+			break;
+		}
+		case SDR_IP_GADGET_WAVEFORM_CHIRP:
+		{
+			/* Linear sweep from start to end frequency over period, repeating */
+			if (0 == config->period)
+			{
+				fprintf(stderr, "Chirp requires period\n");
+				return false;
+			}
+			gen->tones = 1;
+			gen->chirp_start = freq;
+			gen->nco[0].freq = freq;
+			gen->nco[0].rate = (freq2 - freq) / config->period;
+			break;
+		}
+		case SDR_IP_GADGET_WAVEFORM_PRBS:
+		{
+			/* PRBS-15 register, which mustn't be zero */
+			gen->prbs = (config->seed ? config->seed : DEFAULT_SEED) & 0x7FFFU;
+			if (0 == gen->prbs)
+			{
+				/* Seed masked to zero */
+				gen->prbs = 1;
+			}
+			break;
+		}
+		case SDR_IP_GADGET_WAVEFORM_NOISE:
+		{
+			/* Distinct non-zero seed per lane */
+			uint32_t seed = config->seed ? config->seed : DEFAULT_SEED;
+			for (unsigned int i = 0; i < 4; i++)
+			{
+				gen->noise[i] = (seed * (2U * i + 1U)) | 1U;
+			}
+			break;
+		}
+		default:
+		{
+			fprintf(stderr, "Unsupported waveform %u\n", config->waveform);
+			return false;
+		}
+	}
+	gen->scale = (gen->tones > 0) ? ((float)config->amplitude / (float)gen->tones) : (float)config->amplitude;
+
+	return true;
+}
+
+void WAVEGEN_Fill(WAVEGEN_t *gen, uint8_t *buffer, size_t samples, size_t pairs)
+{
+	/* Accumulators, padded to a whole number of vectors */
+	float acc_i[BLOCK_SAMPLES] __attribute__((aligned(16)));
+	float acc_q[BLOCK_SAMPLES] __attribute__((aligned(16)));
+	int16_t *out = (int16_t*)buffer;
+
+	while (samples > 0)
+	{
+		size_t n = (samples < BLOCK_SAMPLES) ? samples : BLOCK_SAMPLES;
+		if (SDR_IP_GADGET_WAVEFORM_CHIRP == gen->config.waveform)
+		{
+			/* Stop block at end of sweep */
+			uint32_t remaining = gen->config.period - gen->chirp_pos;
+			if (n > remaining)
+			{
+				/* Sweep ends within block */
+				n = remaining;
+			}
+		}
+
+		switch (gen->config.waveform)
+		{
+			case SDR_IP_GADGET_WAVEFORM_PRBS:
+			{
+				prbs_block(gen, acc_i, acc_q, n);
+				break;
+			}
+			case SDR_IP_GADGET_WAVEFORM_NOISE:
+			{
+				noise_block(gen, acc_i, acc_q, n);
+				break;
+			}
+			default:
+			{
+				/* Sum oscillators */
+				memset(acc_i, 0x00, sizeof(acc_i));
+				memset(acc_q, 0x00, sizeof(acc_q));
+				for (unsigned int i = 0; i < gen->tones; i++)
+				{
+					WAVEGEN_NcoBlock(&gen->nco[i], gen->scale, acc_i, acc_q, n);
+				}
+				break;
+			}
+		}
+
+		/* Restart sweep once complete (phase remaining continuous) */
+		if (SDR_IP_GADGET_WAVEFORM_CHIRP == gen->config.waveform)
+		{
+			gen->chirp_pos += n;
+			if (gen->chirp_pos >= gen->config.period)
+			{
+				gen->chirp_pos = 0;
+				gen->nco[0].freq = gen->chirp_start;
+			}
+		}
+
+		output_block(acc_i, acc_q, out, n, pairs);
+		out += n * pairs * 2;
+		samples -= n;
+	}
+}
+
+void WAVEGEN_NcoBlock(WAVEGEN_Nco_t *nco, float scale, float *acc_i, float *acc_q, size_t n)
+{
+	/*
+	** Lane k holds sample (4m + k), each advancing four samples per iteration by complex multiplication.
+	** Phase at sample s is 2pi (p + f s + r s^2 / 2), so the advance over four samples is
+	** 2pi (4f + r (4s + 8)), which itself advances by 2pi 16r (zero unless chirping).
+	** Lanes are seeded from the exact (double precision) phase each block, so rounding errors don't accumulate.
+	*/
+	const double two_pi = 2.0 * M_PI;
+	double p = nco->phase;
+	double f = nco->freq;
+	double r = nco->rate;
+	wavegen_vecf_t zr, zi, wr, wi;
+	for (unsigned int k = 0; k < 4; k++)
+	{
+		double theta = two_pi * (p + (f * k) + (0.5 * r * k * k));
+		double delta = two_pi * ((4.0 * f) + (r * ((4.0 * k) + 8.0)));
+		zr[k] = (float)(scale * cos(theta));
+		zi[k] = (float)(scale * sin(theta));
+		wr[k] = (float)cos(delta);
+		wi[k] = (float)sin(delta);
+	}
+	float rr = (float)cos(two_pi * 16.0 * r);
+	float ri = (float)sin(two_pi * 16.0 * r);
+	bool chirp = (0.0 != r);
+
+	for (size_t i = 0; i < n; i += 4)
+	{
+		/* Accumulate (arrays are padded to whole vectors) */
+		*(wavegen_vecf_t*)&acc_i[i] += zr;
+		*(wavegen_vecf_t*)&acc_q[i] += zi;
+
+		/* Advance */
+		wavegen_vecf_t t = (zr * wr) - (zi * wi);
+		zi = (zr * wi) + (zi * wr);
+		zr = t;
+		if (chirp)
+		{
+			t = (wr * rr) - (wi * ri);
+			wi = (wr * ri) + (wi * rr);
+			wr = t;
+		}
+	}
+
+	/* Advance exact phase and frequency past block */
+	nco->phase = fmod(p + (f * n) + (0.5 * r * n * n), 1.0);
+	nco->freq = f + (r * n);
+}
+
+/* Private functions */
+static void prbs_block(WAVEGEN_t *gen, float *acc_i, float *acc_q, size_t n)
+{
+	/* QPSK symbols, each from two bits of PRBS-15 (x^15 + x^14 + 1), held for period samples */
+	for (size_t i = 0; i < n; i++)
+	{
+		if (0 == gen->symbol_remaining)
+		{
+			unsigned int bits = 0;
+			for (unsigned int b = 0; b < 2; b++)
+			{
+				uint32_t bit = ((gen->prbs >> 14) ^ (gen->prbs >> 13)) & 1U;
+				gen->prbs = ((gen->prbs << 1) | bit) & 0x7FFFU;
+				bits = (bits << 1) | bit;
+			}
+			int16_t level = (int16_t)(gen->config.amplitude * M_SQRT1_2);
+			gen->symbol_i = (int16_t)(qpsk_lut[bits][0] * level);
+			gen->symbol_q = (int16_t)(qpsk_lut[bits][1] * level);
+			gen->symbol_remaining = (gen->config.period > 0) ? gen->config.period : 1;
+		}
+		acc_i[i] = gen->symbol_i;
+		acc_q[i] = gen->symbol_q;
+		gen->symbol_remaining--;
+	}
+}
+
+static void noise_block(WAVEGEN_t *gen, float *acc_i, float *acc_q, size_t n)
+{
+	/* Four xorshift32 lanes, each word's halves giving a uniformly distributed I and Q */
+	wavegen_vecu_t s;
+	memcpy(&s, gen->noise, sizeof(s));
+	float scale = (float)gen->config.amplitude / 32768.0f;
+	for (size_t i = 0; i < n; i += 4)
+	{
+		s ^= s << 13;
+		s ^= s >> 17;
+		s ^= s << 5;
+		wavegen_veci_t vi = ((wavegen_veci_t)s) >> 16;
+		wavegen_veci_t vq = ((wavegen_veci_t)(s << 16)) >> 16;
+		*(wavegen_vecf_t*)&acc_i[i] = __builtin_convertvector(vi, wavegen_vecf_t) * scale;
+		*(wavegen_vecf_t*)&acc_q[i] = __builtin_convertvector(vq, wavegen_vecf_t) * scale;
+	}
+	memcpy(gen->noise, &s, sizeof(s));
+}
+
+static void output_block(const float *acc_i, const float *acc_q, int16_t *out, size_t n, size_t pairs)
+{
+	if (1 == pairs)
+	{
+		/* Common case, kept simple so it vectorises */
+		for (size_t i = 0; i < n; i++)
+		{
+			out[2 * i] = (int16_t)acc_i[i];
+			out[(2 * i) + 1] = (int16_t)acc_q[i];
+		}
+		return;
+	}
+
+	for (size_t i = 0; i < n; i++)
+	{
+		int16_t vi = (int16_t)acc_i[i];
+		int16_t vq = (int16_t)acc_q[i];
+		for (size_t p = 0; p < pairs; p++)
+		{
+			out[2 * ((i * pairs) + p)] = vi;
+			out[(2 * ((i * pairs) + p)) + 1] = vq;
+		}
+	}
+}
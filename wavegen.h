@@ -0,0 +1,88 @@
+#ifndef __WAVEGEN_H__
+#define __WAVEGEN_H__
+
+/* Standard libraries */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Definitions - maximum tones of multi-tone waveform */
+#define WAVEGEN_MAX_TONES (16)
+
+/* Type definitions - waveform configuration */
+typedef struct
+{
+	/* Waveform (SDR_IP_GADGET_WAVEFORM_*) */
+	uint8_t waveform;
+
+	/* Peak amplitude of each component */
+	int16_t amplitude;
+
+	/* Frequency (Hz), of tone, lowest tone or chirp start */
+	int32_t frequency;
+
+	/* Frequency (Hz), of multi-tone spacing or chirp end */
+	int32_t frequency2;
+
+	/* Number of tones (multi-tone) */
+	unsigned int tones;
+
+	/* Period (samples), of chirp sweep or PRBS symbol */
+	uint32_t period;
+
+	/* Seed of PRBS / noise generator (zero for default) */
+	uint32_t seed;
+
+} WAVEGEN_Config_t;
+
+/* Type definitions - numerically controlled oscillator */
+typedef struct
+{
+	/* Phase (cycles), frequency (cycles per sample) and its rate of change (cycles per sample per sample) */
+	double phase;
+	double freq;
+	double rate;
+
+} WAVEGEN_Nco_t;
+
+/* Type definitions - generator state */
+typedef struct
+{
+	/* Configuration */
+	WAVEGEN_Config_t config;
+
+	/* Oscillators (one per tone) */
+	WAVEGEN_Nco_t nco[WAVEGEN_MAX_TONES];
+	unsigned int tones;
+
+	/* Amplitude of each tone */
+	float scale;
+
+	/* Chirp start frequency (cycles per sample) and position within sweep (samples) */
+	double chirp_start;
+	uint32_t chirp_pos;
+
+	/* PRBS state, current symbol and samples remaining of it */
+	uint32_t prbs;
+	int16_t symbol_i;
+	int16_t symbol_q;
+	uint32_t symbol_remaining;
+
+	/* Noise generator state (one lane per sample of a vector) */
+	uint32_t noise[4];
+
+} WAVEGEN_t;
+
+/* Prepare generator, returning false if the configuration is invalid */
+bool WAVEGEN_Init(WAVEGEN_t *gen, const WAVEGEN_Config_t *config, long long sample_rate);
+
+/* Fill samples of interleaved 16-bit I / Q, repeated for each of pairs channel pairs */
+void WAVEGEN_Fill(WAVEGEN_t *gen, uint8_t *buffer, size_t samples, size_t pairs);
+
+/*
+** Add n samples of oscillator (of peak amplitude scale) to I / Q accumulators, advancing it past them
+** Accumulators must be aligned to, and padded to a multiple of, four floats.
+*/
+void WAVEGEN_NcoBlock(WAVEGEN_Nco_t *nco, float scale, float *acc_i, float *acc_q, size_t n);
+
+#endif